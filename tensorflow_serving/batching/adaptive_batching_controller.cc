@@ -0,0 +1,229 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/batching/adaptive_batching_controller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+auto* target_batch_size_gauge = monitoring::Gauge<int64_t, 1>::New(
+    "/tensorflow/serving/batching/adaptive/target_batch_size",
+    "The batch size the adaptive batching controller forms batches at.",
+    "name");
+
+auto* batch_timeout_gauge = monitoring::Gauge<int64_t, 1>::New(
+    "/tensorflow/serving/batching/adaptive/batch_timeout_micros",
+    "The batch timeout (in microseconds) chosen by the adaptive batching "
+    "controller.",
+    "name");
+
+auto* arrival_rate_gauge = monitoring::Gauge<int64_t, 1>::New(
+    "/tensorflow/serving/batching/adaptive/arrival_rate",
+    "The arrival rate (in batch units per second) observed by the adaptive "
+    "batching controller.",
+    "name");
+
+}  // namespace
+
+Status AdaptiveBatchingController::Create(
+    const Options& options,
+    std::unique_ptr<AdaptiveBatchingController>* controller) {
+  if (options.latency_slo_micros <= 0) {
+    return errors::InvalidArgument("latency_slo_micros must be positive; was ",
+                                   options.latency_slo_micros);
+  }
+  if (options.max_batch_size <= 0) {
+    return errors::InvalidArgument("max_batch_size must be positive; was ",
+                                   options.max_batch_size);
+  }
+  for (int i = 0; i < options.candidate_batch_sizes.size(); ++i) {
+    const int64_t size = options.candidate_batch_sizes[i];
+    if (size <= 0 || size > options.max_batch_size) {
+      return errors::InvalidArgument(
+          "candidate_batch_sizes must be in (0, max_batch_size]; got ", size);
+    }
+    if (i > 0 && size <= options.candidate_batch_sizes[i - 1]) {
+      return errors::InvalidArgument(
+          "candidate_batch_sizes must be in increasing order");
+    }
+  }
+  if (options.min_batch_timeout_micros < 0 ||
+      options.max_batch_timeout_micros < options.min_batch_timeout_micros) {
+    return errors::InvalidArgument(
+        "Batch timeouts must satisfy 0 <= min_batch_timeout_micros <= "
+        "max_batch_timeout_micros; were ",
+        options.min_batch_timeout_micros, " and ",
+        options.max_batch_timeout_micros);
+  }
+  if (options.adjustment_interval_micros <= 0) {
+    return errors::InvalidArgument(
+        "adjustment_interval_micros must be positive; was ",
+        options.adjustment_interval_micros);
+  }
+  if (options.num_latency_samples <= 0) {
+    return errors::InvalidArgument("num_latency_samples must be positive; was ",
+                                   options.num_latency_samples);
+  }
+  if (options.arrival_rate_smoothing <= 0 ||
+      options.arrival_rate_smoothing > 1) {
+    return errors::InvalidArgument(
+        "arrival_rate_smoothing must be in (0, 1]; was ",
+        options.arrival_rate_smoothing);
+  }
+  controller->reset(new AdaptiveBatchingController(options));
+  return Status();
+}
+
+AdaptiveBatchingController::AdaptiveBatchingController(const Options& options)
+    : options_(options),
+      candidate_batch_sizes_(options.candidate_batch_sizes),
+      last_adjustment_time_micros_(options.env->NowMicros()) {
+  if (candidate_batch_sizes_.empty()) {
+    for (int64_t size = 1; size < options_.max_batch_size; size *= 2) {
+      candidate_batch_sizes_.push_back(size);
+    }
+    candidate_batch_sizes_.push_back(options_.max_batch_size);
+  }
+  latencies_.resize(candidate_batch_sizes_.size());
+  // Until batches have been observed, form the smallest ones.
+  absl::MutexLock l(&mu_);
+  SetDecisions(candidate_batch_sizes_.front(),
+               options_.min_batch_timeout_micros);
+}
+
+void AdaptiveBatchingController::RecordArrival(const size_t size) {
+  absl::MutexLock l(&mu_);
+  num_arrived_units_ += size;
+  MaybeAdjust();
+}
+
+void AdaptiveBatchingController::RecordBatchExecution(
+    const size_t batch_size, const int64_t execution_micros) {
+  absl::MutexLock l(&mu_);
+  LatencySamples& latencies = latencies_[CandidateIndex(batch_size)];
+  if (latencies.samples.size() < options_.num_latency_samples) {
+    latencies.samples.push_back(execution_micros);
+  } else {
+    latencies.samples[latencies.next_index] = execution_micros;
+    latencies.next_index =
+        (latencies.next_index + 1) % options_.num_latency_samples;
+  }
+  MaybeAdjust();
+}
+
+int AdaptiveBatchingController::CandidateIndex(const size_t batch_size) const {
+  const auto it =
+      std::lower_bound(candidate_batch_sizes_.begin(),
+                       candidate_batch_sizes_.end(),
+                       static_cast<int64_t>(batch_size));
+  if (it == candidate_batch_sizes_.end()) {
+    return candidate_batch_sizes_.size() - 1;
+  }
+  return it - candidate_batch_sizes_.begin();
+}
+
+int64_t AdaptiveBatchingController::EstimateExecutionMicros(const int i) const {
+  if (!latencies_[i].samples.empty()) {
+    std::vector<int64_t> samples = latencies_[i].samples;
+    const size_t p99_index = samples.size() * 99 / 100;
+    std::nth_element(samples.begin(), samples.begin() + p99_index,
+                     samples.end());
+    return samples[p99_index];
+  }
+  // Bigger batches take at most proportionally longer...
+  for (int j = i - 1; j >= 0; --j) {
+    if (!latencies_[j].samples.empty()) {
+      return EstimateExecutionMicros(j) * candidate_batch_sizes_[i] /
+             candidate_batch_sizes_[j];
+    }
+  }
+  // ... and smaller ones no longer.
+  for (int j = i + 1; j < candidate_batch_sizes_.size(); ++j) {
+    if (!latencies_[j].samples.empty()) {
+      return EstimateExecutionMicros(j);
+    }
+  }
+  return -1;
+}
+
+void AdaptiveBatchingController::MaybeAdjust() {
+  const uint64_t now_micros = options_.env->NowMicros();
+  const uint64_t elapsed_micros = now_micros - last_adjustment_time_micros_;
+  if (elapsed_micros < options_.adjustment_interval_micros) {
+    return;
+  }
+  const double interval_arrival_rate =
+      static_cast<double>(num_arrived_units_) / elapsed_micros;
+  arrival_rate_ = arrival_rate_ < 0
+                      ? interval_arrival_rate
+                      : options_.arrival_rate_smoothing * interval_arrival_rate +
+                            (1 - options_.arrival_rate_smoothing) *
+                                arrival_rate_;
+  num_arrived_units_ = 0;
+  last_adjustment_time_micros_ = now_micros;
+  arrival_rate_gauge->GetCell(options_.name)
+      ->Set(static_cast<int64_t>(arrival_rate_ * 1000 * 1000));
+
+  // The largest batch size expected to meet the objective, if any, or else
+  // the smallest one.
+  int best_index = 0;
+  int64_t best_execution_micros = EstimateExecutionMicros(0);
+  double best_fill_micros = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < candidate_batch_sizes_.size(); ++i) {
+    const int64_t execution_micros = EstimateExecutionMicros(i);
+    if (execution_micros < 0) {
+      // Nothing has been observed yet.
+      return;
+    }
+    const double fill_micros =
+        arrival_rate_ > 0 ? candidate_batch_sizes_[i] / arrival_rate_
+                          : std::numeric_limits<double>::infinity();
+    if (execution_micros + fill_micros <= options_.latency_slo_micros) {
+      best_index = i;
+      best_execution_micros = execution_micros;
+      best_fill_micros = fill_micros;
+    }
+  }
+  const double timeout_micros = std::max(
+      0.0, std::min(best_fill_micros,
+                    static_cast<double>(options_.latency_slo_micros -
+                                        best_execution_micros)));
+  SetDecisions(candidate_batch_sizes_[best_index],
+               std::clamp(static_cast<int64_t>(std::round(timeout_micros)),
+                          options_.min_batch_timeout_micros,
+                          options_.max_batch_timeout_micros));
+}
+
+void AdaptiveBatchingController::SetDecisions(
+    const int64_t target_batch_size, const int64_t batch_timeout_micros) {
+  target_batch_size_.store(target_batch_size, std::memory_order_relaxed);
+  batch_timeout_micros_.store(batch_timeout_micros, std::memory_order_relaxed);
+  target_batch_size_gauge->GetCell(options_.name)->Set(target_batch_size);
+  batch_timeout_gauge->GetCell(options_.name)->Set(batch_timeout_micros);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
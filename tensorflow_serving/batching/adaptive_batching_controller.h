@@ -0,0 +1,162 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_BATCHING_ADAPTIVE_BATCHING_CONTROLLER_H_
+#define TENSORFLOW_SERVING_BATCHING_ADAPTIVE_BATCHING_CONTROLLER_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Picks the batch size and batch timeout of a batch scheduler online, from
+// the observed arrival rate of tasks and the observed execution latency of
+// batches of each size, so as to keep the p99 latency of tasks within a
+// configured objective while forming batches as large as possible.
+//
+// The controller models the latency of a task in a batch of size B as the
+// time it takes for B units to arrive (bounded by the batch timeout) plus the
+// p99 execution latency of batches of size B. Every 'adjustment_interval_micros'
+// it picks the largest candidate batch size for which that sum is within
+// 'latency_slo_micros', and a batch timeout of the expected time to fill such
+// a batch (bounded by what is left of the objective after execution).
+// Execution latencies of batch sizes which haven't been observed yet are
+// extrapolated linearly from the closest smaller one that has, which
+// overestimates them and makes the controller grow batches gradually.
+//
+// The decisions are exported as gauges labeled with 'name'.
+//
+// This class is thread-safe.
+class AdaptiveBatchingController {
+ public:
+  struct Options {
+    // The p99 latency objective for tasks, from when they are scheduled until
+    // their batch has been processed, in microseconds.
+    int64_t latency_slo_micros = 100 * 1000;
+
+    // The batch sizes to choose from, in increasing order. If empty, powers of
+    // two up to 'max_batch_size' (and 'max_batch_size' itself) are used.
+    std::vector<int64_t> candidate_batch_sizes;
+
+    // The largest batch size to choose.
+    int64_t max_batch_size = 1000;
+
+    // The range of batch timeouts to choose from, in microseconds.
+    int64_t min_batch_timeout_micros = 0;
+    int64_t max_batch_timeout_micros = 100 * 1000;
+
+    // How often the batch size and timeout are re-evaluated, in microseconds.
+    int64_t adjustment_interval_micros = 1000 * 1000;
+
+    // The number of most recent execution latencies to keep per candidate
+    // batch size, to estimate their p99.
+    int num_latency_samples = 100;
+
+    // The weight of the latest adjustment interval in the moving average of
+    // the arrival rate, in (0, 1].
+    double arrival_rate_smoothing = 0.5;
+
+    // The label of the exported metrics, e.g. the name of the batch threads.
+    string name;
+
+    // The environment to use.
+    Env* env = Env::Default();
+  };
+
+  static Status Create(const Options& options,
+                       std::unique_ptr<AdaptiveBatchingController>* controller);
+
+  ~AdaptiveBatchingController() = default;
+
+  // Records that a task of 'size' units was scheduled.
+  void RecordArrival(size_t size);
+
+  // Records that processing a batch of 'batch_size' units took
+  // 'execution_micros'.
+  void RecordBatchExecution(size_t batch_size, int64_t execution_micros);
+
+  // The batch size to form batches at.
+  int64_t target_batch_size() const {
+    return target_batch_size_.load(std::memory_order_relaxed);
+  }
+
+  // How long the oldest task of a batch may wait for it to fill up, in
+  // microseconds.
+  int64_t batch_timeout_micros() const {
+    return batch_timeout_micros_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // The most recent execution latencies of the batches of one candidate size.
+  struct LatencySamples {
+    std::vector<int64_t> samples;
+    size_t next_index = 0;
+  };
+
+  explicit AdaptiveBatchingController(const Options& options);
+
+  // Returns the index in 'candidate_batch_sizes_' of the smallest candidate of
+  // at least 'batch_size' (or the largest one).
+  int CandidateIndex(size_t batch_size) const;
+
+  // Returns the estimated p99 execution latency of batches of the i-th
+  // candidate size, or -1 if no batch has been observed yet.
+  int64_t EstimateExecutionMicros(int i) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Re-evaluates the decisions if 'adjustment_interval_micros' have passed
+  // since they last were.
+  void MaybeAdjust() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Updates and exports the decisions.
+  void SetDecisions(int64_t target_batch_size, int64_t batch_timeout_micros)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Options options_;
+  std::vector<int64_t> candidate_batch_sizes_;
+
+  std::atomic<int64_t> target_batch_size_;
+  std::atomic<int64_t> batch_timeout_micros_;
+
+  mutable absl::Mutex mu_;
+  // Parallel to 'candidate_batch_sizes_'.
+  std::vector<LatencySamples> latencies_ ABSL_GUARDED_BY(mu_);
+  // The number of units scheduled since 'last_adjustment_time_micros_'.
+  int64_t num_arrived_units_ ABSL_GUARDED_BY(mu_) = 0;
+  // The moving average of the arrival rate, in units per microsecond, or -1
+  // before the first adjustment.
+  double arrival_rate_ ABSL_GUARDED_BY(mu_) = -1;
+  uint64_t last_adjustment_time_micros_ ABSL_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AdaptiveBatchingController);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_BATCHING_ADAPTIVE_BATCHING_CONTROLLER_H_
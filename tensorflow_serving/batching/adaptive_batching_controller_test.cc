@@ -0,0 +1,196 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/batching/adaptive_batching_controller.h"
+
+#include <cstdint>
+#include <memory>
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/kernels/batching_util/fake_clock_env.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+constexpr int64_t kAdjustmentIntervalMicros = 1000 * 1000;
+
+// Feeds 'controller' with one adjustment interval worth of traffic: tasks of
+// one unit arriving every 'arrival_interval_micros', processed in batches of
+// the controller's target size which take 'base_micros' plus
+// 'per_unit_micros' per unit.
+void SimulateInterval(int64_t arrival_interval_micros, int64_t base_micros,
+                      int64_t per_unit_micros,
+                      test_util::FakeClockEnv* env,
+                      AdaptiveBatchingController* controller) {
+  const int64_t batch_size = controller->target_batch_size();
+  int64_t num_pending = 0;
+  for (int64_t elapsed_micros = 0; elapsed_micros < kAdjustmentIntervalMicros;
+       elapsed_micros += arrival_interval_micros) {
+    controller->RecordArrival(1);
+    if (++num_pending == batch_size) {
+      controller->RecordBatchExecution(batch_size,
+                                       base_micros + per_unit_micros * batch_size);
+      num_pending = 0;
+    }
+    env->AdvanceByMicroseconds(arrival_interval_micros);
+  }
+}
+
+AdaptiveBatchingController::Options DefaultOptions(
+    test_util::FakeClockEnv* env) {
+  AdaptiveBatchingController::Options options;
+  options.latency_slo_micros = 10 * 1000;
+  options.max_batch_size = 64;
+  options.min_batch_timeout_micros = 0;
+  options.max_batch_timeout_micros = 10 * 1000;
+  options.adjustment_interval_micros = kAdjustmentIntervalMicros;
+  options.env = env;
+  return options;
+}
+
+TEST(AdaptiveBatchingControllerTest, StartsWithSmallestBatches) {
+  test_util::FakeClockEnv env(Env::Default());
+  AdaptiveBatchingController::Options options = DefaultOptions(&env);
+  options.min_batch_timeout_micros = 100;
+  std::unique_ptr<AdaptiveBatchingController> controller;
+  TF_ASSERT_OK(AdaptiveBatchingController::Create(options, &controller));
+  EXPECT_EQ(1, controller->target_batch_size());
+  EXPECT_EQ(100, controller->batch_timeout_micros());
+
+  // No batch has been processed, so there is nothing to base decisions on.
+  controller->RecordArrival(1);
+  env.AdvanceByMicroseconds(kAdjustmentIntervalMicros);
+  controller->RecordArrival(1);
+  EXPECT_EQ(1, controller->target_batch_size());
+  EXPECT_EQ(100, controller->batch_timeout_micros());
+}
+
+TEST(AdaptiveBatchingControllerTest, GrowsBatchesUnderHighLoad) {
+  test_util::FakeClockEnv env(Env::Default());
+  std::unique_ptr<AdaptiveBatchingController> controller;
+  TF_ASSERT_OK(
+      AdaptiveBatchingController::Create(DefaultOptions(&env), &controller));
+
+  // One unit every 10 microseconds, so that a batch of 64 fills up in 640
+  // microseconds and takes 100 + 640 to process, well within the objective.
+  for (int i = 0; i < 10; ++i) {
+    SimulateInterval(10, 100, 10, &env, controller.get());
+  }
+  EXPECT_EQ(64, controller->target_batch_size());
+  EXPECT_EQ(640, controller->batch_timeout_micros());
+}
+
+TEST(AdaptiveBatchingControllerTest, LimitsBatchesUnderLowLoad) {
+  test_util::FakeClockEnv env(Env::Default());
+  std::unique_ptr<AdaptiveBatchingController> controller;
+  TF_ASSERT_OK(
+      AdaptiveBatchingController::Create(DefaultOptions(&env), &controller));
+
+  // One unit every millisecond: a batch of 8 fills up in 8 milliseconds and
+  // takes 180 microseconds to process, but one of 16 would take too long to
+  // fill up.
+  for (int i = 0; i < 10; ++i) {
+    SimulateInterval(1000, 100, 10, &env, controller.get());
+  }
+  EXPECT_EQ(8, controller->target_batch_size());
+  EXPECT_EQ(8000, controller->batch_timeout_micros());
+
+  // Once traffic picks up, batches grow again.
+  for (int i = 0; i < 10; ++i) {
+    SimulateInterval(10, 100, 10, &env, controller.get());
+  }
+  EXPECT_EQ(64, controller->target_batch_size());
+}
+
+TEST(AdaptiveBatchingControllerTest, ShrinksBatchesWhenExecutionSlowsDown) {
+  test_util::FakeClockEnv env(Env::Default());
+  std::unique_ptr<AdaptiveBatchingController> controller;
+  TF_ASSERT_OK(
+      AdaptiveBatchingController::Create(DefaultOptions(&env), &controller));
+  for (int i = 0; i < 10; ++i) {
+    SimulateInterval(10, 100, 10, &env, controller.get());
+  }
+  ASSERT_EQ(64, controller->target_batch_size());
+
+  // Each unit now takes 200 microseconds to process, so only batches of up to
+  // 32 (which take 6.5 milliseconds, plus 320 microseconds to fill up) meet
+  // the objective.
+  for (int i = 0; i < 10; ++i) {
+    SimulateInterval(10, 100, 200, &env, controller.get());
+  }
+  EXPECT_EQ(32, controller->target_batch_size());
+  EXPECT_EQ(320, controller->batch_timeout_micros());
+}
+
+TEST(AdaptiveBatchingControllerTest, FallsBackToSmallestBatches) {
+  test_util::FakeClockEnv env(Env::Default());
+  AdaptiveBatchingController::Options options = DefaultOptions(&env);
+  options.candidate_batch_sizes = {4, 16, 64};
+  std::unique_ptr<AdaptiveBatchingController> controller;
+  TF_ASSERT_OK(AdaptiveBatchingController::Create(options, &controller));
+  EXPECT_EQ(4, controller->target_batch_size());
+
+  // Even the smallest batches take longer than the objective to process.
+  for (int i = 0; i < 10; ++i) {
+    SimulateInterval(10, 20 * 1000, 0, &env, controller.get());
+  }
+  EXPECT_EQ(4, controller->target_batch_size());
+  EXPECT_EQ(0, controller->batch_timeout_micros());
+}
+
+TEST(AdaptiveBatchingControllerTest, ClampsBatchTimeout) {
+  test_util::FakeClockEnv env(Env::Default());
+  AdaptiveBatchingController::Options options = DefaultOptions(&env);
+  options.max_batch_timeout_micros = 5000;
+  std::unique_ptr<AdaptiveBatchingController> controller;
+  TF_ASSERT_OK(AdaptiveBatchingController::Create(options, &controller));
+  for (int i = 0; i < 10; ++i) {
+    SimulateInterval(1000, 100, 10, &env, controller.get());
+  }
+  EXPECT_EQ(8, controller->target_batch_size());
+  EXPECT_EQ(5000, controller->batch_timeout_micros());
+}
+
+TEST(AdaptiveBatchingControllerTest, InvalidOptions) {
+  test_util::FakeClockEnv env(Env::Default());
+  std::unique_ptr<AdaptiveBatchingController> controller;
+
+  AdaptiveBatchingController::Options options = DefaultOptions(&env);
+  options.latency_slo_micros = 0;
+  EXPECT_FALSE(AdaptiveBatchingController::Create(options, &controller).ok());
+
+  options = DefaultOptions(&env);
+  options.candidate_batch_sizes = {4, 2};
+  EXPECT_FALSE(AdaptiveBatchingController::Create(options, &controller).ok());
+
+  options = DefaultOptions(&env);
+  options.candidate_batch_sizes = {2, 128};
+  EXPECT_FALSE(AdaptiveBatchingController::Create(options, &controller).ok());
+
+  options = DefaultOptions(&env);
+  options.min_batch_timeout_micros = 100;
+  options.max_batch_timeout_micros = 10;
+  EXPECT_FALSE(AdaptiveBatchingController::Create(options, &controller).ok());
+
+  options = DefaultOptions(&env);
+  options.arrival_rate_smoothing = 0;
+  EXPECT_FALSE(AdaptiveBatchingController::Create(options, &controller).ok());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,130 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/batching/batch_tensor_pool.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/batch_util.h"
+#include "tensorflow_serving/batching/batching_util.h"
+
+namespace tensorflow {
+namespace serving {
+
+BatchTensorPool::BatchTensorPool(const int max_pooled_tensors)
+    : max_pooled_tensors_(max_pooled_tensors) {}
+
+Tensor BatchTensorPool::Get(const DataType dtype, const TensorShape& shape) {
+  absl::MutexLock l(&mu_);
+  int free_index = -1;
+  for (int i = 0; i < tensors_.size(); ++i) {
+    const Tensor& tensor = tensors_[i];
+    if (!tensor.RefCountIsOne()) {
+      continue;
+    }
+    if (tensor.dtype() == dtype && tensor.shape() == shape) {
+      return tensor;
+    }
+    free_index = i;
+  }
+  Tensor tensor(dtype, shape);
+  ++num_allocations_;
+  if (tensors_.size() < max_pooled_tensors_) {
+    tensors_.push_back(tensor);
+  } else if (free_index >= 0) {
+    tensors_[free_index] = tensor;
+  }
+  return tensor;
+}
+
+int64_t BatchTensorPool::num_allocations() const {
+  absl::MutexLock l(&mu_);
+  return num_allocations_;
+}
+
+Status ConcatIntoPooledTensor(const std::vector<Tensor>& tensors,
+                              BatchTensorPool* pool, Tensor* result) {
+  if (tensors.empty()) {
+    return errors::InvalidArgument("Cannot concatenate zero tensors");
+  }
+  const Tensor& first_tensor = tensors[0];
+  if (first_tensor.dims() == 0) {
+    return errors::InvalidArgument("Cannot concatenate scalars");
+  }
+  int64_t num_rows = 0;
+  for (const Tensor& tensor : tensors) {
+    if (tensor.dtype() != first_tensor.dtype()) {
+      return errors::InvalidArgument(
+          "Cannot concatenate tensors of different types");
+    }
+    if (!AreShapesEqualExceptZeroDim(tensor.shape(), first_tensor.shape())) {
+      return errors::InvalidArgument(
+          "Cannot concatenate tensors of shapes ", tensor.shape().DebugString(),
+          " and ", first_tensor.shape().DebugString());
+    }
+    num_rows += tensor.dim_size(0);
+  }
+
+  TensorShape shape = first_tensor.shape();
+  shape.set_dim(0, num_rows);
+  *result = pool->Get(first_tensor.dtype(), shape);
+  int64_t row = 0;
+  for (const Tensor& tensor : tensors) {
+    if (tensor.dim_size(0) > 0) {
+      TF_RETURN_IF_ERROR(batch_util::CopyContiguousSlices(
+          tensor, 0, row, tensor.dim_size(0), result));
+    }
+    row += tensor.dim_size(0);
+  }
+  return absl::OkStatus();
+}
+
+Status SplitIntoSlices(const Tensor& tensor, absl::Span<const int64_t> sizes,
+                       std::vector<Tensor>* result) {
+  if (tensor.dims() == 0) {
+    return errors::InvalidArgument("Cannot split a scalar");
+  }
+  int64_t num_rows = 0;
+  for (const int64_t size : sizes) {
+    num_rows += size;
+  }
+  if (num_rows != tensor.dim_size(0)) {
+    return errors::InvalidArgument("Split sizes add up to ", num_rows,
+                                   " rows, but the tensor has ",
+                                   tensor.dim_size(0));
+  }
+
+  result->clear();
+  result->reserve(sizes.size());
+  int64_t start_row = 0;
+  for (const int64_t size : sizes) {
+    Tensor slice = tensor.Slice(start_row, start_row + size);
+    // Callers may use the pieces with methods that require alignment, e.g.
+    // flat().
+    if (!slice.IsAligned()) {
+      slice = tensor::DeepCopy(slice);
+    }
+    result->push_back(std::move(slice));
+    start_row += size;
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,83 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_BATCHING_BATCH_TENSOR_POOL_H_
+#define TENSORFLOW_SERVING_BATCHING_BATCH_TENSOR_POOL_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A pool of tensors to merge the inputs of batches into, so that batches of
+// the same (e.g. allowed) sizes reuse the same buffers instead of allocating
+// new ones.
+//
+// A pooled tensor is only handed out again once nothing but the pool
+// references its buffer, i.e. once the batch it was used for is done with it
+// and no output aliases it.
+//
+// This class is thread-safe.
+class BatchTensorPool {
+ public:
+  // Keeps up to 'max_pooled_tensors' tensors.
+  explicit BatchTensorPool(int max_pooled_tensors = 32);
+
+  // Returns a tensor of 'dtype' and 'shape', whose contents are undefined.
+  // Reuses a pooled tensor if one is free, and otherwise allocates one, which
+  // replaces a free pooled tensor (of another type or shape) if the pool is
+  // full.
+  Tensor Get(DataType dtype, const TensorShape& shape);
+
+  // The number of tensors Get() has allocated.
+  int64_t num_allocations() const;
+
+ private:
+  const int max_pooled_tensors_;
+
+  mutable absl::Mutex mu_;
+  std::vector<Tensor> tensors_ ABSL_GUARDED_BY(mu_);
+  int64_t num_allocations_ ABSL_GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BatchTensorPool);
+};
+
+// Concatenates 'tensors' along the 0th dimension into a tensor from 'pool',
+// copying each of them once, straight into its rows. All of 'tensors' must
+// have the same type and the same dimensions, except for the 0th one.
+Status ConcatIntoPooledTensor(const std::vector<Tensor>& tensors,
+                              BatchTensorPool* pool, Tensor* result);
+
+// Splits 'tensor' along the 0th dimension into tensors of 'sizes' rows, which
+// must add up to the 0th dimension size of 'tensor'. The pieces share the
+// buffer of 'tensor' rather than copying it, except for those which wouldn't
+// be aligned, and are copied instead.
+Status SplitIntoSlices(const Tensor& tensor, absl::Span<const int64_t> sizes,
+                       std::vector<Tensor>* result);
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_BATCHING_BATCH_TENSOR_POOL_H_
@@ -0,0 +1,128 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks for merging the inputs of a batch and splitting its outputs, the
+// way BatchingSession does, with tensor::Concat() and tensor::Split() against
+// ConcatIntoPooledTensor() and SplitIntoSlices().
+//
+// Besides the throughput, each benchmark reports the number of allocations of
+// the CPU allocator per batch.
+//
+// Run with:
+// bazel run -c opt \
+// tensorflow_serving/batching:batch_tensor_pool_benchmark --
+// --benchmarks=.
+
+#include <cstdint>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow_serving/batching/batch_tensor_pool.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// The number of floats in each row of the inputs and outputs.
+constexpr int64_t kRowSize = 256;
+
+int64_t NumCpuAllocations() {
+  return cpu_allocator()->GetStats()->num_allocs;
+}
+
+// The inputs of 'num_tasks' tasks of 'task_size' rows each.
+std::vector<Tensor> MakeTaskInputs(int num_tasks, int task_size) {
+  std::vector<Tensor> inputs;
+  for (int i = 0; i < num_tasks; ++i) {
+    Tensor input(DT_FLOAT, {task_size, kRowSize});
+    input.flat<float>().setConstant(i);
+    inputs.push_back(input);
+  }
+  return inputs;
+}
+
+void SetCounters(int64_t num_allocations, int num_tasks, int task_size,
+                 ::testing::benchmark::State& state) {
+  state.SetItemsProcessed(num_tasks * state.iterations());
+  state.SetBytesProcessed(2 * num_tasks * task_size * kRowSize * sizeof(float) *
+                          state.iterations());
+  state.counters["allocs_per_batch"] =
+      static_cast<double>(num_allocations) / state.iterations();
+}
+
+void BM_ConcatAndSplit(::testing::benchmark::State& state) {
+  const int num_tasks = state.range(0);
+  const int task_size = state.range(1);
+  const std::vector<Tensor> inputs = MakeTaskInputs(num_tasks, task_size);
+  const std::vector<int64_t> sizes(num_tasks, task_size);
+
+  const int64_t start_allocations = NumCpuAllocations();
+  for (auto s : state) {
+    Tensor merged;
+    CHECK_OK(tensor::Concat(inputs, &merged));
+    std::vector<Tensor> outputs;
+    CHECK_OK(tensor::Split(merged, sizes, &outputs));
+  }
+  SetCounters(NumCpuAllocations() - start_allocations, num_tasks, task_size,
+              state);
+}
+
+void BM_PooledConcatAndSplitIntoSlices(::testing::benchmark::State& state) {
+  const int num_tasks = state.range(0);
+  const int task_size = state.range(1);
+  const std::vector<Tensor> inputs = MakeTaskInputs(num_tasks, task_size);
+  const std::vector<int64_t> sizes(num_tasks, task_size);
+  BatchTensorPool pool;
+
+  const int64_t start_allocations = NumCpuAllocations();
+  for (auto s : state) {
+    Tensor merged;
+    CHECK_OK(ConcatIntoPooledTensor(inputs, &pool, &merged));
+    std::vector<Tensor> outputs;
+    CHECK_OK(SplitIntoSlices(merged, sizes, &outputs));
+  }
+  SetCounters(NumCpuAllocations() - start_allocations, num_tasks, task_size,
+              state);
+}
+
+// Args are {number of tasks, rows per task}.
+
+BENCHMARK(BM_ConcatAndSplit)
+    ->ArgPair(8, 1)
+    ->ArgPair(32, 1)
+    ->ArgPair(32, 8)
+    ->ArgPair(128, 4);
+
+BENCHMARK(BM_PooledConcatAndSplitIntoSlices)
+    ->ArgPair(8, 1)
+    ->ArgPair(32, 1)
+    ->ArgPair(32, 8)
+    ->ArgPair(128, 4);
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  tensorflow::EnableCPUAllocatorStats();
+  tensorflow::testing::RunBenchmarks();
+  return 0;
+}
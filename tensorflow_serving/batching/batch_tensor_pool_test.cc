@@ -0,0 +1,151 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/batching/batch_tensor_pool.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/tstring.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+TEST(BatchTensorPoolTest, ReusesFreeTensors) {
+  BatchTensorPool pool;
+  const void* data;
+  {
+    Tensor tensor = pool.Get(DT_FLOAT, {4, 2});
+    data = tensor.tensor_data().data();
+    // Still in use, so a new tensor is allocated.
+    Tensor other_tensor = pool.Get(DT_FLOAT, {4, 2});
+    EXPECT_NE(data, other_tensor.tensor_data().data());
+    EXPECT_EQ(2, pool.num_allocations());
+  }
+  Tensor tensor = pool.Get(DT_FLOAT, {4, 2});
+  EXPECT_EQ(2, pool.num_allocations());
+  EXPECT_EQ(DT_FLOAT, tensor.dtype());
+  EXPECT_EQ(TensorShape({4, 2}), tensor.shape());
+
+  // Different types and shapes aren't interchangeable.
+  pool.Get(DT_INT32, {4, 2});
+  pool.Get(DT_FLOAT, {8, 2});
+  EXPECT_EQ(4, pool.num_allocations());
+}
+
+TEST(BatchTensorPoolTest, SlicesKeepTensorsInUse) {
+  BatchTensorPool pool;
+  Tensor slice = pool.Get(DT_FLOAT, {4, 2}).Slice(0, 1);
+  pool.Get(DT_FLOAT, {4, 2});
+  EXPECT_EQ(2, pool.num_allocations());
+}
+
+TEST(BatchTensorPoolTest, ReplacesFreeTensorsWhenFull) {
+  BatchTensorPool pool(1);
+  pool.Get(DT_FLOAT, {1});
+  pool.Get(DT_FLOAT, {2});
+  pool.Get(DT_FLOAT, {2});
+  EXPECT_EQ(2, pool.num_allocations());
+  pool.Get(DT_FLOAT, {1});
+  EXPECT_EQ(3, pool.num_allocations());
+}
+
+TEST(BatchTensorPoolTest, ConcatIntoPooledTensor) {
+  BatchTensorPool pool;
+  const std::vector<Tensor> tensors = {
+      test::AsTensor<float>({1, 2, 3, 4}, {2, 2}),
+      test::AsTensor<float>({5, 6}, {1, 2}),
+      test::AsTensor<float>({1, 2}, {1, 2})};
+  Tensor result;
+  TF_ASSERT_OK(ConcatIntoPooledTensor(tensors, &pool, &result));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1, 2, 3, 4, 5, 6, 1, 2}, {4, 2}), result);
+
+  // Merging a batch of the same shape reuses the buffer once it is free.
+  result = Tensor();
+  TF_ASSERT_OK(ConcatIntoPooledTensor(tensors, &pool, &result));
+  EXPECT_EQ(1, pool.num_allocations());
+}
+
+TEST(BatchTensorPoolTest, ConcatStringsIntoPooledTensor) {
+  BatchTensorPool pool;
+  Tensor result;
+  TF_ASSERT_OK(ConcatIntoPooledTensor(
+      {test::AsTensor<tstring>({"a", "b"}, {2}),
+       test::AsTensor<tstring>({"c"}, {1})},
+      &pool, &result));
+  test::ExpectTensorEqual<tstring>(
+      test::AsTensor<tstring>({"a", "b", "c"}, {3}), result);
+}
+
+TEST(BatchTensorPoolTest, ConcatIntoPooledTensorErrors) {
+  BatchTensorPool pool;
+  Tensor result;
+  EXPECT_FALSE(ConcatIntoPooledTensor({}, &pool, &result).ok());
+  EXPECT_FALSE(
+      ConcatIntoPooledTensor({test::AsScalar<float>(1)}, &pool, &result).ok());
+  EXPECT_FALSE(ConcatIntoPooledTensor({test::AsTensor<float>({1, 2}, {1, 2}),
+                                       test::AsTensor<float>({1}, {1, 1})},
+                                      &pool, &result)
+                   .ok());
+  EXPECT_FALSE(ConcatIntoPooledTensor({test::AsTensor<float>({1}, {1}),
+                                       test::AsTensor<int32>({1}, {1})},
+                                      &pool, &result)
+                   .ok());
+}
+
+TEST(BatchTensorPoolTest, SplitIntoAlignedSlices) {
+  // Rows of 16 floats, i.e. 64 bytes, so that every slice is aligned.
+  Tensor tensor(DT_FLOAT, {4, 16});
+  for (int i = 0; i < tensor.NumElements(); ++i) {
+    tensor.flat<float>()(i) = i;
+  }
+  std::vector<Tensor> split;
+  TF_ASSERT_OK(SplitIntoSlices(tensor, {1, 3}, &split));
+  ASSERT_EQ(2, split.size());
+  EXPECT_EQ(TensorShape({1, 16}), split[0].shape());
+  EXPECT_EQ(TensorShape({3, 16}), split[1].shape());
+  // Not copied.
+  EXPECT_EQ(tensor.tensor_data().data(), split[0].tensor_data().data());
+  EXPECT_EQ(tensor.tensor_data().data() + 64, split[1].tensor_data().data());
+  EXPECT_EQ(16, split[1].flat<float>()(0));
+}
+
+TEST(BatchTensorPoolTest, SplitCopiesUnalignedSlices) {
+  const Tensor tensor = test::AsTensor<float>({1, 2, 3}, {3, 1});
+  std::vector<Tensor> split;
+  TF_ASSERT_OK(SplitIntoSlices(tensor, {1, 2}, &split));
+  ASSERT_EQ(2, split.size());
+  EXPECT_EQ(tensor.tensor_data().data(), split[0].tensor_data().data());
+  EXPECT_TRUE(split[1].IsAligned());
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({1}, {1, 1}), split[0]);
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({2, 3}, {2, 1}),
+                                 split[1]);
+}
+
+TEST(BatchTensorPoolTest, SplitIntoSlicesErrors) {
+  std::vector<Tensor> split;
+  EXPECT_FALSE(SplitIntoSlices(test::AsScalar<float>(1), {1}, &split).ok());
+  EXPECT_FALSE(
+      SplitIntoSlices(test::AsTensor<float>({1, 2}, {2}), {1}, &split).ok());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
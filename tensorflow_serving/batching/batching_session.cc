@@ -17,7 +17,9 @@ limitations under the License.
 
 #include <stddef.h>
 
+#include <algorithm>
 #include <functional>
+#include <limits>
 #include <map>
 #include <memory>
 #include <string>
@@ -26,6 +28,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/fixed_array.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/notification.h"
 #include "tensorflow/core/framework/cost_graph.pb.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -45,6 +48,7 @@ limitations under the License.
 #include "tensorflow/core/profiler/lib/traceme.h"
 #include "tensorflow/core/profiler/lib/traceme_encode.h"
 #include "tensorflow/core/public/session.h"
+#include "tensorflow_serving/batching/batch_tensor_pool.h"
 #include "tensorflow_serving/batching/batching_util.h"
 #include "tensorflow_serving/batching/incremental_barrier.h"
 #include "tensorflow_serving/batching/threadsafe_status.h"
@@ -56,10 +60,10 @@ namespace serving {
 
 namespace {
 
-auto* queuing_latency = monitoring::Sampler<1>::New(
+auto* queuing_latency = monitoring::Sampler<2>::New(
     {"/tensorflow/serving/batching_session/queuing_latency",
      "Distribution of wall time spent (in microseconds) in queuing",
-     "thread_pool_name"},
+     "thread_pool_name", "priority"},
     // Scale of 100, power of 1.2 with bucket count 52 (~1 second).
     monitoring::Buckets::Exponential(100, 1.2, 52));
 
@@ -67,6 +71,41 @@ auto* wrapped_run_count = monitoring::Counter<0>::New(
     "/tensorflow/serving/batching_session/wrapped_run_count",
     "Total count of run calls on the wrapped session");
 
+// Propagates 'status' to 'task' and signals that it is done.
+void CompleteTask(const absl::Status& status, BatchingSessionTask* task) {
+  if (task->is_partial) {
+    task->thread_safe_status->Update(status);
+    task->done_callback();
+  } else {
+    *task->status = status;
+    task->done->Notify();
+  }
+}
+
+// Fails the tasks of 'batch' that are past their deadline at 'now_micros', and
+// returns a new closed batch with the remaining tasks, in the same order.
+std::unique_ptr<Batch<BatchingSessionTask>> ShedExpiredTasks(
+    const uint64_t now_micros,
+    std::unique_ptr<Batch<BatchingSessionTask>> batch) {
+  std::vector<std::unique_ptr<BatchingSessionTask>> tasks(batch->num_tasks());
+  for (int i = tasks.size() - 1; i >= 0; --i) {
+    tasks[i] = batch->RemoveTask();
+  }
+  auto live_batch = std::make_unique<Batch<BatchingSessionTask>>();
+  const absl::Status expired_status = absl::Status(
+      absl::StatusCode::kResourceExhausted,
+      "Run() timeout exceeded while waiting in batching queue");
+  for (std::unique_ptr<BatchingSessionTask>& task : tasks) {
+    if (task->deadline_micros() > now_micros) {
+      live_batch->AddTask(std::move(task));
+    } else {
+      CompleteTask(expired_status, task.get());
+    }
+  }
+  live_batch->Close();
+  return live_batch;
+}
+
 string TensorSignatureDebugString(const TensorSignature& signature) {
   return strings::StrCat("{input_tensors: <",
                          absl::StrJoin(signature.input_tensors, ", "),
@@ -262,6 +301,9 @@ class BatchingSession : public ServingSession {
                                   const std::vector<Tensor>& combined_outputs,
                                   Batch<BatchingSessionTask>* batch);
 
+  // Returns the pool to merge the inputs of batches with 'signature' into.
+  BatchTensorPool* GetBatchTensorPool(const TensorSignature& signature);
+
   // Splits RunMetadata parts (e.g. costgraph attribution) into individual task
   // outputs.
   absl::Status SplitRunMetadata(RunMetadata* batch_metadata,
@@ -278,6 +320,14 @@ class BatchingSession : public ServingSession {
   const std::string thread_pool_name_;
 
   std::unique_ptr<Session> wrapped_;
+
+  // The buffers the inputs of batches are merged into, per signature. (They
+  // must outlive the batch schedulers, whose threads use them.)
+  absl::Mutex batch_tensor_pools_mu_;
+  std::unordered_map<TensorSignature, std::unique_ptr<BatchTensorPool>,
+                     HashTensorSignature, EqTensorSignature>
+      batch_tensor_pools_ ABSL_GUARDED_BY(batch_tensor_pools_mu_);
+
   std::unordered_map<TensorSignature,
                      std::unique_ptr<BatchScheduler<BatchingSessionTask>>,
                      HashTensorSignature, EqTensorSignature>
@@ -569,6 +619,7 @@ absl::Status BatchingSession::MergeInputTensors(
     return errors::Internal(
         "One or more tasks does not conform to batch signature");
   }
+  BatchTensorPool* const batch_tensor_pool = GetBatchTensorPool(signature);
   for (const string& tensor_name : signature.input_tensors) {
     auto tensors = tensors_to_merge.find(tensor_name);
     DCHECK(tensors != tensors_to_merge.end());
@@ -576,9 +627,11 @@ absl::Status BatchingSession::MergeInputTensors(
       return errors::Internal(
           "One or more tasks does not conform to batch signature");
     }
+    // Copies each task's input (and the padding) straight into its rows of a
+    // reused buffer.
     Tensor concated;
     const absl::Status concat_status =
-        tensor::Concat(tensors->second, &concated);
+        ConcatIntoPooledTensor(tensors->second, batch_tensor_pool, &concated);
     DCHECK(concat_status.ok()) << concat_status.ToString();
     if (!concat_status.ok()) {
       return errors::Internal("Tensor concat operation failed: ",
@@ -636,9 +689,11 @@ absl::Status BatchingSession::SplitOutputTensors(
           "0th dimension sizes of the input tensors");
     }
 
+    // The outputs of the tasks share the buffer of the batched output where
+    // they are aligned.
     std::vector<Tensor> split_tensor;
     const absl::Status split_status =
-        tensor::Split(tensor, task_sizes_plus_optional_padding, &split_tensor);
+        SplitIntoSlices(tensor, task_sizes_plus_optional_padding, &split_tensor);
     DCHECK(split_status.ok()) << split_status.ToString();
     if (!split_status.ok()) {
       return errors::Internal("Tensor split operation failed: ",
@@ -677,6 +732,16 @@ absl::Status BatchingSession::SplitOutputTensors(
   return absl::OkStatus();
 }
 
+BatchTensorPool* BatchingSession::GetBatchTensorPool(
+    const TensorSignature& signature) {
+  absl::MutexLock l(&batch_tensor_pools_mu_);
+  std::unique_ptr<BatchTensorPool>& pool = batch_tensor_pools_[signature];
+  if (pool == nullptr) {
+    pool = std::make_unique<BatchTensorPool>();
+  }
+  return pool.get();
+}
+
 absl::Status BatchingSession::SplitRunMetadata(
     RunMetadata* batch_metadata, Batch<BatchingSessionTask>* batch) {
   if (batch->num_tasks() > 0) {
@@ -732,50 +797,38 @@ void BatchingSession::ProcessBatch(
   absl::Status status;
   auto finally = gtl::MakeCleanup([&status, &batch] {
     for (int i = 0; i < batch->num_tasks(); ++i) {
-      BatchingSessionTask* task = batch->mutable_task(i);
-      if (task->is_partial) {
-        task->thread_safe_status->Update(status);
-        task->done_callback();
-      } else {
-        *batch->mutable_task(i)->status = status;
-        batch->mutable_task(i)->done->Notify();
-      }
+      CompleteTask(status, batch->mutable_task(i));
     }
   });
 
-  // Make sure we have at least one task that hasn't exceeded its timeout from
-  // queue time alone, and find the latest task deadline which we'll use for the
-  // overall batch.
-  bool all_tasks_timeout_exceeded = true;
+  // Tasks that have exceeded their timeout from queue time alone are failed
+  // rather than run, so that they don't take up room in the batch. Find the
+  // latest deadline of the remaining tasks, which we'll use for the overall
+  // batch.
+  int num_expired_tasks = 0;
   uint64_t batch_deadline_micros = 0;
   for (int i = 0; i < batch->num_tasks(); ++i) {
     const BatchingSessionTask& task = batch->task(i);
-    // If the caller doesn't populate RunOptions, the timeout is 0 by default.
-    // Interpret that as "no timeout" i.e. infinity.
-    const int64_t task_timeout_micros =
-        task.run_options.timeout_in_ms() <= 0
-            ? INT_MAX
-            : task.run_options.timeout_in_ms() * 1000;
-    const uint64_t task_deadline_micros =
-        task.enqueue_time_micros + task_timeout_micros;
+    const uint64_t task_deadline_micros = task.deadline_micros();
     if (task_deadline_micros > dequeue_time_micros) {
-      all_tasks_timeout_exceeded = false;
-      if (task_deadline_micros > batch_deadline_micros) {
-        batch_deadline_micros = task_deadline_micros;
-      }
+      batch_deadline_micros =
+          std::max(batch_deadline_micros, task_deadline_micros);
+    } else {
+      ++num_expired_tasks;
     }
-    queuing_latency->GetCell(thread_pool_name_)
+    queuing_latency
+        ->GetCell(thread_pool_name_, absl::StrCat(task.priority()))
         ->Add(dequeue_time_micros - task.enqueue_time_micros);
   }
-  if (all_tasks_timeout_exceeded) {
-    status = absl::Status(
-        static_cast<absl::StatusCode>(absl::StatusCode::kResourceExhausted),
-        "Run() timeout exceeded while waiting in batching queue");
-    return;
+  if (num_expired_tasks > 0) {
+    batch = ShedExpiredTasks(dequeue_time_micros, std::move(batch));
+    if (batch->empty()) {
+      return;
+    }
   }
 
   RunOptions run_options = batch->task(0).run_options;
-  if (batch_deadline_micros == INT_MAX) {
+  if (batch_deadline_micros == std::numeric_limits<uint64_t>::max()) {
     run_options.set_timeout_in_ms(0);
   } else {
     run_options.set_timeout_in_ms(
@@ -21,6 +21,7 @@ limitations under the License.
 
 #include <cstddef>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
@@ -172,6 +173,23 @@ struct BatchingSessionTask : public BatchTask {
   // For monitoring purpose.
   static std::string Name() { return "batching_session"; }
 
+  // The time by which the task must be dequeued to run within its
+  // 'run_options.timeout_in_ms()', or UINT64_MAX if it has no timeout.
+  uint64_t deadline_micros() const {
+    // If the caller doesn't populate RunOptions, the timeout is 0 by default.
+    // Interpret that as "no timeout" i.e. infinity.
+    if (run_options.timeout_in_ms() <= 0) {
+      return std::numeric_limits<uint64_t>::max();
+    }
+    return enqueue_time_micros + run_options.timeout_in_ms() * 1000;
+  }
+
+  // The priority of the task, which schedulers may use to batch more critical
+  // requests first. Larger values are more critical.
+  int64_t priority() const {
+    return run_options.experimental().run_handler_pool_options().priority();
+  }
+
   // Fields populated when a task is received.
   uint64_t enqueue_time_micros;
   RunOptions run_options;
@@ -1021,6 +1021,59 @@ TEST_P(BatchingSessionTest, EnqueuedLongerThanTimeout) {
   request_returned.WaitForNotification();
 }
 
+TEST_P(BatchingSessionTest, ExpiredTasksAreShedFromBatch) {
+  BatchScheduler<BatchingSessionTask>* scheduler = nullptr;
+  auto create_scheduler =
+      [&scheduler, this](
+          std::function<void(std::unique_ptr<Batch<BatchingSessionTask>>)>
+              process_batch_callback,
+          std::unique_ptr<BatchScheduler<BatchingSessionTask>>* new_scheduler) {
+        BasicBatchScheduler<BatchingSessionTask>::Options options;
+        options.max_batch_size = 4;  // fits two 2-unit tasks
+        options.batch_timeout_micros = 1 * 1000 * 1000;  // won't trigger
+        options.num_batch_threads = 1;
+        options = annotate_options(options);
+        std::unique_ptr<BasicBatchScheduler<BatchingSessionTask>>
+            basic_scheduler;
+        TF_RETURN_IF_ERROR(BasicBatchScheduler<BatchingSessionTask>::Create(
+            options, process_batch_callback, &basic_scheduler));
+        scheduler = basic_scheduler.get();
+        *new_scheduler = std::move(basic_scheduler);
+        return absl::OkStatus();
+      };
+  BatchingSessionOptions batching_session_options;
+  std::unique_ptr<Session> batching_session;
+  CHECK_OK(CreateBatchingSession(
+      batching_session_options, {{{{"x"}, {"y"}}, create_scheduler}},
+      CreateHalfPlusTwoSession(), &batching_session));
+  ASSERT_FALSE(scheduler == nullptr);
+
+  // Enqueue a request with a timeout specified via RunOptions, which expires
+  // before the batch it is in gets processed.
+  std::unique_ptr<Thread> expired_request_thread(Env::Default()->StartThread(
+      ThreadOptions(), "expired_request_thread", [&batching_session] {
+        Tensor input = test::AsTensor<float>({100.0f, 42.0f}, {2});
+        RunOptions run_options;
+        run_options.set_timeout_in_ms(1);
+        std::vector<Tensor> outputs;
+        RunMetadata run_metadata;
+        const absl::Status status = batching_session->Run(
+            run_options, {{"x", input}}, {"y"} /* outputs */,
+            {} /* target nodes */, &outputs, &run_metadata);
+        EXPECT_EQ(error::RESOURCE_EXHAUSTED, status.code());
+        EXPECT_THAT(
+            status.message(),
+            HasSubstr("Run() timeout exceeded while waiting in batching queue"));
+      }));
+  while (scheduler->NumEnqueuedTasks() != 1) {
+    Env::Default()->SleepForMicroseconds(100);
+  }
+  Env::Default()->SleepForMicroseconds(10 * 1000);
+
+  // A request without a timeout completes the batch, and still runs.
+  TestRequest({10.0f, 20.0f}, {2}, {7.0f, 12.0f}, {2}, batching_session.get());
+}
+
 TEST_P(BatchingSessionTest, ThreadPoolOptions) {
   BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
   schedule_options.max_batch_size = 3;
@@ -0,0 +1,466 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_BATCHING_DEADLINE_BATCH_SCHEDULER_H_
+#define TENSORFLOW_SERVING_BATCHING_DEADLINE_BATCH_SCHEDULER_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "tensorflow/core/kernels/batching_util/batch_scheduler.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/batching/adaptive_batching_controller.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A BatchScheduler which forms batches out of the most urgent tasks, rather
+// than in arrival order. Tasks are ordered by priority (highest first), and
+// then by deadline (earliest first). A task with 5 ms of deadline left
+// therefore no longer waits behind bulk traffic of the same priority that
+// arrived before it.
+//
+// TaskType must provide, in addition to size():
+//  - uint64_t deadline_micros() const: the time (in Env::NowMicros() units) by
+//    which the task must have been processed, or UINT64_MAX if it has none.
+//  - int64_t priority() const: tasks with larger values are batched first.
+//
+// PARAMETERS AND BEHAVIOR:
+//
+// Tasks are enqueued in a single queue of bounded size. Each of
+// 'num_batch_threads' batch threads waits until either the queued tasks fill
+// a batch of 'max_batch_size', or the oldest queued task has waited for
+// 'batch_timeout_micros'. It then fills a batch with queued tasks in the order
+// above (skipping tasks which don't fit in what is left of the batch), and
+// invokes the process-batch callback with it.
+//
+// Tasks whose deadline has passed by the time they are dequeued are not mixed
+// with the others: they are passed to the process-batch callback in batches of
+// their own, so that the callback can fail them without doing any work.
+// (BatchingSession does so.) They don't count toward 'max_batch_size'.
+//
+// Unlike BasicBatchScheduler, batches are formed when a batch thread becomes
+// available rather than when they are full, which is what lets late urgent
+// tasks overtake the ones already enqueued.
+//
+// So that a steady stream of more urgent tasks cannot starve the others, tasks
+// which have been enqueued for 'max_queueing_delay_micros' are batched first,
+// in the order they were scheduled.
+//
+// If 'batching_controller' is set, batches are formed at its target batch size
+// and timeout instead, which it adjusts as it observes the tasks scheduled and
+// the time the process-batch callback takes.
+template <typename TaskType>
+class DeadlineBatchScheduler : public BatchScheduler<TaskType> {
+ public:
+  struct Options {
+    // The maximum size of each batch.
+    size_t max_batch_size = 1000;
+
+    // The maximum amount of time the oldest task of a batch may wait for the
+    // batch to fill up, in microseconds. Zero means that batches are formed as
+    // soon as a batch thread is available.
+    int64_t batch_timeout_micros = 0;
+
+    // The maximum number of enqueued tasks, in units of 'max_batch_size'.
+    // Schedule() fails with UNAVAILABLE once it is reached.
+    int max_enqueued_batches = 10;
+
+    // How long a task may be enqueued, in microseconds, before it is batched
+    // ahead of the more urgent tasks.
+    int64_t max_queueing_delay_micros = 1000 * 1000;  // 1 second
+
+    // The name to use for the batch threads.
+    string thread_pool_name = "batch_threads";
+
+    // The number of threads to use to process batches.
+    // Must be >= 1, and should be tuned carefully.
+    int num_batch_threads = port::MaxParallelism();
+
+    // If set, overrides the size at which batches are formed (up to
+    // 'max_batch_size') and 'batch_timeout_micros'.
+    std::shared_ptr<AdaptiveBatchingController> batching_controller;
+
+    // The following options are typically only overridden by test code.
+
+    // The environment to use.
+    Env* env = Env::Default();
+
+    // The longest the batch threads wait (in real time) before checking
+    // env->NowMicros() again, in microseconds.
+    uint64_t no_tasks_wait_time_micros = 1000;  // 1 millisecond
+  };
+
+  static Status Create(
+      const Options& options,
+      std::function<void(std::unique_ptr<Batch<TaskType>>)>
+          process_batch_callback,
+      std::unique_ptr<DeadlineBatchScheduler<TaskType>>* scheduler);
+
+  // Processes the remaining enqueued tasks, and then stops the batch threads.
+  ~DeadlineBatchScheduler() override;
+
+  Status Schedule(std::unique_ptr<TaskType>* task) override;
+
+  size_t NumEnqueuedTasks() const override;
+
+  size_t SchedulingCapacity() const override;
+
+  size_t max_task_size() const override { return options_.max_batch_size; }
+
+ private:
+  // The order in which tasks are batched: by decreasing priority, increasing
+  // deadline, and then in the order they were scheduled.
+  struct TaskKey {
+    int64_t priority;
+    uint64_t deadline_micros;
+    int64_t sequence_number;
+
+    bool operator<(const TaskKey& other) const {
+      return std::make_tuple(-priority, deadline_micros, sequence_number) <
+             std::make_tuple(-other.priority, other.deadline_micros,
+                             other.sequence_number);
+    }
+  };
+
+  struct QueuedTask {
+    std::unique_ptr<TaskType> task;
+    uint64_t enqueue_time_micros;
+  };
+  using TaskQueue = std::map<TaskKey, QueuedTask>;
+
+  DeadlineBatchScheduler(const Options& options,
+                         std::function<void(std::unique_ptr<Batch<TaskType>>)>
+                             process_batch_callback);
+
+  // The size at which batches are formed.
+  size_t target_batch_size() const;
+
+  // The maximum amount of time the oldest task of a batch may wait for it to
+  // fill up.
+  int64_t batch_timeout_micros() const;
+
+  // Returns true if the batch threads should form a batch now, and otherwise
+  // sets 'wait_micros' to how long they may wait before checking again.
+  bool ShouldFormBatch(uint64_t now_micros, uint64_t* wait_micros) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Moves the tasks of the next batch from 'queue_' to 'batch', and the
+  // expired tasks found along the way to 'expired_batch'.
+  void FormBatch(uint64_t now_micros, Batch<TaskType>* batch,
+                 Batch<TaskType>* expired_batch)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Moves the task of 'it' to 'batch', or to 'expired_batch' if it has
+  // expired. Leaves it enqueued if it does not fit in 'batch'.
+  void MaybeAddTask(typename TaskQueue::iterator it, uint64_t now_micros,
+                    size_t batch_size_limit, Batch<TaskType>* batch,
+                    Batch<TaskType>* expired_batch)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Removes 'it' from 'queue_', and returns its task.
+  std::unique_ptr<TaskType> RemoveTask(typename TaskQueue::iterator it)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // The body of each batch thread.
+  void BatchThreadLogic();
+
+  const Options options_;
+
+  // A callback invoked to process a batch of tasks. Always invoked from a
+  // batch thread.
+  std::function<void(std::unique_ptr<Batch<TaskType>>)> process_batch_callback_;
+
+  mutable absl::Mutex mu_;
+  absl::CondVar tasks_cv_;
+
+  // The enqueued tasks, in the order in which they are batched.
+  TaskQueue queue_ ABSL_GUARDED_BY(mu_);
+  // The tasks of 'queue_' by sequence number, i.e. in the order they were
+  // scheduled, to find the oldest ones.
+  std::map<int64_t, typename TaskQueue::iterator> arrival_order_
+      ABSL_GUARDED_BY(mu_);
+  // The sum of the sizes of the tasks in 'queue_'.
+  size_t queue_size_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t next_sequence_number_ ABSL_GUARDED_BY(mu_) = 0;
+  bool stopping_ ABSL_GUARDED_BY(mu_) = false;
+
+  // NOTE: This must be the last member, to ensure it is destroyed first.
+  std::vector<std::unique_ptr<Thread>> batch_threads_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(DeadlineBatchScheduler);
+};
+
+//////////
+// Implementation details follow. API users need not read.
+
+template <typename TaskType>
+Status DeadlineBatchScheduler<TaskType>::Create(
+    const Options& options,
+    std::function<void(std::unique_ptr<Batch<TaskType>>)>
+        process_batch_callback,
+    std::unique_ptr<DeadlineBatchScheduler<TaskType>>* scheduler) {
+  if (options.max_batch_size <= 0) {
+    return errors::InvalidArgument("max_batch_size must be positive; was ",
+                                   options.max_batch_size);
+  }
+  if (options.batch_timeout_micros < 0) {
+    return errors::InvalidArgument(
+        "batch_timeout_micros must be non-negative; was ",
+        options.batch_timeout_micros);
+  }
+  if (options.max_queueing_delay_micros < 0) {
+    return errors::InvalidArgument(
+        "max_queueing_delay_micros must be non-negative; was ",
+        options.max_queueing_delay_micros);
+  }
+  if (options.max_enqueued_batches <= 0) {
+    return errors::InvalidArgument(
+        "max_enqueued_batches must be positive; was ",
+        options.max_enqueued_batches);
+  }
+  if (options.num_batch_threads <= 0) {
+    return errors::InvalidArgument("num_batch_threads must be positive; was ",
+                                   options.num_batch_threads);
+  }
+  scheduler->reset(
+      new DeadlineBatchScheduler<TaskType>(options, process_batch_callback));
+  return Status();
+}
+
+template <typename TaskType>
+DeadlineBatchScheduler<TaskType>::DeadlineBatchScheduler(
+    const Options& options,
+    std::function<void(std::unique_ptr<Batch<TaskType>>)>
+        process_batch_callback)
+    : options_(options), process_batch_callback_(process_batch_callback) {
+  for (int i = 0; i < options_.num_batch_threads; ++i) {
+    batch_threads_.emplace_back(options_.env->StartThread(
+        {}, absl::StrCat(options_.thread_pool_name, "_", i),
+        [this] { BatchThreadLogic(); }));
+  }
+}
+
+template <typename TaskType>
+DeadlineBatchScheduler<TaskType>::~DeadlineBatchScheduler() {
+  {
+    absl::MutexLock l(&mu_);
+    stopping_ = true;
+    tasks_cv_.SignalAll();
+  }
+  // Blocks until the threads have processed the remaining tasks.
+  batch_threads_.clear();
+}
+
+template <typename TaskType>
+Status DeadlineBatchScheduler<TaskType>::Schedule(
+    std::unique_ptr<TaskType>* task) {
+  const size_t task_size = (*task)->size();
+  if (task_size > options_.max_batch_size) {
+    return errors::InvalidArgument("Task size ", task_size,
+                                   " is larger than maximum batch size ",
+                                   options_.max_batch_size);
+  }
+  const TaskKey key = {(*task)->priority(), (*task)->deadline_micros(), 0};
+  if (options_.batching_controller != nullptr) {
+    options_.batching_controller->RecordArrival(task_size);
+  }
+
+  absl::MutexLock l(&mu_);
+  if (queue_size_ + task_size >
+      options_.max_enqueued_batches * options_.max_batch_size) {
+    return errors::Unavailable(
+        "The batch scheduling queue to which this task was submitted is full");
+  }
+  // (Read under the lock, so that enqueue times follow sequence numbers.)
+  const uint64_t now_micros = options_.env->NowMicros();
+  TaskKey sequenced_key = key;
+  sequenced_key.sequence_number = next_sequence_number_++;
+  const auto it =
+      queue_.emplace(sequenced_key, QueuedTask{std::move(*task), now_micros})
+          .first;
+  arrival_order_.emplace(sequenced_key.sequence_number, it);
+  queue_size_ += task_size;
+  tasks_cv_.Signal();
+  return Status();
+}
+
+template <typename TaskType>
+size_t DeadlineBatchScheduler<TaskType>::NumEnqueuedTasks() const {
+  absl::MutexLock l(&mu_);
+  return queue_.size();
+}
+
+template <typename TaskType>
+size_t DeadlineBatchScheduler<TaskType>::SchedulingCapacity() const {
+  absl::MutexLock l(&mu_);
+  return options_.max_enqueued_batches * options_.max_batch_size - queue_size_;
+}
+
+template <typename TaskType>
+size_t DeadlineBatchScheduler<TaskType>::target_batch_size() const {
+  if (options_.batching_controller == nullptr) {
+    return options_.max_batch_size;
+  }
+  return std::min<size_t>(options_.batching_controller->target_batch_size(),
+                          options_.max_batch_size);
+}
+
+template <typename TaskType>
+int64_t DeadlineBatchScheduler<TaskType>::batch_timeout_micros() const {
+  if (options_.batching_controller == nullptr) {
+    return options_.batch_timeout_micros;
+  }
+  return options_.batching_controller->batch_timeout_micros();
+}
+
+template <typename TaskType>
+bool DeadlineBatchScheduler<TaskType>::ShouldFormBatch(
+    const uint64_t now_micros, uint64_t* wait_micros) const {
+  *wait_micros = options_.no_tasks_wait_time_micros;
+  if (queue_.empty()) {
+    return false;
+  }
+  if (stopping_ || queue_size_ >= target_batch_size()) {
+    return true;
+  }
+  // An expired task needs no more waiting.
+  if (queue_.begin()->first.deadline_micros <= now_micros) {
+    return true;
+  }
+  const uint64_t close_time_micros =
+      arrival_order_.begin()->second->second.enqueue_time_micros +
+      batch_timeout_micros();
+  if (close_time_micros <= now_micros) {
+    return true;
+  }
+  *wait_micros = std::min(*wait_micros, close_time_micros - now_micros);
+  return false;
+}
+
+template <typename TaskType>
+void DeadlineBatchScheduler<TaskType>::FormBatch(
+    const uint64_t now_micros, Batch<TaskType>* batch,
+    Batch<TaskType>* expired_batch) {
+  const size_t batch_size_limit = target_batch_size();
+  // First the tasks which have been enqueued for too long, oldest first.
+  auto oldest = arrival_order_.begin();
+  while (oldest != arrival_order_.end() && batch->size() < batch_size_limit) {
+    const auto current = (oldest++)->second;
+    if (current->second.enqueue_time_micros +
+            options_.max_queueing_delay_micros >
+        now_micros) {
+      break;
+    }
+    MaybeAddTask(current, now_micros, batch_size_limit, batch, expired_batch);
+  }
+  // Then the most urgent ones.
+  auto it = queue_.begin();
+  while (it != queue_.end() && batch->size() < batch_size_limit) {
+    MaybeAddTask(it++, now_micros, batch_size_limit, batch, expired_batch);
+  }
+}
+
+template <typename TaskType>
+void DeadlineBatchScheduler<TaskType>::MaybeAddTask(
+    const typename TaskQueue::iterator it, const uint64_t now_micros,
+    const size_t batch_size_limit, Batch<TaskType>* batch,
+    Batch<TaskType>* expired_batch) {
+  if (it->first.deadline_micros <= now_micros) {
+    expired_batch->AddTask(RemoveTask(it));
+  } else if (batch->empty() ||
+             batch->size() + it->second.task->size() <= batch_size_limit) {
+    // (A task bigger than the target batch size gets a batch of its own.)
+    batch->AddTask(RemoveTask(it));
+  }
+}
+
+template <typename TaskType>
+std::unique_ptr<TaskType> DeadlineBatchScheduler<TaskType>::RemoveTask(
+    const typename TaskQueue::iterator it) {
+  std::unique_ptr<TaskType> task = std::move(it->second.task);
+  arrival_order_.erase(it->first.sequence_number);
+  queue_size_ -= task->size();
+  queue_.erase(it);
+  return task;
+}
+
+template <typename TaskType>
+void DeadlineBatchScheduler<TaskType>::BatchThreadLogic() {
+  while (true) {
+    auto batch = std::make_unique<Batch<TaskType>>();
+    auto expired_batch = std::make_unique<Batch<TaskType>>();
+    {
+      absl::MutexLock l(&mu_);
+      while (true) {
+        if (stopping_ && queue_.empty()) {
+          // (Batches must be closed before they are destroyed.)
+          batch->Close();
+          expired_batch->Close();
+          return;
+        }
+        const uint64_t now_micros = options_.env->NowMicros();
+        uint64_t wait_micros;
+        if (ShouldFormBatch(now_micros, &wait_micros)) {
+          FormBatch(now_micros, batch.get(), expired_batch.get());
+          break;
+        }
+        tasks_cv_.WaitWithTimeout(&mu_, absl::Microseconds(wait_micros));
+      }
+      if (!queue_.empty()) {
+        // Let another thread look at what is left.
+        tasks_cv_.Signal();
+      }
+    }
+
+    expired_batch->Close();
+    batch->Close();
+    if (!expired_batch->empty()) {
+      process_batch_callback_(std::move(expired_batch));
+    }
+    if (!batch->empty()) {
+      const size_t batch_size = batch->size();
+      const uint64_t start_time_micros = options_.env->NowMicros();
+      process_batch_callback_(std::move(batch));
+      if (options_.batching_controller != nullptr) {
+        options_.batching_controller->RecordBatchExecution(
+            batch_size, options_.env->NowMicros() - start_time_micros);
+      }
+    }
+  }
+}
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_BATCHING_DEADLINE_BATCH_SCHEDULER_H_
@@ -0,0 +1,451 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/batching/deadline_batch_scheduler.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "tensorflow/core/kernels/batching_util/fake_clock_env.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/protobuf/error_codes.pb.h"
+
+using ::testing::ElementsAre;
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+constexpr uint64_t kNoDeadline = std::numeric_limits<uint64_t>::max();
+
+class FakeTask : public BatchTask {
+ public:
+  FakeTask(size_t size, uint64_t deadline_micros, int64_t priority)
+      : size_(size), deadline_micros_(deadline_micros), priority_(priority) {}
+
+  ~FakeTask() override = default;
+
+  size_t size() const override { return size_; }
+
+  uint64_t deadline_micros() const { return deadline_micros_; }
+
+  int64_t priority() const { return priority_; }
+
+ private:
+  const size_t size_;
+  const uint64_t deadline_micros_;
+  const int64_t priority_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FakeTask);
+};
+
+// Creates a FakeTask, and calls 'scheduler->Schedule()' on that task. Returns
+// the resulting status.
+absl::Status ScheduleTask(size_t task_size, BatchScheduler<FakeTask>* scheduler,
+                          uint64_t deadline_micros = kNoDeadline,
+                          int64_t priority = 0) {
+  std::unique_ptr<FakeTask> task(
+      new FakeTask(task_size, deadline_micros, priority));
+  absl::Status status = scheduler->Schedule(&task);
+  // Schedule() should have consumed 'task' iff it returned Status::OK.
+  CHECK_EQ(status.ok(), task == nullptr);
+  return status;
+}
+
+// Records the deadlines of the tasks of each batch, and blocks in the first
+// batch until Unblock() is called, so that tests can enqueue tasks while the
+// (single) batch thread is busy.
+class BatchRecorder {
+ public:
+  void ProcessBatch(std::unique_ptr<Batch<FakeTask>> batch) {
+    batch->WaitUntilClosed();
+    std::vector<uint64_t> deadlines;
+    for (int i = 0; i < batch->num_tasks(); ++i) {
+      deadlines.push_back(batch->task(i).deadline_micros());
+    }
+    bool first_batch;
+    {
+      absl::MutexLock l(&mu_);
+      first_batch = !first_batch_started_.HasBeenNotified();
+      if (first_batch) {
+        first_batch_started_.Notify();
+      } else {
+        batches_.push_back(deadlines);
+      }
+    }
+    if (first_batch) {
+      unblock_.WaitForNotification();
+    }
+  }
+
+  void WaitUntilBlocked() { first_batch_started_.WaitForNotification(); }
+
+  void Unblock() { unblock_.Notify(); }
+
+  // The deadlines of the tasks of each batch but the first, in processing
+  // order.
+  std::vector<std::vector<uint64_t>> batches() {
+    absl::MutexLock l(&mu_);
+    return batches_;
+  }
+
+ private:
+  absl::Mutex mu_;
+  absl::Notification first_batch_started_;
+  absl::Notification unblock_;
+  std::vector<std::vector<uint64_t>> batches_ ABSL_GUARDED_BY(mu_);
+};
+
+TEST(DeadlineBatchSchedulerTest, Basic) {
+  bool callback_called = false;
+  auto callback = [&callback_called](std::unique_ptr<Batch<FakeTask>> batch) {
+    callback_called = true;
+    batch->WaitUntilClosed();
+    ASSERT_EQ(2, batch->num_tasks());
+    EXPECT_EQ(3, batch->task(0).size());
+    EXPECT_EQ(5, batch->task(1).size());
+  };
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_batch_size = 10;
+    options.batch_timeout_micros = 100 * 1000 * 1000;  // won't trigger
+    options.num_batch_threads = 1;
+    std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(DeadlineBatchScheduler<FakeTask>::Create(options, callback,
+                                                          &scheduler));
+    TF_ASSERT_OK(ScheduleTask(3, scheduler.get()));
+    TF_ASSERT_OK(ScheduleTask(5, scheduler.get()));
+    EXPECT_EQ(2, scheduler->NumEnqueuedTasks());
+    // Destroying the scheduler processes the enqueued tasks.
+  }
+  EXPECT_TRUE(callback_called);
+}
+
+TEST(DeadlineBatchSchedulerTest, Timeout) {
+  test_util::FakeClockEnv env(Env::Default());
+  absl::Notification batch_processed;
+  auto callback = [&batch_processed](std::unique_ptr<Batch<FakeTask>> batch) {
+    batch->WaitUntilClosed();
+    EXPECT_EQ(1, batch->num_tasks());
+    batch_processed.Notify();
+  };
+  DeadlineBatchScheduler<FakeTask>::Options options;
+  options.max_batch_size = 10;
+  options.batch_timeout_micros = 10;
+  options.num_batch_threads = 1;
+  options.env = &env;
+  std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+  TF_ASSERT_OK(
+      DeadlineBatchScheduler<FakeTask>::Create(options, callback, &scheduler));
+  TF_ASSERT_OK(ScheduleTask(1, scheduler.get()));
+
+  EXPECT_FALSE(batch_processed.WaitForNotificationWithTimeout(
+      absl::Milliseconds(10)));
+  env.AdvanceByMicroseconds(9);
+  EXPECT_FALSE(batch_processed.WaitForNotificationWithTimeout(
+      absl::Milliseconds(10)));
+  env.AdvanceByMicroseconds(1);
+  batch_processed.WaitForNotification();
+}
+
+TEST(DeadlineBatchSchedulerTest, EarliestDeadlineFirst) {
+  test_util::FakeClockEnv env(Env::Default());
+  BatchRecorder recorder;
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_batch_size = 2;
+    options.batch_timeout_micros = 1000 * 1000;
+    options.num_batch_threads = 1;
+    options.env = &env;
+    std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(DeadlineBatchScheduler<FakeTask>::Create(
+        options,
+        [&recorder](std::unique_ptr<Batch<FakeTask>> batch) {
+          recorder.ProcessBatch(std::move(batch));
+        },
+        &scheduler));
+
+    // A full batch, which blocks the batch thread.
+    TF_ASSERT_OK(ScheduleTask(2, scheduler.get()));
+    recorder.WaitUntilBlocked();
+
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 300));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), kNoDeadline));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 100));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 200));
+    recorder.Unblock();
+  }
+  EXPECT_THAT(recorder.batches(),
+              ElementsAre(ElementsAre(100, 200), ElementsAre(300, kNoDeadline)));
+}
+
+TEST(DeadlineBatchSchedulerTest, HigherPriorityFirst) {
+  test_util::FakeClockEnv env(Env::Default());
+  BatchRecorder recorder;
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_batch_size = 2;
+    options.batch_timeout_micros = 1000 * 1000;
+    options.num_batch_threads = 1;
+    options.env = &env;
+    std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(DeadlineBatchScheduler<FakeTask>::Create(
+        options,
+        [&recorder](std::unique_ptr<Batch<FakeTask>> batch) {
+          recorder.ProcessBatch(std::move(batch));
+        },
+        &scheduler));
+
+    TF_ASSERT_OK(ScheduleTask(2, scheduler.get()));
+    recorder.WaitUntilBlocked();
+
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 100, /*priority=*/0));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 200, /*priority=*/0));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 400, /*priority=*/1));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 300, /*priority=*/1));
+    recorder.Unblock();
+  }
+  EXPECT_THAT(recorder.batches(),
+              ElementsAre(ElementsAre(300, 400), ElementsAre(100, 200)));
+}
+
+// Tasks enqueued for longer than the max queueing delay are batched before
+// the more urgent ones, so that these cannot starve them.
+TEST(DeadlineBatchSchedulerTest, MaxQueueingDelay) {
+  test_util::FakeClockEnv env(Env::Default());
+  BatchRecorder recorder;
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_batch_size = 1;
+    options.max_queueing_delay_micros = 50;
+    options.num_batch_threads = 1;
+    options.env = &env;
+    std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(DeadlineBatchScheduler<FakeTask>::Create(
+        options,
+        [&recorder](std::unique_ptr<Batch<FakeTask>> batch) {
+          recorder.ProcessBatch(std::move(batch));
+        },
+        &scheduler));
+
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get()));
+    recorder.WaitUntilBlocked();
+
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 1000, /*priority=*/0));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 2000, /*priority=*/0));
+    env.AdvanceByMicroseconds(40);
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 3000, /*priority=*/0));
+    env.AdvanceByMicroseconds(20);
+    // Only the first two tasks have been enqueued for over 50 microseconds.
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 4000, /*priority=*/1));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 5000, /*priority=*/1));
+    recorder.Unblock();
+  }
+  EXPECT_THAT(recorder.batches(),
+              ElementsAre(ElementsAre(1000), ElementsAre(2000),
+                          ElementsAre(4000), ElementsAre(5000),
+                          ElementsAre(3000)));
+}
+
+// Tasks which don't fit in a batch are skipped in favor of smaller ones.
+TEST(DeadlineBatchSchedulerTest, FillBatchWithSmallerTasks) {
+  test_util::FakeClockEnv env(Env::Default());
+  BatchRecorder recorder;
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_batch_size = 4;
+    options.batch_timeout_micros = 1000 * 1000;
+    options.num_batch_threads = 1;
+    options.env = &env;
+    std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(DeadlineBatchScheduler<FakeTask>::Create(
+        options,
+        [&recorder](std::unique_ptr<Batch<FakeTask>> batch) {
+          recorder.ProcessBatch(std::move(batch));
+        },
+        &scheduler));
+
+    TF_ASSERT_OK(ScheduleTask(4, scheduler.get()));
+    recorder.WaitUntilBlocked();
+
+    TF_ASSERT_OK(ScheduleTask(3, scheduler.get(), 100));
+    TF_ASSERT_OK(ScheduleTask(2, scheduler.get(), 200));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 300));
+    recorder.Unblock();
+  }
+  EXPECT_THAT(recorder.batches(),
+              ElementsAre(ElementsAre(100, 300), ElementsAre(200)));
+}
+
+TEST(DeadlineBatchSchedulerTest, ExpiredTasksAreBatchedSeparately) {
+  test_util::FakeClockEnv env(Env::Default());
+  BatchRecorder recorder;
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_batch_size = 2;
+    options.batch_timeout_micros = 1000 * 1000;
+    options.num_batch_threads = 1;
+    options.env = &env;
+    std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(DeadlineBatchScheduler<FakeTask>::Create(
+        options,
+        [&recorder](std::unique_ptr<Batch<FakeTask>> batch) {
+          recorder.ProcessBatch(std::move(batch));
+        },
+        &scheduler));
+
+    TF_ASSERT_OK(ScheduleTask(2, scheduler.get()));
+    recorder.WaitUntilBlocked();
+
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 10));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 20));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 300));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 400));
+    env.AdvanceByMicroseconds(100);
+    recorder.Unblock();
+  }
+  EXPECT_THAT(recorder.batches(),
+              ElementsAre(ElementsAre(10, 20), ElementsAre(300, 400)));
+}
+
+TEST(DeadlineBatchSchedulerTest, QueueCapacity) {
+  test_util::FakeClockEnv env(Env::Default());
+  BatchRecorder recorder;
+  DeadlineBatchScheduler<FakeTask>::Options options;
+  options.max_batch_size = 2;
+  options.max_enqueued_batches = 2;
+  options.batch_timeout_micros = 1000 * 1000;
+  options.num_batch_threads = 1;
+  options.env = &env;
+  std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+  TF_ASSERT_OK(DeadlineBatchScheduler<FakeTask>::Create(
+      options,
+      [&recorder](std::unique_ptr<Batch<FakeTask>> batch) {
+        recorder.ProcessBatch(std::move(batch));
+      },
+      &scheduler));
+
+  TF_ASSERT_OK(ScheduleTask(2, scheduler.get()));
+  recorder.WaitUntilBlocked();
+
+  EXPECT_EQ(4, scheduler->SchedulingCapacity());
+  TF_ASSERT_OK(ScheduleTask(2, scheduler.get()));
+  TF_ASSERT_OK(ScheduleTask(1, scheduler.get()));
+  EXPECT_EQ(1, scheduler->SchedulingCapacity());
+  const absl::Status status = ScheduleTask(2, scheduler.get());
+  EXPECT_EQ(error::UNAVAILABLE, status.code());
+  TF_ASSERT_OK(ScheduleTask(1, scheduler.get()));
+  EXPECT_EQ(0, scheduler->SchedulingCapacity());
+  EXPECT_EQ(3, scheduler->NumEnqueuedTasks());
+
+  recorder.Unblock();
+}
+
+TEST(DeadlineBatchSchedulerTest, BatchingController) {
+  test_util::FakeClockEnv env(Env::Default());
+  BatchRecorder recorder;
+  {
+    AdaptiveBatchingController::Options controller_options;
+    controller_options.candidate_batch_sizes = {2, 4};
+    controller_options.max_batch_size = 4;
+    controller_options.env = &env;
+    std::unique_ptr<AdaptiveBatchingController> controller;
+    TF_ASSERT_OK(
+        AdaptiveBatchingController::Create(controller_options, &controller));
+    // Nothing has been observed yet, so batches start at the smallest size.
+    ASSERT_EQ(2, controller->target_batch_size());
+
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_batch_size = 4;
+    options.batch_timeout_micros = 1000 * 1000;
+    options.num_batch_threads = 1;
+    options.batching_controller = std::move(controller);
+    options.env = &env;
+    std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(DeadlineBatchScheduler<FakeTask>::Create(
+        options,
+        [&recorder](std::unique_ptr<Batch<FakeTask>> batch) {
+          recorder.ProcessBatch(std::move(batch));
+        },
+        &scheduler));
+
+    // A batch of the target size, which blocks the batch thread.
+    TF_ASSERT_OK(ScheduleTask(2, scheduler.get()));
+    recorder.WaitUntilBlocked();
+
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 100));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 200));
+    TF_ASSERT_OK(ScheduleTask(1, scheduler.get(), 300));
+    TF_ASSERT_OK(ScheduleTask(3, scheduler.get(), 400));
+    recorder.Unblock();
+  }
+  // The task bigger than the target batch size gets a batch of its own.
+  EXPECT_THAT(recorder.batches(),
+              ElementsAre(ElementsAre(100, 200), ElementsAre(300),
+                          ElementsAre(400)));
+}
+
+TEST(DeadlineBatchSchedulerTest, InvalidOptions) {
+  auto callback = [](std::unique_ptr<Batch<FakeTask>> batch) {};
+  std::unique_ptr<DeadlineBatchScheduler<FakeTask>> scheduler;
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_batch_size = 0;
+    EXPECT_FALSE(
+        DeadlineBatchScheduler<FakeTask>::Create(options, callback, &scheduler)
+            .ok());
+  }
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.batch_timeout_micros = -1;
+    EXPECT_FALSE(
+        DeadlineBatchScheduler<FakeTask>::Create(options, callback, &scheduler)
+            .ok());
+  }
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_queueing_delay_micros = -1;
+    EXPECT_FALSE(
+        DeadlineBatchScheduler<FakeTask>::Create(options, callback, &scheduler)
+            .ok());
+  }
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.num_batch_threads = 0;
+    EXPECT_FALSE(
+        DeadlineBatchScheduler<FakeTask>::Create(options, callback, &scheduler)
+            .ok());
+  }
+  {
+    DeadlineBatchScheduler<FakeTask>::Options options;
+    options.max_batch_size = 10;
+    options.num_batch_threads = 1;
+    TF_ASSERT_OK(DeadlineBatchScheduler<FakeTask>::Create(options, callback,
+                                                          &scheduler));
+    const absl::Status status = ScheduleTask(11, scheduler.get());
+    EXPECT_EQ(error::INVALID_ARGUMENT, status.code());
+  }
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -16,6 +16,8 @@ limitations under the License.
 #include "tensorflow_serving/core/aspired_versions_manager.h"
 
 #include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <functional>
 #include <iterator>
 #include <map>
 #include <memory>
@@ -186,7 +188,8 @@ absl::Status AspiredVersionsManager::Create(
       options.manage_state_interval_micros, options.env,
       std::move(options.aspired_version_policy),
       std::move(options.custom_sort_actions), std::move(basic_manager),
-      options.with_current_context));
+      options.with_current_context,
+      options.enable_parallel_version_transitions));
   (manager->get())->enable_reload_servables_with_error_ =
       options.enable_reload_servables_with_error;
   return absl::OkStatus();
@@ -196,16 +199,34 @@ AspiredVersionsManager::AspiredVersionsManager(
     int64_t manage_state_interval_micros, Env* env,
     std::unique_ptr<AspiredVersionPolicy> aspired_version_policy,
     CustomSortActionsFn custom_sort_actions,
-    std::unique_ptr<BasicManager> basic_manager, bool with_current_context)
+    std::unique_ptr<BasicManager> basic_manager, bool with_current_context,
+    const bool enable_parallel_version_transitions)
     : aspired_version_policy_(std::move(aspired_version_policy)),
       custom_sort_actions_(std::move(custom_sort_actions)),
+      enable_parallel_version_transitions_(enable_parallel_version_transitions),
       target_impl_(new internal::AspiredVersionsManagerTargetImpl(this)),
       basic_manager_(std::move(basic_manager)) {
   set_num_load_threads_observer_.reset(
       new Observer<const uint32_t>([this](const uint32_t num_load_threads) {
         this->SetNumLoadThreads(num_load_threads);
       }));
-  if (manage_state_interval_micros > 0) {
+  if (manage_state_interval_micros > 0 &&
+      enable_parallel_version_transitions_) {
+    std::function<void()> run_loop = [this, manage_state_interval_micros]() {
+      this->RunManageStateLoop(manage_state_interval_micros);
+    };
+    if (with_current_context) {
+      tensorflow::Context context(tensorflow::ContextKind::kThread);
+      run_loop = [run_loop, context = std::move(context)]() {
+        tensorflow::WithContext wc(context);
+        run_loop();
+      };
+    }
+    event_driven_manage_state_thread_.reset(
+        env->StartThread(ThreadOptions(),
+                         "AspiredVersionsManager_ManageState_Thread",
+                         std::move(run_loop)));
+  } else if (manage_state_interval_micros > 0) {
     PeriodicFunction::Options pf_options;
     pf_options.env = env;
     pf_options.thread_name_prefix = "AspiredVersionsManager_ManageState_Thread";
@@ -238,6 +259,12 @@ AspiredVersionsManager::~AspiredVersionsManager() {
 
   // This will wait till the thread is joined.
   manage_state_thread_.reset();
+  {
+    mutex_lock l(manage_state_wakeup_mu_);
+    stop_manage_state_thread_ = true;
+    manage_state_wakeup_cv_.notify_all();
+  }
+  event_driven_manage_state_thread_.reset();
 }
 
 std::vector<ServableId> AspiredVersionsManager::ListAvailableServableIds()
@@ -279,6 +306,7 @@ void AspiredVersionsManager::EnqueueAspiredVersionsRequest(
     pending_aspired_versions_requests_[std::string(servable_name)] =
         std::move(versions);
   }
+  WakeManageStateThread();
 }
 
 void AspiredVersionsManager::ProcessAspiredVersionsRequest(
@@ -382,9 +410,10 @@ bool AspiredVersionsManager::ContainsAnyReaspiredVersions(
 }
 
 // We collect the version policy actions for each servable stream first. Then
-// we sort them based on the global policy and pick the first one.
-absl::optional<AspiredVersionPolicy::ServableAction>
-AspiredVersionsManager::GetNextAction() {
+// we sort them based on the global policy.
+std::vector<AspiredVersionPolicy::ServableAction>
+AspiredVersionsManager::GetPolicyActions(int* const num_ongoing_loads) {
+  *num_ongoing_loads = 0;
   std::vector<absl::optional<AspiredVersionPolicy::ServableAction>> actions;
   for (const std::string& servable_name :
        basic_manager_->GetManagedServableNames()) {
@@ -395,40 +424,96 @@ AspiredVersionsManager::GetNextAction() {
       aspired_state_snapshots.push_back(
           {state_snapshot.id, state_snapshot.state,
            state_snapshot.additional_state->is_aspired});
+      switch (state_snapshot.state) {
+        case LoaderHarness::State::kLoadRequested:
+        case LoaderHarness::State::kLoadApproved:
+        case LoaderHarness::State::kLoading:
+          ++*num_ongoing_loads;
+          break;
+        default:
+          break;
+      }
     }
     actions.emplace_back(
         aspired_version_policy_->GetNextAction(aspired_state_snapshots));
   }
 
+  // Streams without an action sort last.
   std::sort(actions.begin(), actions.end(),
             CompareActions(custom_sort_actions_));
-  const absl::optional<AspiredVersionPolicy::ServableAction> next_action =
-      !actions.empty() ? actions[0] : std::nullopt;
-  if (next_action) {
-    VLOG(1) << "Taking action: " << next_action->DebugString();
+  std::vector<AspiredVersionPolicy::ServableAction> sorted_actions;
+  for (const absl::optional<AspiredVersionPolicy::ServableAction>& action :
+       actions) {
+    if (!action) {
+      break;
+    }
+    sorted_actions.push_back(*action);
+  }
+  return sorted_actions;
+}
+
+absl::optional<AspiredVersionPolicy::ServableAction>
+AspiredVersionsManager::GetNextAction() {
+  int num_ongoing_loads;
+  const std::vector<AspiredVersionPolicy::ServableAction> actions =
+      GetPolicyActions(&num_ongoing_loads);
+  if (actions.empty()) {
+    return std::nullopt;
+  }
+  VLOG(1) << "Taking action: " << actions[0].DebugString();
+  return actions[0];
+}
+
+std::vector<AspiredVersionPolicy::ServableAction>
+AspiredVersionsManager::GetNextActions() {
+  int num_ongoing_loads;
+  const std::vector<AspiredVersionPolicy::ServableAction> actions =
+      GetPolicyActions(&num_ongoing_loads);
+  // Without a load thread-pool, loads run one at a time in PerformAction().
+  // Scheduling more than the thread-pool can run at once would only queue them
+  // up behind each other, out of reach of the ordering of later runs.
+  int num_loads_left =
+      std::max<int>(1, basic_manager_->num_load_threads()) - num_ongoing_loads;
+  std::vector<AspiredVersionPolicy::ServableAction> next_actions;
+  for (const AspiredVersionPolicy::ServableAction& action : actions) {
+    if (action.action == AspiredVersionPolicy::Action::kLoad) {
+      if (num_loads_left <= 0) {
+        continue;
+      }
+      --num_loads_left;
+    }
+    VLOG(1) << "Taking action: " << action.DebugString();
+    next_actions.push_back(action);
   }
-  return next_action;
+  return next_actions;
 }
 
 void AspiredVersionsManager::PerformAction(
     const AspiredVersionPolicy::ServableAction action) {
+  // A finished load/unload may let the policy take the next step right away.
+  // Failures wait for the next periodic run instead, so that an action which
+  // keeps failing doesn't make the manage-state thread spin.
   switch (action.action) {
     case AspiredVersionPolicy::Action::kLoad: {
       basic_manager_->LoadServable(
-          action.id, [action](const absl::Status& status) {
+          action.id, [this, action](const absl::Status& status) {
             if (!status.ok()) {
               LOG(ERROR) << "Servable " << action.id.DebugString()
                          << " cannot be loaded: " << status;
+              return;
             }
+            WakeManageStateThread();
           });
     } break;
     case AspiredVersionPolicy::Action::kUnload: {
       basic_manager_->UnloadServable(
-          action.id, [action](const absl::Status& status) {
+          action.id, [this, action](const absl::Status& status) {
             if (!status.ok()) {
               LOG(ERROR) << "Servable " << action.id.DebugString()
                          << " cannot be unloaded: " << status;
+              return;
             }
+            WakeManageStateThread();
           });
     } break;
   }
@@ -492,6 +577,14 @@ void AspiredVersionsManager::HandlePendingAspiredVersionsRequests() {
 void AspiredVersionsManager::InvokePolicyAndExecuteAction() {
   mutex_lock l(basic_manager_read_modify_write_mu_);
 
+  if (enable_parallel_version_transitions_) {
+    for (const AspiredVersionPolicy::ServableAction& action :
+         GetNextActions()) {
+      PerformAction(action);
+    }
+    return;
+  }
+
   const absl::optional<AspiredVersionPolicy::ServableAction> next_action =
       GetNextAction();
   if (!next_action) {
@@ -502,6 +595,35 @@ void AspiredVersionsManager::InvokePolicyAndExecuteAction() {
   PerformAction(*next_action);
 }
 
+void AspiredVersionsManager::RunManageStateLoop(
+    const int64_t manage_state_interval_micros) {
+  while (true) {
+    {
+      mutex_lock l(manage_state_wakeup_mu_);
+      if (!manage_state_wakeup_requested_ && !stop_manage_state_thread_) {
+        manage_state_wakeup_cv_.wait_for(
+            l, std::chrono::microseconds(manage_state_interval_micros));
+      }
+      if (stop_manage_state_thread_) {
+        return;
+      }
+      manage_state_wakeup_requested_ = false;
+    }
+    FlushServables();
+    HandlePendingAspiredVersionsRequests();
+    InvokePolicyAndExecuteAction();
+  }
+}
+
+void AspiredVersionsManager::WakeManageStateThread() {
+  if (!enable_parallel_version_transitions_) {
+    return;
+  }
+  mutex_lock l(manage_state_wakeup_mu_);
+  manage_state_wakeup_requested_ = true;
+  manage_state_wakeup_cv_.notify_all();
+}
+
 void AspiredVersionsManager::SetNumLoadThreads(
     const uint32_t num_load_threads) {
   basic_manager_->SetNumLoadThreads(num_load_threads);
@@ -161,6 +161,18 @@ class AspiredVersionsManager : public Manager,
     // If true, the AspiredVersionsManager will propagate its current context to
     // the newly created periodic functions.
     bool with_current_context = false;
+
+    /// If true, each run of the manage-state thread takes the actions the
+    /// aspired version policy suggests for all servable streams, rather than
+    /// just the topmost one. Unloads are all issued, and loads up to
+    /// 'num_load_threads' at a time (one, if there is no load thread-pool),
+    /// in the order given by 'custom_sort_actions'. Loads which don't fit in
+    /// the available resources wait for ongoing loads/unloads to finish, as
+    /// usual.
+    ///
+    /// The thread also runs as soon as new aspired versions arrive or a load or
+    /// unload finishes, and otherwise every 'manage_state_interval_micros'.
+    bool enable_parallel_version_transitions = false;
   };
   static Status Create(Options options,
                        std::unique_ptr<AspiredVersionsManager>* manager);
@@ -238,7 +250,8 @@ class AspiredVersionsManager : public Manager,
       int64_t manage_state_interval_micros, Env* env,
       std::unique_ptr<AspiredVersionPolicy> aspired_version_policy,
       CustomSortActionsFn custom_sort_actions,
-      std::unique_ptr<BasicManager> basic_manager, bool with_current_context);
+      std::unique_ptr<BasicManager> basic_manager, bool with_current_context,
+      bool enable_parallel_version_transitions);
 
   Status GetUntypedServableHandle(
       const ServableRequest& request,
@@ -274,11 +287,24 @@ class AspiredVersionsManager : public Manager,
       TF_EXCLUSIVE_LOCKS_REQUIRED(basic_manager_read_modify_write_mu_);
 
   // Goes through the harness map and calls the configured servable_policy with
-  // the state snapshots to get a list of suggested actions. The actions are
-  // then ordered and finally the topmost one is performed.
+  // the state snapshots to get a list of suggested actions, at most one per
+  // servable stream, ordered by which one to take first. Also counts the
+  // servables whose loads have been requested but haven't finished yet, in
+  // 'num_ongoing_loads'.
+  std::vector<AspiredVersionPolicy::ServableAction> GetPolicyActions(
+      int* num_ongoing_loads)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(basic_manager_read_modify_write_mu_);
+
+  // Returns the topmost of the actions suggested by the policy.
   absl::optional<AspiredVersionPolicy::ServableAction> GetNextAction()
       TF_EXCLUSIVE_LOCKS_REQUIRED(basic_manager_read_modify_write_mu_);
 
+  // Returns the actions suggested by the policy to take at once, in order: all
+  // the unloads, and as many loads as there are load threads not already busy
+  // with a load.
+  std::vector<AspiredVersionPolicy::ServableAction> GetNextActions()
+      TF_EXCLUSIVE_LOCKS_REQUIRED(basic_manager_read_modify_write_mu_);
+
   // Checks for servables that are not aspired and at some final state and tells
   // 'basic_manager_' to forget about them. This method is intended to be
   // invoked periodically, interleaved with InvokePolicyAndExecuteAction() and
@@ -291,11 +317,23 @@ class AspiredVersionsManager : public Manager,
       TF_LOCKS_EXCLUDED(basic_manager_read_modify_write_mu_,
                         pending_aspired_versions_requests_mu_);
 
-  // Invokes the aspired-version policy and executes any returned policy action.
-  // This method is intended to be invoked periodically.
+  // Invokes the aspired-version policy and executes any returned policy action,
+  // or all of them with 'enable_parallel_version_transitions'. This method is
+  // intended to be invoked periodically.
   void InvokePolicyAndExecuteAction()
       TF_LOCKS_EXCLUDED(basic_manager_read_modify_write_mu_);
 
+  // Runs FlushServables(), HandlePendingAspiredVersionsRequests() and
+  // InvokePolicyAndExecuteAction() whenever WakeManageStateThread() is called,
+  // and at least every 'manage_state_interval_micros', until the manager is
+  // destroyed. Used with 'enable_parallel_version_transitions'.
+  void RunManageStateLoop(int64_t manage_state_interval_micros)
+      TF_LOCKS_EXCLUDED(manage_state_wakeup_mu_);
+
+  // Makes the manage-state thread run as soon as it is done with its current
+  // run, if 'enable_parallel_version_transitions'. No-op otherwise.
+  void WakeManageStateThread() TF_LOCKS_EXCLUDED(manage_state_wakeup_mu_);
+
   // Sets the number of load threads.
   //
   // This may block all new load requests, or temporarily allow more threads to
@@ -305,6 +343,7 @@ class AspiredVersionsManager : public Manager,
 
   std::unique_ptr<AspiredVersionPolicy> aspired_version_policy_;
   CustomSortActionsFn custom_sort_actions_;
+  const bool enable_parallel_version_transitions_;
 
   // Aspired-versions requests pending to be processed, keyed by servable name.
   //
@@ -324,9 +363,22 @@ class AspiredVersionsManager : public Manager,
   // the set of managed servables and their state (in particular, aspiredness).
   mutable mutex basic_manager_read_modify_write_mu_;
 
+  // Wakes up the manage-state thread with
+  // 'enable_parallel_version_transitions'. Declared before 'basic_manager_',
+  // whose load/unload callbacks use it, so that it outlives them.
+  mutex manage_state_wakeup_mu_;
+  condition_variable manage_state_wakeup_cv_;
+  bool manage_state_wakeup_requested_ TF_GUARDED_BY(manage_state_wakeup_mu_) =
+      false;
+  bool stop_manage_state_thread_ TF_GUARDED_BY(manage_state_wakeup_mu_) =
+      false;
+
   // Periodically runs HandlePendingAspiredVersionsRequests() and
-  // InvokePolicyAndExecuteAction() in a background thread.
+  // InvokePolicyAndExecuteAction() in a background thread. Only one of the two
+  // is set: 'event_driven_manage_state_thread_' runs RunManageStateLoop() with
+  // 'enable_parallel_version_transitions'.
   std::unique_ptr<PeriodicFunction> manage_state_thread_;
+  std::unique_ptr<Thread> event_driven_manage_state_thread_;
 
   // The object that implements the Target API on behalf of this manager.
   std::unique_ptr<TargetBase<std::unique_ptr<Loader>>> target_impl_;
@@ -388,6 +388,95 @@ void BM_GetServableHandle(::testing::benchmark::State& state) {
 }
 BENCHMARK(BM_GetServableHandle);
 
+// Aspires 'version' of each of 'num_servables' servable streams, whose loads
+// take 'load_micros' each.
+void AspireVersionOfAllServables(AspiredVersionsManager* const manager,
+                                 const int num_servables, const int64_t version,
+                                 const int64_t load_micros) {
+  auto aspired_versions_callback = manager->GetAspiredVersionsCallback();
+  for (int i = 0; i < num_servables; ++i) {
+    const std::string servable_name = absl::StrCat(kServableName, i);
+    std::unique_ptr<Loader> loader(new SimpleLoader<int64_t>(
+        [version, load_micros](std::unique_ptr<int64_t>* const servable) {
+          Env::Default()->SleepForMicroseconds(load_micros);
+          servable->reset(new int64_t);
+          **servable = version;
+          return absl::OkStatus();
+        },
+        SimpleLoader<int64_t>::EstimateNoResources()));
+    std::vector<ServableData<std::unique_ptr<Loader>>> versions;
+    versions.push_back({{servable_name, version}, std::move(loader)});
+    aspired_versions_callback(servable_name, std::move(versions));
+  }
+}
+
+// Waits until 'version' of each of 'num_servables' servable streams, and no
+// other version, is available.
+void WaitUntilOnlyVersionIsAvailable(AspiredVersionsManager* const manager,
+                                     const int num_servables,
+                                     const int64_t version) {
+  while (true) {
+    const std::vector<ServableId> ids = manager->ListAvailableServableIds();
+    if (ids.size() == static_cast<size_t>(num_servables) &&
+        std::all_of(ids.begin(), ids.end(), [version](const ServableId& id) {
+          return id.version == version;
+        })) {
+      return;
+    }
+    Env::Default()->SleepForMicroseconds(100);
+  }
+}
+
+// Measures how long it takes the manager's own manage-state thread to roll
+// every one of many servable streams over to a new version, i.e. to load the
+// new version and unload the old one, e.g. after a config push. Loads take 1
+// millisecond each, and there are 4 load and unload threads.
+void BM_ManyModelRollout(::testing::benchmark::State& state) {
+  const int num_servables = state.range(0);
+  const bool enable_parallel_version_transitions = state.range(1);
+  constexpr int64_t kLoadMicros = 1000;
+
+  int64_t version = 0;
+  for (auto s : state) {
+    state.PauseTiming();
+    AspiredVersionsManager::Options options;
+    // Shorter than the 100 ms default, to keep the sequential runs short.
+    options.manage_state_interval_micros = 10 * 1000;
+    options.num_load_threads = 4;
+    options.num_unload_threads = 4;
+    options.aspired_version_policy.reset(new AvailabilityPreservingPolicy());
+    options.enable_parallel_version_transitions =
+        enable_parallel_version_transitions;
+    std::unique_ptr<AspiredVersionsManager> manager;
+    CHECK_OK(AspiredVersionsManager::Create(std::move(options), &manager));
+    AspireVersionOfAllServables(manager.get(), num_servables, version,
+                                kLoadMicros);
+    WaitUntilOnlyVersionIsAvailable(manager.get(), num_servables, version);
+    ++version;
+    state.ResumeTiming();
+
+    AspireVersionOfAllServables(manager.get(), num_servables, version,
+                                kLoadMicros);
+    WaitUntilOnlyVersionIsAvailable(manager.get(), num_servables, version);
+
+    state.PauseTiming();
+    manager.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(num_servables * state.iterations());
+}
+
+// Args are {number of servable streams, whether to enable parallel version
+// transitions}.
+BENCHMARK(BM_ManyModelRollout)
+    ->UseRealTime()
+    ->ArgPair(10, 0)
+    ->ArgPair(10, 1)
+    ->ArgPair(100, 0)
+    ->ArgPair(100, 1)
+    ->ArgPair(300, 0)
+    ->ArgPair(300, 1);
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
@@ -1383,6 +1383,117 @@ TEST(AspiredVersionsManagerTest, CallPolicyWithAllVersions) {
   EXPECT_EQ(kNumVersionsPerServable, all_versions.size());
 }
 
+TEST(AspiredVersionsManagerTest, ParallelVersionTransitionsLoadConcurrently) {
+  constexpr int kNumLoadThreads = 3;
+  constexpr int kNumServables = 5;
+  std::shared_ptr<EventBus<ServableState>> servable_event_bus =
+      EventBus<ServableState>::CreateEventBus();
+  ServableStateMonitor servable_state_monitor(servable_event_bus.get());
+  std::unique_ptr<AspiredVersionsManager> manager;
+  AspiredVersionsManager::Options manager_options;
+  manager_options.num_load_threads = kNumLoadThreads;
+  // The state manager thread won't be run automatically.
+  manager_options.manage_state_interval_micros = -1;
+  manager_options.aspired_version_policy.reset(
+      new AvailabilityPreservingPolicy());
+  manager_options.servable_event_bus = servable_event_bus.get();
+  manager_options.enable_parallel_version_transitions = true;
+  TF_ASSERT_OK(
+      AspiredVersionsManager::Create(std::move(manager_options), &manager));
+
+  mutex mu;
+  int num_loading = 0;
+  absl::Notification finish_loads;
+  std::vector<ServableId> ids;
+  for (int i = 0; i < kNumServables; ++i) {
+    const ServableId id = {strings::StrCat(kServableName, i), 0};
+    ids.push_back(id);
+    test_util::MockLoader* loader = new NiceMock<test_util::MockLoader>();
+    EXPECT_CALL(*loader, LoadWithMetadata(Loader::Metadata{id}))
+        .WillOnce(InvokeWithoutArgs([&]() {
+          {
+            mutex_lock l(mu);
+            ++num_loading;
+          }
+          finish_loads.WaitForNotification();
+          return absl::OkStatus();
+        }));
+    std::vector<ServableData<std::unique_ptr<Loader>>> aspired_versions;
+    aspired_versions.push_back({id, std::unique_ptr<Loader>(loader)});
+    manager->GetAspiredVersionsCallback()(id.name,
+                                          std::move(aspired_versions));
+  }
+  test_util::AspiredVersionsManagerTestAccess(manager.get())
+      .HandlePendingAspiredVersionsRequests();
+
+  // A single run starts as many loads as there are load threads.
+  test_util::AspiredVersionsManagerTestAccess(manager.get())
+      .InvokePolicyAndExecuteAction();
+  while (true) {
+    {
+      mutex_lock l(mu);
+      if (num_loading == kNumLoadThreads) break;
+    }
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  // The others wait for those to finish.
+  test_util::AspiredVersionsManagerTestAccess(manager.get())
+      .InvokePolicyAndExecuteAction();
+  int num_loads_reported = 0;
+  for (const ServableId& id : ids) {
+    if (servable_state_monitor.GetState(id)->manager_state ==
+        ServableState::ManagerState::kLoading) {
+      ++num_loads_reported;
+    }
+  }
+  EXPECT_EQ(kNumLoadThreads, num_loads_reported);
+
+  finish_loads.Notify();
+  while (manager->ListAvailableServableIds().size() < ids.size()) {
+    test_util::AspiredVersionsManagerTestAccess(manager.get())
+        .InvokePolicyAndExecuteAction();
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+}
+
+TEST(AspiredVersionsManagerTest, ParallelVersionTransitionsWakeUpOnRequest) {
+  std::shared_ptr<EventBus<ServableState>> servable_event_bus =
+      EventBus<ServableState>::CreateEventBus();
+  ServableStateMonitor servable_state_monitor(servable_event_bus.get());
+  std::unique_ptr<AspiredVersionsManager> manager;
+  AspiredVersionsManager::Options manager_options;
+  // Much longer than the test may take, so that only wake-ups get the versions
+  // loaded and unloaded.
+  manager_options.manage_state_interval_micros = 3600LL * 1000 * 1000;
+  manager_options.aspired_version_policy.reset(
+      new AvailabilityPreservingPolicy());
+  manager_options.servable_event_bus = servable_event_bus.get();
+  manager_options.enable_parallel_version_transitions = true;
+  TF_ASSERT_OK(
+      AspiredVersionsManager::Create(std::move(manager_options), &manager));
+
+  std::vector<ServableData<std::unique_ptr<Loader>>> aspired_versions;
+  aspired_versions.push_back(CreateAspiredVersion({kServableName, 1}));
+  manager->GetAspiredVersionsCallback()(kServableName,
+                                        std::move(aspired_versions));
+  WaitUntilServableManagerStateIsOneOf(
+      servable_state_monitor, {kServableName, 1},
+      {ServableState::ManagerState::kAvailable});
+
+  // Loading version 2 is followed by unloading version 1 without waiting for
+  // the interval either.
+  aspired_versions.clear();
+  aspired_versions.push_back(CreateAspiredVersion({kServableName, 2}));
+  manager->GetAspiredVersionsCallback()(kServableName,
+                                        std::move(aspired_versions));
+  WaitUntilServableManagerStateIsOneOf(
+      servable_state_monitor, {kServableName, 2},
+      {ServableState::ManagerState::kAvailable});
+  WaitUntilServableManagerStateIsOneOf(servable_state_monitor,
+                                       {kServableName, 1},
+                                       {ServableState::ManagerState::kEnd});
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
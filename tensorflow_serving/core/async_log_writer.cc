@@ -0,0 +1,186 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/async_log_writer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+auto* request_log_dropped_count = monitoring::Counter<1>::New(
+    "/tensorflow/serving/request_log_dropped_count",
+    "The total number of request logs dropped because the queue of logs to be "
+    "collected asynchronously was full or over its byte budget, sliced down "
+    "by writer name.",
+    "name");
+
+auto* request_log_collection_error_count = monitoring::Counter<1>::New(
+    "/tensorflow/serving/request_log_collection_error_count",
+    "The total number of asynchronously collected request logs which failed "
+    "to be collected, sliced down by writer name.",
+    "name");
+
+auto* request_log_queue_depth = monitoring::Gauge<int64_t, 1>::New(
+    "/tensorflow/serving/request_log_queue_depth",
+    "The number of request logs waiting to be collected asynchronously, "
+    "sliced down by writer name.",
+    "name");
+
+// Returns the smallest power of two which is at least 'n'.
+int64_t RoundUpToPowerOfTwo(const int64_t n) {
+  int64_t power = 1;
+  while (power < n) {
+    power <<= 1;
+  }
+  return power;
+}
+
+}  // namespace
+
+AsyncLogWriter::AsyncLogWriter(const Options& options,
+                               LogCollector* const log_collector)
+    : options_(options),
+      log_collector_(log_collector),
+      queue_(RoundUpToPowerOfTwo(
+          std::max<int64_t>(options.max_queue_size, 1))),
+      dropped_count_(request_log_dropped_count->GetCell(options.name)),
+      collection_error_count_(
+          request_log_collection_error_count->GetCell(options.name)),
+      queue_depth_(request_log_queue_depth->GetCell(options.name)),
+      last_flush_micros_(options.env->NowMicros()) {
+  const int num_threads = std::max(options_.num_threads, 1);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(options_.env->StartThread(
+        ThreadOptions(), absl::StrCat("async_log_writer_", i),
+        [this]() { CollectLoop(); }));
+  }
+}
+
+AsyncLogWriter::~AsyncLogWriter() {
+  stop_.Notify();
+  // Joins the threads, which only exit once the queue is empty.
+  threads_.clear();
+  queue_depth_->Set(0);
+}
+
+bool AsyncLogWriter::Write(std::unique_ptr<google::protobuf::Message> log) {
+  // Also caches the size, for CollectBatch() to read back.
+  const int64_t bytes = log->ByteSizeLong();
+  if (options_.max_queued_bytes > 0 &&
+      queued_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes >
+          options_.max_queued_bytes) {
+    queued_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    dropped_count_->IncrementBy(1);
+    return false;
+  }
+  if (!queue_.Push(log.get())) {
+    if (options_.max_queued_bytes > 0) {
+      queued_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    dropped_count_->IncrementBy(1);
+    return false;
+  }
+  // Owned by the queue until collected.
+  log.release();
+  return true;
+}
+
+int AsyncLogWriter::CollectBatch() {
+  const int max_batch_size = std::max(options_.max_batch_size, 1);
+  int num_collected = 0;
+  int num_errors = 0;
+  int64_t num_bytes = 0;
+  for (; num_collected < max_batch_size; ++num_collected) {
+    std::unique_ptr<google::protobuf::Message> log(queue_.Pop());
+    if (log == nullptr) {
+      break;
+    }
+    const int64_t bytes = log->GetCachedSize();
+    if (options_.max_queued_bytes > 0) {
+      queued_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    num_bytes += bytes;
+    const absl::Status status = log_collector_->CollectMessage(*log);
+    if (!status.ok()) {
+      ++num_errors;
+      VLOG(1) << "Failed to collect request log: " << status;
+    }
+  }
+  MaybeFlush(num_collected, num_bytes, /*force=*/false);
+  if (num_errors > 0) {
+    collection_error_count_->IncrementBy(num_errors);
+  }
+  queue_depth_->Set(queue_.ApproximateSize());
+  return num_collected;
+}
+
+void AsyncLogWriter::MaybeFlush(const int num_logs, const int64_t num_bytes,
+                                const bool force) {
+  {
+    absl::MutexLock l(&flush_mu_);
+    unflushed_logs_ += num_logs;
+    unflushed_bytes_ += num_bytes;
+    if (unflushed_logs_ == 0) {
+      return;
+    }
+    const uint64_t now_micros = options_.env->NowMicros();
+    if (!force && unflushed_bytes_ < options_.flush_bytes &&
+        now_micros - last_flush_micros_ <
+            static_cast<uint64_t>(
+                std::max<int64_t>(options_.flush_interval_micros, 0))) {
+      return;
+    }
+    unflushed_logs_ = 0;
+    unflushed_bytes_ = 0;
+    last_flush_micros_ = now_micros;
+  }
+  const absl::Status status = log_collector_->Flush();
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to flush request logs: " << status;
+  }
+}
+
+void AsyncLogWriter::CollectLoop() {
+  const int max_batch_size = std::max(options_.max_batch_size, 1);
+  while (true) {
+    if (CollectBatch() == max_batch_size) {
+      continue;
+    }
+    if (stop_.HasBeenNotified()) {
+      // Drains the queue, and flushes what it collected, before exiting.
+      while (CollectBatch() > 0) {
+      }
+      MaybeFlush(/*num_logs=*/0, /*num_bytes=*/0, /*force=*/true);
+      return;
+    }
+    stop_.WaitForNotificationWithTimeout(
+        absl::Microseconds(options_.flush_interval_micros));
+  }
+}
+
+}  // namespace serving
+}  // namespace tensorflow
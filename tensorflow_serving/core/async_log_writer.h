@@ -0,0 +1,130 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_ASYNC_LOG_WRITER_H_
+#define TENSORFLOW_SERVING_CORE_ASYNC_LOG_WRITER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "google/protobuf/message.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/core/log_collector.h"
+#include "tensorflow_serving/util/bounded_mpmc_queue.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Collects logs into a LogCollector from background threads.
+//
+// Write() queues the logs on a bounded, lock-free queue and never blocks: if
+// the queue is full, or the queued logs would take more bytes than the byte
+// budget, the log is dropped. The threads take batches of logs off the queue
+// and collect them. The log-collector is flushed once the logs collected since
+// the last flush reach a number of bytes, or the flush interval has passed
+// since it, rather than after every batch. A thread which found fewer logs
+// than a full batch waits for the flush interval before looking for more.
+//
+// The number of dropped logs, the number of logs which failed to be collected
+// and the depth of the queue are exported as metrics labeled with the name of
+// the writer.
+class AsyncLogWriter {
+ public:
+  struct Options {
+    // The maximum number of queued logs, rounded up to a power of two.
+    int64_t max_queue_size = 1 << 14;
+
+    // The number of threads collecting the logs.
+    int num_threads = 1;
+
+    // The maximum number of bytes of queued logs, as serialized. Logs which
+    // would exceed it are dropped. No limit if zero or negative.
+    int64_t max_queued_bytes = 64 << 20;
+
+    // The maximum number of logs taken off the queue at once.
+    int max_batch_size = 256;
+
+    // The log-collector is flushed once the logs collected since the last
+    // flush take this many bytes, as serialized...
+    int64_t flush_bytes = 1 << 20;
+
+    // ...or once this much time has passed since the last flush, if any log
+    // was collected since. Also how long a thread waits for more logs after
+    // finding fewer than a full batch.
+    int64_t flush_interval_micros = 100 * 1000;
+
+    // Labels the metrics of this writer.
+    string name;
+
+    Env* env = Env::Default();
+  };
+
+  // 'log_collector' must outlive the writer.
+  AsyncLogWriter(const Options& options, LogCollector* log_collector);
+
+  // Collects the logs still queued, then stops the threads.
+  ~AsyncLogWriter();
+
+  // Queues 'log' to be collected. Returns false if it was dropped instead,
+  // because the queue is full or over its byte budget.
+  bool Write(std::unique_ptr<google::protobuf::Message> log);
+
+ private:
+  // Collects up to a batch of queued logs, then flushes the log-collector if
+  // it is due. Returns the number of logs taken off the queue.
+  int CollectBatch();
+
+  // Flushes the log-collector if logs of at least 'options_.flush_bytes' were
+  // collected since the last flush, or any were and either the flush interval
+  // has passed or 'force' is true. 'num_logs' logs of 'num_bytes' were just
+  // collected.
+  void MaybeFlush(int num_logs, int64_t num_bytes, bool force);
+
+  // The body of each thread.
+  void CollectLoop();
+
+  const Options options_;
+  LogCollector* const log_collector_;
+  BoundedMpmcQueue<google::protobuf::Message> queue_;
+  // The bytes of the logs in 'queue_'.
+  std::atomic<int64_t> queued_bytes_{0};
+  absl::Mutex flush_mu_;
+  // The logs collected since the last flush.
+  int64_t unflushed_logs_ ABSL_GUARDED_BY(flush_mu_) = 0;
+  int64_t unflushed_bytes_ ABSL_GUARDED_BY(flush_mu_) = 0;
+  uint64_t last_flush_micros_ ABSL_GUARDED_BY(flush_mu_);
+  // The metric cells of this writer, looked up once.
+  monitoring::CounterCell* const dropped_count_;
+  monitoring::CounterCell* const collection_error_count_;
+  monitoring::GaugeCell<int64_t>* const queue_depth_;
+  absl::Notification stop_;
+  std::vector<std::unique_ptr<Thread>> threads_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AsyncLogWriter);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_ASYNC_LOG_WRITER_H_
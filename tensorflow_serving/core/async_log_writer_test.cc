@@ -0,0 +1,202 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/async_log_writer.h"
+
+#include <memory>
+#include <vector>
+
+#include "google/protobuf/wrappers.pb.h"
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "tensorflow/core/kernels/batching_util/fake_clock_env.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow_serving/core/test_util/mock_log_collector.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+std::unique_ptr<google::protobuf::Message> CreateLog(const int value) {
+  auto log = std::make_unique<google::protobuf::Int32Value>();
+  log->set_value(value);
+  return log;
+}
+
+TEST(AsyncLogWriterTest, CollectsAllLogs) {
+  NiceMock<MockLogCollector> log_collector;
+  absl::Mutex mu;
+  std::vector<int> values;
+  EXPECT_CALL(log_collector, CollectMessage(_))
+      .WillRepeatedly(Invoke([&](const google::protobuf::Message& message) {
+        absl::MutexLock l(&mu);
+        values.push_back(
+            static_cast<const google::protobuf::Int32Value&>(message).value());
+        return absl::OkStatus();
+      }));
+  EXPECT_CALL(log_collector, Flush()).WillRepeatedly(Return(absl::OkStatus()));
+
+  constexpr int kNumLogs = 100;
+  {
+    AsyncLogWriter::Options options;
+    options.max_batch_size = 8;
+    options.flush_interval_micros = 1000;
+    AsyncLogWriter writer(options, &log_collector);
+    for (int i = 0; i < kNumLogs; ++i) {
+      EXPECT_TRUE(writer.Write(CreateLog(i)));
+    }
+  }
+  // With a single thread, the logs are collected in order.
+  ASSERT_EQ(kNumLogs, values.size());
+  for (int i = 0; i < kNumLogs; ++i) {
+    EXPECT_EQ(i, values[i]);
+  }
+}
+
+TEST(AsyncLogWriterTest, DropsLogsWhenFull) {
+  NiceMock<MockLogCollector> log_collector;
+  absl::Notification collecting;
+  absl::Notification unblock;
+  int num_collected = 0;
+  EXPECT_CALL(log_collector, CollectMessage(_))
+      .WillRepeatedly(Invoke([&](const google::protobuf::Message& message) {
+        if (!collecting.HasBeenNotified()) {
+          collecting.Notify();
+        }
+        unblock.WaitForNotification();
+        ++num_collected;
+        return absl::OkStatus();
+      }));
+
+  {
+    AsyncLogWriter::Options options;
+    options.max_queue_size = 3;
+    AsyncLogWriter writer(options, &log_collector);
+    // Blocks the thread on the first log, so that the next ones are queued.
+    EXPECT_TRUE(writer.Write(CreateLog(0)));
+    collecting.WaitForNotification();
+    // Rounded up to 4.
+    for (int i = 1; i <= 4; ++i) {
+      EXPECT_TRUE(writer.Write(CreateLog(i)));
+    }
+    EXPECT_FALSE(writer.Write(CreateLog(5)));
+    unblock.Notify();
+  }
+  EXPECT_EQ(5, num_collected);
+}
+
+TEST(AsyncLogWriterTest, DropsLogsOverByteBudget) {
+  NiceMock<MockLogCollector> log_collector;
+  absl::Notification collecting;
+  absl::Notification unblock;
+  int num_collected = 0;
+  EXPECT_CALL(log_collector, CollectMessage(_))
+      .WillRepeatedly(Invoke([&](const google::protobuf::Message& message) {
+        if (!collecting.HasBeenNotified()) {
+          collecting.Notify();
+        }
+        unblock.WaitForNotification();
+        ++num_collected;
+        return absl::OkStatus();
+      }));
+
+  {
+    AsyncLogWriter::Options options;
+    // Logs of values 1 to 127 take 2 bytes.
+    options.max_queued_bytes = 5;
+    AsyncLogWriter writer(options, &log_collector);
+    // Blocks the thread on the first log, which isn't queued anymore.
+    EXPECT_TRUE(writer.Write(CreateLog(1)));
+    collecting.WaitForNotification();
+    EXPECT_TRUE(writer.Write(CreateLog(2)));
+    EXPECT_TRUE(writer.Write(CreateLog(3)));
+    EXPECT_FALSE(writer.Write(CreateLog(4)));
+    unblock.Notify();
+  }
+  EXPECT_EQ(3, num_collected);
+}
+
+TEST(AsyncLogWriterTest, FlushesOnByteThreshold) {
+  NiceMock<MockLogCollector> log_collector;
+  absl::Notification collecting;
+  absl::Notification unblock;
+  EXPECT_CALL(log_collector, CollectMessage(_))
+      .WillOnce(Invoke([&](const google::protobuf::Message& message) {
+        collecting.Notify();
+        unblock.WaitForNotification();
+        return absl::OkStatus();
+      }))
+      .WillRepeatedly(Return(absl::InternalError("Error")));
+  // One flush for each batch of logs 1 and 2, 3 and 4, and 5 and 6, which
+  // take 4 bytes, and one for log 7 when the writer stops.
+  EXPECT_CALL(log_collector, Flush())
+      .Times(4)
+      .WillRepeatedly(Return(absl::OkStatus()));
+
+  {
+    // The clock doesn't advance, so the flush interval never passes, although
+    // the threads wait for it between looking for logs.
+    test_util::FakeClockEnv env(Env::Default());
+    AsyncLogWriter::Options options;
+    options.max_batch_size = 2;
+    options.flush_bytes = 4;
+    options.flush_interval_micros = 1000;
+    options.env = &env;
+    AsyncLogWriter writer(options, &log_collector);
+    EXPECT_TRUE(writer.Write(CreateLog(1)));
+    collecting.WaitForNotification();
+    for (int i = 2; i <= 7; ++i) {
+      EXPECT_TRUE(writer.Write(CreateLog(i)));
+    }
+    unblock.Notify();
+  }
+}
+
+TEST(AsyncLogWriterTest, FlushesOnTimer) {
+  NiceMock<MockLogCollector> log_collector;
+  absl::Notification flushed;
+  EXPECT_CALL(log_collector, CollectMessage(_))
+      .WillRepeatedly(Return(absl::OkStatus()));
+  EXPECT_CALL(log_collector, Flush())
+      .WillOnce(Invoke([&]() {
+        flushed.Notify();
+        return absl::OkStatus();
+      }))
+      .WillRepeatedly(Return(absl::OkStatus()));
+
+  test_util::FakeClockEnv env(Env::Default());
+  AsyncLogWriter::Options options;
+  options.flush_bytes = 1 << 20;
+  options.flush_interval_micros = 1000;
+  options.env = &env;
+  AsyncLogWriter writer(options, &log_collector);
+  EXPECT_TRUE(writer.Write(CreateLog(1)));
+  // Flushed before the writer stops, once the flush interval has passed,
+  // although far fewer bytes than 'flush_bytes' were collected.
+  env.AdvanceByMicroseconds(1000);
+  flushed.WaitForNotification();
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -144,7 +144,9 @@ absl::Status BasicManager::ServingMap::GetUntypedServableHandle(
   // We use the aliasing constructor of shared_ptr here. So even though we are
   // returning a shared_ptr to servable, the ref-counting is happening on the
   // handles_map. This delays the map destruction till the last handle from the
-  // previous map is freed, when we are doing handles_map updates.
+  // previous map is freed, when we are doing handles_map updates. Each
+  // handles_map pointer has its own reference count (see EpochReadPtrs), so
+  // handles acquired concurrently don't contend on it.
   untyped_handle->reset(new SharedPtrHandle(
       harness.id(), std::shared_ptr<Loader>(handles_map, harness.loader())));
   return absl::OkStatus();
@@ -477,7 +477,11 @@ class BasicManager : public Manager {
         std::unordered_multimap<ServableRequest,
                                 std::shared_ptr<const LoaderHarness>,
                                 HashRequest, EqRequest>;
-    FastReadDynamicPtr<HandlesMap> handles_map_;
+    // Handles are acquired on every request, so readers pin the map through
+    // per-CPU epochs instead of contending on a reference count.
+    FastReadDynamicPtr<HandlesMap,
+                       internal_read_ptr_holder::EpochReadPtrs<HandlesMap>>
+        handles_map_;
   };
   ServingMap serving_map_;
 
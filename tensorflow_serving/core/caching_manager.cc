@@ -25,19 +25,96 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/logging.h"
 #include "tensorflow_serving/core/loader.h"
 #include "tensorflow_serving/core/servable_data.h"
 #include "tensorflow_serving/core/servable_handle.h"
 #include "tensorflow_serving/core/servable_id.h"
+#include "tensorflow_serving/util/threadpool_executor.h"
 
 namespace tensorflow {
 namespace serving {
 
+namespace {
+
+auto* request_count = monitoring::Counter<1>::New(
+    "/tensorflow/serving/caching_manager/request_count",
+    "The number of servable requests to caching-managers, by whether the "
+    "servable was already loaded (\"hit\") or not (\"miss\").",
+    "result");
+
+auto* eviction_count = monitoring::Counter<0>::New(
+    "/tensorflow/serving/caching_manager/eviction_count",
+    "The number of servables unloaded by caching-managers to keep within "
+    "their budget.");
+
+auto* load_latency = monitoring::Sampler<0>::New(
+    {"/tensorflow/serving/caching_manager/load_latency",
+     "Distribution of wall time (in microseconds) for caching-managers to load "
+     "a requested servable, including any evictions. Prefetches are left "
+     "out."},
+    // Scale of 10, power of 1.8 with bucket count 33 (~20 minutes).
+    monitoring::Buckets::Exponential(10, 1.8, 33));
+
+auto* prefetch_count = monitoring::Counter<0>::New(
+    "/tensorflow/serving/caching_manager/prefetch_count",
+    "The number of servables loaded by caching-managers ahead of their "
+    "requests, as predicted from the past requests.");
+
+void RecordRequest(const bool hit) {
+  static monitoring::CounterCell* const hit_count =
+      request_count->GetCell("hit");
+  static monitoring::CounterCell* const miss_count =
+      request_count->GetCell("miss");
+  (hit ? hit_count : miss_count)->IncrementBy(1);
+}
+
+}  // namespace
+
+class CachingManager::PinnedServableHandle : public UntypedServableHandle {
+ public:
+  // Takes over the handle counted in 'cached_servable' by
+  // PinCachedServable().
+  PinnedServableHandle(std::unique_ptr<UntypedServableHandle> handle,
+                       std::shared_ptr<CachedServable> cached_servable)
+      : handle_(std::move(handle)),
+        cached_servable_(std::move(cached_servable)) {}
+
+  ~PinnedServableHandle() override { --cached_servable_->num_handles; }
+
+  const ServableId& id() const override { return handle_->id(); }
+
+  AnyPtr servable() override { return handle_->servable(); }
+
+ private:
+  const std::unique_ptr<UntypedServableHandle> handle_;
+  const std::shared_ptr<CachedServable> cached_servable_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PinnedServableHandle);
+};
+
 absl::Status CachingManager::Create(
     Options options, std::unique_ptr<LoaderFactory> loader_factory,
     std::unique_ptr<CachingManager>* caching_manager) {
+  if (options.max_num_loaded_servables > 0 &&
+      options.eviction_policy == nullptr) {
+    return absl::InvalidArgumentError(
+        "The caching-manager needs an eviction policy to limit the number of "
+        "loaded servables.");
+  }
+  if (options.prefetch_predictor != nullptr &&
+      options.num_prefetch_threads == 0) {
+    return absl::InvalidArgumentError(
+        "The caching-manager needs prefetch threads to prefetch servables.");
+  }
+
   // Set up basic manager options from the caching manager options.
   BasicManager::Options basic_manager_options;
+  // The tracker is owned by the basic manager from now on.
+  const ResourceTracker* const resource_tracker =
+      options.resource_tracker.get();
   basic_manager_options.resource_tracker = std::move(options.resource_tracker);
   basic_manager_options.num_load_threads = options.num_load_threads;
   basic_manager_options.num_unload_threads = options.num_unload_threads;
@@ -53,14 +130,49 @@ absl::Status CachingManager::Create(
       BasicManager::Create(std::move(basic_manager_options), &basic_manager));
 
   caching_manager->reset(
-      new CachingManager(std::move(loader_factory), std::move(basic_manager)));
+      new CachingManager(std::move(options), resource_tracker,
+                         std::move(loader_factory), std::move(basic_manager)));
   return absl::OkStatus();
 }
 
-CachingManager::CachingManager(std::unique_ptr<LoaderFactory> loader_factory,
+CachingManager::CachingManager(Options options,
+                               const ResourceTracker* const resource_tracker,
+                               std::unique_ptr<LoaderFactory> loader_factory,
                                std::unique_ptr<BasicManager> basic_manager)
     : loader_factory_(std::move(loader_factory)),
-      basic_manager_(std::move(basic_manager)) {}
+      basic_manager_(std::move(basic_manager)),
+      eviction_policy_(std::move(options.eviction_policy)),
+      max_num_loaded_servables_(options.max_num_loaded_servables),
+      resource_tracker_(resource_tracker),
+      env_(options.env),
+      prefetch_predictor_(std::move(options.prefetch_predictor)) {
+  if (prefetch_predictor_ == nullptr) {
+    return;
+  }
+  prefetch_executor_.reset(
+      new ThreadPoolExecutor(env_, "CachingManager_Prefetch_ThreadPool",
+                             options.num_prefetch_threads));
+  const int64_t interval_micros = options.periodic_prefetch_interval_micros;
+  if (interval_micros > 0) {
+    PeriodicFunction::Options pf_options;
+    pf_options.env = env_;
+    pf_options.thread_name_prefix = "CachingManager_Prefetch_Thread";
+    periodic_prefetch_thread_.reset(new PeriodicFunction(
+        [this, interval_micros]() {
+          // Prefetches the servables for the time of the next run, the most
+          // requested first, until the budget is full.
+          for (const ServableId& servable_id :
+               prefetch_predictor_->PredictForTime(env_->NowMicros() +
+                                                   interval_micros)) {
+            if (CacheFull()) {
+              break;
+            }
+            MaybePrefetch(servable_id);
+          }
+        },
+        interval_micros, pf_options));
+  }
+}
 
 CachingManager::~CachingManager() {}
 
@@ -82,99 +194,202 @@ absl::Status CachingManager::GetUntypedServableHandle(
 absl::Status CachingManager::GetUntypedServableHandleForId(
     const ServableId& servable_id,
     std::unique_ptr<UntypedServableHandle>* handle) {
-  // Check if the underlying basic manager can already serve this request.
-  const absl::Status handle_status = basic_manager_->GetUntypedServableHandle(
-      ServableRequest::FromId(servable_id), handle);
-
-  // If the servable is already managed and loaded by the basic manager, serve
-  // it.
-  if (handle_status.ok() || handle_status.code() != error::NOT_FOUND) {
-    return handle_status;
+  // Prefetches the servables predicted to follow this request, while it's
+  // served. The request itself is only recorded once served.
+  if (prefetch_predictor_ != nullptr) {
+    for (const ServableId& follower :
+         prefetch_predictor_->PredictFollowers(servable_id)) {
+      MaybePrefetch(follower);
+    }
   }
 
-  // Build the servable data corresponding to the servable-id.
-  ServableData<std::unique_ptr<Loader>> loader_data =
-      loader_factory_->CreateLoader(servable_id);
+  bool hit = true;
+  while (true) {
+    // With an eviction policy, the servable is pinned before taking a handle
+    // to it, so that it can't be selected for eviction meanwhile.
+    std::shared_ptr<CachedServable> cached_servable;
+    std::shared_ptr<CachedServable> evicting_servable;
+    if (eviction_policy_ != nullptr) {
+      cached_servable = PinCachedServable(servable_id, &evicting_servable);
+    }
+
+    // Check if the underlying basic manager can already serve this request.
+    const absl::Status handle_status = basic_manager_->GetUntypedServableHandle(
+        ServableRequest::FromId(servable_id), handle);
+
+    // If the servable is already managed and loaded by the basic manager, and
+    // pinned if need be, serve it.
+    if (handle_status.ok() &&
+        (eviction_policy_ == nullptr || cached_servable != nullptr)) {
+      if (cached_servable != nullptr) {
+        *handle = std::make_unique<PinnedServableHandle>(
+            std::move(*handle), std::move(cached_servable));
+      }
+      RecordRequest(hit);
+      RecordServedRequest(servable_id);
+      return absl::OkStatus();
+    }
+    if (cached_servable != nullptr) {
+      --cached_servable->num_handles;
+    }
+    if (!handle_status.ok() && handle_status.code() != error::NOT_FOUND) {
+      return handle_status;
+    }
+    if (hit) {
+      RecordRequest(/*hit=*/false);
+      hit = false;
+    }
+
+    if (handle_status.ok()) {
+      // The servable is loaded but not cached, as it's being evicted, or the
+      // thread which loaded it has yet to cache it. The handle would hold up
+      // the eviction, so wait for either to be done and try again.
+      handle->reset();
+      if (evicting_servable != nullptr) {
+        evicting_servable->evicted.WaitForNotification();
+      } else {
+        std::shared_ptr<mutex> servable_id_mu = GetLoadMutex(servable_id);
+        { mutex_lock l(*servable_id_mu); }
+        servable_id_mu.reset();
+        MaybeEraseLoadMutexMapEntry(servable_id);
+      }
+      continue;
+    }
+
+    // Build the servable data corresponding to the servable-id.
+    ServableData<std::unique_ptr<Loader>> loader_data =
+        loader_factory_->CreateLoader(servable_id);
 
-  // Load the servable corresponding to the servable-id. For multiple concurrent
-  // requests enforces that exactly one thread performs the load operation with
-  // the wrapped basic-manager. All other requests block until the load
-  // completes and then trivially succeed.
-  TF_RETURN_IF_ERROR(LoadServable(std::move(loader_data)));
+    // Load the servable corresponding to the servable-id. For multiple
+    // concurrent requests enforces that exactly one thread performs the load
+    // operation with the wrapped basic-manager. All other requests block until
+    // the load completes and then trivially succeed.
+    TF_RETURN_IF_ERROR(
+        LoadServable(std::move(loader_data), /*prefetch=*/false));
 
-  // Return the handle using the loaded servable data now.
-  return basic_manager_->GetUntypedServableHandle(
-      ServableRequest::FromId(servable_id), handle);
+    // Return the handle using the loaded servable data now. With an eviction
+    // policy, the servable is pinned first.
+    if (eviction_policy_ == nullptr) {
+      TF_RETURN_IF_ERROR(basic_manager_->GetUntypedServableHandle(
+          ServableRequest::FromId(servable_id), handle));
+      RecordServedRequest(servable_id);
+      return absl::OkStatus();
+    }
+  }
+}
+
+void CachingManager::RecordServedRequest(const ServableId& servable_id) {
+  if (prefetch_predictor_ != nullptr) {
+    prefetch_predictor_->RecordRequest(servable_id, env_->NowMicros());
+  }
 }
 
 absl::Status CachingManager::LoadServable(
-    ServableData<std::unique_ptr<Loader>> loader_data) {
+    ServableData<std::unique_ptr<Loader>> loader_data, const bool prefetch) {
   const ServableId servable_id = loader_data.id();
 
-  std::shared_ptr<mutex> servable_id_mu;
-  {
-    mutex_lock l(load_mutex_map_mu_);
-    auto iter = load_mutex_map_.find(servable_id);
-    if (iter == load_mutex_map_.end()) {
-      iter =
-          load_mutex_map_.emplace(servable_id, std::make_shared<mutex>()).first;
-    }
-    servable_id_mu = iter->second;
-  }
+  std::shared_ptr<mutex> servable_id_mu = GetLoadMutex(servable_id);
 
+  absl::Status status;
   {
     // Ensure only one thread attempts to load the servable at a time.
     mutex_lock l(*servable_id_mu);
+    status = LoadServableLocked(std::move(loader_data), prefetch);
+  }
+  servable_id_mu.reset();
+  MaybeEraseLoadMutexMapEntry(servable_id);
+  return status;
+}
 
-    // Retrieve the state of the servable from the wrapped basic-manager. The
-    // servable should already be managed by the basic-manager.
-    const absl::optional<ServableStateSnapshot<>> snapshot =
-        basic_manager_->GetManagedServableStateSnapshot(servable_id);
-    if (snapshot) {
-      // The servable is already being managed by 'basic_manager_'. Hence it
-      // ought to be loaded, based on CachingManager's implementation invariant
-      // of doing manage+load atomically.
-      if (snapshot.value().state != LoaderHarness::State::kReady) {
-        const std::string error_msg = absl::StrCat(
-            "Servable requested for load is already being managed, but is not "
-            "loaded: ",
-            servable_id.DebugString());
-        DCHECK(false) << error_msg;
-        return absl::InternalError(error_msg);
-      }
-    } else {
-      // Load the servable since it has not been loaded yet based on its state.
-      //
-      // First, transfer the servable to the basic manager. The loader_data may
-      // contain an error and the basic manager is equipped to handle that
-      // appropriately. By propagating such errors back to the basic manager,
-      // the functionality of the event-bus and the servable state monitor are
-      // automatically available in the caching-manager as well (via the basic
-      // manager).
-      const absl::Status manage_status =
-          basic_manager_->ManageServable(std::move(loader_data));
-      if (!manage_status.ok()) {
-        const std::string error_msg = absl::StrCat(
-            "Internal error: unable to transfer servable to 'basic_manager_': ",
-            manage_status.message());
-        DCHECK(false) << error_msg;
-        return absl::InternalError(error_msg);
-      }
+absl::Status CachingManager::LoadServableLocked(
+    ServableData<std::unique_ptr<Loader>> loader_data, const bool prefetch) {
+  const ServableId servable_id = loader_data.id();
 
-      absl::Notification load_done;
-      absl::Status load_status;
-      basic_manager_->LoadServable(servable_id,
-                                   [&](const absl::Status& status) {
-                                     load_status = status;
-                                     load_done.Notify();
-                                   });
-      load_done.WaitForNotification();
-      TF_RETURN_IF_ERROR(load_status);
+  // Retrieve the state of the servable from the wrapped basic-manager. The
+  // servable should already be managed by the basic-manager.
+  const absl::optional<ServableStateSnapshot<>> snapshot =
+      basic_manager_->GetManagedServableStateSnapshot(servable_id);
+  if (snapshot) {
+    // The servable is already being managed by 'basic_manager_'. Hence it
+    // ought to be loaded, based on CachingManager's implementation invariant
+    // of doing manage+load atomically.
+    if (snapshot.value().state != LoaderHarness::State::kReady) {
+      const std::string error_msg = absl::StrCat(
+          "Servable requested for load is already being managed, but is not "
+          "loaded: ",
+          servable_id.DebugString());
+      DCHECK(false) << error_msg;
+      return absl::InternalError(error_msg);
     }
+    return absl::OkStatus();
   }
-  servable_id_mu.reset();
-  MaybeEraseLoadMutexMapEntry(servable_id);
-  return absl::OkStatus();
+
+  // Load the servable since it has not been loaded yet based on its state.
+  const uint64_t start_micros = env_->NowMicros();
+
+  // With an eviction policy, first make room for the servable in the budget.
+  // Prefetches are skipped rather than evicting servables, which were
+  // requested, for ones which only may be.
+  ResourceAllocation resources;
+  if (eviction_policy_ != nullptr) {
+    resources = EstimateResources(loader_data);
+    if (!ReserveCacheSpace(resources, /*may_evict=*/!prefetch)) {
+      return absl::ResourceExhaustedError(absl::StrCat(
+          "Servable doesn't fit in the caching-manager's budget: ",
+          servable_id.DebugString()));
+    }
+  }
+
+  // Transfer the servable to the basic manager. The loader_data may contain an
+  // error and the basic manager is equipped to handle that appropriately. By
+  // propagating such errors back to the basic manager, the functionality of
+  // the event-bus and the servable state monitor are automatically available
+  // in the caching-manager as well (via the basic manager).
+  const absl::Status manage_status =
+      basic_manager_->ManageServable(std::move(loader_data));
+  if (!manage_status.ok()) {
+    if (eviction_policy_ != nullptr) {
+      FinishCacheReservation(servable_id, resources, /*loaded=*/false);
+    }
+    const std::string error_msg = absl::StrCat(
+        "Internal error: unable to transfer servable to 'basic_manager_': ",
+        manage_status.message());
+    DCHECK(false) << error_msg;
+    return absl::InternalError(error_msg);
+  }
+
+  absl::Notification load_done;
+  absl::Status load_status;
+  basic_manager_->LoadServable(servable_id, [&](const absl::Status& status) {
+    load_status = status;
+    load_done.Notify();
+  });
+  load_done.WaitForNotification();
+  if (eviction_policy_ != nullptr) {
+    FinishCacheReservation(servable_id, resources, load_status.ok());
+  }
+  if (prefetch) {
+    if (load_status.ok()) {
+      prefetch_count->GetCell()->IncrementBy(1);
+    } else {
+      // Lets the next request for the servable try loading it again.
+      basic_manager_->StopManagingServable(servable_id).IgnoreError();
+    }
+  } else {
+    load_latency->GetCell()->Add(env_->NowMicros() - start_micros);
+  }
+  return load_status;
+}
+
+std::shared_ptr<mutex> CachingManager::GetLoadMutex(
+    const ServableId& servable_id) {
+  mutex_lock l(load_mutex_map_mu_);
+  auto iter = load_mutex_map_.find(servable_id);
+  if (iter == load_mutex_map_.end()) {
+    iter =
+        load_mutex_map_.emplace(servable_id, std::make_shared<mutex>()).first;
+  }
+  return iter->second;
 }
 
 void CachingManager::MaybeEraseLoadMutexMapEntry(
@@ -193,6 +408,186 @@ int64_t CachingManager::GetLoadMutexMapSize() const {
   return load_mutex_map_.size();
 }
 
+std::shared_ptr<CachingManager::CachedServable>
+CachingManager::PinCachedServable(
+    const ServableId& servable_id,
+    std::shared_ptr<CachedServable>* const evicting) {
+  mutex_lock l(cache_mu_);
+  auto iter = cached_servables_.find(servable_id);
+  if (iter == cached_servables_.end()) {
+    auto evicting_iter = evicting_servables_.find(servable_id);
+    if (evicting_iter != evicting_servables_.end()) {
+      *evicting = evicting_iter->second;
+    }
+    return nullptr;
+  }
+  eviction_policy_->OnAccess(servable_id);
+  ++iter->second->num_handles;
+  return iter->second;
+}
+
+ResourceAllocation CachingManager::EstimateResources(
+    const ServableData<std::unique_ptr<Loader>>& loader_data) const {
+  if (resource_tracker_ == nullptr || !loader_data.status().ok()) {
+    return ResourceAllocation();
+  }
+  ResourceAllocation resources;
+  const absl::Status status =
+      loader_data.DataOrDie()->EstimateResources(&resources);
+  if (!status.ok()) {
+    // The basic-manager reports the error when loading the servable.
+    return ResourceAllocation();
+  }
+  return resource_tracker_->util().Overbind(resources);
+}
+
+bool CachingManager::ReserveCacheSpace(const ResourceAllocation& resources,
+                                       const bool may_evict) {
+  mutex_lock eviction_lock(eviction_mu_);
+  while (true) {
+    ServableId victim;
+    std::shared_ptr<CachedServable> victim_servable;
+    {
+      mutex_lock l(cache_mu_);
+      if (FitsInCacheLocked(resources)) {
+        break;
+      }
+      if (!may_evict) {
+        return false;
+      }
+      const auto& cached_servables = cached_servables_;
+      const absl::optional<ServableId> selected =
+          eviction_policy_->SelectVictim([&](const ServableId& id) {
+            return cached_servables.at(id)->num_handles == 0;
+          });
+      if (!selected) {
+        VLOG(1) << "Loading a servable beyond the caching-manager's budget, as "
+                   "none of the loaded ones can be evicted";
+        break;
+      }
+      victim = *selected;
+      eviction_policy_->OnRemove(victim);
+      auto iter = cached_servables_.find(victim);
+      victim_servable = iter->second;
+      cached_servables_.erase(iter);
+      evicting_servables_[victim] = victim_servable;
+    }
+
+    const absl::Status status = EvictServable(victim);
+    mutex_lock l(cache_mu_);
+    evicting_servables_.erase(victim);
+    victim_servable->evicted.Notify();
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to evict servable " << victim.DebugString() << ": "
+                 << status;
+      cached_servables_[victim] = victim_servable;
+      eviction_policy_->OnInsert(victim);
+      break;
+    }
+    --num_loaded_servables_;
+    if (resource_tracker_ != nullptr) {
+      resource_tracker_->util().Subtract(victim_servable->resources,
+                                         &loaded_resources_);
+    }
+    eviction_count->GetCell()->IncrementBy(1);
+  }
+
+  mutex_lock l(cache_mu_);
+  ++num_loaded_servables_;
+  if (resource_tracker_ != nullptr) {
+    resource_tracker_->util().Add(resources, &loaded_resources_);
+  }
+  return true;
+}
+
+void CachingManager::FinishCacheReservation(const ServableId& servable_id,
+                                            const ResourceAllocation& resources,
+                                            const bool loaded) {
+  mutex_lock l(cache_mu_);
+  if (loaded) {
+    auto cached_servable = std::make_shared<CachedServable>();
+    cached_servable->resources = resources;
+    cached_servables_[servable_id] = std::move(cached_servable);
+    eviction_policy_->OnInsert(servable_id);
+    return;
+  }
+  --num_loaded_servables_;
+  if (resource_tracker_ != nullptr) {
+    resource_tracker_->util().Subtract(resources, &loaded_resources_);
+  }
+}
+
+bool CachingManager::FitsInCacheLocked(
+    const ResourceAllocation& resources) const {
+  if (max_num_loaded_servables_ > 0 &&
+      num_loaded_servables_ >= max_num_loaded_servables_) {
+    return false;
+  }
+  if (resource_tracker_ == nullptr) {
+    return true;
+  }
+  ResourceAllocation total = loaded_resources_;
+  resource_tracker_->util().Add(resources, &total);
+  return resource_tracker_->util().LessThanOrEqual(
+      total, resource_tracker_->total_resources());
+}
+
+bool CachingManager::CacheFull() const {
+  if (eviction_policy_ == nullptr) {
+    return false;
+  }
+  mutex_lock l(cache_mu_);
+  return !FitsInCacheLocked(ResourceAllocation());
+}
+
+void CachingManager::MaybePrefetch(const ServableId& servable_id) {
+  // Skips servables which are loaded, being loaded, or already scheduled, and
+  // all of them once the budget is full, since prefetches don't evict.
+  if (CacheFull() ||
+      basic_manager_->GetManagedServableStateSnapshot(servable_id)) {
+    return;
+  }
+  {
+    mutex_lock l(prefetch_mu_);
+    if (!pending_prefetches_.insert(servable_id).second) {
+      return;
+    }
+  }
+  prefetch_executor_->Schedule([this, servable_id]() {
+    const absl::Status status = LoadServable(
+        loader_factory_->CreateLoader(servable_id), /*prefetch=*/true);
+    if (!status.ok()) {
+      VLOG(1) << "Failed to prefetch servable " << servable_id.DebugString()
+              << ": " << status;
+    }
+    mutex_lock l(prefetch_mu_);
+    pending_prefetches_.erase(servable_id);
+  });
+}
+
+absl::Status CachingManager::EvictServable(const ServableId& servable_id) {
+  std::shared_ptr<mutex> servable_id_mu = GetLoadMutex(servable_id);
+  absl::Status status;
+  {
+    // Requests for the servable wait for it to be unloaded, and then load it
+    // again.
+    mutex_lock l(*servable_id_mu);
+    absl::Notification unload_done;
+    basic_manager_->UnloadServable(servable_id,
+                                   [&](const absl::Status& unload_status) {
+                                     status = unload_status;
+                                     unload_done.Notify();
+                                   });
+    unload_done.WaitForNotification();
+    if (status.ok()) {
+      status = basic_manager_->StopManagingServable(servable_id);
+    }
+  }
+  servable_id_mu.reset();
+  MaybeEraseLoadMutexMapEntry(servable_id);
+  return status;
+}
+
 std::map<ServableId, std::unique_ptr<UntypedServableHandle>>
 CachingManager::GetAvailableUntypedServableHandles() const {
   return basic_manager_->GetAvailableUntypedServableHandles();
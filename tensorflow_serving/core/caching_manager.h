@@ -16,14 +16,23 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_CORE_CACHING_MANAGER_H_
 #define TENSORFLOW_SERVING_CORE_CACHING_MANAGER_H_
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "absl/synchronization/notification.h"
+#include "tensorflow/core/kernels/batching_util/periodic_function.h"
 #include "tensorflow_serving/core/basic_manager.h"
 #include "tensorflow_serving/core/manager.h"
+#include "tensorflow_serving/core/servable_eviction_policy.h"
+#include "tensorflow_serving/core/servable_prefetch_predictor.h"
 #include "tensorflow_serving/core/source_adapter.h"
+#include "tensorflow_serving/resources/resources.pb.h"
+#include "tensorflow_serving/util/executor.h"
 
 namespace tensorflow {
 namespace serving {
@@ -38,10 +47,21 @@ class CachingManagerTestAccess;
 /// operation and then serves the request.
 ///
 /// The manager blocks on the load operation and returns the handle when the
-/// servable has been loaded, or upon error.
-//
-// TODO(b/25449742): Add support for evictions of loaded servables from the
-// caching-manager.
+/// servable has been loaded, or upon error. Concurrent requests for a servable
+/// which isn't loaded share a single load.
+///
+/// Given an eviction policy, the manager keeps the loaded servables within a
+/// budget: a number of servables, and the total resources of the resource
+/// tracker going by the servables' resource estimates. Before loading a
+/// servable which would exceed the budget, it unloads servables selected by the
+/// policy. Servables with outstanding handles from GetServableHandle() are
+/// never selected, so requests in flight neither lose their servable nor hold
+/// up the load. Handles from GetAvailableServableHandles() don't prevent
+/// evictions, and must not be held while requesting other servables.
+///
+/// Given a prefetch predictor, the manager also loads the servables predicted
+/// to be requested soon in the background, so that their first requests don't
+/// block on the load.
 class CachingManager : public Manager {
  public:
   /// Config options and pluggable objects that will be used by the
@@ -74,6 +94,32 @@ class CachingManager : public Manager {
     // Default: 1 minute.
     int64_t load_retry_interval_micros = 1LL * 60 * 1000 * 1000;
 
+    // Selects the servables to unload, once loading another one would exceed
+    // 'max_num_loaded_servables' or the total resources of 'resource_tracker'.
+    // Optional. If left as nullptr, servables are never unloaded.
+    std::unique_ptr<ServableEvictionPolicy> eviction_policy;
+
+    // The maximum number of servables kept loaded. Requires an eviction policy.
+    //
+    // If set as 0, the number of servables isn't limited.
+    uint32 max_num_loaded_servables = 0;
+
+    // Predicts the servables about to be requested, which are then loaded in
+    // the background. Prefetches only fill the budget left free: they never
+    // evict servables, and are skipped if they don't fit. Optional. If left as
+    // nullptr, servables are only loaded on request.
+    std::unique_ptr<ServablePrefetchPredictor> prefetch_predictor;
+
+    // The number of threads prefetching servables, if there's a prefetch
+    // predictor.
+    uint32 num_prefetch_threads = 1;
+
+    // How often the servables predicted to be requested at this time of day
+    // are prefetched. If set as 0, only the servables predicted to follow
+    // requests for others are prefetched.
+    // Default: 1 minute.
+    int64_t periodic_prefetch_interval_micros = 60LL * 1000 * 1000;
+
     // The environment to use for starting threads in the thread-pool.
     Env* env = Env::Default();
   };
@@ -111,7 +157,25 @@ class CachingManager : public Manager {
  private:
   friend class test_util::CachingManagerTestAccess;
 
-  CachingManager(std::unique_ptr<LoaderFactory> loader_factory,
+  // A servable loaded while there's an eviction policy.
+  struct CachedServable {
+    // The overbound resource estimate of the servable, if there's a resource
+    // tracker.
+    ResourceAllocation resources;
+
+    // The number of handles to the servable which haven't been destroyed yet.
+    std::atomic<int64_t> num_handles{0};
+
+    // Notified once the servable has been evicted, or failed to be.
+    absl::Notification evicted;
+  };
+
+  // A handle which keeps its servable from being evicted until destroyed.
+  class PinnedServableHandle;
+
+  // 'resource_tracker' is the one of 'options', now owned by 'basic_manager'.
+  CachingManager(Options options, const ResourceTracker* resource_tracker,
+                 std::unique_ptr<LoaderFactory> loader_factory,
                  std::unique_ptr<BasicManager> basic_manager);
 
   // Returns the untyped handle for the servable request.
@@ -127,14 +191,27 @@ class CachingManager : public Manager {
   // Returns the untyped handle for a servable-id.
   Status GetUntypedServableHandleForId(
       const ServableId& servable_id,
-      std::unique_ptr<UntypedServableHandle>* handle);
+      std::unique_ptr<UntypedServableHandle>* handle)
+      TF_LOCKS_EXCLUDED(cache_mu_);
 
   // Transfer the given servable to 'basic_manager_', and ask it to load it. For
   // multiple concurrent requests for the same servable-id, enforces that
   // exactly one thread performs the load operation using the wrapped
   // basic-manager. All other requests block until the load completes and then
   // trivially succeed.
-  Status LoadServable(ServableData<std::unique_ptr<Loader>> loader_data)
+  //
+  // If 'prefetch', the servable is only loaded if it fits in the free budget,
+  // and isn't left managed if its load fails.
+  Status LoadServable(ServableData<std::unique_ptr<Loader>> loader_data,
+                      bool prefetch) TF_LOCKS_EXCLUDED(load_mutex_map_mu_);
+
+  // LoadServable(), with the servable's mutex held.
+  Status LoadServableLocked(ServableData<std::unique_ptr<Loader>> loader_data,
+                            bool prefetch);
+
+  // Returns the mutex synchronizing the loads and evictions of the servable,
+  // adding it to the load_mutex_map_ if needed.
+  std::shared_ptr<mutex> GetLoadMutex(const ServableId& servable_id)
       TF_LOCKS_EXCLUDED(load_mutex_map_mu_);
 
   // Returns the size of the load_mutex_map_.
@@ -144,6 +221,53 @@ class CachingManager : public Manager {
   // only one remaining reference to the mutex.
   void MaybeEraseLoadMutexMapEntry(const ServableId& servable_id);
 
+  // If the servable is cached, records an access to it with the eviction
+  // policy and returns it with one more handle counted. Otherwise returns
+  // nullptr, and sets 'evicting' if the servable is being evicted.
+  std::shared_ptr<CachedServable> PinCachedServable(
+      const ServableId& servable_id, std::shared_ptr<CachedServable>* evicting)
+      TF_LOCKS_EXCLUDED(cache_mu_);
+
+  // Returns the overbound resource estimate of the servable, or an empty
+  // allocation if there's no resource tracker or the estimate fails.
+  ResourceAllocation EstimateResources(
+      const ServableData<std::unique_ptr<Loader>>& loader_data) const;
+
+  // Evicts servables until one with the given resources fits in the budget, or
+  // no servable can be evicted, and then reserves its place in the budget.
+  // If '!may_evict', returns false without evicting or reserving anything if
+  // it doesn't fit in the budget as it is.
+  bool ReserveCacheSpace(const ResourceAllocation& resources, bool may_evict)
+      TF_LOCKS_EXCLUDED(eviction_mu_, cache_mu_);
+
+  // Caches the servable whose place in the budget has been reserved, if it
+  // was loaded. Otherwise releases its place.
+  void FinishCacheReservation(const ServableId& servable_id,
+                              const ResourceAllocation& resources, bool loaded)
+      TF_LOCKS_EXCLUDED(cache_mu_);
+
+  // Returns whether a servable with the given resources fits in the budget.
+  bool FitsInCacheLocked(const ResourceAllocation& resources) const
+      TF_EXCLUSIVE_LOCKS_REQUIRED(cache_mu_);
+
+  // Returns whether the budget is full, so that no servable fits in it.
+  bool CacheFull() const TF_LOCKS_EXCLUDED(cache_mu_);
+
+  // Records a request which got a handle to the servable with the prefetch
+  // predictor, if any. Failed requests aren't recorded, so that requests for
+  // servables which don't exist don't grow the predictor's state.
+  void RecordServedRequest(const ServableId& servable_id);
+
+  // Schedules the servable to be loaded by 'prefetch_executor_', unless it's
+  // already managed or scheduled, or the budget is already full.
+  void MaybePrefetch(const ServableId& servable_id)
+      TF_LOCKS_EXCLUDED(prefetch_mu_);
+
+  // Unloads the servable and stops managing it, so that it's loaded again on
+  // the next request.
+  Status EvictServable(const ServableId& servable_id)
+      TF_LOCKS_EXCLUDED(load_mutex_map_mu_);
+
   std::unique_ptr<LoaderFactory> loader_factory_;
 
   std::unique_ptr<BasicManager> basic_manager_;
@@ -158,6 +282,53 @@ class CachingManager : public Manager {
   std::map<ServableId, std::shared_ptr<mutex>> load_mutex_map_
       TF_GUARDED_BY(load_mutex_map_mu_);
 
+  // Null if there's no budget to keep the loaded servables within.
+  const std::unique_ptr<ServableEvictionPolicy> eviction_policy_;
+
+  const uint32 max_num_loaded_servables_;
+
+  // Owned by 'basic_manager_'. Only its total resources and util, which are
+  // immutable, are used. Null if there's none.
+  const ResourceTracker* const resource_tracker_;
+
+  Env* const env_;
+
+  // Serializes evictions, so that concurrent loads don't evict more servables
+  // than needed. Taken before 'cache_mu_' when both are held.
+  mutex eviction_mu_;
+
+  mutable mutex cache_mu_;
+
+  // The servables loaded while there's an eviction policy, which can be
+  // evicted.
+  std::unordered_map<ServableId, std::shared_ptr<CachedServable>,
+                     HashServableId>
+      cached_servables_ TF_GUARDED_BY(cache_mu_);
+
+  // The servables being evicted.
+  std::unordered_map<ServableId, std::shared_ptr<CachedServable>,
+                     HashServableId>
+      evicting_servables_ TF_GUARDED_BY(cache_mu_);
+
+  // The number and resources of the servables cached, being loaded, and being
+  // evicted, counted against the budget.
+  int64_t num_loaded_servables_ TF_GUARDED_BY(cache_mu_) = 0;
+  ResourceAllocation loaded_resources_ TF_GUARDED_BY(cache_mu_);
+
+  // Null if servables are only loaded on request.
+  const std::unique_ptr<ServablePrefetchPredictor> prefetch_predictor_;
+
+  mutex prefetch_mu_;
+
+  // The servables scheduled to be prefetched.
+  std::unordered_set<ServableId, HashServableId> pending_prefetches_
+      TF_GUARDED_BY(prefetch_mu_);
+
+  // Declared last, so that the prefetches are done before the members they
+  // use are destroyed.
+  std::unique_ptr<Executor> prefetch_executor_;
+  std::unique_ptr<PeriodicFunction> periodic_prefetch_thread_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(CachingManager);
 };
 
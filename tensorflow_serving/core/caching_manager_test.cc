@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow_serving/core/caching_manager.h"
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <utility>
@@ -23,18 +24,24 @@ limitations under the License.
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow_serving/core/servable_data.h"
+#include "tensorflow_serving/core/servable_eviction_policy.h"
 #include "tensorflow_serving/core/servable_handle.h"
 #include "tensorflow_serving/core/servable_id.h"
+#include "tensorflow_serving/core/servable_prefetch_predictor.h"
 #include "tensorflow_serving/core/servable_state.h"
 #include "tensorflow_serving/core/servable_state_monitor.h"
 #include "tensorflow_serving/core/simple_loader.h"
 #include "tensorflow_serving/core/test_util/fake_loader_source_adapter.h"
 #include "tensorflow_serving/core/test_util/manager_test_util.h"
+#include "tensorflow_serving/resources/resource_tracker.h"
+#include "tensorflow_serving/resources/resource_util.h"
+#include "tensorflow_serving/resources/resources.pb.h"
 #include "tensorflow_serving/util/event_bus.h"
 #include "tensorflow_serving/util/threadpool_executor.h"
 
@@ -42,6 +49,7 @@ namespace tensorflow {
 namespace serving {
 namespace {
 
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::testing::UnorderedElementsAreArray;
 
@@ -57,9 +65,11 @@ class StringLoaderFactory : public CachingManager::LoaderFactory {
   ServableData<std::unique_ptr<Loader>> CreateLoader(
       const ServableId& id) override {
     // Update state to indicate a new loader was created.
+    ResourceAllocation resource_estimate;
     {
       mutex_lock l(mu_);
       num_loaders_dispensed_++;
+      resource_estimate = resource_estimate_;
     }
 
     auto servable_creator = [&](std::unique_ptr<std::string>* servable) {
@@ -67,9 +77,14 @@ class StringLoaderFactory : public CachingManager::LoaderFactory {
       **servable = absl::StrCat(id.name, "-", id.version);
       return absl::OkStatus();
     };
+    auto resource_estimator =
+        [resource_estimate](ResourceAllocation* estimate) {
+          *estimate = resource_estimate;
+          return absl::OkStatus();
+        };
     std::unique_ptr<Loader> loader;
-    loader.reset(new SimpleLoader<std::string>(
-        servable_creator, SimpleLoader<std::string>::EstimateNoResources()));
+    loader.reset(
+        new SimpleLoader<std::string>(servable_creator, resource_estimator));
     return ServableData<std::unique_ptr<Loader>>(id, std::move(loader));
   }
 
@@ -98,6 +113,12 @@ class StringLoaderFactory : public CachingManager::LoaderFactory {
     latest_version_ = version;
   }
 
+  // Update the resource estimate of the servables. Initially empty.
+  void set_resource_estimate(const ResourceAllocation& resource_estimate) {
+    mutex_lock l(mu_);
+    resource_estimate_ = resource_estimate;
+  }
+
   // Returns the number of loaders created by the loader-factory.
   int64_t num_loaders_dispensed() const {
     mutex_lock l(mu_);
@@ -117,6 +138,9 @@ class StringLoaderFactory : public CachingManager::LoaderFactory {
   // Tracks the number of loaders dispensed by the loader-factory.
   int64_t num_loaders_dispensed_ TF_GUARDED_BY(mu_) = 0;
 
+  // The resource estimate of the servables.
+  ResourceAllocation resource_estimate_ TF_GUARDED_BY(mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(StringLoaderFactory);
 };
 
@@ -155,6 +179,27 @@ constexpr char kServableName2[] = "kServableName2";
 
 constexpr int kNumThreads = 10;
 
+// Creates a ResourceAllocation proto with 'quantity' units of RAM.
+ResourceAllocation CreateResourceQuantity(const int quantity) {
+  ResourceAllocation allocation;
+  auto* ram_resource = allocation.add_resource_quantities();
+  ram_resource->mutable_resource()->set_device("main");
+  ram_resource->mutable_resource()->set_kind("ram");
+  ram_resource->set_quantity(quantity);
+  return allocation;
+}
+
+// Creates a resource tracker that deals with just a single resource (RAM) and
+// initially has 'resource_quantity' quantity of that resource.
+std::unique_ptr<ResourceTracker> CreateSimpleResourceTracker(
+    const int resource_quantity) {
+  std::unique_ptr<ResourceUtil> util(new ResourceUtil({{{"main", 1}}}));
+  std::unique_ptr<ResourceTracker> tracker;
+  CHECK_OK(ResourceTracker::Create(CreateResourceQuantity(resource_quantity),
+                                   std::move(util), &tracker));
+  return tracker;
+}
+
 // We parameterize this test with the number of load & unload threads. (Zero
 // means use an in-line executor instead of a thread pool.)
 struct ThreadPoolSizes {
@@ -203,6 +248,74 @@ class CachingManagerTest : public ::testing::TestWithParam<ThreadPoolSizes> {
     return error_manager;
   }
 
+  // Replaces the manager with one which evicts the least recently used
+  // servables, to keep at most 'max_num_loaded_servables' loaded within the
+  // total resources of 'resource_tracker'.
+  void RecreateManagerWithEviction(
+      const uint32_t max_num_loaded_servables,
+      std::unique_ptr<ResourceTracker> resource_tracker = nullptr) {
+    CachingManager::Options options;
+    options.env = Env::Default();
+    options.servable_event_bus = servable_event_bus_.get();
+    options.num_load_threads = GetParam().num_load_threads;
+    options.num_unload_threads = GetParam().num_unload_threads;
+    options.max_num_load_retries = 1;
+    options.load_retry_interval_micros = 0;
+    options.resource_tracker = std::move(resource_tracker);
+    options.eviction_policy.reset(new LruEvictionPolicy);
+    options.max_num_loaded_servables = max_num_loaded_servables;
+
+    std::unique_ptr<StringLoaderFactory> string_loader_factory;
+    string_loader_factory.reset(new StringLoaderFactory(0));
+    string_loader_factory_ = string_loader_factory.get();
+
+    manager_.reset();
+    CHECK_OK(CachingManager::Create(
+        std::move(options), std::move(string_loader_factory), &manager_));
+  }
+
+  // Replaces the manager with one which prefetches the servables predicted by
+  // 'prefetch_predictor', and if 'max_num_loaded_servables' is positive,
+  // evicts the least recently used servables to keep at most as many loaded.
+  void RecreateManagerWithPrefetch(
+      std::unique_ptr<ServablePrefetchPredictor> prefetch_predictor,
+      const int64_t periodic_prefetch_interval_micros,
+      const uint32_t max_num_loaded_servables = 0) {
+    CachingManager::Options options;
+    options.env = Env::Default();
+    options.servable_event_bus = servable_event_bus_.get();
+    options.num_load_threads = GetParam().num_load_threads;
+    options.num_unload_threads = GetParam().num_unload_threads;
+    options.max_num_load_retries = 1;
+    options.load_retry_interval_micros = 0;
+    options.prefetch_predictor = std::move(prefetch_predictor);
+    options.periodic_prefetch_interval_micros =
+        periodic_prefetch_interval_micros;
+    if (max_num_loaded_servables > 0) {
+      options.eviction_policy.reset(new LruEvictionPolicy);
+      options.max_num_loaded_servables = max_num_loaded_servables;
+    }
+
+    std::unique_ptr<StringLoaderFactory> string_loader_factory;
+    string_loader_factory.reset(new StringLoaderFactory(0));
+    string_loader_factory_ = string_loader_factory.get();
+
+    manager_.reset();
+    CHECK_OK(CachingManager::Create(
+        std::move(options), std::move(string_loader_factory), &manager_));
+  }
+
+  // Waits until the servable is loaded, without requesting it.
+  void WaitUntilAvailable(const ServableId& id) {
+    while (true) {
+      const std::vector<ServableId> ids = manager_->ListAvailableServableIds();
+      if (std::find(ids.begin(), ids.end(), id) != ids.end()) {
+        return;
+      }
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+  }
+
   // Helper function to return the size of the load-mutex map from the
   // caching-manager.
   int64_t GetLoadMutexMapSize() {
@@ -580,6 +693,211 @@ TEST_P(CachingManagerTest, ConcurrentIntersectingRequests) {
   EXPECT_EQ(0, GetLoadMutexMapSize());
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Evictions.
+
+TEST_P(CachingManagerTest, EvictionLeastRecentlyUsed) {
+  RecreateManagerWithEviction(/*max_num_loaded_servables=*/2);
+  for (const int version : {30, 31, 30, 32}) {
+    ServableHandle<std::string> handle;
+    TF_ASSERT_OK(manager_->GetServableHandle(
+        ServableRequest::FromId({kServableName, version}), &handle));
+    EXPECT_EQ(absl::StrCat("kServableName-", version), *handle);
+  }
+  const std::vector<ServableId> expected = {{kServableName, 30},
+                                            {kServableName, 32}};
+  EXPECT_THAT(manager_->ListAvailableServableIds(),
+              UnorderedElementsAreArray(expected));
+  EXPECT_EQ(3, string_loader_factory_->num_loaders_dispensed());
+
+  // The evicted servable is loaded again on request.
+  ServableHandle<std::string> handle;
+  TF_ASSERT_OK(manager_->GetServableHandle(
+      ServableRequest::FromId({kServableName, 31}), &handle));
+  EXPECT_EQ("kServableName-31", *handle);
+  EXPECT_EQ(4, string_loader_factory_->num_loaders_dispensed());
+  EXPECT_EQ(0, GetLoadMutexMapSize());
+}
+
+TEST_P(CachingManagerTest, EvictionSkipsServablesInUse) {
+  RecreateManagerWithEviction(/*max_num_loaded_servables=*/1);
+  ServableHandle<std::string> handle_30;
+  TF_ASSERT_OK(manager_->GetServableHandle(
+      ServableRequest::FromId({kServableName, 30}), &handle_30));
+  {
+    // Loaded beyond the budget, as the only loaded servable is in use.
+    ServableHandle<std::string> handle;
+    TF_ASSERT_OK(manager_->GetServableHandle(
+        ServableRequest::FromId({kServableName, 31}), &handle));
+    EXPECT_EQ("kServableName-31", *handle);
+  }
+  {
+    ServableHandle<std::string> handle;
+    TF_ASSERT_OK(manager_->GetServableHandle(
+        ServableRequest::FromId({kServableName, 32}), &handle));
+    EXPECT_EQ("kServableName-32", *handle);
+  }
+  EXPECT_EQ("kServableName-30", *handle_30);
+  const std::vector<ServableId> expected = {{kServableName, 30},
+                                            {kServableName, 32}};
+  EXPECT_THAT(manager_->ListAvailableServableIds(),
+              UnorderedElementsAreArray(expected));
+}
+
+TEST_P(CachingManagerTest, EvictionWithinResources) {
+  RecreateManagerWithEviction(/*max_num_loaded_servables=*/0,
+                              CreateSimpleResourceTracker(10));
+  string_loader_factory_->set_resource_estimate(CreateResourceQuantity(4));
+  for (const int version : {30, 31, 32}) {
+    ServableHandle<std::string> handle;
+    TF_ASSERT_OK(manager_->GetServableHandle(
+        ServableRequest::FromId({kServableName, version}), &handle));
+  }
+  const std::vector<ServableId> expected = {{kServableName, 31},
+                                            {kServableName, 32}};
+  EXPECT_THAT(manager_->ListAvailableServableIds(),
+              UnorderedElementsAreArray(expected));
+}
+
+TEST_P(CachingManagerTest, EvictionConcurrentRequests) {
+  RecreateManagerWithEviction(/*max_num_loaded_servables=*/2);
+  constexpr int kNumRequests = 40;
+  mutex status_mu;
+  std::vector<absl::Status> statuses(kNumRequests);
+  {
+    ThreadPoolExecutor request_executor(Env::Default(), "GetHandles",
+                                        kNumThreads);
+    for (int i = 0; i < kNumRequests; i++) {
+      // Cycle through more servables than fit in the budget.
+      const ServableId id = {kServableName, i % 4 + 30};
+      request_executor.Schedule([this, i, id, &statuses, &status_mu]() {
+        ServableHandle<std::string> handle;
+        absl::Status status =
+            manager_->GetServableHandle(ServableRequest::FromId(id), &handle);
+        if (status.ok() &&
+            *handle != absl::StrCat("kServableName-", id.version)) {
+          status = absl::InternalError(*handle);
+        }
+        mutex_lock l(status_mu);
+        statuses[i] = status;
+      });
+    }
+  }
+  for (int i = 0; i < kNumRequests; i++) {
+    mutex_lock l(status_mu);
+    EXPECT_EQ(absl::OkStatus(), statuses[i]);
+  }
+  EXPECT_EQ(0, GetLoadMutexMapSize());
+}
+
+TEST(CachingManagerEvictionTest, LimitNeedsEvictionPolicy) {
+  CachingManager::Options options;
+  options.max_num_loaded_servables = 1;
+  std::unique_ptr<CachingManager> manager;
+  const absl::Status status = CachingManager::Create(
+      std::move(options), std::make_unique<StringLoaderFactory>(0), &manager);
+  EXPECT_EQ(error::INVALID_ARGUMENT, status.code());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Prefetches.
+
+TEST_P(CachingManagerTest, PrefetchFollowers) {
+  ServablePrefetchPredictor::Options predictor_options;
+  predictor_options.min_co_requests = 1;
+  auto prefetch_predictor =
+      std::make_unique<ServablePrefetchPredictor>(predictor_options);
+  // kServableName2 has followed kServableName.
+  const ServableId id = {kServableName, 30};
+  const ServableId follower = {kServableName2, 30};
+  const int64_t now_micros = Env::Default()->NowMicros();
+  prefetch_predictor->RecordRequest(id, now_micros);
+  prefetch_predictor->RecordRequest(follower, now_micros);
+  RecreateManagerWithPrefetch(std::move(prefetch_predictor),
+                              /*periodic_prefetch_interval_micros=*/0);
+
+  {
+    ServableHandle<std::string> handle;
+    TF_ASSERT_OK(
+        manager_->GetServableHandle(ServableRequest::FromId(id), &handle));
+  }
+  WaitUntilAvailable(follower);
+  EXPECT_EQ(2, string_loader_factory_->num_loaders_dispensed());
+
+  // The follower's request doesn't need to load it.
+  ServableHandle<std::string> handle;
+  TF_ASSERT_OK(
+      manager_->GetServableHandle(ServableRequest::FromId(follower), &handle));
+  EXPECT_EQ("kServableName2-30", *handle);
+  EXPECT_EQ(2, string_loader_factory_->num_loaders_dispensed());
+}
+
+TEST_P(CachingManagerTest, PrefetchForTimeOfDay) {
+  ServablePrefetchPredictor::Options predictor_options;
+  // A single slot, which is always the upcoming one.
+  predictor_options.time_slot_micros = 24LL * 60 * 60 * 1000 * 1000;
+  predictor_options.min_periodic_requests = 1;
+  auto prefetch_predictor =
+      std::make_unique<ServablePrefetchPredictor>(predictor_options);
+  const ServableId id = {kServableName, 30};
+  prefetch_predictor->RecordRequest(id, Env::Default()->NowMicros());
+  RecreateManagerWithPrefetch(std::move(prefetch_predictor),
+                              /*periodic_prefetch_interval_micros=*/1000);
+
+  WaitUntilAvailable(id);
+  EXPECT_EQ(1, string_loader_factory_->num_loaders_dispensed());
+}
+
+TEST_P(CachingManagerTest, PrefetchDoesNotEvict) {
+  ServablePrefetchPredictor::Options predictor_options;
+  predictor_options.min_co_requests = 1;
+  auto prefetch_predictor =
+      std::make_unique<ServablePrefetchPredictor>(predictor_options);
+  ServablePrefetchPredictor* const predictor = prefetch_predictor.get();
+  RecreateManagerWithPrefetch(std::move(prefetch_predictor),
+                              /*periodic_prefetch_interval_micros=*/0,
+                              /*max_num_loaded_servables=*/1);
+  const ServableId id = {kServableName, 30};
+  const ServableId follower = {kServableName2, 30};
+  {
+    ServableHandle<std::string> handle;
+    TF_ASSERT_OK(
+        manager_->GetServableHandle(ServableRequest::FromId(id), &handle));
+  }
+
+  // Once the follower is predicted, the budget is already full, so it isn't
+  // prefetched in place of the servable requested.
+  const int64_t now_micros = Env::Default()->NowMicros();
+  predictor->RecordRequest(id, now_micros);
+  predictor->RecordRequest(follower, now_micros);
+  {
+    ServableHandle<std::string> handle;
+    TF_ASSERT_OK(
+        manager_->GetServableHandle(ServableRequest::FromId(id), &handle));
+  }
+  EXPECT_EQ(1, string_loader_factory_->num_loaders_dispensed());
+  EXPECT_THAT(manager_->ListAvailableServableIds(), ElementsAre(id));
+
+  // Requests still evict.
+  ServableHandle<std::string> handle;
+  TF_ASSERT_OK(
+      manager_->GetServableHandle(ServableRequest::FromId(follower), &handle));
+  EXPECT_EQ("kServableName2-30", *handle);
+  EXPECT_EQ(2, string_loader_factory_->num_loaders_dispensed());
+  EXPECT_THAT(manager_->ListAvailableServableIds(), ElementsAre(follower));
+}
+
+TEST(CachingManagerPrefetchTest, PrefetchNeedsThreads) {
+  CachingManager::Options options;
+  options.prefetch_predictor = std::make_unique<ServablePrefetchPredictor>(
+      ServablePrefetchPredictor::Options());
+  options.num_prefetch_threads = 0;
+  std::unique_ptr<CachingManager> manager;
+  const absl::Status status = CachingManager::Create(
+      std::move(options), std::make_unique<StringLoaderFactory>(0), &manager);
+  EXPECT_EQ(error::INVALID_ARGUMENT, status.code());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 TEST(PathPrefixLoaderFactoryTest, Basic) {
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
 #include "tensorflow_serving/apis/model.pb.h"
+#include "tensorflow_serving/core/async_log_writer.h"
 #include "tensorflow_serving/core/log_collector.h"
 
 namespace tensorflow {
@@ -46,6 +47,33 @@ RequestLogger::RequestLogger(const LoggingConfig& logging_config,
       saved_model_tags_(saved_model_tags),
       log_collector_(std::move(log_collector)),
       uniform_sampler_() {
+  if (logging_config_.has_async_logging_config()) {
+    const AsyncLoggingConfig& async_logging_config =
+        logging_config_.async_logging_config();
+    AsyncLogWriter::Options options;
+    if (async_logging_config.max_queue_size() > 0) {
+      options.max_queue_size = async_logging_config.max_queue_size();
+    }
+    if (async_logging_config.num_threads() > 0) {
+      options.num_threads = async_logging_config.num_threads();
+    }
+    if (async_logging_config.max_batch_size() > 0) {
+      options.max_batch_size = async_logging_config.max_batch_size();
+    }
+    if (async_logging_config.flush_interval_micros() > 0) {
+      options.flush_interval_micros =
+          async_logging_config.flush_interval_micros();
+    }
+    if (async_logging_config.max_queued_bytes() > 0) {
+      options.max_queued_bytes = async_logging_config.max_queued_bytes();
+    }
+    if (async_logging_config.flush_bytes() > 0) {
+      options.flush_bytes = async_logging_config.flush_bytes();
+    }
+    options.name = logging_config_.log_collector_config().filename_prefix();
+    async_log_writer_ =
+        std::make_unique<AsyncLogWriter>(options, log_collector_.get());
+  }
   for (const auto& config :
        logging_config_.sampling_config().per_task_sampling_configs()) {
     bool dc_match = config.dc().empty() || config.dc() == dc;
@@ -76,7 +104,7 @@ absl::Status RequestLogger::Log(const google::protobuf::Message& request,
       std::unique_ptr<google::protobuf::Message> log;
       TF_RETURN_IF_ERROR(
           CreateLogMessage(request, response, log_metadata_with_config, &log));
-      return Log(*log);
+      return Log(std::move(log));
     }();
     request_log_count
         ->GetCell(log_metadata.model_spec().name(),
@@ -88,7 +116,23 @@ absl::Status RequestLogger::Log(const google::protobuf::Message& request,
 }
 
 absl::Status RequestLogger::Log(const google::protobuf::Message& log) {
-  return log_collector_->CollectMessage(log);
+  if (async_log_writer_ == nullptr) {
+    return log_collector_->CollectMessage(log);
+  }
+  std::unique_ptr<google::protobuf::Message> log_copy(log.New());
+  log_copy->CopyFrom(log);
+  return Log(std::move(log_copy));
+}
+
+absl::Status RequestLogger::Log(
+    std::unique_ptr<google::protobuf::Message> log) {
+  if (async_log_writer_ == nullptr) {
+    return log_collector_->CollectMessage(*log);
+  }
+  // Dropped logs are only counted by the writer, so that a slow log-collector
+  // doesn't fail requests either.
+  async_log_writer_->Write(std::move(log));
+  return absl::OkStatus();
 }
 
 }  // namespace serving
@@ -20,12 +20,11 @@ limitations under the License.
 #include <vector>
 
 #include "google/protobuf/message.h"
-#include "absl/base/thread_annotations.h"
 #include "absl/random/random.h"
-#include "absl/synchronization/mutex.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow_serving/apis/logging.pb.h"
 #include "tensorflow_serving/config/logging_config.pb.h"
+#include "tensorflow_serving/core/async_log_writer.h"
 #include "tensorflow_serving/core/log_collector.h"
 #include "tensorflow_serving/core/stream_logger.h"
 
@@ -36,6 +35,10 @@ namespace serving {
 // is handled by the log-collector. We sample requests based on the config.
 // All subclasses must only implement a factory method that returns a
 // shared_ptr.
+//
+// If the config has an async_logging_config, the logs are only created on the
+// calling thread, and collected by the background threads of an
+// AsyncLogWriter.
 class RequestLogger : public std::enable_shared_from_this<RequestLogger> {
  public:
   RequestLogger(const LoggingConfig& logging_config,
@@ -46,7 +49,9 @@ class RequestLogger : public std::enable_shared_from_this<RequestLogger> {
   virtual ~RequestLogger() = default;
 
   // Writes the log for the particular request, response and metadata, if we
-  // decide to sample it.
+  // decide to sample it. With asynchronous logging, only the errors creating
+  // the log are returned, and logs dropped because too many are queued are
+  // counted but not reported.
   Status Log(const google::protobuf::Message& request, const google::protobuf::Message& response,
              const LogMetadata& log_metadata);
 
@@ -74,9 +79,13 @@ class RequestLogger : public std::enable_shared_from_this<RequestLogger> {
   // Implementations can fill up additional information to LogMetadata.
   virtual LogMetadata FillLogMetadata(const LogMetadata& lm_in) = 0;
 
-  // Writes the log.
+  // Writes the log, or queues it with asynchronous logging (in which case it
+  // is copied).
   Status Log(const google::protobuf::Message& log);
 
+  // Writes the log, or queues it with asynchronous logging.
+  Status Log(std::unique_ptr<google::protobuf::Message> log);
+
   // A sampler which samples uniformly at random.
   class UniformSampler {
    public:
@@ -87,18 +96,19 @@ class RequestLogger : public std::enable_shared_from_this<RequestLogger> {
     bool Sample(const double rate) {
       if (rate <= 0.0) return false;
       if (rate >= 1.0) return true;
-      absl::MutexLock lock(&mu_);
-      return absl::Uniform(bit_gen_, 0.0, 1.0) < rate;
+      // A generator per thread, so that concurrent requests don't contend on
+      // it.
+      thread_local absl::InsecureBitGen bit_gen;
+      return absl::Uniform(bit_gen, 0.0, 1.0) < rate;
     }
-
-   private:
-    absl::Mutex mu_;
-    absl::BitGen bit_gen_ ABSL_GUARDED_BY(mu_);
   };
 
   LoggingConfig logging_config_;
   const std::vector<string> saved_model_tags_;
   std::unique_ptr<LogCollector> log_collector_;
+  // Set with asynchronous logging. Declared after 'log_collector_' so that the
+  // logs still queued are collected before it is destroyed.
+  std::unique_ptr<AsyncLogWriter> async_log_writer_;
   UniformSampler uniform_sampler_;
 };
 
@@ -367,6 +367,48 @@ TEST_F(RequestLoggerTest, ConcurrentLogging) {
   }
 }
 
+TEST_F(RequestLoggerTest, AsyncLogging) {
+  LoggingConfig logging_config;
+  logging_config.mutable_sampling_config()->set_sampling_rate(1.0);
+  logging_config.mutable_async_logging_config()->set_flush_interval_micros(
+      1000);
+  auto* collector = new NiceMock<MockLogCollector>();
+  auto logger = std::shared_ptr<NiceMock<MockRequestLogger>>(
+      new NiceMock<MockRequestLogger>(logging_config, model_tags_, collector,
+                                      "", -1));
+
+  EXPECT_CALL(*logger, CreateLogMessage(_, _, _, _))
+      .WillRepeatedly([](const google::protobuf::Message&,
+                         const google::protobuf::Message&, const LogMetadata&,
+                         std::unique_ptr<google::protobuf::Message>* log) {
+        *log = std::make_unique<google::protobuf::Any>();
+        return absl::OkStatus();
+      });
+
+  constexpr int kNumThreads = 8;
+  constexpr int kNumRequestsPerThread = 100;
+  // All the logs are collected by the time the logger is destroyed.
+  EXPECT_CALL(*collector, CollectMessage(_))
+      .Times(kNumThreads * kNumRequestsPerThread)
+      .WillRepeatedly(Return(absl::OkStatus()));
+  EXPECT_CALL(*collector, Flush()).WillRepeatedly(Return(absl::OkStatus()));
+
+  LogMetadata log_metadata;
+  log_metadata.mutable_model_spec()->set_name("model");
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&]() {
+        for (int i = 0; i < kNumRequestsPerThread; ++i) {
+          TF_ASSERT_OK(
+              logger->Log(PredictRequest(), PredictResponse(), log_metadata));
+        }
+      });
+    }
+  }
+  logger.reset();
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
@@ -0,0 +1,230 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/servable_eviction_policy.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <list>
+
+#include "absl/types/optional.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace serving {
+
+namespace {
+
+// The admission window holds this fraction of the servables, and at least one.
+constexpr double kWindowFraction = 0.01;
+
+// The protected segment holds at most this fraction of the main space.
+constexpr double kProtectedFraction = 0.8;
+
+// Returns the least recently used servable of 'servables' that 'can_evict'
+// accepts.
+absl::optional<ServableId> LeastRecentlyUsedOf(
+    const std::list<ServableId>& servables,
+    const std::function<bool(const ServableId&)>& can_evict) {
+  for (auto iter = servables.rbegin(); iter != servables.rend(); ++iter) {
+    if (can_evict(*iter)) {
+      return *iter;
+    }
+  }
+  return absl::nullopt;
+}
+
+}  // namespace
+
+void LruEvictionPolicy::OnInsert(const ServableId& id) {
+  if (positions_.count(id) > 0) {
+    OnAccess(id);
+    return;
+  }
+  servables_.push_front(id);
+  positions_[id] = servables_.begin();
+}
+
+void LruEvictionPolicy::OnAccess(const ServableId& id) {
+  auto iter = positions_.find(id);
+  if (iter == positions_.end()) {
+    return;
+  }
+  servables_.splice(servables_.begin(), servables_, iter->second);
+}
+
+void LruEvictionPolicy::OnRemove(const ServableId& id) {
+  auto iter = positions_.find(id);
+  if (iter == positions_.end()) {
+    return;
+  }
+  servables_.erase(iter->second);
+  positions_.erase(iter);
+}
+
+absl::optional<ServableId> LruEvictionPolicy::SelectVictim(
+    const std::function<bool(const ServableId&)>& can_evict) {
+  return LeastRecentlyUsedOf(servables_, can_evict);
+}
+
+TinyLfuEvictionPolicy::FrequencySketch::FrequencySketch(const int width)
+    : width_(std::max(width, 16)),
+      sample_size_(10 * static_cast<int64_t>(width_)),
+      counters_(kNumRows * width_, 0) {}
+
+size_t TinyLfuEvictionPolicy::FrequencySketch::Index(const uint64_t hash,
+                                                      const int row) const {
+  static constexpr uint64_t kSeeds[kNumRows] = {
+      0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL,
+      0xcbf29ce484222325ULL};
+  uint64_t mixed = (hash ^ kSeeds[row]) * kSeeds[row];
+  mixed ^= mixed >> 32;
+  return row * width_ + mixed % width_;
+}
+
+void TinyLfuEvictionPolicy::FrequencySketch::Increment(const uint64_t hash) {
+  for (int row = 0; row < kNumRows; ++row) {
+    uint8_t& counter = counters_[Index(hash, row)];
+    if (counter < kMaxCount) {
+      ++counter;
+    }
+  }
+  if (++num_increments_ >= sample_size_) {
+    for (uint8_t& counter : counters_) {
+      counter /= 2;
+    }
+    num_increments_ /= 2;
+  }
+}
+
+int TinyLfuEvictionPolicy::FrequencySketch::Estimate(
+    const uint64_t hash) const {
+  int estimate = kMaxCount;
+  for (int row = 0; row < kNumRows; ++row) {
+    estimate = std::min<int>(estimate, counters_[Index(hash, row)]);
+  }
+  return estimate;
+}
+
+TinyLfuEvictionPolicy::TinyLfuEvictionPolicy(const int expected_num_servables)
+    : sketch_(expected_num_servables) {}
+
+void TinyLfuEvictionPolicy::OnInsert(const ServableId& id) {
+  if (positions_.count(id) > 0) {
+    OnAccess(id);
+    return;
+  }
+  sketch_.Increment(HashServableId()(id));
+  window_.push_front(id);
+  positions_[id] = {Segment::kWindow, window_.begin()};
+  Rebalance();
+}
+
+void TinyLfuEvictionPolicy::OnAccess(const ServableId& id) {
+  sketch_.Increment(HashServableId()(id));
+  auto iter = positions_.find(id);
+  if (iter == positions_.end()) {
+    return;
+  }
+  Position& position = iter->second;
+  switch (position.segment) {
+    case Segment::kWindow:
+    case Segment::kProtected:
+      MoveToFront(position.segment, &position);
+      break;
+    case Segment::kProbation:
+      MoveToFront(Segment::kProtected, &position);
+      Rebalance();
+      break;
+  }
+}
+
+void TinyLfuEvictionPolicy::OnRemove(const ServableId& id) {
+  auto iter = positions_.find(id);
+  if (iter == positions_.end()) {
+    return;
+  }
+  GetList(iter->second.segment)->erase(iter->second.iterator);
+  positions_.erase(iter);
+  Rebalance();
+}
+
+absl::optional<ServableId> TinyLfuEvictionPolicy::SelectVictim(
+    const std::function<bool(const ServableId&)>& can_evict) {
+  const absl::optional<ServableId> candidate =
+      LeastRecentlyUsed(Segment::kWindow, can_evict);
+  const absl::optional<ServableId> victim =
+      LeastRecentlyUsed(Segment::kProbation, can_evict);
+  if (candidate && victim) {
+    // The servable leaving the window is only admitted into the main space if
+    // it's more popular than the one it would replace.
+    return EstimateFrequency(*candidate) > EstimateFrequency(*victim)
+               ? victim
+               : candidate;
+  }
+  if (candidate) {
+    return candidate;
+  }
+  if (victim) {
+    return victim;
+  }
+  return LeastRecentlyUsed(Segment::kProtected, can_evict);
+}
+
+int TinyLfuEvictionPolicy::EstimateFrequency(const ServableId& id) const {
+  return sketch_.Estimate(HashServableId()(id));
+}
+
+std::list<ServableId>* TinyLfuEvictionPolicy::GetList(const Segment segment) {
+  switch (segment) {
+    case Segment::kWindow:
+      return &window_;
+    case Segment::kProbation:
+      return &probation_;
+    case Segment::kProtected:
+      return &protected_;
+  }
+  LOG(FATAL) << "Unknown segment";
+}
+
+void TinyLfuEvictionPolicy::MoveToFront(const Segment segment,
+                                        Position* const position) {
+  std::list<ServableId>* const to = GetList(segment);
+  to->splice(to->begin(), *GetList(position->segment), position->iterator);
+  position->segment = segment;
+}
+
+void TinyLfuEvictionPolicy::Rebalance() {
+  const size_t window_capacity = std::max<size_t>(
+      1, static_cast<size_t>(positions_.size() * kWindowFraction));
+  while (window_.size() > window_capacity) {
+    MoveToFront(Segment::kProbation, &positions_.at(window_.back()));
+  }
+  const size_t protected_capacity = static_cast<size_t>(
+      (positions_.size() - window_.size()) * kProtectedFraction);
+  while (protected_.size() > protected_capacity) {
+    MoveToFront(Segment::kProbation, &positions_.at(protected_.back()));
+  }
+}
+
+absl::optional<ServableId> TinyLfuEvictionPolicy::LeastRecentlyUsed(
+    const Segment segment,
+    const std::function<bool(const ServableId&)>& can_evict) {
+  return LeastRecentlyUsedOf(*GetList(segment), can_evict);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
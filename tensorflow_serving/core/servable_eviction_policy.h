@@ -0,0 +1,164 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_SERVABLE_EVICTION_POLICY_H_
+#define TENSORFLOW_SERVING_CORE_SERVABLE_EVICTION_POLICY_H_
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow_serving/core/servable_id.h"
+
+namespace tensorflow {
+namespace serving {
+
+/// Decides which of the servables loaded by a CachingManager to unload, to
+/// make room for another one. The manager tells the policy about the servables
+/// it loads, the requests they serve, and the servables it unloads.
+///
+/// Implementations need not be thread-safe; the manager serializes the calls.
+class ServableEvictionPolicy {
+ public:
+  virtual ~ServableEvictionPolicy() = default;
+
+  /// Called once 'id' has been loaded.
+  virtual void OnInsert(const ServableId& id) = 0;
+
+  /// Called for each request served by 'id', once it's been inserted.
+  virtual void OnAccess(const ServableId& id) = 0;
+
+  /// Called once 'id' is no longer loaded, or is about to be unloaded.
+  virtual void OnRemove(const ServableId& id) = 0;
+
+  /// Returns the inserted servable to unload next, among those for which
+  /// 'can_evict' returns true, or nullopt if there is none.
+  virtual absl::optional<ServableId> SelectVictim(
+      const std::function<bool(const ServableId&)>& can_evict) = 0;
+};
+
+/// Evicts the least recently used servable.
+class LruEvictionPolicy : public ServableEvictionPolicy {
+ public:
+  LruEvictionPolicy() = default;
+  ~LruEvictionPolicy() override = default;
+
+  void OnInsert(const ServableId& id) override;
+  void OnAccess(const ServableId& id) override;
+  void OnRemove(const ServableId& id) override;
+  absl::optional<ServableId> SelectVictim(
+      const std::function<bool(const ServableId&)>& can_evict) override;
+
+ private:
+  // The servables, most recently used first.
+  std::list<ServableId> servables_;
+  std::unordered_map<ServableId, std::list<ServableId>::iterator,
+                     HashServableId>
+      positions_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(LruEvictionPolicy);
+};
+
+/// A W-TinyLFU policy, which keeps the servables requested often over those
+/// requested recently but rarely, e.g. by a scan over many models.
+///
+/// The servables are kept in three LRU lists: a small admission window holding
+/// the most recently loaded ones, and a main space split into probation and
+/// protected segments. Servables overflow from the window into probation, and
+/// move to protected once they are requested again. When a servable must be
+/// evicted, the least recently used ones of the window and of probation
+/// compete, and the one requested less often according to a frequency sketch
+/// is evicted. The sketch remembers servables which were evicted, and ages
+/// its counts so that frequency reflects recent popularity.
+class TinyLfuEvictionPolicy : public ServableEvictionPolicy {
+ public:
+  /// 'expected_num_servables' sizes the frequency sketch; it should be about
+  /// the number of distinct servables requested over a while.
+  explicit TinyLfuEvictionPolicy(int expected_num_servables = 1024);
+  ~TinyLfuEvictionPolicy() override = default;
+
+  void OnInsert(const ServableId& id) override;
+  void OnAccess(const ServableId& id) override;
+  void OnRemove(const ServableId& id) override;
+  absl::optional<ServableId> SelectVictim(
+      const std::function<bool(const ServableId&)>& can_evict) override;
+
+  /// Returns the estimated number of recent requests for 'id'.
+  int EstimateFrequency(const ServableId& id) const;
+
+ private:
+  // A count-min sketch of 4-bit counters, which are halved once the number of
+  // increments reaches ten times the width, so that old requests fade away.
+  class FrequencySketch {
+   public:
+    explicit FrequencySketch(int width);
+
+    void Increment(uint64_t hash);
+    int Estimate(uint64_t hash) const;
+
+   private:
+    // Returns the index of the counter for 'hash' in row 'row'.
+    size_t Index(uint64_t hash, int row) const;
+
+    static constexpr int kNumRows = 4;
+    static constexpr uint8_t kMaxCount = 15;
+
+    const size_t width_;
+    const int64_t sample_size_;
+    int64_t num_increments_ = 0;
+    std::vector<uint8_t> counters_;
+  };
+
+  enum class Segment { kWindow, kProbation, kProtected };
+
+  struct Position {
+    Segment segment;
+    std::list<ServableId>::iterator iterator;
+  };
+
+  std::list<ServableId>* GetList(Segment segment);
+
+  // Moves the servable at 'position' to the front of 'segment'.
+  void MoveToFront(Segment segment, Position* position);
+
+  // Moves the least recently used servables out of the window and protected
+  // segments, once they exceed their share of the servables.
+  void Rebalance();
+
+  // Returns the least recently used servable of 'segment' that 'can_evict'
+  // accepts.
+  absl::optional<ServableId> LeastRecentlyUsed(
+      Segment segment,
+      const std::function<bool(const ServableId&)>& can_evict);
+
+  FrequencySketch sketch_;
+
+  // Each list holds its servables most recently used first.
+  std::list<ServableId> window_;
+  std::list<ServableId> probation_;
+  std::list<ServableId> protected_;
+  std::unordered_map<ServableId, Position, HashServableId> positions_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TinyLfuEvictionPolicy);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_SERVABLE_EVICTION_POLICY_H_
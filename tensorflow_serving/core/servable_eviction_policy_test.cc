@@ -0,0 +1,155 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/servable_eviction_policy.h"
+
+#include <set>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Optional;
+
+bool EvictAny(const ServableId& id) { return true; }
+
+// Requests 'id' from a cache holding at most 'capacity' servables, whose
+// evictions are decided by 'policy'.
+void Request(const ServableId& id, const size_t capacity,
+             ServableEvictionPolicy* policy, std::set<ServableId>* cached) {
+  if (cached->count(id) > 0) {
+    policy->OnAccess(id);
+    return;
+  }
+  while (cached->size() >= capacity) {
+    const absl::optional<ServableId> victim = policy->SelectVictim(EvictAny);
+    ASSERT_TRUE(victim);
+    policy->OnRemove(*victim);
+    cached->erase(*victim);
+  }
+  policy->OnInsert(id);
+  cached->insert(id);
+}
+
+// Requests 'a' and 'b' five times each, and then scans through ten other
+// servables, from a cache of three.
+std::set<ServableId> RequestWithScan(const ServableId& a, const ServableId& b,
+                                     ServableEvictionPolicy* policy) {
+  std::set<ServableId> cached;
+  for (const ServableId& id : {a, b}) {
+    for (int i = 0; i < 5; ++i) {
+      Request(id, 3, policy, &cached);
+    }
+  }
+  for (int i = 0; i < 10; ++i) {
+    Request({absl::StrCat("scan_", i), 0}, 3, policy, &cached);
+  }
+  return cached;
+}
+
+TEST(LruEvictionPolicyTest, EvictsLeastRecentlyUsed) {
+  LruEvictionPolicy policy;
+  const ServableId a = {"a", 1};
+  const ServableId b = {"b", 1};
+  const ServableId c = {"c", 1};
+  policy.OnInsert(a);
+  policy.OnInsert(b);
+  policy.OnInsert(c);
+  policy.OnAccess(a);
+  EXPECT_THAT(policy.SelectVictim(EvictAny), Optional(Eq(b)));
+
+  policy.OnRemove(b);
+  EXPECT_THAT(policy.SelectVictim(EvictAny), Optional(Eq(c)));
+}
+
+TEST(LruEvictionPolicyTest, SkipsServablesThatCannotBeEvicted) {
+  LruEvictionPolicy policy;
+  const ServableId a = {"a", 1};
+  const ServableId b = {"b", 1};
+  policy.OnInsert(a);
+  policy.OnInsert(b);
+  EXPECT_THAT(
+      policy.SelectVictim([&](const ServableId& id) { return id != a; }),
+      Optional(Eq(b)));
+  EXPECT_FALSE(policy.SelectVictim([](const ServableId& id) { return false; }));
+}
+
+TEST(LruEvictionPolicyTest, EvictsFrequentServablesOnScan) {
+  LruEvictionPolicy policy;
+  EXPECT_THAT(RequestWithScan({"a", 1}, {"b", 1}, &policy),
+              ElementsAre(ServableId{"scan_7", 0}, ServableId{"scan_8", 0},
+                          ServableId{"scan_9", 0}));
+}
+
+TEST(TinyLfuEvictionPolicyTest, KeepsFrequentServablesOnScan) {
+  TinyLfuEvictionPolicy policy;
+  EXPECT_THAT(RequestWithScan({"a", 1}, {"b", 1}, &policy),
+              ElementsAre(ServableId{"a", 1}, ServableId{"b", 1},
+                          ServableId{"scan_9", 0}));
+}
+
+TEST(TinyLfuEvictionPolicyTest, AdmitsServablesMoreFrequentThanVictim) {
+  TinyLfuEvictionPolicy policy;
+  std::set<ServableId> cached = RequestWithScan({"a", 1}, {"b", 1}, &policy);
+  const ServableId c = {"c", 1};
+  for (int i = 0; i < 10; ++i) {
+    Request(c, 3, &policy, &cached);
+  }
+  // 'c' is now more popular than the least recently used of 'a' and 'b'.
+  Request({"d", 1}, 3, &policy, &cached);
+  EXPECT_THAT(cached, ElementsAre(ServableId{"b", 1}, ServableId{"c", 1},
+                                  ServableId{"d", 1}));
+}
+
+TEST(TinyLfuEvictionPolicyTest, SkipsServablesThatCannotBeEvicted) {
+  TinyLfuEvictionPolicy policy;
+  std::set<ServableId> cached;
+  const ServableId a = {"a", 1};
+  const ServableId b = {"b", 1};
+  const ServableId c = {"c", 1};
+  for (const ServableId& id : {a, a, b, b, c}) {
+    Request(id, 3, &policy, &cached);
+  }
+  EXPECT_THAT(
+      policy.SelectVictim([&](const ServableId& id) { return id == b; }),
+      Optional(Eq(b)));
+  EXPECT_FALSE(policy.SelectVictim([](const ServableId& id) { return false; }));
+}
+
+TEST(TinyLfuEvictionPolicyTest, FrequencyAges) {
+  TinyLfuEvictionPolicy policy(/*expected_num_servables=*/16);
+  const ServableId a = {"a", 1};
+  for (int i = 0; i < 20; ++i) {
+    policy.OnAccess(a);
+  }
+  // The counts saturate.
+  EXPECT_EQ(15, policy.EstimateFrequency(a));
+
+  // The counts are halved once the sketch has seen ten requests per column.
+  for (int i = 0; i < 16 * 10 - 20; ++i) {
+    policy.OnAccess({absl::StrCat("other_", i), 1});
+  }
+  EXPECT_EQ(7, policy.EstimateFrequency(a));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,191 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/servable_prefetch_predictor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace tensorflow {
+namespace serving {
+
+namespace {
+
+constexpr int64_t kMicrosPerDay = 24LL * 60 * 60 * 1000 * 1000;
+
+// Bounds the requests kept for co-requests, however many are made within the
+// window.
+constexpr size_t kMaxRecentRequests = 64;
+
+// Bounds the followers tracked per servable. The least frequent one makes room
+// for a new one.
+constexpr size_t kMaxFollowers = 16;
+
+}  // namespace
+
+ServablePrefetchPredictor::ServablePrefetchPredictor(const Options& options)
+    : options_(options),
+      num_slots_(static_cast<int>(
+          std::max<int64_t>(1, kMicrosPerDay / options.time_slot_micros))) {}
+
+void ServablePrefetchPredictor::RecordRequest(const ServableId& id,
+                                              const int64_t now_micros) {
+  mutex_lock l(mu_);
+  while (!recent_requests_.empty() &&
+         (recent_requests_.size() >= kMaxRecentRequests ||
+          now_micros - recent_requests_.front().time_micros >
+              options_.co_request_window_micros)) {
+    recent_requests_.pop_front();
+  }
+  for (RecentRequest& recent : recent_requests_) {
+    // Each request counts its followers once. The servable requested may have
+    // been evicted since.
+    if (recent.id == id || !recent.followers.insert(id).second) {
+      continue;
+    }
+    auto iter = stats_.find(recent.id);
+    if (iter != stats_.end()) {
+      AddFollower(id, &iter->second);
+    }
+  }
+  recent_requests_.push_back({id, now_micros, {}});
+
+  if (stats_.find(id) == stats_.end() &&
+      static_cast<int64_t>(stats_.size()) >= options_.max_num_servables) {
+    EvictLeastRecentlyRequested();
+  }
+  ServableStats& stats = stats_[id];
+  ++stats.num_requests;
+  stats.last_request_micros = now_micros;
+  if (stats.slots.empty()) {
+    stats.slots.resize(num_slots_);
+  }
+  const int64_t day = now_micros / kMicrosPerDay;
+  SlotRequests& slot =
+      stats.slots[(now_micros % kMicrosPerDay) * num_slots_ / kMicrosPerDay];
+  slot.num_requests = DecayedRequests(slot, day) + 1;
+  slot.day = day;
+}
+
+std::vector<ServableId> ServablePrefetchPredictor::PredictFollowers(
+    const ServableId& id) const {
+  std::vector<std::pair<int64_t, ServableId>> followers;
+  {
+    mutex_lock l(mu_);
+    auto iter = stats_.find(id);
+    if (iter == stats_.end()) {
+      return {};
+    }
+    const ServableStats& stats = iter->second;
+    for (const auto& follower : stats.followers) {
+      if (follower.second >= options_.min_co_requests &&
+          follower.second >=
+              options_.min_co_request_fraction * stats.num_requests) {
+        followers.push_back({follower.second, follower.first});
+      }
+    }
+  }
+  std::sort(followers.begin(), followers.end(),
+            [](const std::pair<int64_t, ServableId>& a,
+               const std::pair<int64_t, ServableId>& b) {
+              return a.first != b.first ? a.first > b.first
+                                        : a.second < b.second;
+            });
+  std::vector<ServableId> predicted;
+  predicted.reserve(followers.size());
+  for (auto& follower : followers) {
+    predicted.push_back(std::move(follower.second));
+  }
+  return predicted;
+}
+
+std::vector<ServableId> ServablePrefetchPredictor::PredictForTime(
+    const int64_t time_micros) const {
+  const int64_t day = time_micros / kMicrosPerDay;
+  const int slot_index =
+      (time_micros % kMicrosPerDay) * num_slots_ / kMicrosPerDay;
+  std::vector<std::pair<double, ServableId>> servables;
+  {
+    mutex_lock l(mu_);
+    for (const auto& servable : stats_) {
+      const ServableStats& stats = servable.second;
+      if (stats.slots.empty()) {
+        continue;
+      }
+      const double num_requests =
+          DecayedRequests(stats.slots[slot_index], day);
+      if (num_requests >= options_.min_periodic_requests) {
+        servables.push_back({num_requests, servable.first});
+      }
+    }
+  }
+  std::sort(servables.begin(), servables.end(),
+            [](const std::pair<double, ServableId>& a,
+               const std::pair<double, ServableId>& b) {
+              return a.first != b.first ? a.first > b.first
+                                        : a.second < b.second;
+            });
+  std::vector<ServableId> predicted;
+  predicted.reserve(servables.size());
+  for (auto& servable : servables) {
+    predicted.push_back(std::move(servable.second));
+  }
+  return predicted;
+}
+
+double ServablePrefetchPredictor::DecayedRequests(const SlotRequests& slot,
+                                                  const int64_t day) const {
+  if (day <= slot.day) {
+    return slot.num_requests;
+  }
+  return slot.num_requests * std::pow(options_.daily_decay, day - slot.day);
+}
+
+void ServablePrefetchPredictor::EvictLeastRecentlyRequested() {
+  if (stats_.empty()) {
+    return;
+  }
+  stats_.erase(std::min_element(
+      stats_.begin(), stats_.end(),
+      [](const std::pair<const ServableId, ServableStats>& a,
+         const std::pair<const ServableId, ServableStats>& b) {
+        return a.second.last_request_micros < b.second.last_request_micros;
+      }));
+}
+
+// static
+void ServablePrefetchPredictor::AddFollower(const ServableId& follower,
+                                            ServableStats* const stats) {
+  auto iter = stats->followers.find(follower);
+  if (iter != stats->followers.end()) {
+    ++iter->second;
+    return;
+  }
+  if (stats->followers.size() >= kMaxFollowers) {
+    stats->followers.erase(std::min_element(
+        stats->followers.begin(), stats->followers.end(),
+        [](const std::pair<const ServableId, int64_t>& a,
+           const std::pair<const ServableId, int64_t>& b) {
+          return a.second < b.second;
+        }));
+  }
+  stats->followers.emplace(follower, 1);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,141 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_SERVABLE_PREFETCH_PREDICTOR_H_
+#define TENSORFLOW_SERVING_CORE_SERVABLE_PREFETCH_PREDICTOR_H_
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow_serving/core/servable_id.h"
+
+namespace tensorflow {
+namespace serving {
+
+/// Learns the request patterns of servables, to predict which ones are about to
+/// be requested so that a CachingManager can load them ahead of the requests.
+/// Two patterns are learnt:
+///  * Co-requests: a servable which is usually requested shortly after
+///    another one is predicted to follow each of its requests.
+///  * Time of day: a servable which was requested often around some time on
+///    recent days is predicted to be requested around that time again.
+///
+/// This class is thread-safe.
+class ServablePrefetchPredictor {
+ public:
+  struct Options {
+    // A request for a servable this long after one for another counts as a
+    // co-request of the two.
+    int64_t co_request_window_micros = 10LL * 1000 * 1000;
+
+    // A servable is predicted to follow the requests for another once it has
+    // followed at least this many of them...
+    int64_t min_co_requests = 5;
+
+    // ... and this fraction of them.
+    double min_co_request_fraction = 0.5;
+
+    // The time of day, in UTC, is split into slots this long.
+    int64_t time_slot_micros = 15LL * 60 * 1000 * 1000;
+
+    // A servable is predicted to be requested during a slot of the day once it
+    // has had this many requests during it, weighing those of each day by
+    // 'daily_decay' times those of the day after.
+    double min_periodic_requests = 5;
+
+    double daily_decay = 0.5;
+
+    // At most this many servables are tracked. The least recently requested
+    // one makes room for a new one.
+    int64_t max_num_servables = 1024;
+  };
+
+  explicit ServablePrefetchPredictor(const Options& options);
+  ~ServablePrefetchPredictor() = default;
+
+  /// Records a request for 'id' at 'now_micros', which should not decrease
+  /// from one call to the next. Only requests which were served should be
+  /// recorded.
+  void RecordRequest(const ServableId& id, int64_t now_micros)
+      TF_LOCKS_EXCLUDED(mu_);
+
+  /// Returns the servables predicted to follow a request for 'id', the most
+  /// likely first.
+  std::vector<ServableId> PredictFollowers(const ServableId& id) const
+      TF_LOCKS_EXCLUDED(mu_);
+
+  /// Returns the servables predicted to be requested during the slot of the
+  /// day of 'time_micros', the most requested first.
+  std::vector<ServableId> PredictForTime(int64_t time_micros) const
+      TF_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // The decayed number of requests for a servable during a slot of the day.
+  struct SlotRequests {
+    double num_requests = 0;
+    // The day 'num_requests' is as of.
+    int64_t day = 0;
+  };
+
+  struct ServableStats {
+    int64_t num_requests = 0;
+    int64_t last_request_micros = 0;
+    // The number of requests for the servable that each other servable has
+    // followed.
+    std::unordered_map<ServableId, int64_t, HashServableId> followers;
+    // Indexed by slot of the day. Empty until the first request.
+    std::vector<SlotRequests> slots;
+  };
+
+  struct RecentRequest {
+    ServableId id;
+    int64_t time_micros;
+    // The servables requested after this request so far.
+    std::unordered_set<ServableId, HashServableId> followers;
+  };
+
+  // Returns 'slot' decayed to 'day'.
+  double DecayedRequests(const SlotRequests& slot, int64_t day) const;
+
+  // Stops tracking the least recently requested servable.
+  void EvictLeastRecentlyRequested() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Counts 'follower' as having followed one more request of 'stats'.
+  static void AddFollower(const ServableId& follower, ServableStats* stats);
+
+  const Options options_;
+
+  // The number of slots per day.
+  const int num_slots_;
+
+  mutable mutex mu_;
+  std::unordered_map<ServableId, ServableStats, HashServableId> stats_
+      TF_GUARDED_BY(mu_);
+  // The requests within the co-request window, oldest first.
+  std::deque<RecentRequest> recent_requests_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ServablePrefetchPredictor);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_SERVABLE_PREFETCH_PREDICTOR_H_
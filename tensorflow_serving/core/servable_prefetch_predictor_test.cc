@@ -0,0 +1,163 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/servable_prefetch_predictor.h"
+
+#include <cstdint>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+constexpr int64_t kMicrosPerSecond = 1000 * 1000;
+constexpr int64_t kMicrosPerHour = 60 * 60 * kMicrosPerSecond;
+constexpr int64_t kMicrosPerDay = 24 * kMicrosPerHour;
+
+ServablePrefetchPredictor::Options CoRequestOptions() {
+  ServablePrefetchPredictor::Options options;
+  options.co_request_window_micros = 10 * kMicrosPerSecond;
+  options.min_co_requests = 2;
+  options.min_co_request_fraction = 0.5;
+  return options;
+}
+
+TEST(ServablePrefetchPredictorTest, PredictsFollowers) {
+  ServablePrefetchPredictor predictor(CoRequestOptions());
+  const ServableId a = {"a", 1};
+  const ServableId b = {"b", 1};
+  const ServableId c = {"c", 1};
+  int64_t now_micros = kMicrosPerDay;
+
+  // 'b' follows 'a' twice, and 'c' only once.
+  for (const ServableId& follower : {b, b, c}) {
+    predictor.RecordRequest(a, now_micros);
+    predictor.RecordRequest(follower, now_micros + kMicrosPerSecond);
+    now_micros += kMicrosPerHour;
+  }
+  EXPECT_THAT(predictor.PredictFollowers(a), ElementsAre(b));
+  EXPECT_THAT(predictor.PredictFollowers(b), IsEmpty());
+  EXPECT_THAT(predictor.PredictFollowers(c), IsEmpty());
+}
+
+TEST(ServablePrefetchPredictorTest, IgnoresRequestsOutsideWindow) {
+  ServablePrefetchPredictor predictor(CoRequestOptions());
+  const ServableId a = {"a", 1};
+  const ServableId b = {"b", 1};
+  int64_t now_micros = kMicrosPerDay;
+  for (int i = 0; i < 3; ++i) {
+    predictor.RecordRequest(a, now_micros);
+    predictor.RecordRequest(b, now_micros + 11 * kMicrosPerSecond);
+    now_micros += kMicrosPerHour;
+  }
+  EXPECT_THAT(predictor.PredictFollowers(a), IsEmpty());
+}
+
+TEST(ServablePrefetchPredictorTest, NeedsFollowersOfEnoughRequests) {
+  ServablePrefetchPredictor predictor(CoRequestOptions());
+  const ServableId a = {"a", 1};
+  const ServableId b = {"b", 1};
+  int64_t now_micros = kMicrosPerDay;
+  for (int i = 0; i < 5; ++i) {
+    predictor.RecordRequest(a, now_micros);
+    // 'b' only follows two of the five requests for 'a'.
+    if (i < 2) {
+      predictor.RecordRequest(b, now_micros + kMicrosPerSecond);
+    }
+    now_micros += kMicrosPerHour;
+  }
+  EXPECT_THAT(predictor.PredictFollowers(a), IsEmpty());
+}
+
+TEST(ServablePrefetchPredictorTest, PredictsForTimeOfDay) {
+  ServablePrefetchPredictor::Options options;
+  options.time_slot_micros = kMicrosPerHour;
+  options.min_periodic_requests = 5;
+  options.daily_decay = 0.5;
+  ServablePrefetchPredictor predictor(options);
+  const ServableId a = {"a", 1};
+
+  // Ten requests at 9:30 on day 10.
+  const int64_t day_10 = 10 * kMicrosPerDay;
+  const int64_t request_micros =
+      day_10 + 9 * kMicrosPerHour + kMicrosPerHour / 2;
+  for (int i = 0; i < 10; ++i) {
+    predictor.RecordRequest(a, request_micros);
+  }
+  EXPECT_THAT(predictor.PredictForTime(day_10 + 9 * kMicrosPerHour),
+              ElementsAre(a));
+  EXPECT_THAT(predictor.PredictForTime(day_10 + 10 * kMicrosPerHour),
+              IsEmpty());
+
+  // Around 9:00 on the next day, they weigh half as much.
+  EXPECT_THAT(
+      predictor.PredictForTime(day_10 + kMicrosPerDay + 9 * kMicrosPerHour),
+      ElementsAre(a));
+  // Two days later, not enough.
+  EXPECT_THAT(
+      predictor.PredictForTime(day_10 + 2 * kMicrosPerDay + 9 * kMicrosPerHour),
+      IsEmpty());
+}
+
+TEST(ServablePrefetchPredictorTest, RanksForTimeOfDay) {
+  ServablePrefetchPredictor::Options options;
+  options.time_slot_micros = kMicrosPerHour;
+  options.min_periodic_requests = 1;
+  ServablePrefetchPredictor predictor(options);
+  const ServableId a = {"a", 1};
+  const ServableId b = {"b", 1};
+  const ServableId c = {"c", 1};
+
+  const int64_t request_micros = 10 * kMicrosPerDay + 9 * kMicrosPerHour;
+  predictor.RecordRequest(a, request_micros);
+  for (int i = 0; i < 3; ++i) {
+    predictor.RecordRequest(b, request_micros);
+  }
+  for (int i = 0; i < 2; ++i) {
+    predictor.RecordRequest(c, request_micros);
+  }
+  EXPECT_THAT(predictor.PredictForTime(request_micros), ElementsAre(b, c, a));
+}
+
+TEST(ServablePrefetchPredictorTest, EvictsLeastRecentlyRequested) {
+  ServablePrefetchPredictor::Options options = CoRequestOptions();
+  options.min_co_requests = 1;
+  options.max_num_servables = 2;
+  ServablePrefetchPredictor predictor(options);
+  const ServableId a = {"a", 1};
+  const ServableId b = {"b", 1};
+  const ServableId c = {"c", 1};
+  int64_t now_micros = kMicrosPerDay;
+
+  predictor.RecordRequest(a, now_micros);
+  predictor.RecordRequest(b, now_micros + kMicrosPerSecond);
+  EXPECT_THAT(predictor.PredictFollowers(a), ElementsAre(b));
+
+  // Tracking 'c' evicts 'a', which was requested least recently.
+  now_micros += kMicrosPerHour;
+  predictor.RecordRequest(b, now_micros);
+  predictor.RecordRequest(c, now_micros + kMicrosPerSecond);
+  EXPECT_THAT(predictor.PredictFollowers(a), IsEmpty());
+  EXPECT_THAT(predictor.PredictFollowers(b), ElementsAre(c));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,271 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/tfrecord_log_collector.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/compression.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+auto* tfrecord_log_dropped_count = monitoring::Counter<1>::New(
+    "/tensorflow/serving/tfrecord_log_dropped_count",
+    "The total number of logs dropped by tfrecord log-collectors because their "
+    "buffer was full, sliced down by filename prefix.",
+    "filename_prefix");
+
+}  // namespace
+
+// static
+absl::Status TfRecordLogCollector::Create(
+    const Options& options,
+    std::unique_ptr<TfRecordLogCollector>* log_collector) {
+  if (options.filename_prefix.empty()) {
+    return absl::InvalidArgumentError(
+        "The tfrecord log-collector needs a filename_prefix.");
+  }
+  if (options.compression_type != io::compression::kNone &&
+      options.compression_type != io::compression::kZlib &&
+      options.compression_type != io::compression::kGzip) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unsupported compression type for the tfrecord "
+                     "log-collector: ",
+                     options.compression_type));
+  }
+  const absl::string_view dir = io::Dirname(options.filename_prefix);
+  if (!dir.empty()) {
+    TF_RETURN_IF_ERROR(options.env->RecursivelyCreateDir(std::string(dir)));
+  }
+  log_collector->reset(new TfRecordLogCollector(options));
+  return absl::OkStatus();
+}
+
+// static
+absl::Status TfRecordLogCollector::Create(
+    const LogCollectorConfig& config, const uint32_t id,
+    std::unique_ptr<LogCollector>* log_collector) {
+  const TfRecordLogCollectorConfig& tfrecord_config = config.tfrecord_config();
+  Options options;
+  options.filename_prefix = config.filename_prefix();
+  options.id = id;
+  if (tfrecord_config.max_file_bytes() > 0) {
+    options.max_file_bytes = tfrecord_config.max_file_bytes();
+  }
+  options.max_file_age_micros =
+      tfrecord_config.max_file_age_seconds() * 1000 * 1000;
+  options.compression_type = tfrecord_config.compression_type();
+  if (tfrecord_config.max_buffer_bytes() > 0) {
+    options.max_buffer_bytes = tfrecord_config.max_buffer_bytes();
+  }
+  if (tfrecord_config.max_pending_bytes() > 0) {
+    options.max_pending_bytes = tfrecord_config.max_pending_bytes();
+  }
+  if (tfrecord_config.flush_interval_micros() > 0) {
+    options.flush_interval_micros = tfrecord_config.flush_interval_micros();
+  }
+  std::unique_ptr<TfRecordLogCollector> tfrecord_log_collector;
+  TF_RETURN_IF_ERROR(Create(options, &tfrecord_log_collector));
+  *log_collector = std::move(tfrecord_log_collector);
+  return absl::OkStatus();
+}
+
+TfRecordLogCollector::TfRecordLogCollector(const Options& options)
+    : options_(options),
+      dropped_count_(
+          tfrecord_log_dropped_count->GetCell(options.filename_prefix)) {
+  write_thread_.reset(options_.env->StartThread(
+      ThreadOptions(), "TfRecordLogCollector_Write_Thread",
+      [this]() { WriteLoop(); }));
+}
+
+TfRecordLogCollector::~TfRecordLogCollector() {
+  // Stops the background writes first.
+  {
+    mutex_lock l(buffer_mu_);
+    stopping_ = true;
+  }
+  buffer_cv_.notify_all();
+  write_thread_.reset();
+  absl::Status status = WriteBuffer(/*flush=*/false);
+  {
+    mutex_lock l(file_mu_);
+    status.Update(CloseFile());
+  }
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to write logs to " << options_.filename_prefix
+               << ": " << status;
+  }
+}
+
+absl::Status TfRecordLogCollector::CollectMessage(
+    const google::protobuf::Message& message) {
+  std::string record;
+  if (!message.SerializeToString(&record)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Failed to serialize log: ", message.ShortDebugString()));
+  }
+  const int64_t max_pending_bytes =
+      std::max(options_.max_pending_bytes, options_.max_buffer_bytes);
+  mutex_lock l(buffer_mu_);
+  if (!buffer_.empty() &&
+      buffer_bytes_ + static_cast<int64_t>(record.size()) >
+          max_pending_bytes) {
+    // The background thread is behind, so drop the log rather than making
+    // the caller wait for the file.
+    dropped_count_->IncrementBy(1);
+    return absl::OkStatus();
+  }
+  buffer_bytes_ += record.size();
+  buffer_.push_back(std::move(record));
+  if (!buffer_full_ && buffer_bytes_ >= options_.max_buffer_bytes) {
+    buffer_full_ = true;
+    buffer_cv_.notify_one();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status TfRecordLogCollector::Flush() {
+  return WriteBuffer(/*flush=*/true);
+}
+
+void TfRecordLogCollector::WriteLoop() {
+  while (true) {
+    bool buffer_full;
+    {
+      mutex_lock l(buffer_mu_);
+      if (!buffer_full_ && !stopping_) {
+        if (options_.flush_interval_micros > 0) {
+          buffer_cv_.wait_for(
+              l, std::chrono::microseconds(options_.flush_interval_micros));
+        } else {
+          buffer_cv_.wait(l);
+        }
+      }
+      if (stopping_) {
+        // The destructor writes what's left.
+        return;
+      }
+      buffer_full = buffer_full_;
+    }
+    // Only flushes the periodic writes.
+    const absl::Status status = WriteBuffer(/*flush=*/!buffer_full);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to write logs to " << options_.filename_prefix
+                 << ": " << status;
+    }
+  }
+}
+
+absl::Status TfRecordLogCollector::WriteBuffer(const bool flush) {
+  mutex_lock file_lock(file_mu_);
+  {
+    mutex_lock buffer_lock(buffer_mu_);
+    // 'write_buffer_' is empty since the last write.
+    buffer_.swap(write_buffer_);
+    buffer_bytes_ = 0;
+    buffer_full_ = false;
+  }
+  const int64_t now_micros = options_.env->NowMicros();
+  absl::Status status;
+  for (const std::string& record : write_buffer_) {
+    status = MaybeRotateFile(now_micros);
+    if (!status.ok()) {
+      break;
+    }
+    status = record_writer_->WriteRecord(record);
+    if (!status.ok()) {
+      // Rather than writing more records after a broken one.
+      status.Update(CloseFile());
+      break;
+    }
+    file_bytes_ += io::RecordWriter::kHeaderSize + record.size() +
+                   io::RecordWriter::kFooterSize;
+  }
+  // Logs which failed to be written are dropped rather than retried, as the
+  // file they were partially written to is likely broken. The next write starts
+  // a new file.
+  write_buffer_.clear();
+  TF_RETURN_IF_ERROR(status);
+  if (FileTooOld(now_micros)) {
+    // Rather than when the next log is written, which may be much later.
+    return CloseFile();
+  }
+  if (flush && record_writer_ != nullptr) {
+    status = record_writer_->Flush();
+    if (!status.ok()) {
+      status.Update(CloseFile());
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status TfRecordLogCollector::MaybeRotateFile(const int64_t now_micros) {
+  if (record_writer_ != nullptr && file_bytes_ < options_.max_file_bytes &&
+      !FileTooOld(now_micros)) {
+    return absl::OkStatus();
+  }
+  TF_RETURN_IF_ERROR(CloseFile());
+  // Files are named after the time they were opened, which must differ from
+  // that of the previous file.
+  file_open_micros_ = std::max(now_micros, file_open_micros_ + 1);
+  const std::string filename = absl::StrCat(
+      options_.filename_prefix, "-", options_.id, "-", file_open_micros_);
+  TF_RETURN_IF_ERROR(options_.env->NewWritableFile(filename, &file_));
+  record_writer_ = std::make_unique<io::RecordWriter>(
+      file_.get(), io::RecordWriterOptions::CreateRecordWriterOptions(
+                       options_.compression_type));
+  file_bytes_ = 0;
+  return absl::OkStatus();
+}
+
+bool TfRecordLogCollector::FileTooOld(const int64_t now_micros) const {
+  return record_writer_ != nullptr && options_.max_file_age_micros > 0 &&
+         now_micros - file_open_micros_ >= options_.max_file_age_micros;
+}
+
+absl::Status TfRecordLogCollector::CloseFile() {
+  if (record_writer_ == nullptr) {
+    return absl::OkStatus();
+  }
+  absl::Status status = record_writer_->Close();
+  status.Update(file_->Close());
+  record_writer_.reset();
+  file_.reset();
+  return status;
+}
+
+REGISTER_LOG_COLLECTOR(
+    "tfrecord", [](const LogCollectorConfig& config, const uint32_t id,
+                   std::unique_ptr<LogCollector>* log_collector) {
+      return TfRecordLogCollector::Create(config, id, log_collector);
+    });
+
+}  // namespace serving
+}  // namespace tensorflow
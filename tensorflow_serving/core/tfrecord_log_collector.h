@@ -0,0 +1,160 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_CORE_TFRECORD_LOG_COLLECTOR_H_
+#define TENSORFLOW_SERVING_CORE_TFRECORD_LOG_COLLECTOR_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "google/protobuf/message.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/config/log_collector_config.pb.h"
+#include "tensorflow_serving/core/log_collector.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A LogCollector which writes the serialized logs as TFRecords, registered for
+// the type "tfrecord". Files of PredictionLogs written without compression can
+// be used as the warmup data of SavedModels.
+//
+// The logs are serialized by the collecting threads, and appended to an
+// in-memory buffer under a short lock. Writing the buffer swaps it for a second
+// one, so that logs keep being collected into that one while the first is
+// written out. The buffer is written by a background thread every flush
+// interval, and as soon as it holds 'max_buffer_bytes', so that the collecting
+// threads never wait for the file. It is also written on Flush(), by the
+// calling thread. Logs which would take the buffer beyond 'max_pending_bytes'
+// while it waits to be written are dropped, and counted in a metric.
+//
+// The files are named '<filename_prefix>-<id>-<time they were opened, in
+// microseconds>', and rotated by size and age. A file which gets too old is
+// closed by the next write of the buffer, including the periodic ones, even if
+// there are no logs to write, so that it is complete (e.g. has its GZIP
+// trailer) without waiting for the next log.
+class TfRecordLogCollector : public LogCollector {
+ public:
+  struct Options {
+    string filename_prefix;
+
+    // Disambiguates the files of replicated servers.
+    uint32 id = 0;
+
+    // Records beyond which a new file is started, before compression.
+    int64_t max_file_bytes = int64_t{1} << 30;
+
+    // Age beyond which a new file is started. Zero means no limit.
+    int64_t max_file_age_micros = 0;
+
+    // One of the io::compression types.
+    string compression_type;
+
+    // The buffer is written once it holds this many bytes.
+    int64_t max_buffer_bytes = int64_t{4} << 20;
+
+    // Logs which would take the buffer beyond this many bytes are dropped. At
+    // least 'max_buffer_bytes'.
+    int64_t max_pending_bytes = int64_t{16} << 20;
+
+    // Zero means the buffer is only written when full or flushed.
+    int64_t flush_interval_micros = 1000 * 1000;
+
+    Env* env = Env::Default();
+  };
+
+  static Status Create(const Options& options,
+                       std::unique_ptr<TfRecordLogCollector>* log_collector);
+
+  // Creates the collector of a LogCollectorConfig, with the defaults of its
+  // TfRecordLogCollectorConfig.
+  static Status Create(const LogCollectorConfig& config, uint32 id,
+                       std::unique_ptr<LogCollector>* log_collector);
+
+  // Writes the buffered logs and closes the file.
+  ~TfRecordLogCollector() override;
+
+  // Never writes to the file. Returns OK if the log is dropped.
+  Status CollectMessage(const google::protobuf::Message& message) override;
+
+  // Writes the buffered logs and flushes the file. Logs are collected into the
+  // second buffer meanwhile.
+  Status Flush() override;
+
+ private:
+  explicit TfRecordLogCollector(const Options& options);
+
+  // The body of the background thread, which writes the buffer once it's full
+  // or every flush interval, until the collector is destroyed.
+  void WriteLoop() TF_LOCKS_EXCLUDED(file_mu_, buffer_mu_);
+
+  // Writes the buffered logs, and then closes the file if it is too old, or
+  // else flushes it if 'flush'. The file is closed on errors, so that the next
+  // write starts a new one.
+  Status WriteBuffer(bool flush) TF_LOCKS_EXCLUDED(file_mu_, buffer_mu_);
+
+  // Starts a new file if there's none, or the current one is too big or too
+  // old at 'now_micros'.
+  Status MaybeRotateFile(int64_t now_micros)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(file_mu_);
+
+  // Returns true if the current file is too old at 'now_micros'.
+  bool FileTooOld(int64_t now_micros) const
+      TF_EXCLUSIVE_LOCKS_REQUIRED(file_mu_);
+
+  // Closes the current file, if any.
+  Status CloseFile() TF_EXCLUSIVE_LOCKS_REQUIRED(file_mu_);
+
+  const Options options_;
+
+  // The buffer logs are collected into.
+  mutex buffer_mu_;
+  std::vector<string> buffer_ TF_GUARDED_BY(buffer_mu_);
+  int64_t buffer_bytes_ TF_GUARDED_BY(buffer_mu_) = 0;
+  // Whether the buffer is full, for the background thread to write it.
+  bool buffer_full_ TF_GUARDED_BY(buffer_mu_) = false;
+  bool stopping_ TF_GUARDED_BY(buffer_mu_) = false;
+  // Wakes up the background thread when the buffer is full, or on stopping.
+  condition_variable buffer_cv_;
+
+  // Serializes the writes. Taken before 'buffer_mu_' when both are held.
+  mutex file_mu_;
+  // The buffer being written, swapped with 'buffer_' on each write so that
+  // both keep their capacity.
+  std::vector<string> write_buffer_ TF_GUARDED_BY(file_mu_);
+  std::unique_ptr<WritableFile> file_ TF_GUARDED_BY(file_mu_);
+  std::unique_ptr<io::RecordWriter> record_writer_ TF_GUARDED_BY(file_mu_);
+  int64_t file_bytes_ TF_GUARDED_BY(file_mu_) = 0;
+  int64_t file_open_micros_ TF_GUARDED_BY(file_mu_) = 0;
+
+  monitoring::CounterCell* const dropped_count_;
+  std::unique_ptr<Thread> write_thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TfRecordLogCollector);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_CORE_TFRECORD_LOG_COLLECTOR_H_
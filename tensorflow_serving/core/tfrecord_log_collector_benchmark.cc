@@ -0,0 +1,127 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks for the throughput of TfRecordLogCollector.
+//
+// PredictionLogs with a request tensor of a given size are collected from a
+// few threads at once, and the collector is flushed at the end of each
+// iteration. The throughput is reported in records (items) and bytes of
+// serialized logs per second.
+//
+// Run with:
+// bazel run -c opt \
+// tensorflow_serving/core:tfrecord_log_collector_benchmark --
+// --benchmarks=.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/compression.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow_serving/apis/prediction_log.pb.h"
+#include "tensorflow_serving/core/tfrecord_log_collector.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// The number of logs each thread collects per iteration.
+constexpr int kLogsPerThread = 1000;
+
+constexpr const char* kCompressionTypes[] = {
+    io::compression::kNone, io::compression::kZlib, io::compression::kGzip};
+
+PredictionLog CreateLog(const int tensor_bytes) {
+  PredictionLog log;
+  PredictRequest* request = log.mutable_predict_log()->mutable_request();
+  request->mutable_model_spec()->set_name("model");
+  TensorProto& tensor = (*request->mutable_inputs())["input"];
+  tensor.set_dtype(DT_STRING);
+  // Varied contents, so that compression has some work to do.
+  string contents;
+  for (int i = 0; contents.size() < static_cast<size_t>(tensor_bytes); ++i) {
+    absl::StrAppend(&contents, i, ",");
+  }
+  contents.resize(tensor_bytes);
+  tensor.add_string_val(contents);
+  return log;
+}
+
+void BM_CollectMessage(::testing::benchmark::State& state) {
+  const int tensor_bytes = state.range(0);
+  const int num_threads = state.range(1);
+  const string compression_type = kCompressionTypes[state.range(2)];
+
+  TfRecordLogCollector::Options options;
+  options.filename_prefix = io::JoinPath(
+      testing::TmpDir(), "tfrecord_log_collector_benchmark",
+      absl::StrCat(tensor_bytes, "_", num_threads, "_", state.range(2)));
+  options.compression_type = compression_type;
+  std::unique_ptr<TfRecordLogCollector> log_collector;
+  TF_CHECK_OK(TfRecordLogCollector::Create(options, &log_collector));
+  const PredictionLog log = CreateLog(tensor_bytes);
+  thread::ThreadPool threads(Env::Default(), "BM_CollectMessage",
+                             num_threads);
+
+  for (auto s : state) {
+    absl::BlockingCounter done(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      threads.Schedule([&]() {
+        for (int j = 0; j < kLogsPerThread; ++j) {
+          TF_CHECK_OK(log_collector->CollectMessage(log));
+        }
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+    TF_CHECK_OK(log_collector->Flush());
+  }
+  const int64_t num_logs =
+      static_cast<int64_t>(num_threads) * kLogsPerThread * state.iterations();
+  state.SetItemsProcessed(num_logs);
+  state.SetBytesProcessed(num_logs * log.ByteSizeLong());
+}
+
+// Args are {bytes of the request tensor, number of collecting threads,
+// compression type (none, ZLIB, GZIP)}. Uses real time, as the CPU time would
+// include the time spent by all threads.
+BENCHMARK(BM_CollectMessage)
+    ->UseRealTime()
+    ->Args({100, 1, 0})
+    ->Args({1000, 1, 0})
+    ->Args({10000, 1, 0})
+    ->Args({1000, 4, 0})
+    ->Args({1000, 16, 0})
+    ->Args({1000, 4, 1})
+    ->Args({1000, 4, 2});
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  tensorflow::testing::RunBenchmarks();
+  return 0;
+}
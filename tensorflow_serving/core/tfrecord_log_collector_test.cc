@@ -0,0 +1,245 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/core/tfrecord_log_collector.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/compression.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow_serving/apis/prediction_log.pb.h"
+#include "tensorflow_serving/config/log_collector_config.pb.h"
+#include "tensorflow_serving/test_util/test_util.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using test_util::EqualsProto;
+using ::testing::ElementsAre;
+using ::testing::SizeIs;
+
+PredictionLog CreateLog(const int i) {
+  PredictionLog log;
+  log.mutable_predict_log()->mutable_request()->mutable_model_spec()->set_name(
+      absl::StrCat("model_", i));
+  return log;
+}
+
+// Returns the files written for 'filename_prefix', in the order they were
+// written.
+std::vector<string> GetFiles(const string& filename_prefix) {
+  std::vector<string> files;
+  TF_CHECK_OK(
+      Env::Default()->GetMatchingPaths(absl::StrCat(filename_prefix, "-*"),
+                                       &files));
+  // The names only differ by the time the files were opened.
+  std::sort(files.begin(), files.end(), [](const string& a, const string& b) {
+    return a.size() != b.size() ? a.size() < b.size() : a < b;
+  });
+  return files;
+}
+
+// Reads the logs of 'file' the way SavedModel warmup does.
+std::vector<PredictionLog> ReadLogs(const string& file,
+                                    const string& compression_type = "") {
+  std::unique_ptr<RandomAccessFile> random_access_file;
+  TF_CHECK_OK(Env::Default()->NewRandomAccessFile(file, &random_access_file));
+  io::SequentialRecordReader reader(
+      random_access_file.get(),
+      io::RecordReaderOptions::CreateRecordReaderOptions(compression_type));
+  std::vector<PredictionLog> logs;
+  tstring record;
+  absl::Status status;
+  while ((status = reader.ReadRecord(&record)).ok()) {
+    PredictionLog log;
+    CHECK(log.ParseFromArray(record.data(), record.size()));
+    logs.push_back(log);
+  }
+  CHECK(absl::IsOutOfRange(status)) << status;
+  return logs;
+}
+
+TEST(TfRecordLogCollectorTest, Registered) {
+  const string filename_prefix =
+      io::JoinPath(testing::TmpDir(), "registered", "logs");
+  LogCollectorConfig config;
+  config.set_type("tfrecord");
+  config.set_filename_prefix(filename_prefix);
+  {
+    std::unique_ptr<LogCollector> log_collector;
+    TF_ASSERT_OK(LogCollector::Create(config, 7, &log_collector));
+    TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(1)));
+    TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(2)));
+  }
+
+  const std::vector<string> files = GetFiles(filename_prefix);
+  ASSERT_THAT(files, SizeIs(1));
+  EXPECT_EQ(0, files[0].rfind(absl::StrCat(filename_prefix, "-7-"), 0));
+  EXPECT_THAT(ReadLogs(files[0]),
+              ElementsAre(EqualsProto(CreateLog(1)),
+                          EqualsProto(CreateLog(2))));
+}
+
+TEST(TfRecordLogCollectorTest, Flush) {
+  TfRecordLogCollector::Options options;
+  options.filename_prefix = io::JoinPath(testing::TmpDir(), "flush", "logs");
+  options.flush_interval_micros = 0;
+  std::unique_ptr<TfRecordLogCollector> log_collector;
+  TF_ASSERT_OK(TfRecordLogCollector::Create(options, &log_collector));
+
+  TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(1)));
+  EXPECT_THAT(GetFiles(options.filename_prefix), SizeIs(0));
+  TF_ASSERT_OK(log_collector->Flush());
+  const std::vector<string> files = GetFiles(options.filename_prefix);
+  ASSERT_THAT(files, SizeIs(1));
+  EXPECT_THAT(ReadLogs(files[0]), ElementsAre(EqualsProto(CreateLog(1))));
+
+  TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(2)));
+  TF_ASSERT_OK(log_collector->Flush());
+  EXPECT_THAT(ReadLogs(files[0]),
+              ElementsAre(EqualsProto(CreateLog(1)),
+                          EqualsProto(CreateLog(2))));
+}
+
+TEST(TfRecordLogCollectorTest, WritesFullBuffer) {
+  TfRecordLogCollector::Options options;
+  options.filename_prefix =
+      io::JoinPath(testing::TmpDir(), "full_buffer", "logs");
+  options.max_buffer_bytes = 1;
+  options.flush_interval_micros = 0;
+  std::unique_ptr<TfRecordLogCollector> log_collector;
+  TF_ASSERT_OK(TfRecordLogCollector::Create(options, &log_collector));
+
+  TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(1)));
+  // Written by the background thread, without flushing or any flush interval.
+  while (GetFiles(options.filename_prefix).empty()) {
+    Env::Default()->SleepForMicroseconds(1000 /* 1 ms */);
+  }
+  EXPECT_THAT(GetFiles(options.filename_prefix), SizeIs(1));
+}
+
+TEST(TfRecordLogCollectorTest, RotatesBySize) {
+  TfRecordLogCollector::Options options;
+  options.filename_prefix = io::JoinPath(testing::TmpDir(), "size", "logs");
+  // Two logs per file.
+  options.max_file_bytes = 2 * (CreateLog(0).ByteSizeLong() + 16);
+  std::unique_ptr<TfRecordLogCollector> log_collector;
+  TF_ASSERT_OK(TfRecordLogCollector::Create(options, &log_collector));
+  for (int i = 0; i < 5; ++i) {
+    TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(i)));
+  }
+  log_collector.reset();
+
+  const std::vector<string> files = GetFiles(options.filename_prefix);
+  ASSERT_THAT(files, SizeIs(3));
+  EXPECT_THAT(ReadLogs(files[0]),
+              ElementsAre(EqualsProto(CreateLog(0)),
+                          EqualsProto(CreateLog(1))));
+  EXPECT_THAT(ReadLogs(files[1]),
+              ElementsAre(EqualsProto(CreateLog(2)),
+                          EqualsProto(CreateLog(3))));
+  EXPECT_THAT(ReadLogs(files[2]), ElementsAre(EqualsProto(CreateLog(4))));
+}
+
+TEST(TfRecordLogCollectorTest, RotatesByAge) {
+  TfRecordLogCollector::Options options;
+  options.filename_prefix = io::JoinPath(testing::TmpDir(), "age", "logs");
+  options.max_file_age_micros = 1;
+  options.flush_interval_micros = 0;
+  std::unique_ptr<TfRecordLogCollector> log_collector;
+  TF_ASSERT_OK(TfRecordLogCollector::Create(options, &log_collector));
+  TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(0)));
+  TF_ASSERT_OK(log_collector->Flush());
+  Env::Default()->SleepForMicroseconds(10);
+  TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(1)));
+  log_collector.reset();
+
+  const std::vector<string> files = GetFiles(options.filename_prefix);
+  ASSERT_THAT(files, SizeIs(2));
+  EXPECT_THAT(ReadLogs(files[0]), ElementsAre(EqualsProto(CreateLog(0))));
+  EXPECT_THAT(ReadLogs(files[1]), ElementsAre(EqualsProto(CreateLog(1))));
+}
+
+TEST(TfRecordLogCollectorTest, ClosesOldFileOnFlush) {
+  TfRecordLogCollector::Options options;
+  options.filename_prefix =
+      io::JoinPath(testing::TmpDir(), "close_old_file", "logs");
+  options.compression_type = io::compression::kGzip;
+  options.max_file_age_micros = 1000;
+  // Flush() writes the buffer the same way as the periodic writes.
+  options.flush_interval_micros = 0;
+  std::unique_ptr<TfRecordLogCollector> log_collector;
+  TF_ASSERT_OK(TfRecordLogCollector::Create(options, &log_collector));
+  TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(0)));
+  TF_ASSERT_OK(log_collector->Flush());
+  Env::Default()->SleepForMicroseconds(2000);
+  // Closes the file, although there are no more logs.
+  TF_ASSERT_OK(log_collector->Flush());
+
+  // The file is complete while the log-collector is still open.
+  const std::vector<string> files = GetFiles(options.filename_prefix);
+  ASSERT_THAT(files, SizeIs(1));
+  EXPECT_THAT(ReadLogs(files[0], options.compression_type),
+              ElementsAre(EqualsProto(CreateLog(0))));
+
+  TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(1)));
+  log_collector.reset();
+  EXPECT_THAT(GetFiles(options.filename_prefix), SizeIs(2));
+}
+
+TEST(TfRecordLogCollectorTest, Compression) {
+  for (const string& compression_type :
+       {io::compression::kZlib, io::compression::kGzip}) {
+    TfRecordLogCollector::Options options;
+    options.filename_prefix =
+        io::JoinPath(testing::TmpDir(), compression_type, "logs");
+    options.compression_type = compression_type;
+    std::unique_ptr<TfRecordLogCollector> log_collector;
+    TF_ASSERT_OK(TfRecordLogCollector::Create(options, &log_collector));
+    TF_ASSERT_OK(log_collector->CollectMessage(CreateLog(1)));
+    log_collector.reset();
+
+    const std::vector<string> files = GetFiles(options.filename_prefix);
+    ASSERT_THAT(files, SizeIs(1));
+    EXPECT_THAT(ReadLogs(files[0], compression_type),
+                ElementsAre(EqualsProto(CreateLog(1))));
+  }
+}
+
+TEST(TfRecordLogCollectorTest, InvalidOptions) {
+  std::unique_ptr<TfRecordLogCollector> log_collector;
+  TfRecordLogCollector::Options options;
+  EXPECT_FALSE(TfRecordLogCollector::Create(options, &log_collector).ok());
+
+  options.filename_prefix = io::JoinPath(testing::TmpDir(), "invalid", "logs");
+  options.compression_type = "SNAPPY";
+  EXPECT_FALSE(TfRecordLogCollector::Create(options, &log_collector).ok());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
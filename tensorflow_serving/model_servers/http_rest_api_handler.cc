@@ -30,6 +30,7 @@ limitations under the License.
 #include "absl/time/time.h"
 #include "tensorflow/cc/saved_model/loader.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/threadpool_options.h"
@@ -43,6 +44,7 @@ limitations under the License.
 #include "tensorflow_serving/servables/tensorflow/get_model_metadata_impl.h"
 #include "tensorflow_serving/servables/tensorflow/predict_impl.h"
 #include "tensorflow_serving/servables/tensorflow/regression_service.h"
+#include "tensorflow_serving/util/binary_tensor.h"
 #include "tensorflow_serving/util/json_tensor.h"
 
 namespace tensorflow {
@@ -67,6 +69,34 @@ absl::Status HttpRestApiHandler::ProcessRequest(
     const absl::string_view request_body,
     std::vector<std::pair<string, string>>* headers, string* model_name,
     string* method, string* output) {
+  return ProcessRequestWithOutputWriter(
+      http_method, request_path, request_body,
+      [](absl::string_view) { return absl::string_view(); }, headers,
+      model_name, method,
+      [output](absl::string_view chunk) {
+        output->append(chunk.data(), chunk.size());
+      },
+      output);
+}
+
+absl::Status HttpRestApiHandler::ProcessRequestWithOutputWriter(
+    const absl::string_view http_method, const absl::string_view request_path,
+    const absl::string_view request_body,
+    const RequestHeaderGetter& request_header,
+    std::vector<std::pair<string, string>>* headers, string* model_name,
+    string* method, const OutputWriter& output_writer, string* output) {
+  return ProcessStreamingRequest(http_method, request_path,
+                                 StringBodyReaderFactory(request_body),
+                                 request_header, headers, model_name, method,
+                                 output_writer, output);
+}
+
+absl::Status HttpRestApiHandler::ProcessStreamingRequest(
+    const absl::string_view http_method, const absl::string_view request_path,
+    const RequestBodyReaderFactory& new_body_reader,
+    const RequestHeaderGetter& request_header,
+    std::vector<std::pair<string, string>>* headers, string* model_name,
+    string* method, const OutputWriter& output_writer, string* output) {
   headers->clear();
   output->clear();
   AddHeaders(headers);
@@ -83,16 +113,25 @@ absl::Status HttpRestApiHandler::ProcessRequest(
 
   // Dispatch request to appropriate processor
   if (http_method == "POST" && parse_successful) {
+    string request_body;
     if (*method == "classify") {
-      status =
-          ProcessClassifyRequest(*model_name, model_version,
-                                 model_version_label, request_body, output);
+      status = ReadRequestBody(new_body_reader, &request_body);
+      if (status.ok()) {
+        status =
+            ProcessClassifyRequest(*model_name, model_version,
+                                   model_version_label, request_body, output);
+      }
     } else if (*method == "regress") {
-      status = ProcessRegressRequest(*model_name, model_version,
-                                     model_version_label, request_body, output);
+      status = ReadRequestBody(new_body_reader, &request_body);
+      if (status.ok()) {
+        status =
+            ProcessRegressRequest(*model_name, model_version,
+                                  model_version_label, request_body, output);
+      }
     } else if (*method == "predict") {
       status = ProcessPredictRequest(*model_name, model_version,
-                                     model_version_label, request_body, output);
+                                     model_version_label, new_body_reader,
+                                     request_header, headers, output_writer);
     }
   } else if (http_method == "GET" && parse_successful) {
     if (!model_subresource.empty() && model_subresource == "metadata") {
@@ -153,7 +192,10 @@ absl::Status HttpRestApiHandler::ProcessPredictRequest(
     const absl::string_view model_name,
     const absl::optional<int64_t>& model_version,
     const absl::optional<absl::string_view>& model_version_label,
-    const absl::string_view request_body, string* output) {
+    const RequestBodyReaderFactory& new_body_reader,
+    const RequestHeaderGetter& request_header,
+    std::vector<std::pair<string, string>>* headers,
+    const OutputWriter& output_writer) {
   ::google::protobuf::Arena arena;
 
   auto* request = ::google::protobuf::Arena::Create<PredictRequest>(&arena);
@@ -161,19 +203,101 @@ absl::Status HttpRestApiHandler::ProcessPredictRequest(
       model_name, model_version, model_version_label,
       request->mutable_model_spec()));
 
-  JsonPredictRequestFormat format;
-  TF_RETURN_IF_ERROR(FillPredictRequestFromJson(
-      request_body,
-      [this, request](const string& sig,
-                      ::google::protobuf::Map<string, TensorInfo>* map) {
-        return this->GetInfoMap(request->model_spec(), sig, map);
-      },
-      request, &format));
-
-  auto* response = ::google::protobuf::Arena::Create<PredictResponse>(&arena);
-  TF_RETURN_IF_ERROR(
-      predictor_->Predict(run_options_, core_, *request, response));
-  TF_RETURN_IF_ERROR(MakeJsonFromTensors(response->outputs(), format, output));
+  const PredictBodyEncoding request_encoding =
+      GetPredictRequestEncoding(request_header("Content-Type"));
+  const PredictBodyEncoding response_encoding =
+      GetPredictResponseEncoding(request_header("Accept"), request_encoding);
+
+  // Inputs are decoded straight into Tensors, bypassing `request.inputs()`.
+  // JSON is decoded as the body is read (and uncompressed), binary bodies
+  // once read whole.
+  string signature_name;
+  std::vector<std::pair<string, Tensor>> inputs;
+  JsonPredictRequestFormat format = JsonPredictRequestFormat::kColumnar;
+  string request_body;
+  if (request_encoding != PredictBodyEncoding::kJson) {
+    TF_RETURN_IF_ERROR(ReadRequestBody(new_body_reader, &request_body));
+  }
+  switch (request_encoding) {
+    case PredictBodyEncoding::kJson: {
+      std::unique_ptr<RequestBodyReader> reader = new_body_reader();
+      // The size of a compressed body does not hint at that of the JSON.
+      int64_t json_size_hint = 0;
+      if (request_header("Content-Encoding").empty() &&
+          !absl::SimpleAtoi(request_header("Content-Length"),
+                            &json_size_hint)) {
+        json_size_hint = 0;
+      }
+      TF_RETURN_IF_ERROR(FillPredictInputsFromJsonChunks(
+          [&reader](absl::string_view* chunk) { return reader->Next(chunk); },
+          json_size_hint,
+          [&new_body_reader](string* json) {
+            return ReadRequestBody(new_body_reader, json);
+          },
+          [this, request](const string& sig,
+                          ::google::protobuf::Map<string, TensorInfo>* map) {
+            return this->GetInfoMap(request->model_spec(), sig, map);
+          },
+          &signature_name, &inputs, &format));
+      TF_RETURN_IF_ERROR(CheckRequestBodyReader(*reader));
+      break;
+    }
+    case PredictBodyEncoding::kBinaryTensors:
+      TF_RETURN_IF_ERROR(
+          DecodeBinaryTensors(request_body, &signature_name, &inputs));
+      break;
+    case PredictBodyEncoding::kProtobuf: {
+      // The model is named by the request path, not the proto.
+      auto* body = ::google::protobuf::Arena::Create<PredictRequest>(&arena);
+      if (!body->ParseFromArray(request_body.data(), request_body.size())) {
+        return errors::InvalidArgument("Failed to parse PredictRequest");
+      }
+      signature_name = body->model_spec().signature_name();
+      request->mutable_output_filter()->Swap(body->mutable_output_filter());
+      for (const auto& kv : body->inputs()) {
+        Tensor tensor;
+        if (!tensor.FromProto(kv.second)) {
+          return errors::InvalidArgument("tensor parsing error: ", kv.first);
+        }
+        inputs.emplace_back(kv.first, std::move(tensor));
+      }
+      break;
+    }
+  }
+  request->mutable_model_spec()->set_signature_name(signature_name);
+
+  // Outputs are encoded straight from the Tensors, and handed to
+  // `output_writer` in chunks rather than built up in one string.
+  std::vector<std::pair<string, Tensor>> outputs;
+  TF_RETURN_IF_ERROR(predictor_->PredictWithTensors(run_options_, core_,
+                                                    *request, inputs, &outputs));
+  switch (response_encoding) {
+    case PredictBodyEncoding::kJson:
+      TF_RETURN_IF_ERROR(WriteJsonFromTensors(outputs, format, output_writer));
+      break;
+    case PredictBodyEncoding::kBinaryTensors:
+      TF_RETURN_IF_ERROR(
+          EncodeBinaryTensors(signature_name, outputs, output_writer));
+      break;
+    case PredictBodyEncoding::kProtobuf: {
+      auto* response =
+          ::google::protobuf::Arena::Create<PredictResponse>(&arena);
+      *response->mutable_model_spec() = request->model_spec();
+      for (const auto& kv : outputs) {
+        TensorProto& proto = (*response->mutable_outputs())[kv.first];
+        if (core_->predict_response_tensor_serialization_option() ==
+            internal::PredictResponseTensorSerializationOption::
+                kAsProtoContent) {
+          kv.second.AsProtoTensorContent(&proto);
+        } else {
+          kv.second.AsProtoField(&proto);
+        }
+      }
+      output_writer(response->SerializeAsString());
+      break;
+    }
+  }
+  SetContentTypeHeader(PredictBodyContentType(response_encoding), headers);
   return absl::OkStatus();
 }
 
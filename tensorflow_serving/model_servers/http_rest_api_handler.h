@@ -86,6 +86,26 @@ class HttpRestApiHandler : public HttpRestApiHandlerBase {
                         string* model_name, string* method,
                         string* output) override;
 
+  // Predict request and response bodies may be binary, as selected by the
+  // Content-Type and Accept request headers, and responses are passed to
+  // `output_writer` as they are generated.
+  Status ProcessRequestWithOutputWriter(
+      const absl::string_view http_method, const absl::string_view request_path,
+      const absl::string_view request_body,
+      const RequestHeaderGetter& request_header,
+      std::vector<std::pair<string, string>>* headers, string* model_name,
+      string* method, const OutputWriter& output_writer,
+      string* output) override;
+
+  // JSON predict requests are decoded as the body is read.
+  Status ProcessStreamingRequest(
+      const absl::string_view http_method, const absl::string_view request_path,
+      const RequestBodyReaderFactory& new_body_reader,
+      const RequestHeaderGetter& request_header,
+      std::vector<std::pair<string, string>>* headers, string* model_name,
+      string* method, const OutputWriter& output_writer,
+      string* output) override;
+
  private:
   Status ProcessClassifyRequest(
       const absl::string_view model_name,
@@ -101,7 +121,10 @@ class HttpRestApiHandler : public HttpRestApiHandlerBase {
       const absl::string_view model_name,
       const absl::optional<int64_t>& model_version,
       const absl::optional<absl::string_view>& model_version_label,
-      const absl::string_view request_body, string* output);
+      const RequestBodyReaderFactory& new_body_reader,
+      const RequestHeaderGetter& request_header,
+      std::vector<std::pair<string, string>>* headers,
+      const OutputWriter& output_writer);
   Status ProcessModelStatusRequest(
       const absl::string_view model_name,
       const absl::optional<int64_t>& model_version,
@@ -16,12 +16,14 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_MODEL_SERVERS_HTTP_REST_API_HANDLER_BASE_H_
 #define TENSORFLOW_SERVING_MODEL_SERVERS_HTTP_REST_API_HANDLER_BASE_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/strings/string_view.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 
 namespace tensorflow {
@@ -65,6 +67,119 @@ class HttpRestApiHandlerBase {
                                 std::vector<std::pair<string, string>>* headers,
                                 string* model_name, string* method,
                                 string* output) = 0;
+
+  // Returns the value of the named request header, or an empty string if the
+  // request has no such header.
+  using RequestHeaderGetter =
+      std::function<absl::string_view(absl::string_view name)>;
+
+  // Receives chunks of a response body, see ProcessRequestWithOutputWriter().
+  using OutputWriter = std::function<void(absl::string_view chunk)>;
+
+  // Like ProcessRequest(), but with access to the request headers (the
+  // Content-Type and Accept headers select binary predict request and response
+  // bodies), and large response bodies may be handed to `output_writer` in
+  // chunks as they are generated, instead of accumulating in `output`. The
+  // full response body is all chunks passed to `output_writer`, followed by
+  // the contents of `output`.
+  //
+  // The default implementation ignores the request headers and passes nothing
+  // to `output_writer`.
+  virtual Status ProcessRequestWithOutputWriter(
+      const absl::string_view http_method, const absl::string_view request_path,
+      const absl::string_view request_body,
+      const RequestHeaderGetter& request_header,
+      std::vector<std::pair<string, string>>* headers, string* model_name,
+      string* method, const OutputWriter& output_writer, string* output) {
+    return ProcessRequest(http_method, request_path, request_body, headers,
+                          model_name, method, output);
+  }
+
+  // Reads a request body in chunks, from its start.
+  class RequestBodyReader {
+   public:
+    virtual ~RequestBodyReader() = default;
+
+    // Sets `chunk` to the next chunk of the body, which stays valid until the
+    // next call. Returns false after the last chunk, or if reading failed.
+    virtual bool Next(absl::string_view* chunk) = 0;
+
+    // Returns false if reading the body failed, e.g. it is corrupted or
+    // exceeds the max uncompressed size.
+    virtual bool ok() const = 0;
+  };
+
+  // Returns a new reader of the request body, see ProcessStreamingRequest().
+  using RequestBodyReaderFactory =
+      std::function<std::unique_ptr<RequestBodyReader>()>;
+
+  // Like ProcessRequestWithOutputWriter(), but reads the request body through
+  // readers from `new_body_reader`, so that (e.g. JSON predict) requests can
+  // be decoded as the body is read and uncompressed, without holding all of
+  // it in memory. A handler may create more than one reader, e.g. to fall back
+  // to decoding the whole body.
+  //
+  // The default implementation reads the whole body into a string.
+  virtual Status ProcessStreamingRequest(
+      const absl::string_view http_method, const absl::string_view request_path,
+      const RequestBodyReaderFactory& new_body_reader,
+      const RequestHeaderGetter& request_header,
+      std::vector<std::pair<string, string>>* headers, string* model_name,
+      string* method, const OutputWriter& output_writer, string* output) {
+    string body;
+    TF_RETURN_IF_ERROR(ReadRequestBody(new_body_reader, &body));
+    return ProcessRequestWithOutputWriter(http_method, request_path, body,
+                                          request_header, headers, model_name,
+                                          method, output_writer, output);
+  }
+
+ protected:
+  // Reads the whole request body from a new reader into `body`.
+  static Status ReadRequestBody(const RequestBodyReaderFactory& new_body_reader,
+                                string* body) {
+    body->clear();
+    std::unique_ptr<RequestBodyReader> reader = new_body_reader();
+    absl::string_view chunk;
+    while (reader->Next(&chunk)) {
+      body->append(chunk.data(), chunk.size());
+    }
+    return CheckRequestBodyReader(*reader);
+  }
+
+  // Returns an error if `reader` failed to read the request body.
+  static Status CheckRequestBodyReader(const RequestBodyReader& reader) {
+    if (!reader.ok()) {
+      return errors::InvalidArgument(
+          "Failed to read the request body, it may be corrupted or exceed "
+          "the max uncompressed size");
+    }
+    return Status();
+  }
+
+  // Returns readers of `body`, which has to outlive them, in one chunk.
+  static RequestBodyReaderFactory StringBodyReaderFactory(
+      const absl::string_view body) {
+    class StringBodyReader final : public RequestBodyReader {
+     public:
+      explicit StringBodyReader(const absl::string_view body) : body_(body) {}
+
+      bool Next(absl::string_view* chunk) override {
+        if (done_) return false;
+        *chunk = body_;
+        done_ = true;
+        return true;
+      }
+
+      bool ok() const override { return true; }
+
+     private:
+      const absl::string_view body_;
+      bool done_ = false;
+    };
+    return [body]() -> std::unique_ptr<RequestBodyReader> {
+      return std::unique_ptr<RequestBodyReader>(new StringBodyReader(body));
+    };
+  }
 };
 
 }  // namespace serving
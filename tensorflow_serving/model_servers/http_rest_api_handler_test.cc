@@ -31,10 +31,13 @@ limitations under the License.
 #include "re2/re2.h"
 #include "tensorflow/cc/saved_model/loader.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "xla/tsl/platform/errors.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow_serving/apis/predict.pb.h"
 #include "tensorflow_serving/core/availability_preserving_policy.h"
 #include "tensorflow_serving/model_servers/model_platform_types.h"
 #include "tensorflow_serving/model_servers/platform_config_util.h"
@@ -43,6 +46,7 @@ limitations under the License.
 #include "tensorflow_serving/servables/tensorflow/saved_model_bundle_source_adapter.pb.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
 #include "tensorflow_serving/test_util/test_util.h"
+#include "tensorflow_serving/util/binary_tensor.h"
 
 namespace tensorflow {
 namespace serving {
@@ -384,6 +388,162 @@ TEST_F(HttpRestApiHandlerTest, Predict) {
                            (HeaderList){{"Content-Type", "application/json"}}));
 }
 
+TEST_F(HttpRestApiHandlerTest, PredictBinaryBodies) {
+  const string path = absl::StrCat("/v1/models/", kTestModelName, "/versions/",
+                                   kTestModelVersion1, ":predict");
+  HeaderList request_headers;
+  const auto request_header = [&request_headers](absl::string_view name) {
+    for (const auto& kv : request_headers) {
+      if (kv.first == name) return absl::string_view(kv.second);
+    }
+    return absl::string_view();
+  };
+  HeaderList headers;
+  string model_name, method, output;
+  const auto process_request = [&](absl::string_view body) {
+    output.clear();
+    return handler_.ProcessRequestWithOutputWriter(
+        "POST", path, body, request_header, &headers, &model_name, &method,
+        [&output](absl::string_view chunk) {
+          output.append(chunk.data(), chunk.size());
+        },
+        &output);
+  };
+
+  // Binary tensors in, binary tensors out.
+  string body;
+  TF_ASSERT_OK(EncodeBinaryTensors(
+      "serving_default", {{"x", test::AsTensor<float>({1.0, 2.0})}},
+      [&body](absl::string_view chunk) {
+        body.append(chunk.data(), chunk.size());
+      }));
+  request_headers = {{"Content-Type", kBinaryTensorsContentType}};
+  TF_ASSERT_OK(process_request(body));
+  EXPECT_THAT(headers, UnorderedElementsAreArray((HeaderList){
+                           {"Content-Type", kBinaryTensorsContentType}}));
+  string signature_name;
+  std::vector<std::pair<string, Tensor>> outputs;
+  TF_ASSERT_OK(DecodeBinaryTensors(output, &signature_name, &outputs));
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_EQ(outputs[0].first, "y");
+  test::ExpectTensorEqual<float>(outputs[0].second,
+                                 test::AsTensor<float>({2.5, 3.0}));
+
+  // Binary tensors in, JSON out.
+  request_headers.push_back({"Accept", "application/json"});
+  TF_ASSERT_OK(process_request(body));
+  TF_EXPECT_OK(CompareJson(output, R"({ "outputs": [2.5, 3.0] })"));
+  EXPECT_THAT(headers, UnorderedElementsAreArray(
+                           (HeaderList){{"Content-Type", "application/json"}}));
+
+  // Serialized PredictRequest in, PredictResponse out.
+  PredictRequest request;
+  test::AsTensor<float>({3.0, 4.0}).AsProtoTensorContent(
+      &(*request.mutable_inputs())["x"]);
+  request_headers = {{"Content-Type", "application/x-protobuf"}};
+  TF_ASSERT_OK(process_request(request.SerializeAsString()));
+  EXPECT_THAT(headers, UnorderedElementsAreArray((HeaderList){
+                           {"Content-Type", "application/x-protobuf"}}));
+  PredictResponse response;
+  ASSERT_TRUE(response.ParseFromString(output));
+  Tensor y;
+  ASSERT_TRUE(y.FromProto(response.outputs().at("y")));
+  test::ExpectTensorEqual<float>(y, test::AsTensor<float>({3.5, 4.0}));
+
+  // JSON in, binary tensors out.
+  request_headers = {{"Accept", kBinaryTensorsContentType}};
+  TF_ASSERT_OK(process_request(R"({"instances": [1.0, 2.0]})"));
+  TF_ASSERT_OK(DecodeBinaryTensors(output, &signature_name, &outputs));
+  test::ExpectTensorEqual<float>(outputs[0].second,
+                                 test::AsTensor<float>({2.5, 3.0}));
+
+  // Errors are reported as JSON.
+  request_headers = {{"Content-Type", kBinaryTensorsContentType}};
+  const absl::Status status = process_request("not binary tensors");
+  EXPECT_TRUE(absl::IsInvalidArgument(status));
+  EXPECT_THAT(GetJsonErrorMsg(output), HasSubstr("magic bytes"));
+  EXPECT_THAT(headers, UnorderedElementsAreArray(
+                           (HeaderList){{"Content-Type", "application/json"}}));
+}
+
+// Reads a request body in chunks of (at most) 3 bytes, and fails after
+// `fail_after` of them if non-negative.
+class ChunkedBodyReader final
+    : public HttpRestApiHandlerBase::RequestBodyReader {
+ public:
+  ChunkedBodyReader(absl::string_view body, int fail_after)
+      : body_(body), fail_after_(fail_after) {}
+
+  bool Next(absl::string_view* chunk) override {
+    if (fail_after_ == 0) {
+      ok_ = false;
+    }
+    if (!ok_ || body_.empty()) return false;
+    --fail_after_;
+    *chunk = body_.substr(0, 3);
+    body_.remove_prefix(chunk->size());
+    return true;
+  }
+
+  bool ok() const override { return ok_; }
+
+ private:
+  absl::string_view body_;
+  int fail_after_;
+  bool ok_ = true;
+};
+
+TEST_F(HttpRestApiHandlerTest, PredictStreamingRequest) {
+  const string path = absl::StrCat("/v1/models/", kTestModelName, "/versions/",
+                                   kTestModelVersion1, ":predict");
+  HeaderList headers;
+  string model_name, method, output;
+  int num_readers = 0;
+  const auto process_request = [&](absl::string_view body, int fail_after) {
+    output.clear();
+    num_readers = 0;
+    return handler_.ProcessStreamingRequest(
+        "POST", path,
+        [&]() {
+          ++num_readers;
+          return std::unique_ptr<HttpRestApiHandlerBase::RequestBodyReader>(
+              new ChunkedBodyReader(body, fail_after));
+        },
+        [](absl::string_view) { return absl::string_view(); }, &headers,
+        &model_name, &method,
+        [&output](absl::string_view chunk) {
+          output.append(chunk.data(), chunk.size());
+        },
+        &output);
+  };
+
+  // JSON is decoded from the chunks as they are read, with a single reader.
+  TF_ASSERT_OK(process_request(R"({"instances": [[1.0, 2.0], [3.0, 4.0]]})",
+                               /*fail_after=*/-1));
+  EXPECT_EQ(num_readers, 1);
+  TF_EXPECT_OK(
+      CompareJson(output, R"({ "predictions": [[2.5, 3.0], [3.5, 4.0]] })"));
+
+  // Failing to read the body is an error, even if the JSON read so far is
+  // malformed.
+  absl::Status status =
+      process_request(R"({"instances": [1.0, 2.0]})", /*fail_after=*/2);
+  EXPECT_TRUE(absl::IsInvalidArgument(status));
+  EXPECT_THAT(GetJsonErrorMsg(output),
+              HasSubstr("Failed to read the request body"));
+
+  // Malformed JSON is reported as by ProcessRequest().
+  status = process_request(R"({"instances": [1.0, 2.0])", /*fail_after=*/-1);
+  EXPECT_TRUE(absl::IsInvalidArgument(status));
+  EXPECT_EQ(num_readers, 2);
+  string expected_output;
+  EXPECT_EQ(
+      handler_.ProcessRequest("POST", path, R"({"instances": [1.0, 2.0])",
+                              &headers, &model_name, &method, &expected_output),
+      status);
+  EXPECT_EQ(output, expected_output);
+}
+
 TEST_F(HttpRestApiHandlerTest, Regress) {
   HeaderList headers;
   string model_name, method, output;
@@ -19,11 +19,15 @@ limitations under the License.
 #include <vector>
 
 #include "google/protobuf/util/json_util.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
 #include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
 #include <curl/curl.h>
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow_serving/servables/tensorflow/get_model_metadata_impl.h"
+#include "tensorflow_serving/util/binary_tensor.h"
 
 namespace tensorflow {
 namespace serving {
@@ -43,6 +47,64 @@ void AddCORSHeaders(std::vector<std::pair<string, string>>* headers) {
   headers->push_back({"Access-Control-Allow-Headers", "Content-Type"});
 }
 
+void SetContentTypeHeader(absl::string_view content_type,
+                          std::vector<std::pair<string, string>>* headers) {
+  for (auto& kv : *headers) {
+    if (kv.first == "Content-Type") {
+      kv.second = string(content_type);
+      return;
+    }
+  }
+  headers->push_back({"Content-Type", string(content_type)});
+}
+
+const char* const kProtobufContentType = "application/x-protobuf";
+
+const char* PredictBodyContentType(PredictBodyEncoding encoding) {
+  switch (encoding) {
+    case PredictBodyEncoding::kJson:
+      return "application/json";
+    case PredictBodyEncoding::kBinaryTensors:
+      return kBinaryTensorsContentType;
+    case PredictBodyEncoding::kProtobuf:
+      return kProtobufContentType;
+  }
+}
+
+namespace {
+
+// Returns the encoding named by `media_type` (a Content-Type header value or
+// one element of an Accept header), ignoring any parameters.
+absl::optional<PredictBodyEncoding> GetPredictBodyEncoding(
+    absl::string_view media_type) {
+  media_type = absl::StripAsciiWhitespace(
+      media_type.substr(0, media_type.find(';')));
+  for (const auto encoding :
+       {PredictBodyEncoding::kJson, PredictBodyEncoding::kBinaryTensors,
+        PredictBodyEncoding::kProtobuf}) {
+    if (absl::EqualsIgnoreCase(media_type, PredictBodyContentType(encoding))) {
+      return encoding;
+    }
+  }
+  return absl::nullopt;
+}
+
+}  // namespace
+
+PredictBodyEncoding GetPredictRequestEncoding(absl::string_view content_type) {
+  return GetPredictBodyEncoding(content_type)
+      .value_or(PredictBodyEncoding::kJson);
+}
+
+PredictBodyEncoding GetPredictResponseEncoding(
+    absl::string_view accept, PredictBodyEncoding request_encoding) {
+  for (const absl::string_view media_type : absl::StrSplit(accept, ',')) {
+    const auto encoding = GetPredictBodyEncoding(media_type);
+    if (encoding.has_value()) return *encoding;
+  }
+  return request_encoding;
+}
+
 absl::Status FillModelSpecWithNameVersionAndLabel(
     const absl::string_view model_name,
     const absl::optional<int64_t>& model_version,
@@ -36,6 +36,36 @@ void AddHeaders(std::vector<std::pair<string, string>>* headers);
 
 void AddCORSHeaders(std::vector<std::pair<string, string>>* headers);
 
+// Replaces the Content-Type header added by AddHeaders().
+void SetContentTypeHeader(absl::string_view content_type,
+                          std::vector<std::pair<string, string>>* headers);
+
+// Encodings of predict request and response bodies.
+enum class PredictBodyEncoding {
+  kJson,
+  // Named tensors, see tensorflow_serving/util/binary_tensor.h.
+  kBinaryTensors,
+  // Serialized PredictRequest and PredictResponse protos.
+  kProtobuf,
+};
+
+// Content type of kProtobuf bodies.
+extern const char* const kProtobufContentType;
+
+// Returns the content type of bodies in `encoding`.
+const char* PredictBodyContentType(PredictBodyEncoding encoding);
+
+// Returns the encoding of a predict request body, given the value of its
+// Content-Type header. Bodies are JSON unless the header names one of the
+// binary encodings.
+PredictBodyEncoding GetPredictRequestEncoding(absl::string_view content_type);
+
+// Returns the encoding of a predict response body, given the value of the
+// Accept header of the request: the encoding of the first media type listed
+// that names one, or else the encoding of the request body.
+PredictBodyEncoding GetPredictResponseEncoding(
+    absl::string_view accept, PredictBodyEncoding request_encoding);
+
 Status FillModelSpecWithNameVersionAndLabel(
     const absl::string_view model_name,
     const absl::optional<int64_t>& model_version,
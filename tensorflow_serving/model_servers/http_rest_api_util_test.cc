@@ -16,6 +16,9 @@ limitations under the License.
 #include "tensorflow_serving/model_servers/http_rest_api_util.h"
 
 #include <limits>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -221,6 +224,38 @@ TEST_F(HttpRestApiUtilTest, TestParseModelInfoForPost) {
       &model_subresource, &parse_successful));
   EXPECT_FALSE(parse_successful);
 }
+
+TEST_F(HttpRestApiUtilTest, TestPredictBodyEncoding) {
+  EXPECT_EQ(GetPredictRequestEncoding(""), PredictBodyEncoding::kJson);
+  EXPECT_EQ(GetPredictRequestEncoding("application/json; charset=utf-8"),
+            PredictBodyEncoding::kJson);
+  EXPECT_EQ(GetPredictRequestEncoding("text/plain"),
+            PredictBodyEncoding::kJson);
+  EXPECT_EQ(
+      GetPredictRequestEncoding("Application/X-TensorFlow-Serving-Tensors"),
+      PredictBodyEncoding::kBinaryTensors);
+  EXPECT_EQ(GetPredictRequestEncoding("application/x-protobuf"),
+            PredictBodyEncoding::kProtobuf);
+
+  EXPECT_EQ(GetPredictResponseEncoding("", PredictBodyEncoding::kProtobuf),
+            PredictBodyEncoding::kProtobuf);
+  EXPECT_EQ(GetPredictResponseEncoding("*/*", PredictBodyEncoding::kJson),
+            PredictBodyEncoding::kJson);
+  EXPECT_EQ(GetPredictResponseEncoding(
+                "text/html, application/x-tensorflow-serving-tensors;q=0.9, "
+                "application/json",
+                PredictBodyEncoding::kJson),
+            PredictBodyEncoding::kBinaryTensors);
+  EXPECT_EQ(GetPredictResponseEncoding("application/json",
+                                       PredictBodyEncoding::kBinaryTensors),
+            PredictBodyEncoding::kJson);
+
+  std::vector<std::pair<string, string>> headers;
+  AddHeaders(&headers);
+  SetContentTypeHeader(kProtobufContentType, &headers);
+  EXPECT_EQ(headers.size(), 1);
+  EXPECT_EQ(headers[0].second, "application/x-protobuf");
+}
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
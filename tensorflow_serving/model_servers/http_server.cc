@@ -21,8 +21,8 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
-#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "re2/re2.h"
 #include "tensorflow/core/platform/env.h"
@@ -37,6 +37,7 @@ limitations under the License.
 #include "tensorflow_serving/util/net_http/server/public/server_request_interface.h"
 #include "tensorflow_serving/util/prometheus_exporter.h"
 #include "tensorflow_serving/util/threadpool_executor.h"
+#include "tensorflow_serving/util/work_stealing_executor.h"
 
 namespace tensorflow {
 namespace serving {
@@ -92,15 +93,28 @@ void ProcessPrometheusRequest(PrometheusExporter* exporter, const string& path,
   headers.push_back({"Content-Type", "text/plain"});
   string output;
   absl::Status status;
+  const std::pair<absl::string_view, absl::string_view> path_and_query =
+      absl::StrSplit(req->uri_path(), absl::MaxSplits('?', 1));
+  PrometheusExporter::PageOptions page_options;
   // Check if url matches the path.
-  if (req->uri_path() != path) {
+  if (path_and_query.first != path) {
     output = absl::StrFormat("Unexpected path: %s. Should be %s",
                              req->uri_path(), path);
     status = absl::Status(
         static_cast<absl::StatusCode>(absl::StatusCode::kInvalidArgument),
         output);
   } else {
-    status = exporter->GeneratePage(&output);
+    status = PrometheusExporter::ParsePageOptions(path_and_query.second,
+                                                  &page_options);
+    if (status.ok()) {
+      // Append the page to the response as it is generated, rather than
+      // building it up in one string first.
+      status = exporter->WritePage(
+          page_options,
+          [req](absl::string_view chunk) { req->WriteResponseString(chunk); });
+    } else {
+      output = string(status.message());
+    }
   }
   const net_http::HTTPStatusCode http_status = ToHTTPStatusCode(status);
   // Note: we add headers+output for non successful status too, in case the
@@ -118,15 +132,47 @@ void ProcessPrometheusRequest(PrometheusExporter* exporter, const string& path,
 
 class RequestExecutor final : public net_http::EventExecutor {
  public:
-  explicit RequestExecutor(int num_threads)
-      : executor_(Env::Default(), "httprestserver", num_threads) {}
+  RequestExecutor(int num_threads, bool work_stealing) {
+    if (work_stealing) {
+      executor_ = absl::make_unique<WorkStealingExecutor>(
+          Env::Default(), "httprestserver", num_threads);
+    } else {
+      executor_ = absl::make_unique<ThreadPoolExecutor>(
+          Env::Default(), "httprestserver", num_threads);
+    }
+  }
 
-  void Schedule(std::function<void()> fn) override { executor_.Schedule(fn); }
+  void Schedule(std::function<void()> fn) override {
+    executor_->Schedule(std::move(fn));
+  }
 
  private:
-  ThreadPoolExecutor executor_;
+  std::unique_ptr<Executor> executor_;
 };
 
+// Reads a request body through a net_http::RequestBodyStream.
+class RequestBodyStreamReader final
+    : public HttpRestApiHandlerBase::RequestBodyReader {
+ public:
+  explicit RequestBodyStreamReader(
+      std::unique_ptr<net_http::RequestBodyStream> stream)
+      : stream_(std::move(stream)) {}
+
+  bool Next(absl::string_view* chunk) override { return stream_->Next(chunk); }
+
+  bool ok() const override { return stream_->ok(); }
+
+ private:
+  const std::unique_ptr<net_http::RequestBodyStream> stream_;
+};
+
+// Returns a new reader of the body of `req`, from its start.
+std::unique_ptr<HttpRestApiHandlerBase::RequestBodyReader> NewRequestBodyReader(
+    net_http::ServerRequestInterface* req) {
+  return absl::make_unique<RequestBodyStreamReader>(
+      req->NewRequestBodyStream());
+}
+
 class RestApiRequestDispatcher {
  public:
   RestApiRequestDispatcher(int timeout_in_ms, ServerCore* core)
@@ -151,20 +197,13 @@ class RestApiRequestDispatcher {
  private:
   void ProcessRequest(net_http::ServerRequestInterface* req) {
     const uint64_t start = Env::Default()->NowMicros();
-    string body;
-    int64_t num_bytes = 0;
-    auto request_chunk = req->ReadRequestBytes(&num_bytes);
-    while (request_chunk != nullptr) {
-      absl::StrAppend(&body, absl::string_view(request_chunk.get(), num_bytes));
-      request_chunk = req->ReadRequestBytes(&num_bytes);
-    }
-
     std::vector<std::pair<string, string>> headers;
     string model_name;
     string method;
     string output;
     VLOG(1) << "Processing HTTP request: " << req->http_method() << " "
-            << req->uri_path() << " body: " << body.size() << " bytes.";
+            << req->uri_path() << " body: "
+            << req->GetRequestHeader("Content-Length") << " bytes.";
 
     absl::Status status;
     if (req->http_method() == "OPTIONS") {
@@ -176,9 +215,17 @@ class RestApiRequestDispatcher {
             "Origin header is missing in CORS preflight");
       }
     } else {
-      status =
-          handler_->ProcessRequest(req->http_method(), req->uri_path(), body,
-                                   &headers, &model_name, &method, &output);
+      // The body is read (and gzip bodies uncompressed) in chunks straight
+      // from the transport buffers, as the handler decodes it. Large
+      // (predict) responses are copied into the response buffer in chunks as
+      // they are generated, ahead of the rest of `output`.
+      status = handler_->ProcessStreamingRequest(
+          req->http_method(), req->uri_path(),
+          [req]() { return NewRequestBodyReader(req); },
+          [req](absl::string_view name) { return req->GetRequestHeader(name); },
+          &headers, &model_name, &method,
+          [req](absl::string_view chunk) { req->WriteResponseString(chunk); },
+          &output);
     }
     if (core_->enable_cors_support()) {
       AddCORSHeaders(&headers);
@@ -210,11 +257,13 @@ class RestApiRequestDispatcher {
 }  // namespace
 
 std::unique_ptr<net_http::HTTPServerInterface> CreateAndStartHttpServer(
-    int port, int num_threads, int timeout_in_ms,
-    const MonitoringConfig& monitoring_config, ServerCore* core) {
+    int port, int num_threads, bool work_stealing_executor, int timeout_in_ms,
+    const MonitoringConfig& monitoring_config,
+    const net_http::RequestHandlerOptions& handler_options, ServerCore* core) {
   auto options = absl::make_unique<net_http::ServerOptions>();
   options->AddPort(static_cast<uint32_t>(port));
-  options->SetExecutor(absl::make_unique<RequestExecutor>(num_threads));
+  options->SetExecutor(
+      absl::make_unique<RequestExecutor>(num_threads, work_stealing_executor));
 
   auto server = net_http::CreateEvHTTPServer(std::move(options));
   if (server == nullptr) {
@@ -227,6 +276,8 @@ std::unique_ptr<net_http::HTTPServerInterface> CreateAndStartHttpServer(
         std::make_shared<PrometheusExporter>();
     net_http::RequestHandlerOptions prometheus_request_options;
     PrometheusConfig prometheus_config = monitoring_config.prometheus_config();
+    prometheus_request_options.set_auto_compress_output(
+        prometheus_config.enable_response_compression());
     auto path = prometheus_config.path().empty()
                     ? PrometheusExporter::kPrometheusPath
                     : prometheus_config.path();
@@ -240,7 +291,6 @@ std::unique_ptr<net_http::HTTPServerInterface> CreateAndStartHttpServer(
 
   std::shared_ptr<RestApiRequestDispatcher> dispatcher =
       std::make_shared<RestApiRequestDispatcher>(timeout_in_ms, core);
-  net_http::RequestHandlerOptions handler_options;
   server->RegisterRequestDispatcher(
       [dispatcher](net_http::ServerRequestInterface* req) {
         return dispatcher->Dispatch(req);
@@ -30,9 +30,13 @@ class ServerCore;
 //   o HTTP/REST API (under /v1/models/...)
 //
 // The returned server is in a state of accepting new requests.
+// Requests are processed by `num_threads` threads, of a WorkStealingExecutor if
+// `work_stealing_executor` is true and of a ThreadPoolExecutor otherwise.
+// `handler_options` apply to the HTTP/REST API, e.g. to compress responses.
 std::unique_ptr<net_http::HTTPServerInterface> CreateAndStartHttpServer(
-    int port, int num_threads, int timeout_in_ms,
-    const MonitoringConfig& monitoring_config, ServerCore* core);
+    int port, int num_threads, bool work_stealing_executor, int timeout_in_ms,
+    const MonitoringConfig& monitoring_config,
+    const net_http::RequestHandlerOptions& handler_options, ServerCore* core);
 
 }  // namespace serving
 }  // namespace tensorflow
@@ -99,11 +99,31 @@ int main(int argc, char** argv) {
       tensorflow::Flag("rest_api_num_threads", &options.http_num_threads,
                        "Number of threads for HTTP/REST API processing. If not "
                        "set, will be auto set based on number of CPUs."),
+      tensorflow::Flag("rest_api_enable_work_stealing_executor",
+                       &options.http_enable_work_stealing_executor,
+                       "Run HTTP/REST API requests on a work-stealing executor, "
+                       "which schedules requests without taking a lock, "
+                       "instead of the default thread pool."),
       tensorflow::Flag("rest_api_timeout_in_ms", &options.http_timeout_in_ms,
                        "Timeout for HTTP/REST API calls."),
       tensorflow::Flag("rest_api_enable_cors_support",
                        &options.enable_cors_support,
                        "Enable CORS headers in response"),
+      tensorflow::Flag("rest_api_enable_response_compression",
+                       &options.enable_http_response_compression,
+                       "Gzip-compress HTTP/REST API responses for clients "
+                       "that send an Accept-Encoding header accepting gzip."),
+      tensorflow::Flag("rest_api_response_compression_min_bytes",
+                       &options.http_response_compression_min_bytes,
+                       "HTTP/REST API responses smaller than this are not "
+                       "compressed. Only used with "
+                       "--rest_api_enable_response_compression."),
+      tensorflow::Flag("rest_api_response_compression_level",
+                       &options.http_response_compression_level,
+                       "zlib compression level of HTTP/REST API responses, "
+                       "from 1 (fastest) to 9 (best compression), or -1 for "
+                       "the zlib default. Only used with "
+                       "--rest_api_enable_response_compression."),
       tensorflow::Flag("enable_batching", &options.enable_batching,
                        "enable batching"),
       tensorflow::Flag(
@@ -160,6 +180,15 @@ int main(int argc, char** argv) {
                        "thread-pool, and servable loads are performed serially "
                        "in the manager's main work loop, may casue the Serving "
                        "request to be delayed. Default: 0"),
+      tensorflow::Flag("enable_parallel_version_transitions",
+                       &options.enable_parallel_version_transitions,
+                       "If true, the manager takes the next load or unload "
+                       "step of all models at once, running up to "
+                       "num_load_threads loads concurrently, and takes them as "
+                       "soon as new model versions are found or a load or "
+                       "unload finishes, instead of one step of one model "
+                       "every 100 milliseconds. Speeds up config changes "
+                       "touching many models. Default: false"),
       tensorflow::Flag("max_num_load_retries", &options.max_num_load_retries,
                        "maximum number of times it retries loading a model "
                        "after the first failure, before giving up. "
@@ -179,6 +208,26 @@ int main(int argc, char** argv) {
                        "entirely causing ModelServer to indefinitely wait for "
                        "a new model at startup. Negative values are reserved "
                        "for testing purposes only."),
+      tensorflow::Flag("num_file_system_polling_threads",
+                       &options.num_file_system_polling_threads,
+                       "The number of threads with which to poll the base "
+                       "paths of the models concurrently. If set to 0 or 1, "
+                       "they are polled one at a time. Default: 0"),
+      tensorflow::Flag("cache_base_path_listings",
+                       &options.cache_base_path_listings,
+                       "If true, the filesystem poll only lists the versions "
+                       "of a model again once the modification time of its "
+                       "base path changes. Requires a filesystem which "
+                       "updates the modification times of directories, like "
+                       "local ones. Default: false"),
+      tensorflow::Flag("max_base_path_listing_age_seconds",
+                       &options.max_base_path_listing_age_seconds,
+                       "With --cache_base_path_listings, the longest time in "
+                       "seconds for which the versions of a model are reused "
+                       "before they are listed again. Base paths whose "
+                       "versions change without their modification time "
+                       "changing are not cached anymore. If 0, 5 minutes, and "
+                       "if negative, no limit. Default: 0"),
       tensorflow::Flag("flush_filesystem_caches",
                        &options.flush_filesystem_caches,
                        "If true (the default), filesystem caches will be "
@@ -313,11 +313,18 @@ absl::Status Server::BuildAndStart(const Options& server_options) {
       std::unique_ptr<AspiredVersionPolicy>(new AvailabilityPreservingPolicy);
   options.num_load_threads = server_options.num_load_threads;
   options.num_unload_threads = server_options.num_unload_threads;
+  options.enable_parallel_version_transitions =
+      server_options.enable_parallel_version_transitions;
   options.max_num_load_retries = server_options.max_num_load_retries;
   options.load_retry_interval_micros =
       server_options.load_retry_interval_micros;
   options.file_system_poll_wait_seconds =
       server_options.file_system_poll_wait_seconds;
+  options.num_file_system_polling_threads =
+      server_options.num_file_system_polling_threads;
+  options.cache_base_path_listings = server_options.cache_base_path_listings;
+  options.max_base_path_listing_age_seconds =
+      server_options.max_base_path_listing_age_seconds;
   options.flush_filesystem_caches = server_options.flush_filesystem_caches;
   options.allow_version_labels_for_unavailable_models =
       server_options.allow_version_labels_for_unavailable_models;
@@ -443,10 +450,19 @@ absl::Status Server::BuildAndStart(const Options& server_options) {
         TF_RETURN_IF_ERROR(ParseProtoTextFile<MonitoringConfig>(
             server_options.monitoring_config_file, &monitoring_config));
       }
+      net_http::RequestHandlerOptions http_handler_options;
+      http_handler_options
+          .set_auto_compress_output(
+              server_options.enable_http_response_compression)
+          .set_auto_compress_min_size(
+              server_options.http_response_compression_min_bytes)
+          .set_auto_compress_level(
+              server_options.http_response_compression_level);
       http_server_ = CreateAndStartHttpServer(
           server_options.http_port, server_options.http_num_threads,
+          server_options.http_enable_work_stealing_executor,
           server_options.http_timeout_in_ms, monitoring_config,
-          server_core_.get());
+          http_handler_options, server_core_.get());
       if (http_server_ != nullptr) {
         LOG(INFO) << "Exporting HTTP/REST API at:" << server_address << " ...";
       } else {
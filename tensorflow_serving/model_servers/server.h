@@ -50,8 +50,12 @@ class Server {
     //
     tensorflow::int32 http_port = 0;
     tensorflow::int32 http_num_threads = 4.0 * port::NumSchedulableCPUs();
+    bool http_enable_work_stealing_executor = false;
     tensorflow::int32 http_timeout_in_ms = 30000;  // 30 seconds.
     bool enable_cors_support = false;
+    bool enable_http_response_compression = false;
+    tensorflow::int32 http_response_compression_min_bytes = 1024;
+    tensorflow::int32 http_response_compression_level = -1;  // zlib default.
 
     //
     // Model Server options.
@@ -65,9 +69,13 @@ class Server {
     tensorflow::string model_name;
     tensorflow::int32 num_load_threads = 0;
     tensorflow::int32 num_unload_threads = 0;
+    bool enable_parallel_version_transitions = false;
     tensorflow::int32 max_num_load_retries = 5;
     int64_t load_retry_interval_micros = 1LL * 60 * 1000 * 1000;
     tensorflow::int32 file_system_poll_wait_seconds = 1;
+    tensorflow::int32 num_file_system_polling_threads = 0;
+    bool cache_base_path_listings = false;
+    int64_t max_base_path_listing_age_seconds = 0;
     bool flush_filesystem_caches = true;
     tensorflow::string model_base_path;
     tensorflow::string saved_model_tags;
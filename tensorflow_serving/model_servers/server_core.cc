@@ -637,6 +637,11 @@ FileSystemStoragePathSourceConfig ServerCore::CreateStoragePathSourceConfig(
   FileSystemStoragePathSourceConfig source_config;
   source_config.set_file_system_poll_wait_seconds(
       options_.file_system_poll_wait_seconds);
+  source_config.set_num_file_system_polling_threads(
+      options_.num_file_system_polling_threads);
+  source_config.set_cache_base_path_listings(options_.cache_base_path_listings);
+  source_config.set_max_base_path_listing_age_seconds(
+      options_.max_base_path_listing_age_seconds);
   source_config.set_fail_if_zero_versions_at_startup(
       options_.fail_if_no_model_versions_found);
   source_config.set_servable_versions_always_present(
@@ -796,6 +801,8 @@ absl::Status ServerCore::CreateAspiredVersionsManager(
   manager_options.custom_sort_actions = std::move(custom_sort_actions);
   manager_options.num_load_threads = options_.num_load_threads;
   manager_options.num_unload_threads = options_.num_unload_threads;
+  manager_options.enable_parallel_version_transitions =
+      options_.enable_parallel_version_transitions;
   manager_options.max_num_load_retries = options_.max_num_load_retries;
   manager_options.load_retry_interval_micros =
       options_.load_retry_interval_micros;
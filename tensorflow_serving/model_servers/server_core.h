@@ -119,6 +119,9 @@ class ServerCore : public Manager {
     // pool is used and unloads are performed serially in the manager thread.
     int32 num_unload_threads = 0;
 
+    // See AspiredVersionsManager::Options::enable_parallel_version_transitions.
+    bool enable_parallel_version_transitions = false;
+
     // Total model size limit, in terms of main memory, in bytes.
     uint64_t total_model_memory_limit_bytes =
         std::numeric_limits<uint64_t>::max();
@@ -137,6 +140,16 @@ class ServerCore : public Manager {
     // Time interval between file-system polls, in seconds.
     int32 file_system_poll_wait_seconds = 30;
 
+    // See FileSystemStoragePathSourceConfig.num_file_system_polling_threads.
+    int32 num_file_system_polling_threads = 0;
+
+    // See FileSystemStoragePathSourceConfig.cache_base_path_listings.
+    bool cache_base_path_listings = false;
+
+    // See
+    // FileSystemStoragePathSourceConfig.max_base_path_listing_age_seconds.
+    int64_t max_base_path_listing_age_seconds = 0;
+
     // If true, filesystem caches are flushed in the following cases:
     //
     // 1) After the initial models are loaded.
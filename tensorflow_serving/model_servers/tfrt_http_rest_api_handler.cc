@@ -30,6 +30,7 @@ limitations under the License.
 #include "absl/time/time.h"
 #include "tensorflow/cc/saved_model/loader.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "xla/tsl/platform/errors.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/platform/errors.h"
@@ -44,6 +45,7 @@ limitations under the License.
 #include "tensorflow_serving/servables/tensorflow/servable.h"
 #include "tensorflow_serving/servables/tensorflow/tfrt_get_model_metadata_impl.h"
 #include "tensorflow_serving/servables/tensorflow/tfrt_servable.h"
+#include "tensorflow_serving/util/binary_tensor.h"
 #include "tensorflow_serving/util/json_tensor.h"
 
 namespace tensorflow {
@@ -67,6 +69,19 @@ absl::Status TFRTHttpRestApiHandler::ProcessRequest(
     const absl::string_view request_body,
     std::vector<std::pair<std::string, std::string>>* headers,
     std::string* model_name, std::string* method, std::string* output) {
+  return ProcessRequestWithOutputWriter(
+      http_method, request_path, request_body,
+      [](absl::string_view) { return absl::string_view(); }, headers,
+      model_name, method, [](absl::string_view) {}, output);
+}
+
+absl::Status TFRTHttpRestApiHandler::ProcessRequestWithOutputWriter(
+    const absl::string_view http_method, const absl::string_view request_path,
+    const absl::string_view request_body,
+    const RequestHeaderGetter& request_header,
+    std::vector<std::pair<std::string, std::string>>* headers,
+    std::string* model_name, std::string* method,
+    const OutputWriter& output_writer, std::string* output) {
   headers->clear();
   output->clear();
   AddHeaders(headers);
@@ -96,9 +111,9 @@ absl::Status TFRTHttpRestApiHandler::ProcessRequest(
           ProcessRegressRequest(*model_name, model_version, model_version_label,
                                 request_body, run_options, output);
     } else if (*method == "predict") {
-      status =
-          ProcessPredictRequest(*model_name, model_version, model_version_label,
-                                request_body, run_options, output);
+      status = ProcessPredictRequest(
+          *model_name, model_version, model_version_label, request_body,
+          request_header, run_options, headers, output);
     }
   } else if (http_method == "GET" && parse_successful) {
     if (!model_subresource.empty() && model_subresource == "metadata") {
@@ -165,7 +180,10 @@ absl::Status TFRTHttpRestApiHandler::ProcessPredictRequest(
     const absl::optional<int64_t>& model_version,
     const absl::optional<absl::string_view>& model_version_label,
     const absl::string_view request_body,
-    const Servable::RunOptions& run_options, std::string* output) {
+    const RequestHeaderGetter& request_header,
+    const Servable::RunOptions& run_options,
+    std::vector<std::pair<std::string, std::string>>* headers,
+    std::string* output) {
   ::google::protobuf::Arena arena;
 
   auto* request = ::google::protobuf::Arena::Create<PredictRequest>(&arena);
@@ -173,14 +191,49 @@ absl::Status TFRTHttpRestApiHandler::ProcessPredictRequest(
       model_name, model_version, model_version_label,
       request->mutable_model_spec()));
 
-  JsonPredictRequestFormat format;
-  TF_RETURN_IF_ERROR(FillPredictRequestFromJson(
-      request_body,
-      [this, request](const std::string& sig,
-                      ::google::protobuf::Map<std::string, TensorInfo>* map) {
-        return this->GetInfoMap(request->model_spec(), sig, map);
-      },
-      request, &format));
+  const PredictBodyEncoding request_encoding =
+      GetPredictRequestEncoding(request_header("Content-Type"));
+  const PredictBodyEncoding response_encoding =
+      GetPredictResponseEncoding(request_header("Accept"), request_encoding);
+
+  // The servable takes TensorProtos, so binary tensors are copied into
+  // `tensor_content` (a single memcpy per tensor).
+  JsonPredictRequestFormat format = JsonPredictRequestFormat::kColumnar;
+  switch (request_encoding) {
+    case PredictBodyEncoding::kJson:
+      TF_RETURN_IF_ERROR(FillPredictRequestFromJson(
+          request_body,
+          [this, request](const std::string& sig,
+                          ::google::protobuf::Map<std::string, TensorInfo>* map) {
+            return this->GetInfoMap(request->model_spec(), sig, map);
+          },
+          request, &format));
+      break;
+    case PredictBodyEncoding::kBinaryTensors: {
+      std::string signature_name;
+      std::vector<std::pair<std::string, Tensor>> inputs;
+      TF_RETURN_IF_ERROR(
+          DecodeBinaryTensors(request_body, &signature_name, &inputs));
+      request->mutable_model_spec()->set_signature_name(signature_name);
+      for (const auto& kv : inputs) {
+        kv.second.AsProtoTensorContent(
+            &(*request->mutable_inputs())[kv.first]);
+      }
+      break;
+    }
+    case PredictBodyEncoding::kProtobuf: {
+      // The model is named by the request path, not the proto.
+      auto* body = ::google::protobuf::Arena::Create<PredictRequest>(&arena);
+      if (!body->ParseFromArray(request_body.data(), request_body.size())) {
+        return errors::InvalidArgument("Failed to parse PredictRequest");
+      }
+      request->mutable_model_spec()->set_signature_name(
+          body->model_spec().signature_name());
+      request->mutable_inputs()->swap(*body->mutable_inputs());
+      request->mutable_output_filter()->Swap(body->mutable_output_filter());
+      break;
+    }
+  }
 
   auto* response = ::google::protobuf::Arena::Create<PredictResponse>(&arena);
 
@@ -189,7 +242,34 @@ absl::Status TFRTHttpRestApiHandler::ProcessPredictRequest(
       core_->GetServableHandle(request->model_spec(), &servable));
   TF_RETURN_IF_ERROR(servable->Predict(run_options, *request, response));
 
-  TF_RETURN_IF_ERROR(MakeJsonFromTensors(response->outputs(), format, output));
+  switch (response_encoding) {
+    case PredictBodyEncoding::kJson:
+      TF_RETURN_IF_ERROR(
+          MakeJsonFromTensors(response->outputs(), format, output));
+      break;
+    case PredictBodyEncoding::kBinaryTensors: {
+      std::vector<std::pair<std::string, Tensor>> outputs;
+      for (const auto& kv : response->outputs()) {
+        Tensor tensor;
+        if (!tensor.FromProto(kv.second)) {
+          return errors::Internal("Failed to parse output tensor: ", kv.first);
+        }
+        outputs.emplace_back(kv.first, std::move(tensor));
+      }
+      TF_RETURN_IF_ERROR(EncodeBinaryTensors(
+          request->model_spec().signature_name(), outputs,
+          [output](absl::string_view chunk) {
+            output->append(chunk.data(), chunk.size());
+          }));
+      break;
+    }
+    case PredictBodyEncoding::kProtobuf:
+      if (!response->SerializeToString(output)) {
+        return errors::Internal("Failed to serialize PredictResponse");
+      }
+      break;
+  }
+  SetContentTypeHeader(PredictBodyContentType(response_encoding), headers);
   return absl::Status();
 }
 
@@ -89,6 +89,16 @@ class TFRTHttpRestApiHandler : public HttpRestApiHandlerBase {
                         string* model_name, string* method,
                         string* output) override;
 
+  // Predict request and response bodies may be binary, as selected by the
+  // Content-Type and Accept request headers. All output goes to `output`.
+  Status ProcessRequestWithOutputWriter(
+      const absl::string_view http_method, const absl::string_view request_path,
+      const absl::string_view request_body,
+      const RequestHeaderGetter& request_header,
+      std::vector<std::pair<string, string>>* headers, string* model_name,
+      string* method, const OutputWriter& output_writer,
+      string* output) override;
+
  private:
   Status ProcessClassifyRequest(
       const absl::string_view model_name,
@@ -107,7 +117,9 @@ class TFRTHttpRestApiHandler : public HttpRestApiHandlerBase {
       const absl::optional<int64_t>& model_version,
       const absl::optional<absl::string_view>& model_version_label,
       const absl::string_view request_body,
-      const Servable::RunOptions& run_options, string* output);
+      const RequestHeaderGetter& request_header,
+      const Servable::RunOptions& run_options,
+      std::vector<std::pair<string, string>>* headers, string* output);
   Status ProcessModelStatusRequest(
       const absl::string_view model_name,
       const absl::optional<int64_t>& model_version,
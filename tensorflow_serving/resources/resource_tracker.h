@@ -57,6 +57,8 @@ class ResourceTracker {
   const ResourceAllocation& total_resources() const { return total_resources_; }
   const ResourceAllocation& used_resources() const { return used_resources_; }
 
+  const ResourceUtil& util() const { return *util_; }
+
  private:
   ResourceTracker(const ResourceAllocation& total_resources,
                   std::unique_ptr<ResourceUtil> util);
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow_serving/batching/batching_session.h"
 #include "tensorflow_serving/resources/resource_values.h"
 #include "tensorflow_serving/servables/tensorflow/serving_session.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
 #include "tensorflow_serving/util/proto_util.h"
 
 namespace tensorflow {
@@ -97,6 +98,40 @@ absl::Status EstimateResourceFromPath(const string& path,
                                       estimate);
 }
 
+absl::optional<AdaptiveBatchingController::Options>
+GetAdaptiveBatchingControllerOptions(const BatchingParameters& batching_config) {
+  if (!batching_config.has_adaptive_batching_latency_slo_micros()) {
+    return absl::nullopt;
+  }
+  AdaptiveBatchingController::Options options;
+  options.latency_slo_micros =
+      batching_config.adaptive_batching_latency_slo_micros().value();
+  options.candidate_batch_sizes.assign(
+      batching_config.allowed_batch_sizes().begin(),
+      batching_config.allowed_batch_sizes().end());
+  options.max_batch_size = batching_config.has_max_batch_size()
+                               ? batching_config.max_batch_size().value()
+                               : Batcher::QueueOptions().input_batch_size_limit;
+  // Without an explicit bound, batches may wait as long as the objective
+  // allows.
+  options.max_batch_timeout_micros =
+      batching_config.has_batch_timeout_micros()
+          ? batching_config.batch_timeout_micros().value()
+          : options.latency_slo_micros;
+  if (batching_config.has_thread_pool_name()) {
+    options.name = batching_config.thread_pool_name().value();
+  } else {
+    options.name =
+        DeadlineBatchScheduler<BatchingSessionTask>::Options().thread_pool_name;
+  }
+  return options;
+}
+
+bool UseDeadlineBatchScheduler(const BatchingParameters& batching_config) {
+  return batching_config.enable_deadline_batch_scheduler() ||
+         batching_config.has_adaptive_batching_latency_slo_micros();
+}
+
 absl::Status WrapSessionForBatching(const BatchingParameters& batching_config,
                                     std::shared_ptr<Batcher> batch_scheduler,
                                     const std::vector<SignatureDef>& signatures,
@@ -144,14 +179,32 @@ absl::Status WrapSessionForBatching(const BatchingParameters& batching_config,
   batching_session_options.pad_variable_length_inputs =
       batching_config.pad_variable_length_inputs();
 
-  auto create_queue = [batch_scheduler, queue_options](
-      std::function<void(std::unique_ptr<Batch<BatchingSessionTask>>)>
-          process_batch_callback,
-      std::unique_ptr<BatchScheduler<BatchingSessionTask>>* queue) {
-    TF_RETURN_IF_ERROR(batch_scheduler->AddQueue(
-        queue_options, process_batch_callback, queue));
-    return absl::OkStatus();
-  };
+  BatchingSessionSchedulerCreator create_queue =
+      [batch_scheduler, queue_options](
+          std::function<void(std::unique_ptr<Batch<BatchingSessionTask>>)>
+              process_batch_callback,
+          std::unique_ptr<BatchScheduler<BatchingSessionTask>>* queue) {
+        TF_RETURN_IF_ERROR(batch_scheduler->AddQueue(
+            queue_options, process_batch_callback, queue));
+        return absl::OkStatus();
+      };
+  if (UseDeadlineBatchScheduler(batching_config)) {
+    LOG(INFO) << "Batching the most urgent requests first";
+    if (batching_config.has_adaptive_batching_latency_slo_micros()) {
+      LOG(INFO)
+          << "Adjusting batch size and timeout to a p99 latency of "
+          << batching_config.adaptive_batching_latency_slo_micros().value()
+          << " microseconds";
+    }
+    create_queue =
+        [batching_config](
+            std::function<void(std::unique_ptr<Batch<BatchingSessionTask>>)>
+                process_batch_callback,
+            std::unique_ptr<BatchScheduler<BatchingSessionTask>>* queue) {
+          return CreateDeadlineBatchScheduler<BatchingSessionTask>(
+              batching_config, process_batch_callback, queue);
+        };
+  }
   std::vector<SignatureWithBatchingSessionSchedulerCreator>
       signatures_with_scheduler_creators;
   for (const SignatureDef& signature : signatures) {
@@ -171,6 +224,16 @@ absl::Status WrapSession(std::unique_ptr<Session>* session) {
   return absl::OkStatus();
 }
 
+absl::Status WrapSessionWithExampleParsingSpecs(
+    ExampleParsingSpecMap specs, std::unique_ptr<Session>* session) {
+  if (specs.empty()) {
+    return WrapSession(session);
+  }
+  session->reset(
+      new ExampleParsingSessionWrapper(std::move(*session), std::move(specs)));
+  return absl::OkStatus();
+}
+
 absl::Status WrapSessionIgnoreThreadPoolOptions(
     std::unique_ptr<Session>* session) {
   session->reset(
@@ -19,14 +19,18 @@ limitations under the License.
 #include "google/protobuf/wrappers.pb.h"
 #include "absl/types/optional.h"
 #include "tensorflow/core/kernels/batching_util/shared_batch_scheduler.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/public/session_options.h"
+#include "tensorflow_serving/batching/adaptive_batching_controller.h"
 #include "tensorflow_serving/batching/batching_session.h"
+#include "tensorflow_serving/batching/deadline_batch_scheduler.h"
 #include "tensorflow_serving/resources/resources.pb.h"
 #include "tensorflow_serving/servables/tensorflow/resource_estimator.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
 #include "tensorflow_serving/util/file_probing_env.h"
 
 namespace tensorflow {
@@ -68,6 +72,77 @@ Status CreateBatchScheduler(
   return SharedBatchScheduler<TaskType>::Create(options, batch_scheduler);
 }
 
+// Returns the options of the AdaptiveBatchingController to adjust the batch
+// size and timeout with, if the batching configuration enables adaptive
+// batching (i.e. sets 'adaptive_batching_latency_slo_micros').
+absl::optional<AdaptiveBatchingController::Options>
+GetAdaptiveBatchingControllerOptions(const BatchingParameters& batching_config);
+
+// Returns true if the batching configuration has each signature use a
+// DeadlineBatchScheduler, rather than a queue of the SharedBatchScheduler
+// (i.e. sets 'enable_deadline_batch_scheduler' or enables adaptive batching).
+bool UseDeadlineBatchScheduler(const BatchingParameters& batching_config);
+
+// Creates a DeadlineBatchScheduler based on the batching configuration, used
+// instead of a queue of the SharedBatchScheduler when the configuration
+// enables it. With adaptive batching, its batch size and timeout are adjusted
+// by an AdaptiveBatchingController.
+template <typename TaskType>
+Status CreateDeadlineBatchScheduler(
+    const BatchingParameters& batching_config,
+    std::function<void(std::unique_ptr<Batch<TaskType>>)>
+        process_batch_callback,
+    std::unique_ptr<BatchScheduler<TaskType>>* batch_scheduler) {
+  if (!UseDeadlineBatchScheduler(batching_config)) {
+    return errors::InvalidArgument(
+        "The deadline batch scheduler is not enabled");
+  }
+  typename DeadlineBatchScheduler<TaskType>::Options options;
+  const absl::optional<AdaptiveBatchingController::Options>
+      controller_options =
+          GetAdaptiveBatchingControllerOptions(batching_config);
+  if (controller_options) {
+    std::unique_ptr<AdaptiveBatchingController> controller;
+    TF_RETURN_IF_ERROR(
+        AdaptiveBatchingController::Create(*controller_options, &controller));
+    options.max_batch_size = controller_options->max_batch_size;
+    options.batch_timeout_micros =
+        controller_options->max_batch_timeout_micros;
+    options.thread_pool_name = controller_options->name;
+    options.batching_controller = std::move(controller);
+  } else {
+    options.max_batch_size =
+        batching_config.has_max_batch_size()
+            ? batching_config.max_batch_size().value()
+            : typename SharedBatchScheduler<TaskType>::QueueOptions()
+                  .input_batch_size_limit;
+    if (batching_config.has_batch_timeout_micros()) {
+      options.batch_timeout_micros =
+          batching_config.batch_timeout_micros().value();
+    }
+    if (batching_config.has_thread_pool_name()) {
+      options.thread_pool_name = batching_config.thread_pool_name().value();
+    }
+  }
+  if (batching_config.has_max_enqueued_batches()) {
+    options.max_enqueued_batches =
+        batching_config.max_enqueued_batches().value();
+  }
+  if (batching_config.has_num_batch_threads()) {
+    options.num_batch_threads = batching_config.num_batch_threads().value();
+  }
+  if (batching_config.has_max_queueing_delay_micros()) {
+    options.max_queueing_delay_micros =
+        batching_config.max_queueing_delay_micros().value();
+  }
+
+  std::unique_ptr<DeadlineBatchScheduler<TaskType>> deadline_batch_scheduler;
+  TF_RETURN_IF_ERROR(DeadlineBatchScheduler<TaskType>::Create(
+      options, process_batch_callback, &deadline_batch_scheduler));
+  *batch_scheduler = std::move(deadline_batch_scheduler);
+  return absl::OkStatus();
+}
+
 // Estimates the resources a session bundle or saved model bundle will use once
 // loaded, from infra validation.
 Status EstimateResourceFromValidationResult(const string& path,
@@ -95,6 +170,13 @@ Status WrapSessionForBatching(
 // Wraps a session in a new session that only supports Run() without batching.
 Status WrapSession(std::unique_ptr<Session>* session);
 
+// Same as WrapSession(), except the new session is an
+// ExampleParsingSessionWrapper carrying 'specs' (see GetExampleParsingSpecs()),
+// for requests to it to find with FindExampleParsingSpec() and skip the
+// ParseExample ops of the signatures.
+Status WrapSessionWithExampleParsingSpecs(ExampleParsingSpecMap specs,
+                                          std::unique_ptr<Session>* session);
+
 // Wraps a session in a new session that only supports Run() without threading
 // parameters.
 Status WrapSessionIgnoreThreadPoolOptions(std::unique_ptr<Session>* session);
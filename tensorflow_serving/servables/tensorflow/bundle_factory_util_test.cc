@@ -33,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/public/version.h"
+#include "tensorflow_serving/batching/adaptive_batching_controller.h"
 #include "tensorflow_serving/batching/batching_session.h"
 #include "tensorflow_serving/resources/resources.pb.h"
 #include "tensorflow_serving/servables/tensorflow/bundle_factory_test_util.h"
@@ -156,6 +157,96 @@ TEST_F(BundleFactoryUtilTest, WrapSessionForBatching) {
   test_util::TestMultipleRequests(bundle.session.get(), 10, 2);
 }
 
+TEST_F(BundleFactoryUtilTest, WrapSessionForAdaptiveBatching) {
+  SavedModelBundle bundle;
+  TF_ASSERT_OK(LoadSavedModel(SessionOptions(), RunOptions(), export_dir_,
+                              {"serve"}, &bundle));
+
+  BatchingParameters batching_params;
+  batching_params.mutable_max_batch_size()->set_value(2);
+  batching_params.mutable_max_enqueued_batches()->set_value(INT_MAX);
+  batching_params.mutable_num_batch_threads()->set_value(2);
+  batching_params.mutable_adaptive_batching_latency_slo_micros()->set_value(
+      100 * 1000);
+
+  // The shared batch scheduler is left unused.
+  std::shared_ptr<Batcher> batcher;
+  TF_ASSERT_OK(CreateBatchScheduler(batching_params, &batcher));
+
+  TF_ASSERT_OK(WrapSessionForBatching(batching_params, batcher,
+                                      {test_util::GetTestSessionSignature()},
+                                      &bundle.session));
+
+  test_util::TestMultipleRequests(bundle.session.get(), 10, 2);
+}
+
+TEST_F(BundleFactoryUtilTest, WrapSessionForDeadlineBatching) {
+  SavedModelBundle bundle;
+  TF_ASSERT_OK(LoadSavedModel(SessionOptions(), RunOptions(), export_dir_,
+                              {"serve"}, &bundle));
+
+  BatchingParameters batching_params;
+  batching_params.mutable_max_batch_size()->set_value(2);
+  batching_params.mutable_batch_timeout_micros()->set_value(1000);
+  batching_params.mutable_max_enqueued_batches()->set_value(INT_MAX);
+  batching_params.mutable_num_batch_threads()->set_value(2);
+  batching_params.set_enable_deadline_batch_scheduler(true);
+  batching_params.mutable_max_queueing_delay_micros()->set_value(10 * 1000);
+  EXPECT_TRUE(UseDeadlineBatchScheduler(batching_params));
+
+  // The shared batch scheduler is left unused.
+  std::shared_ptr<Batcher> batcher;
+  TF_ASSERT_OK(CreateBatchScheduler(batching_params, &batcher));
+
+  TF_ASSERT_OK(WrapSessionForBatching(batching_params, batcher,
+                                      {test_util::GetTestSessionSignature()},
+                                      &bundle.session));
+
+  test_util::TestMultipleRequests(bundle.session.get(), 10, 2);
+}
+
+TEST_F(BundleFactoryUtilTest, UseDeadlineBatchScheduler) {
+  BatchingParameters batching_params;
+  EXPECT_FALSE(UseDeadlineBatchScheduler(batching_params));
+  batching_params.mutable_adaptive_batching_latency_slo_micros()->set_value(
+      50 * 1000);
+  EXPECT_TRUE(UseDeadlineBatchScheduler(batching_params));
+
+  // Fails unless enabled.
+  std::unique_ptr<BatchScheduler<BatchingSessionTask>> scheduler;
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      CreateDeadlineBatchScheduler<BatchingSessionTask>(
+          BatchingParameters(),
+          [](std::unique_ptr<Batch<BatchingSessionTask>>) {}, &scheduler)));
+}
+
+TEST_F(BundleFactoryUtilTest, GetAdaptiveBatchingControllerOptions) {
+  BatchingParameters batching_params;
+  batching_params.mutable_max_batch_size()->set_value(8);
+  batching_params.add_allowed_batch_sizes(2);
+  batching_params.add_allowed_batch_sizes(8);
+  EXPECT_FALSE(GetAdaptiveBatchingControllerOptions(batching_params));
+
+  batching_params.mutable_adaptive_batching_latency_slo_micros()->set_value(
+      50 * 1000);
+  absl::optional<AdaptiveBatchingController::Options> options =
+      GetAdaptiveBatchingControllerOptions(batching_params);
+  ASSERT_TRUE(options);
+  EXPECT_EQ(50 * 1000, options->latency_slo_micros);
+  EXPECT_EQ(8, options->max_batch_size);
+  EXPECT_EQ((std::vector<int64_t>{2, 8}), options->candidate_batch_sizes);
+  // Defaults to the objective.
+  EXPECT_EQ(50 * 1000, options->max_batch_timeout_micros);
+  EXPECT_EQ("batch_threads", options->name);
+
+  batching_params.mutable_batch_timeout_micros()->set_value(1000);
+  batching_params.mutable_thread_pool_name()->set_value("model_threads");
+  options = GetAdaptiveBatchingControllerOptions(batching_params);
+  ASSERT_TRUE(options);
+  EXPECT_EQ(1000, options->max_batch_timeout_micros);
+  EXPECT_EQ("model_threads", options->name);
+}
+
 TEST_F(BundleFactoryUtilTest, WrapSessionForBatchingConfigError) {
   BatchingParameters batching_params;
   batching_params.mutable_max_batch_size()->set_value(2);
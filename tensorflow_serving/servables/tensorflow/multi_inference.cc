@@ -90,11 +90,44 @@ absl::Status TensorFlowMultiInferenceRunner::Infer(
   const std::vector<std::string> output_tensor_names(
       output_tensor_name_set.begin(), output_tensor_name_set.end());
 
+  // Feeds the features parsed out of the Examples if the ParseExample ops of
+  // all the signatures can be skipped, and otherwise the serialized Examples.
+  bool parse_examples = true;
+  ExampleParsingSpec parsing_spec;
+  for (const std::string& input_tensor_name : input_tensor_name_set) {
+    const ExampleParsingSpec* input_parsing_spec =
+        FindExampleParsingSpec(session_, input_tensor_name);
+    if (input_parsing_spec == nullptr) {
+      parse_examples = false;
+      break;
+    }
+    parsing_spec.dense_features.insert(
+        parsing_spec.dense_features.end(),
+        input_parsing_spec->dense_features.begin(),
+        input_parsing_spec->dense_features.end());
+    parsing_spec.sparse_features.insert(
+        parsing_spec.sparse_features.end(),
+        input_parsing_spec->sparse_features.begin(),
+        input_parsing_spec->sparse_features.end());
+  }
+
   std::vector<Tensor> outputs;
   int num_examples;
-  TF_RETURN_IF_ERROR(PerformOneShotTensorComputation(
-      run_options, request.input(), input_tensor_name_set, output_tensor_names,
-      session_, &outputs, &num_examples, thread_pool_options_));
+  absl::Status status;
+  if (parse_examples) {
+    status = PerformOneShotTensorComputation(
+        run_options, request.input(), parsing_spec, output_tensor_names,
+        session_, &outputs, &num_examples, thread_pool_options_);
+  }
+  if (!parse_examples || absl::IsNotFound(status) ||
+      absl::IsUnimplemented(status)) {
+    outputs.clear();
+    status = PerformOneShotTensorComputation(
+        run_options, request.input(), input_tensor_name_set,
+        output_tensor_names, session_, &outputs, &num_examples,
+        thread_pool_options_);
+  }
+  TF_RETURN_IF_ERROR(status);
   RecordRequestExampleCount(model_name, num_examples);
 
   TRACELITERAL("PostProcessResults");
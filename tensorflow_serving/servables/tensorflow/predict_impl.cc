@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/strings/substitute.h"
 #include "tensorflow/cc/saved_model/loader.h"
@@ -58,5 +59,25 @@ absl::Status TensorflowPredictor::PredictWithModelSpec(
           : thread_pool_factory_->GetThreadPools().get());
 }
 
+absl::Status TensorflowPredictor::PredictWithTensors(
+    const RunOptions& run_options, ServerCore* core,
+    const PredictRequest& request,
+    const std::vector<std::pair<string, Tensor>>& inputs,
+    std::vector<std::pair<string, Tensor>>* outputs) {
+  if (!request.has_model_spec()) {
+    return absl::Status(
+        static_cast<absl::StatusCode>(absl::StatusCode::kInvalidArgument),
+        "Missing ModelSpec");
+  }
+  ServableHandle<SavedModelBundle> bundle;
+  TF_RETURN_IF_ERROR(core->GetServableHandle(request.model_spec(), &bundle));
+  return internal::RunPredictWithTensors(
+      run_options, bundle->meta_graph_def, bundle->session.get(), request,
+      inputs, outputs,
+      thread_pool_factory_ == nullptr
+          ? thread::ThreadPoolOptions()
+          : thread_pool_factory_->GetThreadPools().get());
+}
+
 }  // namespace serving
 }  // namespace tensorflow
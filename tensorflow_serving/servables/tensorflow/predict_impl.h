@@ -16,6 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_IMPL_H_
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_IMPL_H_
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/protobuf/config.pb.h"
@@ -44,6 +49,15 @@ class TensorflowPredictor {
                               const PredictRequest& request,
                               PredictResponse* response);
 
+  // Like Predict(), but with the inputs supplied as Tensors keyed by signature
+  // alias instead of in `request.inputs()`, and the outputs returned the same
+  // way in `outputs`.
+  Status PredictWithTensors(
+      const RunOptions& run_options, ServerCore* core,
+      const PredictRequest& request,
+      const std::vector<std::pair<string, Tensor>>& inputs,
+      std::vector<std::pair<string, Tensor>>* outputs);
+
  private:
   ThreadPoolFactory* thread_pool_factory_ = nullptr;
 };
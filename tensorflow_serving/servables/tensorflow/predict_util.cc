@@ -48,12 +48,12 @@ absl::Status VerifySignature(const SignatureDef& signature) {
   return absl::OkStatus();
 }
 
-absl::Status VerifyRequestInputsSize(const SignatureDef& signature,
-                                     const PredictRequest& request) {
-  if (request.inputs().size() > signature.inputs().size() ||
-      (request.inputs().size() < signature.inputs().size() &&
+absl::Status VerifyRequestInputsSize(
+    const SignatureDef& signature,
+    const std::set<std::string>& request_inputs) {
+  if (request_inputs.size() > signature.inputs().size() ||
+      (request_inputs.size() < signature.inputs().size() &&
        signature.defaults().empty())) {
-    const std::set<std::string> request_inputs = GetMapKeys(request.inputs());
     const std::set<std::string> signature_inputs =
         GetMapKeys(signature.inputs());
     const std::set<std::string> sent_extra =
@@ -63,7 +63,7 @@ absl::Status VerifyRequestInputsSize(const SignatureDef& signature,
     return absl::Status(
         static_cast<absl::StatusCode>(absl::StatusCode::kInvalidArgument),
         absl::StrCat(
-            "input size does not match signature: ", request.inputs().size(),
+            "input size does not match signature: ", request_inputs.size(),
             "!=", signature.inputs().size(), " len({",
             absl::StrJoin(request_inputs, ","), "}) != len({",
             absl::StrJoin(signature_inputs, ","), "}). Sent extra: {",
@@ -73,62 +73,54 @@ absl::Status VerifyRequestInputsSize(const SignatureDef& signature,
   return absl::OkStatus();
 }
 
-}  // namespace
-
-namespace internal {
-absl::Status RunPredict(
-    const RunOptions& run_options, const MetaGraphDef& meta_graph_def,
-    const absl::optional<int64_t>& servable_version,
-    const internal::PredictResponseTensorSerializationOption option,
-    Session* session, const PredictRequest& request, PredictResponse* response,
-    const thread::ThreadPoolOptions& thread_pool_options) {
-  // Validate signatures.
-  const std::string signature_name =
-      request.model_spec().signature_name().empty()
-          ? kDefaultServingSignatureDefKey
-          : request.model_spec().signature_name();
-  auto iter = meta_graph_def.signature_def().find(signature_name);
-  if (iter == meta_graph_def.signature_def().end()) {
-    return absl::FailedPreconditionError(absl::StrCat(
-        "Serving signature key \"", signature_name, "\" not found."));
+// Maps the aliased input Tensors to the tensor names of `signature`, filling in
+// defaults for inputs that are not supplied. Mirrors
+// saved_model::GetInputValues(), which does the same for TensorProtos.
+absl::Status GetInputTensors(
+    const SignatureDef& signature,
+    const std::vector<std::pair<std::string, Tensor>>& aliased_inputs,
+    std::vector<std::pair<std::string, Tensor>>* inputs) {
+  std::map<std::string, const Tensor*> request_inputs;
+  for (const auto& kv : aliased_inputs) {
+    request_inputs.emplace(kv.first, &kv.second);
   }
-  const SignatureDef& signature = iter->second;
-
-  MakeModelSpec(request.model_spec().name(), signature_name, servable_version,
-                response->mutable_model_spec());
-
-  std::vector<std::pair<std::string, Tensor>> input_tensors;
-  std::vector<std::string> output_tensor_names;
-  std::vector<std::string> output_tensor_aliases;
-  TF_RETURN_IF_ERROR(PreProcessPrediction(signature, request, &input_tensors,
-                                          &output_tensor_names,
-                                          &output_tensor_aliases));
-  std::vector<Tensor> outputs;
-  RunMetadata run_metadata;
-  const uint64_t start_microseconds = EnvTime::NowMicros();
-  TF_RETURN_IF_ERROR(session->Run(run_options, input_tensors,
-                                  output_tensor_names, {}, &outputs,
-                                  &run_metadata, thread_pool_options));
-  const uint64_t end_microseconds = EnvTime::NowMicros();
-  RecordRuntimeLatency(request.model_spec().name(), /*api=*/"Predict",
-                       /*runtime=*/"TF1",
-                       end_microseconds - start_microseconds);
-
-  return PostProcessPredictionResult(output_tensor_aliases, outputs, option,
-                                     response);
+  size_t num_seen_request_inputs = 0;
+  for (const auto& kv : signature.inputs()) {
+    const std::string& alias = kv.first;
+    const std::string& feed_name = kv.second.name();
+    auto iter = request_inputs.find(alias);
+    if (iter != request_inputs.end()) {
+      inputs->emplace_back(feed_name, *iter->second);
+      num_seen_request_inputs++;
+      continue;
+    }
+    auto default_iter = signature.defaults().find(alias);
+    if (default_iter == signature.defaults().end()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Request inputs do not include required input: ", alias));
+    }
+    Tensor tensor;
+    if (!tensor.FromProto(default_iter->second)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("tensor parsing error: ", alias));
+    }
+    inputs->emplace_back(feed_name, std::move(tensor));
+  }
+  if (num_seen_request_inputs != request_inputs.size()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Inputs contains invalid name. Used request inputs: ",
+        num_seen_request_inputs, ", request input size: ",
+        request_inputs.size()));
+  }
+  return absl::OkStatus();
 }
 
-absl::Status PreProcessPrediction(
+// Populates the output tensor names and aliases to fetch, as selected by
+// `request.output_filter()`.
+absl::Status GetOutputTensorNames(
     const SignatureDef& signature, const PredictRequest& request,
-    std::vector<std::pair<std::string, Tensor>>* inputs,
     std::vector<std::string>* output_tensor_names,
     std::vector<std::string>* output_tensor_aliases) {
-  TF_RETURN_IF_ERROR(VerifySignature(signature));
-  TF_RETURN_IF_ERROR(VerifyRequestInputsSize(signature, request));
-  TF_RETURN_IF_ERROR(
-      saved_model::GetInputValues(signature, request.inputs(), *inputs));
-
-  // Prepare run target.
   std::set<std::string> seen_outputs;
   std::vector<std::string> output_filter(request.output_filter().begin(),
                                          request.output_filter().end());
@@ -162,6 +154,134 @@ absl::Status PreProcessPrediction(
   return absl::OkStatus();
 }
 
+// Returns the signature requested by `request`, or the default serving
+// signature if none is named.
+std::string GetSignatureName(const PredictRequest& request) {
+  return request.model_spec().signature_name().empty()
+             ? kDefaultServingSignatureDefKey
+             : request.model_spec().signature_name();
+}
+
+// Shared implementation of internal::RunPredict() and
+// internal::RunPredictWithTensors(). Inputs are taken from `aliased_inputs` if
+// not null, and from `request.inputs()` otherwise. On success
+// `output_tensor_aliases` and `outputs` hold the fetched outputs.
+absl::Status RunPredictImpl(
+    const RunOptions& run_options, const MetaGraphDef& meta_graph_def,
+    Session* session, const PredictRequest& request,
+    const std::vector<std::pair<std::string, Tensor>>* aliased_inputs,
+    std::vector<std::string>* output_tensor_aliases,
+    std::vector<Tensor>* outputs,
+    const thread::ThreadPoolOptions& thread_pool_options) {
+  // Validate signatures.
+  const std::string signature_name = GetSignatureName(request);
+  auto iter = meta_graph_def.signature_def().find(signature_name);
+  if (iter == meta_graph_def.signature_def().end()) {
+    return absl::FailedPreconditionError(absl::StrCat(
+        "Serving signature key \"", signature_name, "\" not found."));
+  }
+  const SignatureDef& signature = iter->second;
+
+  std::vector<std::pair<std::string, Tensor>> input_tensors;
+  std::vector<std::string> output_tensor_names;
+  if (aliased_inputs == nullptr) {
+    TF_RETURN_IF_ERROR(internal::PreProcessPrediction(
+        signature, request, &input_tensors, &output_tensor_names,
+        output_tensor_aliases));
+  } else {
+    TF_RETURN_IF_ERROR(internal::PreProcessPredictionWithInputTensors(
+        signature, request, *aliased_inputs, &input_tensors,
+        &output_tensor_names, output_tensor_aliases));
+  }
+  RunMetadata run_metadata;
+  const uint64_t start_microseconds = EnvTime::NowMicros();
+  TF_RETURN_IF_ERROR(session->Run(run_options, input_tensors,
+                                  output_tensor_names, {}, outputs,
+                                  &run_metadata, thread_pool_options));
+  const uint64_t end_microseconds = EnvTime::NowMicros();
+  RecordRuntimeLatency(request.model_spec().name(), /*api=*/"Predict",
+                       /*runtime=*/"TF1",
+                       end_microseconds - start_microseconds);
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+namespace internal {
+absl::Status RunPredict(
+    const RunOptions& run_options, const MetaGraphDef& meta_graph_def,
+    const absl::optional<int64_t>& servable_version,
+    const internal::PredictResponseTensorSerializationOption option,
+    Session* session, const PredictRequest& request, PredictResponse* response,
+    const thread::ThreadPoolOptions& thread_pool_options) {
+  MakeModelSpec(request.model_spec().name(), GetSignatureName(request),
+                servable_version, response->mutable_model_spec());
+
+  std::vector<std::string> output_tensor_aliases;
+  std::vector<Tensor> outputs;
+  TF_RETURN_IF_ERROR(RunPredictImpl(
+      run_options, meta_graph_def, session, request,
+      /*aliased_inputs=*/nullptr, &output_tensor_aliases, &outputs,
+      thread_pool_options));
+  return internal::PostProcessPredictionResult(output_tensor_aliases, outputs,
+                                               option, response);
+}
+
+absl::Status RunPredictWithTensors(
+    const RunOptions& run_options, const MetaGraphDef& meta_graph_def,
+    Session* session, const PredictRequest& request,
+    const std::vector<std::pair<std::string, Tensor>>& aliased_inputs,
+    std::vector<std::pair<std::string, Tensor>>* aliased_outputs,
+    const thread::ThreadPoolOptions& thread_pool_options) {
+  std::vector<std::string> output_tensor_aliases;
+  std::vector<Tensor> outputs;
+  TF_RETURN_IF_ERROR(RunPredictImpl(run_options, meta_graph_def, session,
+                                    request, &aliased_inputs,
+                                    &output_tensor_aliases, &outputs,
+                                    thread_pool_options));
+  if (outputs.size() != output_tensor_aliases.size()) {
+    return absl::Status(
+        static_cast<absl::StatusCode>(absl::StatusCode::kUnknown),
+        "Predict internal error");
+  }
+  aliased_outputs->clear();
+  aliased_outputs->reserve(outputs.size());
+  for (int i = 0; i < outputs.size(); i++) {
+    aliased_outputs->emplace_back(std::move(output_tensor_aliases[i]),
+                                  std::move(outputs[i]));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status PreProcessPrediction(
+    const SignatureDef& signature, const PredictRequest& request,
+    std::vector<std::pair<std::string, Tensor>>* inputs,
+    std::vector<std::string>* output_tensor_names,
+    std::vector<std::string>* output_tensor_aliases) {
+  TF_RETURN_IF_ERROR(VerifySignature(signature));
+  TF_RETURN_IF_ERROR(
+      VerifyRequestInputsSize(signature, GetMapKeys(request.inputs())));
+  TF_RETURN_IF_ERROR(
+      saved_model::GetInputValues(signature, request.inputs(), *inputs));
+  return GetOutputTensorNames(signature, request, output_tensor_names,
+                              output_tensor_aliases);
+}
+
+absl::Status PreProcessPredictionWithInputTensors(
+    const SignatureDef& signature, const PredictRequest& request,
+    const std::vector<std::pair<std::string, Tensor>>& aliased_inputs,
+    std::vector<std::pair<std::string, Tensor>>* inputs,
+    std::vector<std::string>* output_tensor_names,
+    std::vector<std::string>* output_tensor_aliases) {
+  TF_RETURN_IF_ERROR(VerifySignature(signature));
+  std::set<std::string> request_inputs;
+  for (const auto& kv : aliased_inputs) request_inputs.insert(kv.first);
+  TF_RETURN_IF_ERROR(VerifyRequestInputsSize(signature, request_inputs));
+  TF_RETURN_IF_ERROR(GetInputTensors(signature, aliased_inputs, inputs));
+  return GetOutputTensorNames(signature, request, output_tensor_names,
+                              output_tensor_aliases);
+}
+
 absl::Status PostProcessPredictionResult(
     const std::vector<std::string>& output_tensor_aliases,
     const std::vector<Tensor>& output_tensors,
@@ -16,6 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_UTIL_H_
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_UTIL_H_
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "absl/types/optional.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/threadpool_options.h"
@@ -40,6 +44,20 @@ Status RunPredict(
     const thread::ThreadPoolOptions& thread_pool_options =
         thread::ThreadPoolOptions());
 
+// Similar to RunPredict above, but the inputs are supplied as Tensors keyed by
+// signature alias instead of as TensorProtos in `request.inputs()` (which is
+// ignored), and the outputs are returned the same way in `aliased_outputs`
+// instead of being serialized into a PredictResponse. Lets callers that work
+// with Tensors directly, such as the REST API handler, skip the TensorProto
+// round trip in both directions.
+Status RunPredictWithTensors(
+    const RunOptions& run_options, const MetaGraphDef& meta_graph_def,
+    Session* session, const PredictRequest& request,
+    const std::vector<std::pair<string, Tensor>>& aliased_inputs,
+    std::vector<std::pair<string, Tensor>>* aliased_outputs,
+    const thread::ThreadPoolOptions& thread_pool_options =
+        thread::ThreadPoolOptions());
+
 // Validate a SignatureDef to make sure it's compatible with prediction, and
 // if so, populate the input and output tensor names.
 Status PreProcessPrediction(const SignatureDef& signature,
@@ -48,6 +66,15 @@ Status PreProcessPrediction(const SignatureDef& signature,
                             std::vector<string>* output_tensor_names,
                             std::vector<string>* output_tensor_aliases);
 
+// Like PreProcessPrediction above, but the inputs are taken from
+// `aliased_inputs` (keyed by signature alias) instead of `request.inputs()`.
+Status PreProcessPredictionWithInputTensors(
+    const SignatureDef& signature, const PredictRequest& request,
+    const std::vector<std::pair<string, Tensor>>& aliased_inputs,
+    std::vector<std::pair<string, Tensor>>* inputs,
+    std::vector<string>* output_tensor_names,
+    std::vector<string>* output_tensor_aliases);
+
 // Validate results and populate a PredictResponse.
 // Tensors are serialized as specified.
 Status PostProcessPredictionResult(
@@ -24,6 +24,7 @@ limitations under the License.
 #include "absl/strings/str_cat.h"
 #include "tensorflow/cc/saved_model/loader.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/threadpool_options.h"
 #include "tensorflow_serving/core/availability_preserving_policy.h"
@@ -373,6 +374,36 @@ TEST_F(PredictImplTest, PredictionSuccess) {
   EXPECT_THAT(response, test_util::EqualsProto(expected_response));
 }
 
+TEST_F(PredictImplTest, PredictionWithTensorsSuccess) {
+  PredictRequest request;
+
+  ModelSpec* model_spec = request.mutable_model_spec();
+  model_spec->set_name(kTestModelName);
+  model_spec->mutable_version()->set_value(kTestModelVersion);
+
+  ServableHandle<SavedModelBundle> bundle;
+  TF_ASSERT_OK(GetSavedModelServableHandle(GetServerCore(), &bundle));
+  const std::vector<std::pair<std::string, Tensor>> inputs = {
+      {kInputTensorKey, test::AsScalar<float>(2.0)}};
+  std::vector<std::pair<std::string, Tensor>> outputs;
+  TF_EXPECT_OK(internal::RunPredictWithTensors(
+      GetRunOptions(), bundle->meta_graph_def, bundle->session.get(), request,
+      inputs, &outputs));
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_EQ(outputs[0].first, kOutputTensorKey);
+  test::ExpectTensorEqual<float>(outputs[0].second, test::AsScalar<float>(3));
+
+  // Unknown aliases are rejected the same way as for TensorProto inputs.
+  const std::vector<std::pair<std::string, Tensor>> bad_inputs = {
+      {"unknown_key", test::AsScalar<float>(2.0)}};
+  const absl::Status status = internal::RunPredictWithTensors(
+      GetRunOptions(), bundle->meta_graph_def, bundle->session.get(), request,
+      bad_inputs, &outputs);
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_THAT(status.message(),
+              ::testing::HasSubstr("Sent extra: {unknown_key}"));
+}
+
 // Test querying a model with a named regression signature (not default). This
 TEST_F(PredictImplTest, PredictionWithNamedRegressionSignature) {
   PredictRequest request;
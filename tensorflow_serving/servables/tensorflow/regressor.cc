@@ -70,10 +70,26 @@ class SavedModelTensorFlowRegressor : public RegressorInterface {
     std::vector<Tensor> outputs;
     int num_examples;
     int64_t runtime_latency;
-    TF_RETURN_IF_ERROR(PerformOneShotTensorComputation(
-        run_options_, request.input(), input_tensor_name, output_tensor_names,
-        session_, &outputs, &num_examples, thread_pool_options_,
-        &runtime_latency));
+    // Feeds the features parsed out of the Examples if the ParseExample op of
+    // the signature can be skipped, and otherwise the serialized Examples.
+    const ExampleParsingSpec* parsing_spec =
+        FindExampleParsingSpec(session_, input_tensor_name);
+    absl::Status status;
+    if (parsing_spec != nullptr) {
+      status = PerformOneShotTensorComputation(
+          run_options_, request.input(), *parsing_spec, output_tensor_names,
+          session_, &outputs, &num_examples, thread_pool_options_,
+          &runtime_latency);
+    }
+    if (parsing_spec == nullptr || absl::IsNotFound(status) ||
+        absl::IsUnimplemented(status)) {
+      outputs.clear();
+      status = PerformOneShotTensorComputation(
+          run_options_, request.input(), input_tensor_name,
+          output_tensor_names, session_, &outputs, &num_examples,
+          thread_pool_options_, &runtime_latency);
+    }
+    TF_RETURN_IF_ERROR(status);
     RecordRuntimeLatency(request.model_spec().name(), /*api=*/"Regress",
                          /*runtime=*/"TF1", runtime_latency);
 
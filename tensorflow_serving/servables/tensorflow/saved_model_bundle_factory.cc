@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/saved_model_bundle_factory.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <unordered_set>
 #include <utility>
@@ -30,11 +32,19 @@ limitations under the License.
 #include "tensorflow/core/protobuf/named_tensor.pb.h"
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
 #include "tensorflow/core/public/session_options.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/api/flatbuffer_conversions.h"
+#include "tensorflow/lite/model.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow_serving/resources/resource_values.h"
 #include "tensorflow_serving/servables/tensorflow/bundle_factory_util.h"
 #include "tensorflow_serving/servables/tensorflow/saved_model_config.pb.h"
 #include "tensorflow_serving/servables/tensorflow/saved_model_config_util.h"
+#include "tensorflow_serving/servables/tensorflow/saved_model_mapped_variables.h"
 #include "tensorflow_serving/servables/tensorflow/tflite_session.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
 #include "tensorflow_serving/session_bundle/session_bundle_util.h"
+#include "tensorflow_serving/util/file_probing_env.h"
 
 namespace tensorflow {
 namespace serving {
@@ -58,10 +68,33 @@ absl::Status LoadTfLiteModel(const std::string& model_dir,
                              SavedModelBundle* bundle,
                              const SessionOptions& options,
                              int num_interpreter_pools,
-                             int num_interpreters_per_pool) {
-  std::unique_ptr<TfLiteSession> session;
-
+                             int num_interpreters_per_pool,
+                             const std::vector<int>& allowed_batch_sizes,
+                             bool zero_copy_io,
+                             const TfLiteDelegateConfig& delegate_config) {
   const std::string& fname = io::JoinPath(model_dir, kTfLiteModelFilename);
+  std::unique_ptr<TfLiteSession> tflite_session;
+
+  // Map the model rather than reading it, so that its pages are loaded
+  // lazily, and can be reclaimed under memory pressure, e.g. while two
+  // versions of a large model are loaded.
+  std::unique_ptr<ReadOnlyMemoryRegion> model_region;
+  const absl::Status status =
+      Env::Default()->NewReadOnlyMemoryRegionFromFile(fname, &model_region);
+  if (status.ok()) {
+    TF_RETURN_IF_ERROR(TfLiteSession::Create(
+        std::move(model_region), options, num_interpreter_pools,
+        num_interpreters_per_pool, allowed_batch_sizes, zero_copy_io,
+        delegate_config, &tflite_session,
+        bundle->meta_graph_def.mutable_signature_def()));
+    bundle->session = std::move(tflite_session);
+    return absl::OkStatus();
+  }
+  if (!errors::IsUnimplemented(status)) {
+    return status;
+  }
+
+  // The file system doesn't support mapping files.
   uint64_t size;
   TF_RETURN_IF_ERROR(Env::Default()->GetFileSize(fname, &size));
 
@@ -73,10 +106,10 @@ absl::Status LoadTfLiteModel(const std::string& model_dir,
   absl::string_view sv;
   TF_RETURN_IF_ERROR(file->Read(0, sv, absl::MakeSpan(&model_bytes[0], size)));
 
-  std::unique_ptr<TfLiteSession> tflite_session;
   TF_RETURN_IF_ERROR(TfLiteSession::Create(
       std::move(model_bytes), options, num_interpreter_pools,
-      num_interpreters_per_pool, &tflite_session,
+      num_interpreters_per_pool, allowed_batch_sizes, zero_copy_io,
+      delegate_config, &tflite_session,
       bundle->meta_graph_def.mutable_signature_def()));
   bundle->session = std::move(tflite_session);
   return absl::OkStatus();
@@ -87,6 +120,212 @@ bool TfLiteModelFound(const std::string& model_dir) {
   return Env::Default()->FilesExist({fname}, nullptr);
 }
 
+int NumTfLitePools(const SessionBundleConfig& config) {
+  if (config.num_tflite_pools() == 0 && config.num_tflite_interpreters() > 0) {
+    return config.num_tflite_interpreters();
+  }
+  return config.num_tflite_pools();
+}
+
+// Batches are padded to the allowed batch sizes, so TfLiteSession plans
+// interpreters for them.
+std::vector<int> TfLitePlannedBatchSizes(const SessionBundleConfig& config) {
+  std::vector<int> planned_batch_sizes;
+  if (config.has_batching_parameters()) {
+    planned_batch_sizes.assign(
+        config.batching_parameters().allowed_batch_sizes().begin(),
+        config.batching_parameters().allowed_batch_sizes().end());
+  }
+  return planned_batch_sizes;
+}
+
+// Returns the first dimension of the first input of the model, which
+// interpreters planned for a batch size resize the first dimension of all the
+// inputs to, or 0 if there is none.
+int GetTfLiteModelBatchSize(const tflite::Model& model) {
+  if (model.subgraphs() == nullptr || model.subgraphs()->size() == 0) {
+    return 0;
+  }
+  const auto* primary_subgraph = model.subgraphs()->Get(0);
+  if (primary_subgraph->inputs() == nullptr ||
+      primary_subgraph->inputs()->size() == 0 ||
+      primary_subgraph->tensors() == nullptr) {
+    return 0;
+  }
+  const auto* shape =
+      primary_subgraph->tensors()->Get(primary_subgraph->inputs()->Get(0))
+          ->shape();
+  return shape == nullptr || shape->size() == 0 ? 0 : shape->Get(0);
+}
+
+// Returns the number of bytes of 'tensor' at batch size 'batch_size', if it
+// carries the batch of the model, i.e. its first dimension is the one of the
+// batched inputs of the model, 'model_batch_size', or at its shape in the
+// model otherwise. Unknown dimensions count as 1.
+uint64_t TfLiteTensorBytes(const tflite::Tensor& tensor,
+                           const int model_batch_size, const int batch_size,
+                           tflite::ErrorReporter* error_reporter) {
+  TfLiteType type;
+  if (tflite::ConvertTensorType(tensor.type(), &type, error_reporter) !=
+      kTfLiteOk) {
+    return 0;
+  }
+  uint64_t bytes = TfLiteTypeGetSize(type);
+  if (tensor.shape() == nullptr) {
+    return bytes;
+  }
+  for (int i = 0; i < tensor.shape()->size(); ++i) {
+    const int32_t dim = tensor.shape()->Get(i);
+    const bool batched = i == 0 && batch_size > 0 && model_batch_size > 0 &&
+                         dim == model_batch_size;
+    bytes *= batched ? batch_size : std::max(dim, 1);
+  }
+  return bytes;
+}
+
+// Returns the largest number of bytes of the non-constant tensors of
+// 'subgraph' which are live at the same time, which the arena planner of an
+// interpreter packs its arena into, at the batch size 'batch_size' if it is
+// positive. A tensor is live from the first operator which uses it to the
+// last one, or throughout if it is an input, output or variable.
+uint64_t MaxLiveTfLiteTensorBytes(const tflite::Model& model,
+                                  const tflite::SubGraph& subgraph,
+                                  const int model_batch_size,
+                                  const int batch_size,
+                                  tflite::ErrorReporter* error_reporter) {
+  if (subgraph.tensors() == nullptr) {
+    return 0;
+  }
+  const int num_tensors = subgraph.tensors()->size();
+  const int num_steps =
+      std::max<int>(1, subgraph.operators() ? subgraph.operators()->size() : 0);
+  std::vector<int> first_use(num_tensors, num_steps);
+  std::vector<int> last_use(num_tensors, -1);
+  const auto use = [&](const flatbuffers::Vector<int32_t>* tensors,
+                       const int first, const int last) {
+    if (tensors == nullptr) {
+      return;
+    }
+    for (const int32_t idx : *tensors) {
+      if (idx >= 0 && idx < num_tensors) {
+        first_use[idx] = std::min(first_use[idx], first);
+        last_use[idx] = std::max(last_use[idx], last);
+      }
+    }
+  };
+  use(subgraph.inputs(), 0, num_steps - 1);
+  use(subgraph.outputs(), 0, num_steps - 1);
+  if (subgraph.operators() != nullptr) {
+    for (int step = 0; step < subgraph.operators()->size(); ++step) {
+      const auto* op = subgraph.operators()->Get(step);
+      use(op->inputs(), step, step);
+      use(op->outputs(), step, step);
+      use(op->intermediates(), step, step);
+    }
+  }
+
+  const auto* buffers = model.buffers();
+  std::vector<int64_t> live_bytes_delta(num_steps + 1, 0);
+  for (int idx = 0; idx < num_tensors; ++idx) {
+    const auto* tensor = subgraph.tensors()->Get(idx);
+    if (buffers != nullptr && tensor->buffer() < buffers->size()) {
+      const auto* buffer = buffers->Get(tensor->buffer());
+      if (buffer->data() != nullptr && buffer->data()->size() > 0) {
+        // Constant, in the model.
+        continue;
+      }
+    }
+    if (tensor->is_variable()) {
+      first_use[idx] = 0;
+      last_use[idx] = num_steps - 1;
+    }
+    if (last_use[idx] < first_use[idx]) {
+      continue;
+    }
+    const uint64_t bytes = TfLiteTensorBytes(*tensor, model_batch_size,
+                                             batch_size, error_reporter);
+    live_bytes_delta[first_use[idx]] += bytes;
+    live_bytes_delta[last_use[idx] + 1] -= bytes;
+  }
+  int64_t live_bytes = 0;
+  int64_t max_live_bytes = 0;
+  for (int step = 0; step < num_steps; ++step) {
+    live_bytes += live_bytes_delta[step];
+    max_live_bytes = std::max(max_live_bytes, live_bytes);
+  }
+  return max_live_bytes;
+}
+
+// Estimates the main memory taken by a TfLiteSession of the model in 'fname'.
+// The model is mapped, so its constant tensors, which all interpreters share,
+// only count if the file system can't map it and it is read instead. Each
+// interpreter has an arena for the other tensors of each subgraph, about as
+// large as the most bytes of them live at once, at the batch size of the
+// model or the one the interpreter is planned for. XNNPACK delegates also
+// pack the weights, once per interpreter unless they share a weights cache.
+absl::Status EstimateTfLiteRamBytes(const std::string& fname,
+                                    const SessionBundleConfig& config,
+                                    uint64_t* ram_bytes) {
+  uint64_t model_bytes;
+  TF_RETURN_IF_ERROR(Env::Default()->GetFileSize(fname, &model_bytes));
+  std::unique_ptr<ReadOnlyMemoryRegion> model_region;
+  const absl::Status map_status =
+      Env::Default()->NewReadOnlyMemoryRegionFromFile(fname, &model_region);
+  if (!map_status.ok() && !errors::IsUnimplemented(map_status)) {
+    return map_status;
+  }
+  std::string model_buffer;
+  if (!map_status.ok()) {
+    TF_RETURN_IF_ERROR(
+        ReadFileToString(Env::Default(), fname, &model_buffer));
+  }
+  const auto model =
+      map_status.ok()
+          ? tflite::FlatBufferModel::BuildFromBuffer(
+                static_cast<const char*>(model_region->data()),
+                model_region->length())
+          : tflite::FlatBufferModel::BuildFromBuffer(model_buffer.data(),
+                                                     model_buffer.size());
+  if (model == nullptr) {
+    return errors::InvalidArgument("Cannot build FlatBufferModel from ",
+                                   fname);
+  }
+  const tflite::Model* const flatbuffer = model->GetModel();
+  const int model_batch_size = GetTfLiteModelBatchSize(*flatbuffer);
+  auto arena_bytes = [&](const int batch_size) {
+    uint64_t bytes = 0;
+    if (flatbuffer->subgraphs() == nullptr) {
+      return bytes;
+    }
+    for (const auto* subgraph : *flatbuffer->subgraphs()) {
+      bytes += MaxLiveTfLiteTensorBytes(*flatbuffer, *subgraph,
+                                        model_batch_size, batch_size,
+                                        model->error_reporter());
+    }
+    return bytes;
+  };
+
+  const std::vector<int> planned_batch_sizes = TfLitePlannedBatchSizes(config);
+  // Each pool has this many interpreters, each with its own arena.
+  const uint64_t num_pools = std::max(1, NumTfLitePools(config));
+  const uint64_t num_interpreters =
+      num_pools * (1 + planned_batch_sizes.size());
+  uint64_t total_arena_bytes = num_pools * arena_bytes(/*batch_size=*/0);
+  for (const int batch_size : planned_batch_sizes) {
+    total_arena_bytes += num_pools * arena_bytes(std::max(batch_size, 1));
+  }
+  uint64_t packed_weights_bytes = 0;
+  if (config.tflite_delegate_config().has_xnnpack()) {
+    packed_weights_bytes =
+        config.tflite_delegate_config().xnnpack().enable_weights_cache()
+            ? model_bytes
+            : num_interpreters * model_bytes;
+  }
+  const uint64_t read_model_bytes = map_status.ok() ? 0 : model_bytes;
+  *ram_bytes = read_model_bytes + total_arena_bytes + packed_weights_bytes;
+  return absl::OkStatus();
+}
+
 }  // namespace
 
 absl::Status SavedModelBundleFactory::Create(
@@ -103,6 +342,38 @@ absl::Status SavedModelBundleFactory::Create(
 
 absl::Status SavedModelBundleFactory::EstimateResourceRequirement(
     const std::string& path, ResourceAllocation* estimate) const {
+  if (config_.prefer_tflite_model() && TfLiteModelFound(path)) {
+    if (config_.resource_estimation_uses_validation_result()) {
+      ResourceAllocation validation_estimate;
+      if (EstimateResourceFromValidationResult(path, &validation_estimate)
+              .ok()) {
+        *estimate = std::move(validation_estimate);
+        return absl::OkStatus();
+      }
+    }
+    uint64_t ram_bytes;
+    TF_RETURN_IF_ERROR(EstimateTfLiteRamBytes(
+        io::JoinPath(path, kTfLiteModelFilename), config_, &ram_bytes));
+    ResourceAllocation::Entry* ram_entry = estimate->add_resource_quantities();
+    Resource* ram_resource = ram_entry->mutable_resource();
+    ram_resource->set_device(device_types::kMain);
+    ram_resource->set_kind(resource_kinds::kRamBytes);
+    ram_entry->set_quantity(ram_bytes);
+    return absl::OkStatus();
+  }
+  if (config_.enable_mapped_variables()) {
+    if (config_.resource_estimation_uses_validation_result()) {
+      ResourceAllocation validation_estimate;
+      if (EstimateResourceFromValidationResult(path, &validation_estimate)
+              .ok()) {
+        *estimate = std::move(validation_estimate);
+        return absl::OkStatus();
+      }
+    }
+    TensorflowFileProbingEnv env(Env::Default());
+    return EstimateResourceFromPathUsingDiskState(
+        path, &env, /*map_variables=*/true, estimate);
+  }
   return EstimateResourceFromPath(
       path, config_.resource_estimation_uses_validation_result(), estimate);
 }
@@ -167,18 +438,27 @@ absl::Status SavedModelBundleFactory::InternalCreateSavedModelBundle(
   }();
 
   if (is_tflite) {
-    int num_tflite_pools = config_.num_tflite_pools();
-    if (num_tflite_pools == 0 && config_.num_tflite_interpreters() > 0) {
-      num_tflite_pools = config_.num_tflite_interpreters();
-    }
-    TF_RETURN_IF_ERROR(
-        LoadTfLiteModel(path, bundle->get(), session_options, num_tflite_pools,
-                        config_.num_tflite_interpreters_per_pool()));
+    TF_RETURN_IF_ERROR(LoadTfLiteModel(
+        path, bundle->get(), session_options, NumTfLitePools(config_),
+        config_.num_tflite_interpreters_per_pool(),
+        TfLitePlannedBatchSizes(config_), config_.enable_tflite_zero_copy_io(),
+        config_.tflite_delegate_config()));
+  } else if (config_.enable_mapped_variables()) {
+    TF_RETURN_IF_ERROR(LoadSavedModelWithMappedVariables(
+        session_options, GetRunOptions(config_), path, saved_model_tags,
+        bundle->get()));
   } else {
     TF_RETURN_IF_ERROR(session_bundle::LoadSessionBundleOrSavedModelBundle(
         session_options, GetRunOptions(config_), path, saved_model_tags,
         config_.enable_saved_model_config(), bundle->get()));
   }
+  // Gets the parsing specs of the signatures while the graph is still there.
+  // Only sessions which neither batch requests nor run TFLite models use them,
+  // as those have to be fed the inputs of the signatures.
+  ExampleParsingSpecMap example_parsing_specs;
+  if (config_.enable_example_parsing_fusion() && !is_tflite) {
+    example_parsing_specs = GetExampleParsingSpecs((*bundle)->meta_graph_def);
+  }
   if (config_.remove_unused_fields_from_bundle_metagraph()) {
     // Save memory by removing fields in MetaGraphDef proto message stored
     // in the bundle that we never use. Notably the unused graphdef submessage
@@ -207,7 +487,8 @@ absl::Status SavedModelBundleFactory::InternalCreateSavedModelBundle(
                                     signatures, &(*bundle)->session);
     }
   }
-  return WrapSession(&(*bundle)->session);
+  return WrapSessionWithExampleParsingSpecs(std::move(example_parsing_specs),
+                                            &(*bundle)->session);
 }
 
 SavedModelBundleFactory::SavedModelBundleFactory(
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/saved_model_bundle_factory.h"
 
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -43,11 +44,18 @@ limitations under the License.
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/public/version.h"
+#include "tensorflow_serving/apis/classification.pb.h"
+#include "tensorflow_serving/apis/input.pb.h"
+#include "tensorflow_serving/apis/regression.pb.h"
 #include "tensorflow_serving/core/test_util/session_test_util.h"
 #include "tensorflow_serving/servables/tensorflow/bundle_factory_test.h"
 #include "tensorflow_serving/servables/tensorflow/bundle_factory_test_util.h"
+#include "tensorflow_serving/servables/tensorflow/classifier.h"
+#include "tensorflow_serving/servables/tensorflow/regressor.h"
 #include "tensorflow_serving/servables/tensorflow/saved_model_config.pb.h"
 #include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
+#include "tensorflow_serving/test_util/test_util.h"
 
 namespace tensorflow {
 namespace serving {
@@ -244,6 +252,96 @@ TEST_P(SavedModelBundleFactoryTest, RemoveUnusedFieldsFromMetaGraphEnabled) {
   EXPECT_FALSE(bundle->meta_graph_def.signature_def().empty());
 }
 
+TEST_P(SavedModelBundleFactoryTest, ExampleParsingSpecs) {
+  if (ExpectCreateBundleFailure()) {
+    return;
+  }
+  SessionBundleConfig config = GetSessionBundleConfig();
+  *config.add_saved_model_tags() = kSavedModelTagServe;
+  // The specs are got before the graph is removed.
+  config.set_remove_unused_fields_from_bundle_metagraph(true);
+  std::unique_ptr<SavedModelBundle> bundle;
+  TF_ASSERT_OK(CreateBundleFromPath(GetParam().creation_type, config,
+                                    export_dir_, &bundle));
+  // Off by default.
+  EXPECT_EQ(nullptr,
+            FindExampleParsingSpec(bundle->session.get(), "tf_example:0"));
+
+  config.set_enable_example_parsing_fusion(true);
+  TF_ASSERT_OK(CreateBundleFromPath(GetParam().creation_type, config,
+                                    export_dir_, &bundle));
+  const ExampleParsingSpec* spec =
+      FindExampleParsingSpec(bundle->session.get(), "tf_example:0");
+  if (GetParam().prefer_tflite_model &&
+      (GetParam().model_type == ModelType::kTfLiteModel)) {
+    // TF Lite sessions are fed serialized Examples.
+    EXPECT_EQ(nullptr, spec);
+    return;
+  }
+  ASSERT_NE(nullptr, spec);
+  ASSERT_FALSE(spec->dense_features.empty());
+  EXPECT_EQ("x", spec->dense_features[0].key);
+  EXPECT_EQ(DT_FLOAT, spec->dense_features[0].dtype);
+}
+
+TEST_P(SavedModelBundleFactoryTest, ExampleParsingFusionMatchesGraph) {
+  if (ExpectCreateBundleFailure() ||
+      (GetParam().prefer_tflite_model &&
+       (GetParam().model_type == ModelType::kTfLiteModel))) {
+    return;
+  }
+  // The second example gets the default value of "x2".
+  Input input;
+  auto* examples = input.mutable_example_list()->mutable_examples();
+  for (const float x : {1.0, 2.0}) {
+    (*examples->Add()->mutable_features()->mutable_feature())["x"]
+        .mutable_float_list()
+        ->add_value(x);
+  }
+  (*examples->Mutable(0)->mutable_features()->mutable_feature())["x2"]
+      .mutable_float_list()
+      ->add_value(3.0);
+
+  std::vector<ClassificationResponse> classification_responses;
+  std::vector<RegressionResponse> regression_responses;
+  for (const bool fusion : {false, true}) {
+    SessionBundleConfig config = GetSessionBundleConfig();
+    *config.add_saved_model_tags() = kSavedModelTagServe;
+    config.set_enable_example_parsing_fusion(fusion);
+    std::unique_ptr<SavedModelBundle> bundle;
+    TF_ASSERT_OK(CreateBundleFromPath(GetParam().creation_type, config,
+                                      export_dir_, &bundle));
+    EXPECT_EQ(fusion, FindExampleParsingSpec(bundle->session.get(),
+                                             "tf_example:0") != nullptr);
+
+    ClassificationRequest classification_request;
+    classification_request.mutable_model_spec()->set_signature_name(
+        "classify_x_to_y");
+    *classification_request.mutable_input() = input;
+    classification_responses.emplace_back();
+    TF_ASSERT_OK(RunClassify(RunOptions(), bundle->meta_graph_def, {},
+                             bundle->session.get(), classification_request,
+                             &classification_responses.back()));
+
+    for (const char* signature_name : {"regress_x_to_y", "regress_x2_to_y3"}) {
+      RegressionRequest regression_request;
+      regression_request.mutable_model_spec()->set_signature_name(
+          signature_name);
+      *regression_request.mutable_input() = input;
+      regression_responses.emplace_back();
+      TF_ASSERT_OK(RunRegress(RunOptions(), bundle->meta_graph_def, {},
+                              bundle->session.get(), regression_request,
+                              &regression_responses.back()));
+    }
+  }
+  EXPECT_THAT(classification_responses[1],
+              test_util::EqualsProto(classification_responses[0]));
+  EXPECT_THAT(regression_responses[2],
+              test_util::EqualsProto(regression_responses[0]));
+  EXPECT_THAT(regression_responses[3],
+              test_util::EqualsProto(regression_responses[1]));
+}
+
 TEST_P(SavedModelBundleFactoryTest, Batching) {
   // Most test cases don't cover batching session code path so call
   // 'TestBatching' twice with different options for batching test case, as
@@ -289,11 +387,56 @@ TEST_P(SavedModelBundleFactoryTest, PerModelBatchingParams) {
 }
 
 TEST_P(SavedModelBundleFactoryTest, EstimateResourceRequirementWithGoodExport) {
+  if (GetParam().prefer_tflite_model &&
+      GetParam().model_type == ModelType::kTfLiteModel) {
+    // Covered by EstimateTfLiteResourceRequirement.
+    return;
+  }
   const double kTotalFileSize = test_util::GetTotalFileSize(GetModelFiles());
   TestEstimateResourceRequirementWithGoodExport<SavedModelBundleFactory>(
       kTotalFileSize);
 }
 
+TEST_P(SavedModelBundleFactoryTest, EstimateTfLiteResourceRequirement) {
+  if (!GetParam().prefer_tflite_model ||
+      GetParam().model_type != ModelType::kTfLiteModel) {
+    return;
+  }
+  const uint64_t model_bytes = test_util::GetTotalFileSize(GetModelFiles());
+  auto estimate_ram_bytes = [&](const SessionBundleConfig& config) {
+    std::unique_ptr<SavedModelBundleFactory> factory;
+    TF_CHECK_OK(SavedModelBundleFactory::Create(config, &factory));
+    ResourceAllocation estimate;
+    TF_CHECK_OK(factory->EstimateResourceRequirement(export_dir_, &estimate));
+    CHECK_EQ(estimate.resource_quantities_size(), 1);
+    return estimate.resource_quantities(0).quantity();
+  };
+
+  // The model is mapped, so only the arenas count, once per interpreter.
+  SessionBundleConfig config = GetSessionBundleConfig();
+  const uint64_t arena_bytes = estimate_ram_bytes(config);
+  ASSERT_GT(arena_bytes, 0u);
+  config.set_num_tflite_pools(3);
+  EXPECT_EQ(estimate_ram_bytes(config), 3 * arena_bytes);
+
+  // Interpreters planned for a batch size have arenas for the batched tensors
+  // at that size, and the other ones at their size in the model.
+  SessionBundleConfig planned_config = config;
+  planned_config.mutable_batching_parameters()->add_allowed_batch_sizes(4);
+  const uint64_t planned_bytes = estimate_ram_bytes(planned_config);
+  EXPECT_GE(planned_bytes, 2 * 3 * arena_bytes);
+  EXPECT_LE(planned_bytes, (1 + 4) * 3 * arena_bytes);
+
+  // XNNPACK delegates pack the weights once per interpreter, or once in all
+  // if they share a weights cache.
+  config.mutable_tflite_delegate_config()->mutable_xnnpack();
+  EXPECT_EQ(estimate_ram_bytes(config), 3 * model_bytes + 3 * arena_bytes);
+  config.mutable_tflite_delegate_config()
+      ->mutable_xnnpack()
+      ->set_enable_weights_cache(true);
+  EXPECT_EQ(estimate_ram_bytes(config), model_bytes + 3 * arena_bytes);
+}
+
 TEST_P(SavedModelBundleFactoryTest, RunOptions) { TestRunOptions(); }
 
 TEST_P(SavedModelBundleFactoryTest, RunOptionsError) { TestRunOptionsError(); }
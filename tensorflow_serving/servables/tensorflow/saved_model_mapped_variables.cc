@@ -0,0 +1,340 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/servables/tensorflow/saved_model_mapped_variables.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/cc/saved_model/constants.h"
+#include "tensorflow/cc/saved_model/loader_util.h"
+#include "tensorflow/cc/saved_model/reader.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+#include "tensorflow/core/protobuf/saver.pb.h"
+#include "tensorflow/core/protobuf/tensor_bundle.pb.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+#include "tensorflow_serving/servables/tensorflow/serving_session.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// The buffer of a tensor in a memory-mapped checkpoint data file. Keeps the
+// file mapped while in use.
+class MappedTensorBuffer : public TensorBuffer {
+ public:
+  MappedTensorBuffer(std::shared_ptr<ReadOnlyMemoryRegion> region,
+                     const uint64_t offset, const size_t size)
+      : TensorBuffer(const_cast<char*>(
+            static_cast<const char*>(region->data()) + offset)),
+        region_(std::move(region)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+
+  TensorBuffer* root_buffer() override { return this; }
+
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("mapped_checkpoint");
+  }
+
+  // Keeps kernels from forwarding the read-only buffer to their outputs.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const size_t size_;
+};
+
+// A session which keeps the tensors pointing into the mapped checkpoint
+// referenced, so that the variables using them never hold the only reference
+// to them, and copy them rather than write to them.
+class MappedVariablesSession : public ServingSessionWrapper {
+ public:
+  MappedVariablesSession(std::unique_ptr<Session> wrapped,
+                         std::vector<Tensor> mapped_tensors)
+      : ServingSessionWrapper(std::move(wrapped)),
+        mapped_tensors_(std::move(mapped_tensors)) {}
+
+ private:
+  const std::vector<Tensor> mapped_tensors_;
+};
+
+// The data files of a checkpoint, mapped into memory.
+class MappedCheckpoint {
+ public:
+  explicit MappedCheckpoint(const std::string& prefix)
+      : prefix_(prefix), reader_(Env::Default(), prefix) {}
+
+  absl::Status Init() {
+    TF_RETURN_IF_ERROR(reader_.status());
+    reader_.Seek(kHeaderEntryKey);
+    BundleHeaderProto header;
+    if (!reader_.Valid() || reader_.key() != kHeaderEntryKey ||
+        !header.ParseFromArray(reader_.value().data(),
+                               reader_.value().size())) {
+      return absl::DataLossError(
+          absl::StrCat("Cannot read the header of checkpoint ", prefix_));
+    }
+    for (int i = 0; i < header.num_shards(); ++i) {
+      std::unique_ptr<ReadOnlyMemoryRegion> shard;
+      TF_RETURN_IF_ERROR(Env::Default()->NewReadOnlyMemoryRegionFromFile(
+          DataFilename(prefix_, i, header.num_shards()), &shard));
+      shards_.push_back(std::move(shard));
+    }
+    return absl::OkStatus();
+  }
+
+  // Sets 'tensor' to the checkpoint tensor 'key'. If its data is aligned in
+  // the mapping, the tensor points there and 'aliased' is set, and otherwise
+  // it is copied out of the mapping. Returns Unimplemented for tensors which
+  // can't be read that way.
+  absl::Status GetTensor(const std::string& key, Tensor* tensor,
+                         bool* aliased) {
+    *aliased = false;
+    BundleEntryProto entry;
+    TF_RETURN_IF_ERROR(reader_.GetBundleEntryProto(key, &entry));
+    if (entry.slices_size() > 0) {
+      return absl::UnimplementedError(
+          absl::StrCat("Checkpoint tensor ", key, " is partitioned"));
+    }
+    if (!DataTypeCanUseMemcpy(entry.dtype())) {
+      return absl::UnimplementedError(
+          absl::StrCat("Checkpoint tensor ", key, " is of type ",
+                       DataTypeString(entry.dtype())));
+    }
+    TensorShape shape;
+    TF_RETURN_IF_ERROR(TensorShape::BuildTensorShape(entry.shape(), &shape));
+    const uint64_t size = shape.num_elements() * DataTypeSize(entry.dtype());
+    if (entry.shard_id() < 0 ||
+        entry.shard_id() >= static_cast<int>(shards_.size()) ||
+        entry.size() != size ||
+        entry.offset() + size > shards_[entry.shard_id()]->length()) {
+      return absl::DataLossError(
+          absl::StrCat("Invalid checkpoint entry of tensor ", key));
+    }
+    if (size == 0) {
+      *tensor = Tensor(entry.dtype(), shape);
+      return absl::OkStatus();
+    }
+
+    MappedTensorBuffer* buffer =
+        new MappedTensorBuffer(shards_[entry.shard_id()], entry.offset(), size);
+    Tensor mapped_tensor(entry.dtype(), shape, buffer);
+    buffer->Unref();
+    if (mapped_tensor.IsAligned()) {
+      *tensor = std::move(mapped_tensor);
+      *aliased = true;
+    } else {
+      *tensor = tensor::DeepCopy(mapped_tensor);
+    }
+    return absl::OkStatus();
+  }
+
+ private:
+  const std::string prefix_;
+  BundleReader reader_;
+  std::vector<std::shared_ptr<ReadOnlyMemoryRegion>> shards_;
+};
+
+// Sets 'values' to the values of the string constant that 'input' (the input
+// of a node of 'nodes') refers to.
+absl::Status GetStringConstant(
+    const std::unordered_map<std::string, const NodeDef*>& nodes,
+    const std::string& input, std::vector<std::string>* values) {
+  const auto it = nodes.find(std::string(ParseTensorName(input).node()));
+  if (it == nodes.end() || it->second->op() != "Const") {
+    return absl::UnimplementedError(
+        absl::StrCat(input, " is not a string constant"));
+  }
+  const auto value = it->second->attr().find("value");
+  if (value == it->second->attr().end()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid Const node ", it->second->name()));
+  }
+  Tensor tensor;
+  if (!tensor.FromProto(value->second.tensor()) ||
+      tensor.dtype() != DT_STRING) {
+    return absl::UnimplementedError(
+        absl::StrCat(input, " is not a string constant"));
+  }
+  values->clear();
+  for (int i = 0; i < tensor.NumElements(); ++i) {
+    values->push_back(tensor.flat<tstring>()(i));
+  }
+  return absl::OkStatus();
+}
+
+// Adds the values of all the outputs of the RestoreV2 nodes of 'graph_def' to
+// 'feeds', read from 'checkpoint', and those which point into it to
+// 'mapped_tensors'. With all their outputs fed, the RestoreV2 nodes don't run.
+// Returns Unimplemented if there are outputs which can't be fed.
+absl::Status GetRestoreFeeds(const GraphDef& graph_def,
+                             MappedCheckpoint* checkpoint,
+                             std::vector<std::pair<std::string, Tensor>>* feeds,
+                             std::vector<Tensor>* mapped_tensors) {
+  std::unordered_map<std::string, const NodeDef*> nodes;
+  for (const NodeDef& node : graph_def.node()) {
+    nodes[node.name()] = &node;
+  }
+  int num_restore_nodes = 0;
+  for (const NodeDef& node : graph_def.node()) {
+    if (node.op() != "RestoreV2") {
+      continue;
+    }
+    ++num_restore_nodes;
+    if (node.input_size() < 3) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid RestoreV2 node ", node.name()));
+    }
+    std::vector<std::string> tensor_names;
+    TF_RETURN_IF_ERROR(GetStringConstant(nodes, node.input(1), &tensor_names));
+    std::vector<std::string> shape_and_slices;
+    TF_RETURN_IF_ERROR(
+        GetStringConstant(nodes, node.input(2), &shape_and_slices));
+    for (int i = 0; i < tensor_names.size(); ++i) {
+      if (i < shape_and_slices.size() && !shape_and_slices[i].empty()) {
+        return absl::UnimplementedError(absl::StrCat(
+            node.name(), " restores a slice of ", tensor_names[i]));
+      }
+      Tensor tensor;
+      bool aliased;
+      TF_RETURN_IF_ERROR(
+          checkpoint->GetTensor(tensor_names[i], &tensor, &aliased));
+      if (aliased) {
+        mapped_tensors->push_back(tensor);
+      }
+      feeds->emplace_back(absl::StrCat(node.name(), ":", i), std::move(tensor));
+    }
+  }
+  if (num_restore_nodes == 0) {
+    return absl::UnimplementedError("The graph has no RestoreV2 nodes");
+  }
+  return absl::OkStatus();
+}
+
+// Runs the restore op of 'meta_graph_def' in 'session', feeding it the values
+// of the checkpoint in 'export_dir' from a mapping of the checkpoint. Returns
+// Unimplemented, before running anything, if that isn't possible.
+absl::Status RestoreMappedVariables(const RunOptions& run_options,
+                                    const std::string& export_dir,
+                                    const MetaGraphDef& meta_graph_def,
+                                    Session* session,
+                                    std::vector<Tensor>* mapped_tensors) {
+  const std::string prefix =
+      io::JoinPath(export_dir, kSavedModelVariablesDirectory,
+                   kSavedModelVariablesFilename);
+  if (!Env::Default()->FileExists(MetaFilename(prefix)).ok()) {
+    return absl::UnimplementedError("The SavedModel has no checkpoint");
+  }
+  MappedCheckpoint checkpoint(prefix);
+  TF_RETURN_IF_ERROR(checkpoint.Init());
+  std::vector<std::pair<std::string, Tensor>> feeds;
+  TF_RETURN_IF_ERROR(GetRestoreFeeds(meta_graph_def.graph_def(), &checkpoint,
+                                     &feeds, mapped_tensors));
+
+  // The inputs the restore op gets from LoadSavedModel() too.
+  Tensor prefix_tensor(DT_STRING, TensorShape({}));
+  prefix_tensor.scalar<tstring>()() = prefix;
+  feeds.emplace_back(meta_graph_def.saver_def().filename_tensor_name(),
+                     prefix_tensor);
+  std::vector<AssetFileDef> asset_file_defs;
+  TF_RETURN_IF_ERROR(
+      internal::GetAssetFileDefs(meta_graph_def, &asset_file_defs));
+  for (const AssetFileDef& asset_file_def : asset_file_defs) {
+    Tensor asset_tensor(DT_STRING, TensorShape({}));
+    asset_tensor.scalar<tstring>()() = io::JoinPath(
+        export_dir, kSavedModelAssetsDirectory, asset_file_def.filename());
+    feeds.emplace_back(asset_file_def.tensor_info().name(), asset_tensor);
+  }
+
+  RunMetadata run_metadata;
+  const absl::Status status =
+      session->Run(run_options, feeds, {},
+                   {meta_graph_def.saver_def().restore_op_name()},
+                   /*outputs=*/nullptr, &run_metadata);
+  if (absl::IsUnimplemented(status)) {
+    // Not to be mistaken for a checkpoint which can't be mapped, since the
+    // variables may be partly restored by now.
+    return absl::InternalError(status.message());
+  }
+  return status;
+}
+
+}  // namespace
+
+absl::Status LoadSavedModelWithMappedVariables(
+    const SessionOptions& session_options, const RunOptions& run_options,
+    const std::string& export_dir, const std::unordered_set<std::string>& tags,
+    SavedModelBundle* bundle) {
+  TF_RETURN_IF_ERROR(ReadMetaGraphDefFromSavedModel(export_dir, tags,
+                                                    &bundle->meta_graph_def));
+  if (!bundle->meta_graph_def.has_saver_def()) {
+    return LoadSavedModel(session_options, run_options, export_dir, tags,
+                          bundle);
+  }
+  std::unique_ptr<Session> session;
+  TF_RETURN_IF_ERROR(LoadMetagraphIntoSession(
+      session_options, bundle->meta_graph_def, &session));
+  std::vector<Tensor> mapped_tensors;
+  const absl::Status restore_status =
+      RestoreMappedVariables(run_options, export_dir, bundle->meta_graph_def,
+                             session.get(), &mapped_tensors);
+  if (absl::IsUnimplemented(restore_status)) {
+    LOG(INFO) << "Not mapping the variables of " << export_dir << ": "
+              << restore_status;
+    return LoadSavedModel(session_options, run_options, export_dir, tags,
+                          bundle);
+  }
+  TF_RETURN_IF_ERROR(restore_status);
+  LOG(INFO) << "Restored the variables of " << export_dir
+            << " from a mapping of the checkpoint, " << mapped_tensors.size()
+            << " of them in place";
+
+  // Run the init ops like LoadSavedModel() does, but without the saver, which
+  // would restore the variables again.
+  SaverDef saver_def;
+  saver_def.Swap(bundle->meta_graph_def.mutable_saver_def());
+  bundle->meta_graph_def.clear_saver_def();
+  const absl::Status init_status = RestoreSession(
+      run_options, bundle->meta_graph_def, export_dir, &session);
+  bundle->meta_graph_def.mutable_saver_def()->Swap(&saver_def);
+  TF_RETURN_IF_ERROR(init_status);
+
+  bundle->session.reset(new MappedVariablesSession(std::move(session),
+                                                   std::move(mapped_tensors)));
+  return absl::OkStatus();
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,54 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_SAVED_MODEL_MAPPED_VARIABLES_H_
+#define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_SAVED_MODEL_MAPPED_VARIABLES_H_
+
+#include <string>
+#include <unordered_set>
+
+#include "tensorflow/cc/saved_model/loader.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Loads the SavedModel in 'export_dir' like LoadSavedModel(), except that the
+// variables are restored from a memory mapping of the checkpoint data files
+// rather than read into newly allocated tensors.
+//
+// The values fed to the variables point straight into the mapping where the
+// checkpoint lays them out aligned (as tensors require), so their pages are
+// only read from disk when first used, and can be dropped again by the kernel
+// under memory pressure. Resource variables keep using these values, and copy
+// them before any update. Ref variables and values that aren't aligned in the
+// checkpoint are copied out of the mapping. Unlike with LoadSavedModel(), the
+// checksums of the values aren't verified.
+//
+// This works for checkpoints restored by RestoreV2 ops of the main graph (e.g.
+// those of TF1 Savers) of whole, fixed-size tensors. SavedModels with other
+// checkpoints (e.g. restored by functions, as in TF2, or with partitioned or
+// string variables) are loaded with LoadSavedModel() instead.
+Status LoadSavedModelWithMappedVariables(
+    const SessionOptions& session_options, const RunOptions& run_options,
+    const string& export_dir, const std::unordered_set<string>& tags,
+    SavedModelBundle* bundle);
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_SAVED_MODEL_MAPPED_VARIABLES_H_
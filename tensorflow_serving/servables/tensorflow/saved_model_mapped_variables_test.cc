@@ -0,0 +1,86 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/servables/tensorflow/saved_model_mapped_variables.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/status/status.h"
+#include "tensorflow/cc/saved_model/tag_constants.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+#include "tensorflow_serving/servables/tensorflow/bundle_factory_test_util.h"
+#include "tensorflow_serving/test_util/test_util.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+constexpr char kCounterModelPath[] =
+    "/servables/tensorflow/testdata/saved_model_counter/00000123";
+constexpr char kTf2ModelPath[] =
+    "/servables/tensorflow/testdata/saved_model_half_plus_two_tf2_cpu/00000123";
+
+absl::Status LoadBundle(const std::string& path, SavedModelBundle* bundle) {
+  return LoadSavedModelWithMappedVariables(SessionOptions(), RunOptions(), path,
+                                           {kSavedModelTagServe}, bundle);
+}
+
+// Runs the output of the signature 'signature_name' of 'bundle'.
+float RunCounterSignature(const SavedModelBundle& bundle,
+                          const std::string& signature_name) {
+  const std::string output_name = bundle.meta_graph_def.signature_def()
+                                      .at(signature_name)
+                                      .outputs()
+                                      .at("output")
+                                      .name();
+  std::vector<Tensor> outputs;
+  TF_CHECK_OK(bundle.session->Run({}, {output_name}, {}, &outputs));
+  return outputs[0].scalar<float>()();
+}
+
+TEST(SavedModelMappedVariablesTest, Load) {
+  SavedModelBundle bundle;
+  TF_ASSERT_OK(LoadBundle(test_util::GetTestSavedModelPath(), &bundle));
+  test_util::TestSingleRequest(bundle.session.get());
+}
+
+TEST(SavedModelMappedVariablesTest, UpdatesDontChangeTheCheckpoint) {
+  const std::string path = test_util::TestSrcDirPath(kCounterModelPath);
+  SavedModelBundle bundle;
+  TF_ASSERT_OK(LoadBundle(path, &bundle));
+  EXPECT_EQ(0, RunCounterSignature(bundle, "get_counter"));
+  EXPECT_EQ(1, RunCounterSignature(bundle, "incr_counter"));
+  EXPECT_EQ(2, RunCounterSignature(bundle, "incr_counter"));
+
+  SavedModelBundle other_bundle;
+  TF_ASSERT_OK(LoadBundle(path, &other_bundle));
+  EXPECT_EQ(0, RunCounterSignature(other_bundle, "get_counter"));
+  EXPECT_EQ(2, RunCounterSignature(bundle, "get_counter"));
+}
+
+TEST(SavedModelMappedVariablesTest, FallsBackForFunctionCheckpoints) {
+  SavedModelBundle bundle;
+  TF_ASSERT_OK(LoadBundle(test_util::TestSrcDirPath(kTf2ModelPath), &bundle));
+  EXPECT_NE(nullptr, bundle.session);
+  EXPECT_EQ(1, bundle.meta_graph_def.signature_def().count("serving_default"));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
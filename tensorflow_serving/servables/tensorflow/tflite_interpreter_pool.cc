@@ -15,12 +15,17 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/tflite_interpreter_pool.h"
 
+#include <algorithm>
+#include <functional>
 #include <limits>
 #include <memory>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/lite/external_cpu_backend_context.h"
 #include "tensorflow/lite/kernels/cpu_backend_context.h"
@@ -30,6 +35,19 @@ limitations under the License.
 namespace tensorflow {
 namespace serving {
 namespace internal {
+namespace {
+
+auto* interpreter_steal_count = monitoring::Counter<0>::New(
+    "/tensorflow/serving/tflite/interpreter_pool/steal_count",
+    "Total count of TFLite interpreters taken from a slot other than the home "
+    "slot of the CPU");
+
+auto* interpreter_wait_count = monitoring::Counter<0>::New(
+    "/tensorflow/serving/tflite/interpreter_pool/wait_count",
+    "Total count of requests that had to wait for a TFLite interpreter to be "
+    "returned");
+
+}  // namespace
 
 TfLiteInterpreterWrapper::TfLiteInterpreterWrapper(
     std::unique_ptr<tflite::ExternalCpuBackendContext> external_context,
@@ -51,8 +69,6 @@ TfLiteInterpreterWrapper::TfLiteInterpreterWrapper(
   for (const int& idx : interpreter_->inputs()) {
     const auto* tflite_tensor = interpreter_->tensor(idx);
     if (tflite_tensor->type == kTfLiteString) {
-      tensor_buffer_.emplace(idx,
-                             std::unique_ptr<char>(tflite_tensor->data.raw));
       tensor_buffer_max_bytes_[idx] = 0;
     }
   }
@@ -66,53 +82,58 @@ absl::Status TfLiteInterpreterWrapper::SetStringData(
   //   [4] offset of each string (int32_t)
   //   [sizeof(int32_t) * (num_strings + 1)]] total size of strings
   //   [sizeof(int32_t) * (num_strings + 2)] batch.data()
-  int32_t num_strings = batch_size;
-  offset_.clear();
+  const int32_t num_strings = batch_size;
+  int64_t num_tensor_strings = 0;
   size_t total_size = 0;
-  offset_.push_back(static_cast<int32_t>(total_size));
   for (const auto& tensor : tensors) {
     const auto& flat = tensor->flat<tstring>();
     for (int i = 0; i < flat.size(); ++i) {
       total_size += flat(i).size();
-      offset_.push_back(static_cast<int32_t>(total_size));
     }
+    num_tensor_strings += flat.size();
+  }
+  if (num_tensor_strings > num_strings) {
+    return absl::InternalError(absl::StrCat("Got ", num_tensor_strings,
+                                            " strings for a batch of ",
+                                            num_strings));
   }
-  size_t required_bytes = total_size + sizeof(int32_t) * (num_strings + 2);
-  if (tensor_buffer_.find(tensor_index) == tensor_buffer_.end()) {
+  const size_t start = sizeof(int32_t) * (num_strings + 2);
+  const size_t required_bytes = start + total_size;
+  if (required_bytes > std::numeric_limits<int32_t>::max()) {
+    return absl::InternalError(
+        absl::StrCat("Invalid size, string input too large:", required_bytes));
+  }
+  auto max_bytes = tensor_buffer_max_bytes_.find(tensor_index);
+  if (max_bytes == tensor_buffer_max_bytes_.end()) {
     return absl::InternalError(
         absl::StrCat("Tensor input for index not found: ", tensor_index));
   }
-  if (required_bytes > tensor_buffer_max_bytes_[tensor_index]) {
+  if (required_bytes > max_bytes->second || !tflite_tensor->data.raw) {
     if (tflite_tensor->data.raw) {
       free(tflite_tensor->data.raw);
     }
     tflite_tensor->data.raw = reinterpret_cast<char*>(malloc(required_bytes));
-    tensor_buffer_max_bytes_[tensor_index] = required_bytes;
-  }
-  tensor_buffer_[tensor_index].reset(tflite_tensor->data.raw);
-  memcpy(tensor_buffer_[tensor_index].get(), &num_strings, sizeof(int32_t));
-  int32_t start = sizeof(int32_t) * (num_strings + 2);
-  for (size_t i = 0; i < offset_.size(); i++) {
-    size_t size_offset_i = start + offset_[i];
-    if (size_offset_i > std::numeric_limits<int32_t>::max()) {
-      return absl::InternalError(
-          absl::StrCat("Invalid size, string input too large:", size_offset_i));
-    }
-    int32_t offset_i = static_cast<int32_t>(size_offset_i);
-    memcpy(tensor_buffer_[tensor_index].get() + sizeof(int32_t) * (i + 1),
-           &offset_i, sizeof(int32_t));
+    max_bytes->second = required_bytes;
   }
+
+  char* const buffer = tflite_tensor->data.raw;
+  memcpy(buffer, &num_strings, sizeof(int32_t));
+  int32_t offset = static_cast<int32_t>(start);
+  int slot = 1;
   for (const auto& tensor : tensors) {
     const auto& flat = tensor->flat<tstring>();
     for (int i = 0; i < flat.size(); ++i) {
-      memcpy(tensor_buffer_[tensor_index].get() + start, flat(i).data(),
-             flat(i).size());
-      start += flat(i).size();
+      memcpy(buffer + sizeof(int32_t) * slot++, &offset, sizeof(int32_t));
+      memcpy(buffer + offset, flat(i).data(), flat(i).size());
+      offset += flat(i).size();
     }
   }
+  // The end of the last string, and the missing strings.
+  for (; slot <= num_strings + 1; ++slot) {
+    memcpy(buffer + sizeof(int32_t) * slot, &offset, sizeof(int32_t));
+  }
 
-  // tflite_tensor will take ownership of the pointer.
-  tflite_tensor->data.raw = tensor_buffer_[tensor_index].release();
+  // tflite_tensor owns the buffer.
   tflite_tensor->bytes = required_bytes;
   tflite_tensor->allocation_type = kTfLiteDynamic;
   return absl::OkStatus();
@@ -141,12 +162,156 @@ TfLiteStatus TfLiteInterpreterWrapper::Invoke() {
   return status;
 }
 
+int64_t TfLiteInterpreterWrapper::GetArenaTensorBytes() const {
+  int64_t bytes = 0;
+  for (int i = 0; i < interpreter_->tensors_size(); ++i) {
+    const TfLiteTensor* tensor = interpreter_->tensor(i);
+    if (tensor->allocation_type == kTfLiteArenaRw ||
+        tensor->allocation_type == kTfLiteArenaRwPersistent) {
+      bytes += tensor->bytes;
+    }
+  }
+  return bytes;
+}
+
+absl::Status TfLiteInterpreterWrapper::BindTensorBuffer(
+    const int tensor_index, const Tensor& tensor) {
+  return BindBuffer(tensor_index, tensor, /*owned=*/false);
+}
+
+absl::Status TfLiteInterpreterWrapper::BindBuffer(const int tensor_index,
+                                                  const Tensor& tensor,
+                                                  const bool owned) {
+  const absl::string_view data = tensor.tensor_data();
+  TfLiteCustomAllocation allocation;
+  allocation.data = const_cast<char*>(data.data());
+  allocation.bytes = data.size();
+  if (interpreter_->SetCustomAllocationForTensor(tensor_index, allocation) !=
+      kTfLiteOk) {
+    return absl::InternalError(
+        absl::StrCat("Failed to bind a buffer to tensor: ",
+                     interpreter_->tensor(tensor_index)->name));
+  }
+  bound_tensors_[tensor_index] = {tensor, owned};
+  return absl::OkStatus();
+}
+
+absl::Status TfLiteInterpreterWrapper::ReleaseBoundTensor(
+    const int tensor_index) {
+  const auto it = bound_tensors_.find(tensor_index);
+  if (it == bound_tensors_.end()) {
+    return absl::OkStatus();
+  }
+  const size_t bytes = interpreter_->tensor(tensor_index)->bytes;
+  if (it->second.owned && it->second.tensor.TotalBytes() >= bytes) {
+    return absl::OkStatus();
+  }
+  Tensor& buffer = owned_buffers_[tensor_index];
+  if (!buffer.IsInitialized() || buffer.TotalBytes() < bytes) {
+    buffer = Tensor(DT_INT8, TensorShape({std::max<int64_t>(bytes, 1)}));
+  }
+  return BindBuffer(tensor_index, buffer, /*owned=*/true);
+}
+
+const Tensor* TfLiteInterpreterWrapper::GetBoundTensor(
+    const int tensor_index) const {
+  const auto it = bound_tensors_.find(tensor_index);
+  if (it == bound_tensors_.end() || it->second.owned) {
+    return nullptr;
+  }
+  return &it->second.tensor;
+}
+
+absl::Status TfLiteInterpreterWrapper::AllocateTensors() {
+  // TFLite checks that bound buffers are large enough for their tensors as it
+  // plans them, and gives up at the first one which isn't, so this may take
+  // as many attempts as there are bound buffers.
+  for (int i = 0; i <= bound_tensors_.size(); ++i) {
+    if (interpreter_->AllocateTensors() == kTfLiteOk) {
+      return absl::OkStatus();
+    }
+    bool released = false;
+    for (const auto& entry : bound_tensors_) {
+      if (entry.second.tensor.TotalBytes() <
+          interpreter_->tensor(entry.first)->bytes) {
+        TF_RETURN_IF_ERROR(ReleaseBoundTensor(entry.first));
+        released = true;
+      }
+    }
+    if (!released) {
+      break;
+    }
+  }
+  return absl::InternalError("Failed to allocate tensors");
+}
+
+absl::Status TfLiteInterpreterWrapper::CreateTfLiteInterpreterWrapper(
+    const tflite::FlatBufferModel& model,
+    const tensorflow::SessionOptions& options, const int planned_batch_size,
+    const TfLiteDelegateOptions& delegate_options,
+    std::unique_ptr<TfLiteInterpreterWrapper>& wrapper) {
+  if (planned_batch_size < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid planned batch size: ", planned_batch_size));
+  }
+  TF_RETURN_IF_ERROR(CreateTfLiteInterpreterWrapper(model, options,
+                                                    delegate_options, wrapper));
+  tflite::Interpreter* const interpreter = wrapper->Get();
+  for (const int idx : interpreter->inputs()) {
+    const TfLiteTensor* tensor = interpreter->tensor(idx);
+    if (tensor->dims->size == 0) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Cannot plan batches for scalar input: ", tensor->name));
+    }
+    std::vector<int> dims(tensor->dims->data,
+                          tensor->dims->data + tensor->dims->size);
+    dims[0] = planned_batch_size;
+    if (interpreter->ResizeInputTensor(idx, dims) != kTfLiteOk) {
+      return absl::InternalError(
+          absl::StrCat("Failed to resize input: ", tensor->name));
+    }
+  }
+  if (interpreter->AllocateTensors() != kTfLiteOk) {
+    return absl::InternalError("Failed to allocate tensors");
+  }
+  for (const int idx : interpreter->outputs()) {
+    const TfLiteTensor* tensor = interpreter->tensor(idx);
+    if (tensor->dims->size == 0 ||
+        tensor->dims->data[0] != planned_batch_size) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Cannot plan batches for output which isn't batched: ",
+          tensor->name));
+    }
+  }
+  wrapper->SetBatchSize(planned_batch_size);
+  wrapper->planned_batch_size_ = planned_batch_size;
+  return absl::OkStatus();
+}
+
 absl::Status TfLiteInterpreterWrapper::CreateTfLiteInterpreterWrapper(
     const tflite::FlatBufferModel& model,
     const tensorflow::SessionOptions& options,
     std::unique_ptr<TfLiteInterpreterWrapper>& wrapper) {
-  tflite::ops::builtin::BuiltinOpResolver resolver;
-  tflite::ops::custom::AddParseExampleOp(&resolver);
+  return CreateTfLiteInterpreterWrapper(model, options, TfLiteDelegateOptions(),
+                                        wrapper);
+}
+
+absl::Status TfLiteInterpreterWrapper::CreateTfLiteInterpreterWrapper(
+    const tflite::FlatBufferModel& model,
+    const tensorflow::SessionOptions& options,
+    const TfLiteDelegateOptions& delegate_options,
+    std::unique_ptr<TfLiteInterpreterWrapper>& wrapper) {
+  const bool use_xnnpack = delegate_options.xnnpack_num_threads > 0;
+  // The builtin op resolver may apply XNNPACK on its own, without the options
+  // we want.
+  std::unique_ptr<tflite::MutableOpResolver> resolver;
+  if (use_xnnpack) {
+    resolver.reset(
+        new tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates());
+  } else {
+    resolver.reset(new tflite::ops::builtin::BuiltinOpResolver());
+  }
+  tflite::ops::custom::AddParseExampleOp(resolver.get());
   std::unique_ptr<tflite::Interpreter> interpreter;
 
   // Use an initial batch_size of 1, will be resized later.
@@ -154,7 +319,7 @@ absl::Status TfLiteInterpreterWrapper::CreateTfLiteInterpreterWrapper(
   // Use a single thread to reduce contention across sessions.
   const int num_threads = 1;
 
-  if (tflite::InterpreterBuilder(model, resolver)(&interpreter, num_threads) !=
+  if (tflite::InterpreterBuilder(model, *resolver)(&interpreter, num_threads) !=
       kTfLiteOk) {
     return absl::InternalError(
         "Failed to create a TFLite interpreter with the given model");
@@ -169,6 +334,20 @@ absl::Status TfLiteInterpreterWrapper::CreateTfLiteInterpreterWrapper(
       std::move(cpu_backend_context));
   interpreter->SetExternalContext(kTfLiteCpuBackendContext,
                                   external_context.get());
+  std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate*)> delegate(
+      nullptr, TfLiteXNNPackDelegateDelete);
+  if (use_xnnpack) {
+    TfLiteXNNPackDelegateOptions xnnpack_options =
+        TfLiteXNNPackDelegateOptionsDefault();
+    xnnpack_options.num_threads = delegate_options.xnnpack_num_threads;
+    xnnpack_options.weights_cache =
+        delegate_options.xnnpack_weights_cache.get();
+    delegate.reset(TfLiteXNNPackDelegateCreate(&xnnpack_options));
+    if (delegate == nullptr ||
+        interpreter->ModifyGraphWithDelegate(delegate.get()) != kTfLiteOk) {
+      return absl::InternalError("Failed to apply the XNNPACK delegate");
+    }
+  }
   const int idx = interpreter->inputs()[0];
   const auto* tensor = interpreter->tensor(idx);
   if (tensor->type == kTfLiteString) {
@@ -181,6 +360,8 @@ absl::Status TfLiteInterpreterWrapper::CreateTfLiteInterpreterWrapper(
   }
   wrapper.reset(new TfLiteInterpreterWrapper(std::move(external_context),
                                              std::move(interpreter)));
+  wrapper->xnnpack_weights_cache_ = delegate_options.xnnpack_weights_cache;
+  wrapper->delegate_ = std::move(delegate);
   return absl::OkStatus();
 }
 
@@ -195,10 +376,123 @@ absl::Status TfLiteInterpreterPool::CreateTfLiteInterpreterPool(
     TF_RETURN_IF_ERROR(TfLiteInterpreterWrapper::CreateTfLiteInterpreterWrapper(
         *model, options, wrapper));
   }
-  interpreter_pool.reset(new TfLiteInterpreterPool(std::move(interpreters)));
+  interpreter_pool.reset(new TfLiteInterpreterPool(std::move(interpreters),
+                                                   /*planned_batch_size=*/0));
+  return absl::OkStatus();
+}
+
+absl::Status TfLiteInterpreterPool::CreateTfLiteInterpreterPool(
+    const tflite::FlatBufferModel* model,
+    const tensorflow::SessionOptions& options, int pool_size,
+    int planned_batch_size, const TfLiteDelegateOptions& delegate_options,
+    std::unique_ptr<TfLiteInterpreterPool>& interpreter_pool) {
+  std::vector<std::unique_ptr<TfLiteInterpreterWrapper>> interpreters(
+      pool_size);
+  for (int i = 0; i < pool_size; i++) {
+    auto& wrapper = interpreters[i];
+    if (planned_batch_size > 0) {
+      TF_RETURN_IF_ERROR(
+          TfLiteInterpreterWrapper::CreateTfLiteInterpreterWrapper(
+              *model, options, planned_batch_size, delegate_options, wrapper));
+    } else {
+      TF_RETURN_IF_ERROR(
+          TfLiteInterpreterWrapper::CreateTfLiteInterpreterWrapper(
+              *model, options, delegate_options, wrapper));
+    }
+  }
+  interpreter_pool.reset(
+      new TfLiteInterpreterPool(std::move(interpreters), planned_batch_size));
   return absl::OkStatus();
 }
 
+TfLiteInterpreterPool::TfLiteInterpreterPool(
+    std::vector<std::unique_ptr<TfLiteInterpreterWrapper>> interpreters,
+    const int planned_batch_size)
+    : size_(interpreters.size()),
+      planned_batch_size_(planned_batch_size),
+      num_slots_(std::max<int>(1, interpreters.size())),
+      slots_(new PaddedSlot[num_slots_]) {
+  for (int i = 0; i < interpreters.size(); ++i) {
+    arena_tensor_bytes_ += interpreters[i]->GetArenaTensorBytes();
+    slots_[i].interpreter.store(interpreters[i].release());
+  }
+}
+
+TfLiteInterpreterPool::~TfLiteInterpreterPool() {
+  for (int i = 0; i < num_slots_; ++i) {
+    delete slots_[i].interpreter.load();
+  }
+}
+
+std::unique_ptr<TfLiteInterpreterWrapper>
+TfLiteInterpreterPool::GetInterpreter() {
+  const int home_slot = GetHomeSlot();
+  TfLiteInterpreterWrapper* interpreter = TryTakeInterpreter(home_slot);
+  if (interpreter != nullptr) {
+    return std::unique_ptr<TfLiteInterpreterWrapper>(interpreter);
+  }
+
+  interpreter_wait_count->GetCell()->IncrementBy(1);
+  absl::MutexLock l(&mutex_);
+  // Registering as a waiter before looking at the slots again ensures that
+  // either we see an interpreter returned from now on, or the thread returning
+  // it sees us waiting and signals us.
+  num_waiters_.fetch_add(1);
+  while ((interpreter = TryTakeInterpreter(home_slot)) == nullptr) {
+    interpreter_returned_.Wait(&mutex_);
+  }
+  num_waiters_.fetch_sub(1);
+  return std::unique_ptr<TfLiteInterpreterWrapper>(interpreter);
+}
+
+void TfLiteInterpreterPool::ReturnInterpreter(
+    std::unique_ptr<TfLiteInterpreterWrapper> interpreter) {
+  TfLiteInterpreterWrapper* const returned = interpreter.release();
+  // There are as many slots as interpreters, so one of them is empty.
+  for (int slot = GetHomeSlot();; slot = (slot + 1) % num_slots_) {
+    TfLiteInterpreterWrapper* empty = nullptr;
+    if (slots_[slot].interpreter.compare_exchange_strong(empty, returned)) {
+      break;
+    }
+  }
+  if (num_waiters_.load() > 0) {
+    absl::MutexLock l(&mutex_);
+    interpreter_returned_.Signal();
+  }
+}
+
+int TfLiteInterpreterPool::GetHomeSlot() const {
+  const int cpu = port::GetCurrentCPU();
+  if (cpu != -1) {
+    return cpu % num_slots_;
+  }
+  // Otherwise, keep each thread on the same slot.
+  thread_local const size_t thread_hash =
+      std::hash<std::thread::id>()(std::this_thread::get_id());
+  return thread_hash % num_slots_;
+}
+
+TfLiteInterpreterWrapper* TfLiteInterpreterPool::TryTakeInterpreter(
+    const int home_slot) {
+  for (int i = 0; i < num_slots_; ++i) {
+    std::atomic<TfLiteInterpreterWrapper*>& slot =
+        slots_[(home_slot + i) % num_slots_].interpreter;
+    // Only write to slots that hold an interpreter, to avoid bouncing the
+    // cache lines of the empty ones between CPUs.
+    if (slot.load() == nullptr) {
+      continue;
+    }
+    TfLiteInterpreterWrapper* const interpreter = slot.exchange(nullptr);
+    if (interpreter != nullptr) {
+      if (i > 0) {
+        interpreter_steal_count->GetCell()->IncrementBy(1);
+      }
+      return interpreter;
+    }
+  }
+  return nullptr;
+}
+
 }  // namespace internal
 }  // namespace serving
 }  // namespace tensorflow
@@ -16,7 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_TFLITE_INTERPRETER_POOL_H_
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_TFLITE_INTERPRETER_POOL_H_
 
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include "absl/base/thread_annotations.h"
@@ -27,6 +30,7 @@ limitations under the License.
 #include "tensorflow/core/platform/tstring.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
 #include "tensorflow/lite/model.h"
 #ifdef TFLITE_PROFILE
 #ifndef TFLITE_PROFILE_EVENTS
@@ -44,6 +48,15 @@ namespace internal {
 
 constexpr int kInitialBatchSize = 500;
 
+// The delegates to apply to TFLite interpreters.
+struct TfLiteDelegateOptions {
+  // If positive, the XNNPACK delegate is applied, with as many threads.
+  int xnnpack_num_threads = 0;
+  // Packed weights shared by the XNNPACK delegates of all interpreters of a
+  // model, or null for each delegate to pack its own.
+  std::shared_ptr<TfLiteXNNPackDelegateWeightsCache> xnnpack_weights_cache;
+};
+
 class TfLiteInterpreterWrapper {
   // Wrapper class for a single TfLite Interpreter for use in an interpreter
   // pool.
@@ -55,6 +68,23 @@ class TfLiteInterpreterWrapper {
       const tensorflow::SessionOptions& options,
       std::unique_ptr<TfLiteInterpreterWrapper>& wrapper);
 
+  // Same as above, but with the delegates of 'delegate_options' applied.
+  static Status CreateTfLiteInterpreterWrapper(
+      const tflite::FlatBufferModel& model,
+      const tensorflow::SessionOptions& options,
+      const TfLiteDelegateOptions& delegate_options,
+      std::unique_ptr<TfLiteInterpreterWrapper>& wrapper);
+
+  // Same as above, but with all inputs resized to 'planned_batch_size' rows and
+  // the tensors allocated for them, so that batches of up to that many rows
+  // can be run without resizing (see GetPlannedBatchSize()). Fails if the
+  // outputs of the model aren't batched along with the inputs.
+  static Status CreateTfLiteInterpreterWrapper(
+      const tflite::FlatBufferModel& model,
+      const tensorflow::SessionOptions& options, int planned_batch_size,
+      const TfLiteDelegateOptions& delegate_options,
+      std::unique_ptr<TfLiteInterpreterWrapper>& wrapper);
+
   // Constructor for wrapper takes only an initialized interpreter.
   TfLiteInterpreterWrapper(
       std::unique_ptr<tflite::ExternalCpuBackendContext> external_context,
@@ -72,6 +102,38 @@ class TfLiteInterpreterWrapper {
   // Set the batch size.
   void SetBatchSize(int batch_size) { batch_size_ = batch_size; }
 
+  // Returns the batch size the tensors of the interpreter were planned for, in
+  // which case inputs with fewer rows are padded rather than resized to, or 0
+  // if they weren't.
+  int GetPlannedBatchSize() const { return planned_batch_size_; }
+
+  // Returns the total size of the tensors allocated in the arena of the
+  // interpreter, an upper bound of the size of the arena.
+  int64_t GetArenaTensorBytes() const;
+
+  // Binds the buffer of 'tensor' to the TFLite tensor at 'tensor_index' as a
+  // custom allocation, so that the interpreter reads or writes it in place
+  // rather than in its arena. The buffer must be aligned to
+  // tflite::kDefaultTensorAlignment and hold at least as many bytes as the
+  // TFLite tensor. The wrapper references 'tensor' until another buffer is
+  // bound in its place, since the interpreter keeps pointing to it.
+  Status BindTensorBuffer(int tensor_index, const Tensor& tensor);
+
+  // Makes the TFLite tensor at 'tensor_index' stop using the buffer of the
+  // tensor bound to it, if any, by binding a buffer owned by the wrapper
+  // instead. (TFLite can't move tensors back into the arena.) The wrapper
+  // keeps that buffer for the next release of the same tensor.
+  Status ReleaseBoundTensor(int tensor_index);
+
+  // Returns the tensor bound to the TFLite tensor at 'tensor_index' by
+  // BindTensorBuffer(), or nullptr.
+  const Tensor* GetBoundTensor(int tensor_index) const;
+
+  // Allocates the tensors of the interpreter, e.g. after resizing inputs.
+  // Bound buffers which turn out to be too small for their tensors are
+  // released first.
+  Status AllocateTensors();
+
   // Invokes the interpreter.
   TfLiteStatus Invoke();
 #ifdef TFLITE_PROFILE
@@ -89,23 +151,37 @@ class TfLiteInterpreterWrapper {
   }
 #endif
 
-  // Sets the contents of the internal buffer _tensor_buffer_ to the tflite
-  // formatted string buffer equivalent stored in `batch` and sets
-  // raw pointer of `tflite_tensor` to the internal buffer. If the required
-  // size is larger than the current size, will allocate new memory and
-  // free the existing buffer.
+  // Writes the strings of `tensors` straight into the buffer of
+  // `tflite_tensor`, in the tflite string format, as a batch of `batch_size`
+  // strings, the ones missing being empty. If the required size is larger
+  // than the current size, will allocate new memory and free the existing
+  // buffer.
   tensorflow::Status SetStringData(const std::vector<const Tensor*>& tensors,
                                    TfLiteTensor* tflite_tensor,
                                    int tensor_index, int batch_size);
 
  private:
+  Status BindBuffer(int tensor_index, const Tensor& tensor, bool owned);
+
+  // Outlive the interpreter, which uses them.
+  std::shared_ptr<TfLiteXNNPackDelegateWeightsCache> xnnpack_weights_cache_;
+  std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate*)> delegate_{
+      nullptr, nullptr};
   // External cpu context to enable caching.
   std::unique_ptr<tflite::ExternalCpuBackendContext> external_context_;
   std::unique_ptr<tflite::Interpreter> interpreter_;
   int batch_size_ = 1;
-  std::map<int, std::unique_ptr<char>> tensor_buffer_;
+  int planned_batch_size_ = 0;
   std::map<int, size_t> tensor_buffer_max_bytes_;
-  std::vector<int32_t> offset_;
+  struct BoundTensor {
+    Tensor tensor;
+    // Whether the buffer was allocated by ReleaseBoundTensor(), rather than
+    // passed to BindTensorBuffer().
+    bool owned;
+  };
+  std::map<int, BoundTensor> bound_tensors_;
+  // The buffers allocated by ReleaseBoundTensor(), by tensor index.
+  std::map<int, Tensor> owned_buffers_;
 #ifdef TFLITE_PROFILE
   int max_num_entries_;
   tflite::profiling::ProfileSummarizer run_summarizer_;
@@ -114,9 +190,21 @@ class TfLiteInterpreterWrapper {
 #endif
 };
 
-// Contains a vector of TfLiteInterpreterWrapper, which are protected by mutex.
-// When GetInterpreter is called, will either release a unique ptr to the
-// caller or block if the vector is empty.
+// Contains a set of TfLiteInterpreterWrappers, one per slot of a fixed array
+// of slots, which callers take interpreters from and return them to without
+// locking.
+//
+// Each CPU has a home slot, CPU number modulo the number of slots (so CPUs
+// share slots when there are more CPUs than interpreters). GetInterpreter()
+// first tries the home slot of the CPU it runs on, and ReturnInterpreter()
+// puts the interpreter back into it, so that requests running on the same CPU
+// tend to reuse the same interpreter, and threads on different CPUs mostly
+// access different slots. Only when the home slot is empty (or, when
+// returning, taken) are the other slots tried, in slot order. Slots are not
+// placed according to the cache or NUMA topology of the CPUs.
+//
+// When all interpreters are in use, GetInterpreter() blocks until one is
+// returned.
 class TfLiteInterpreterPool {
  public:
   // Creates a TfLiteSessionPool with model, session options,
@@ -126,33 +214,66 @@ class TfLiteInterpreterPool {
       const tensorflow::SessionOptions& options, int pool_size,
       std::unique_ptr<TfLiteInterpreterPool>& interpreter_pool);
 
+  // Same as above, but with interpreters planned for 'planned_batch_size', if
+  // positive (see TfLiteInterpreterWrapper::GetPlannedBatchSize()), and the
+  // delegates of 'delegate_options' applied.
+  static tensorflow::Status CreateTfLiteInterpreterPool(
+      const tflite::FlatBufferModel* model,
+      const tensorflow::SessionOptions& options, int pool_size,
+      int planned_batch_size, const TfLiteDelegateOptions& delegate_options,
+      std::unique_ptr<TfLiteInterpreterPool>& interpreter_pool);
+
+  // All interpreters must have been returned.
+  ~TfLiteInterpreterPool();
+
   // Returns a TFLite interpreter wrapper object. Caller may *block* waiting for
   // a free interpreter pool to be available.
-  std::unique_ptr<TfLiteInterpreterWrapper> GetInterpreter() {
-    auto interpreter_available = [this]() ABSL_SHARED_LOCKS_REQUIRED(mutex_) {
-      return !this->available_.empty();
-    };
-    mutex_.LockWhen(absl::Condition(&interpreter_available));
-    auto pool = std::move(available_.back());
-    available_.pop_back();
-    mutex_.Unlock();
-    return pool;
-  }
+  std::unique_ptr<TfLiteInterpreterWrapper> GetInterpreter();
 
   // Returns an interpreter wrapper to the available pool.
-  void ReturnInterpreter(
-      std::unique_ptr<TfLiteInterpreterWrapper> interpreter) {
-    absl::MutexLock l(&mutex_);
-    available_.emplace_back(std::move(interpreter));
-  }
+  void ReturnInterpreter(std::unique_ptr<TfLiteInterpreterWrapper> interpreter);
+
+  // The number of interpreters in the pool.
+  int size() const { return size_; }
+
+  // The batch size the interpreters were planned for, or 0.
+  int planned_batch_size() const { return planned_batch_size_; }
+
+  // The sum of TfLiteInterpreterWrapper::GetArenaTensorBytes() over the
+  // interpreters, when the pool was created.
+  int64_t arena_tensor_bytes() const { return arena_tensor_bytes_; }
 
  private:
   TfLiteInterpreterPool(
-      std::vector<std::unique_ptr<TfLiteInterpreterWrapper>> interpreters)
-      : available_(std::move(interpreters)) {}
-  mutable absl::Mutex mutex_;
-  std::vector<std::unique_ptr<TfLiteInterpreterWrapper>> available_
-      ABSL_GUARDED_BY(mutex_);
+      std::vector<std::unique_ptr<TfLiteInterpreterWrapper>> interpreters,
+      int planned_batch_size);
+
+  const int size_;
+  const int planned_batch_size_;
+  int64_t arena_tensor_bytes_ = 0;
+
+  // Returns the home slot of the CPU the calling thread runs on.
+  int GetHomeSlot() const;
+
+  // Takes an interpreter out of the first non-empty slot starting at
+  // 'home_slot', or returns null if all slots are empty.
+  TfLiteInterpreterWrapper* TryTakeInterpreter(int home_slot);
+
+  // We pad the slots to ensure that threads taking interpreters from different
+  // slots don't experience false sharing.
+  struct PaddedSlot {
+    std::atomic<TfLiteInterpreterWrapper*> interpreter{nullptr};
+    char padding[64 - sizeof(std::atomic<TfLiteInterpreterWrapper*>)];
+  };
+
+  const int num_slots_;
+  std::unique_ptr<PaddedSlot[]> slots_;
+
+  // The number of GetInterpreter() calls waiting for an interpreter to be
+  // returned. ReturnInterpreter() only locks mutex_ if this is positive.
+  std::atomic<int> num_waiters_{0};
+  absl::Mutex mutex_;
+  absl::CondVar interpreter_returned_;
 };
 
 }  // namespace internal
@@ -0,0 +1,174 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks for taking TFLite interpreters from a TfLiteInterpreterPool, on
+// their own and as part of TfLiteSession::Run() on a tiny model, from many
+// threads at once, with plain interpreters and with the XNNPACK delegate.
+//
+// Run with:
+// bazel run -c opt \
+// tensorflow_serving/servables/tensorflow:tflite_interpreter_pool_benchmark --
+// --benchmarks=.
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/notification.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/lite/model.h"
+#include "tensorflow_serving/servables/tensorflow/tflite_interpreter_pool.h"
+#include "tensorflow_serving/servables/tensorflow/tflite_session.h"
+#include "tensorflow_serving/test_util/test_util.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+constexpr char kTestModel[] =
+    "/servables/tensorflow/testdata/saved_model_half_plus_two_tflite/00000123/"
+    "model.tflite";
+
+// The number of times each thread calls the benchmarked function per
+// iteration.
+constexpr int kSubIters = 100;
+
+std::string ReadTestModel() {
+  std::string model_bytes;
+  TF_CHECK_OK(ReadFileToString(
+      Env::Default(), test_util::TestSrcDirPath(kTestModel), &model_bytes));
+  return model_bytes;
+}
+
+// Calls 'fn' kSubIters times from each of 'num_threads' threads, in every
+// iteration of the benchmark.
+void RunConcurrently(const int num_threads, const std::function<void()>& fn,
+                     ::testing::benchmark::State& state) {
+  for (auto s : state) {
+    // Exclude scheduling setup time.
+    state.PauseTiming();
+    absl::Notification start;
+    {
+      thread::ThreadPool pool(Env::Default(), "RunConcurrently", num_threads);
+      for (int i = 0; i < num_threads; ++i) {
+        pool.Schedule([&] {
+          start.WaitForNotification();
+          for (int j = 0; j < kSubIters; ++j) {
+            fn();
+          }
+        });
+      }
+      state.ResumeTiming();
+      start.Notify();
+      // Destructing the pool waits for all threads to be done.
+    }
+  }
+  state.SetItemsProcessed(num_threads * kSubIters * state.iterations());
+}
+
+void BM_GetAndReturnInterpreter(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const int num_interpreters = state.range(1);
+  const std::string model_bytes = ReadTestModel();
+  auto model = tflite::FlatBufferModel::BuildFromBuffer(model_bytes.data(),
+                                                        model_bytes.size());
+  std::unique_ptr<internal::TfLiteInterpreterPool> interpreter_pool;
+  TF_CHECK_OK(internal::TfLiteInterpreterPool::CreateTfLiteInterpreterPool(
+      model.get(), SessionOptions(), num_interpreters, interpreter_pool));
+
+  RunConcurrently(
+      num_threads,
+      [&] {
+        auto interpreter = interpreter_pool->GetInterpreter();
+        testing::DoNotOptimize(interpreter.get());
+        interpreter_pool->ReturnInterpreter(std::move(interpreter));
+      },
+      state);
+}
+
+void BM_TfLiteSessionRun(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const int num_interpreters = state.range(1);
+  const int xnnpack_num_threads = state.range(2);
+  TfLiteDelegateConfig delegate_config;
+  if (xnnpack_num_threads > 0) {
+    delegate_config.mutable_xnnpack()->set_num_threads(xnnpack_num_threads);
+    delegate_config.mutable_xnnpack()->set_enable_weights_cache(true);
+  }
+  ::google::protobuf::Map<std::string, SignatureDef> signatures;
+  std::unique_ptr<TfLiteSession> session;
+  TF_CHECK_OK(TfLiteSession::Create(
+      ReadTestModel(), SessionOptions(), num_interpreters,
+      /*num_interpreters_per_pool=*/1, /*allowed_batch_sizes=*/{},
+      /*zero_copy_io=*/false, delegate_config, &session, &signatures));
+  const Tensor input = test::AsTensor<float>({1.0, 2.0, 3.0}, {3});
+
+  RunConcurrently(
+      num_threads,
+      [&] {
+        std::vector<Tensor> outputs;
+        TF_CHECK_OK(session->Run({{"x", input}}, {"y"}, {}, &outputs));
+      },
+      state);
+}
+
+// Args are {number of threads, number of interpreters}, and for
+// BM_TfLiteSessionRun the number of threads of the XNNPACK delegate of each
+// interpreter, or 0 for the plain interpreter.
+
+// The benchmarking system by default uses cpu time to calculate items per
+// second, which would include time spent by all the threads on the cpu.
+// Instead of that we use real-time here so that we can see items/s increasing
+// with increasing threads, which is easier to understand.
+
+BENCHMARK(BM_GetAndReturnInterpreter)
+    ->UseRealTime()
+    ->ArgPair(1, 1)
+    ->ArgPair(4, 4)
+    ->ArgPair(16, 16)
+    ->ArgPair(64, 64)
+    ->ArgPair(64, 16);
+
+BENCHMARK(BM_TfLiteSessionRun)
+    ->UseRealTime()
+    ->Args({1, 1, 0})
+    ->Args({1, 1, 1})
+    ->Args({4, 4, 0})
+    ->Args({4, 4, 1})
+    ->Args({16, 16, 0})
+    ->Args({16, 16, 1})
+    ->Args({64, 16, 0})
+    ->Args({64, 16, 1})
+    ->Args({4, 1, 0})
+    ->Args({4, 1, 4});
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  tensorflow::testing::RunBenchmarks();
+  return 0;
+}
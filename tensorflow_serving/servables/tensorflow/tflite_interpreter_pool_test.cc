@@ -14,7 +14,9 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow_serving/servables/tensorflow/tflite_interpreter_pool.h"
 
+#include <atomic>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -22,9 +24,11 @@ limitations under the License.
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/base/attributes.h"
+#include "absl/synchronization/notification.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/lite/kernels/parse_example/parse_example.h"
 #include "tensorflow/lite/kernels/register.h"
 #include "tensorflow_serving/test_util/test_util.h"
@@ -74,6 +78,79 @@ TEST(TfLiteInterpreterPool, CreateTfLiteInterpreterPoolTest) {
   interpreter_pool.reset();
 }
 
+TEST(TfLiteInterpreterPool, GetInterpreterWaitsForReturnedInterpreter) {
+  std::string model_bytes;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(),
+                                test_util::TestSrcDirPath(kParseExampleModel),
+                                &model_bytes));
+  auto model = tflite::FlatBufferModel::BuildFromModel(
+      flatbuffers::GetRoot<tflite::Model>(model_bytes.data()));
+  const tensorflow::SessionOptions options;
+  std::unique_ptr<TfLiteInterpreterPool> interpreter_pool;
+  TF_ASSERT_OK(TfLiteInterpreterPool::CreateTfLiteInterpreterPool(
+      model.get(), options, /*pool_size=*/2, interpreter_pool));
+
+  auto interpreter = interpreter_pool->GetInterpreter();
+  auto next_interpreter = interpreter_pool->GetInterpreter();
+  EXPECT_NE(interpreter.get(), next_interpreter.get());
+  TfLiteInterpreterWrapper* const returned = next_interpreter.get();
+
+  absl::Notification got_interpreter;
+  std::unique_ptr<Thread> thread(Env::Default()->StartThread({}, "Waiter", [&] {
+    auto waited_for = interpreter_pool->GetInterpreter();
+    EXPECT_EQ(returned, waited_for.get());
+    got_interpreter.Notify();
+    interpreter_pool->ReturnInterpreter(std::move(waited_for));
+  }));
+  Env::Default()->SleepForMicroseconds(100 * 1000);
+  EXPECT_FALSE(got_interpreter.HasBeenNotified());
+  interpreter_pool->ReturnInterpreter(std::move(next_interpreter));
+  got_interpreter.WaitForNotification();
+  thread.reset();
+  interpreter_pool->ReturnInterpreter(std::move(interpreter));
+}
+
+TEST(TfLiteInterpreterPool, ConcurrentGetAndReturn) {
+  std::string model_bytes;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(),
+                                test_util::TestSrcDirPath(kParseExampleModel),
+                                &model_bytes));
+  auto model = tflite::FlatBufferModel::BuildFromModel(
+      flatbuffers::GetRoot<tflite::Model>(model_bytes.data()));
+  const tensorflow::SessionOptions options;
+  const int kPoolSize = 3;
+  std::unique_ptr<TfLiteInterpreterPool> interpreter_pool;
+  TF_ASSERT_OK(TfLiteInterpreterPool::CreateTfLiteInterpreterPool(
+      model.get(), options, kPoolSize, interpreter_pool));
+
+  std::atomic<int> num_in_use{0};
+  {
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int i = 0; i < 8; ++i) {
+      threads.emplace_back(Env::Default()->StartThread({}, "User", [&] {
+        for (int j = 0; j < 1000; ++j) {
+          auto interpreter = interpreter_pool->GetInterpreter();
+          EXPECT_LE(++num_in_use, kPoolSize);
+          --num_in_use;
+          interpreter_pool->ReturnInterpreter(std::move(interpreter));
+        }
+      }));
+    }
+  }
+
+  // All interpreters made it back into the pool.
+  std::set<TfLiteInterpreterWrapper*> interpreters;
+  std::vector<std::unique_ptr<TfLiteInterpreterWrapper>> taken;
+  for (int i = 0; i < kPoolSize; ++i) {
+    taken.push_back(interpreter_pool->GetInterpreter());
+    interpreters.insert(taken.back().get());
+  }
+  EXPECT_EQ(kPoolSize, interpreters.size());
+  for (auto& interpreter : taken) {
+    interpreter_pool->ReturnInterpreter(std::move(interpreter));
+  }
+}
+
 int GetTensorSize(const TfLiteTensor* tflite_tensor) {
   int size = 1;
   for (int i = 0; i < tflite_tensor->dims->size; ++i) {
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow_serving/servables/tensorflow/tflite_session.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
@@ -23,7 +24,10 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/base/const_init.h"
 #include "absl/functional/bind_front.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
@@ -31,6 +35,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/cpu_backend_context.h"
@@ -49,6 +54,37 @@ namespace serving {
 // Map of TFLite tensor name to <TF TensorInfo, TFLite tensor index>.
 namespace {
 
+auto* planned_interpreter_count = monitoring::Gauge<int64_t, 1>::New(
+    "/tensorflow/serving/tflite/planned_interpreters",
+    "Number of TFLite interpreters planned for a batch size, over all models",
+    "batch_size");
+
+auto* planned_interpreter_bytes = monitoring::Gauge<int64_t, 1>::New(
+    "/tensorflow/serving/tflite/planned_interpreter_bytes",
+    "Bytes of the tensors in the arenas of the TFLite interpreters planned for "
+    "a batch size, over all models",
+    "batch_size");
+
+// Adds the interpreters in 'pools' to the planned interpreter metrics if 'add',
+// and otherwise removes them.
+void UpdatePlannedInterpreterMetrics(
+    const std::vector<std::unique_ptr<internal::TfLiteInterpreterPool>>& pools,
+    const bool add) {
+  static absl::Mutex mu(absl::kConstInit);
+  // Batch size -> {number of interpreters, bytes}, over all sessions.
+  static auto* totals = new std::map<int, std::pair<int64_t, int64_t>>();
+  absl::MutexLock l(&mu);
+  for (const auto& pool : pools) {
+    const int sign = add ? 1 : -1;
+    auto& total = (*totals)[pool->planned_batch_size()];
+    total.first += sign * pool->size();
+    total.second += sign * pool->arena_tensor_bytes();
+    const std::string batch_size = absl::StrCat(pool->planned_batch_size());
+    planned_interpreter_count->GetCell(batch_size)->Set(total.first);
+    planned_interpreter_bytes->GetCell(batch_size)->Set(total.second);
+  }
+}
+
 absl::Status TfLiteTypeToTfType(TfLiteType tflite_type, DataType* type) {
   switch (tflite_type) {
     case kTfLiteNoType:
@@ -160,6 +196,96 @@ std::vector<int> TensorDims(const Tensor& tensor) {
   return dims;
 }
 
+// Returns true if an input of 'tf_dims' can be copied into the first rows of a
+// tensor of 'tflite_dims', planned for 'planned_batch_size' rows.
+bool FitsPlannedBatch(const std::vector<int>& tf_dims,
+                      const std::vector<int>& tflite_dims,
+                      const int planned_batch_size) {
+  return planned_batch_size > 0 && !tf_dims.empty() &&
+         tf_dims.size() == tflite_dims.size() &&
+         tflite_dims[0] == planned_batch_size &&
+         tf_dims[0] <= planned_batch_size &&
+         std::equal(tf_dims.begin() + 1, tf_dims.end(),
+                    tflite_dims.begin() + 1);
+}
+
+// Fills the rows of the TFLite tensor 'tflite_tensor' past the 'num_rows' rows
+// of 'input_bytes' (which have been copied into it) with copies of its first
+// row, as BatchingSession pads batches, so that ops such as Gather only see
+// valid values. Zeroes them if there is no first row.
+void PadPlannedBatchRows(const absl::string_view input_bytes,
+                         const int64_t num_rows, TfLiteTensor* tflite_tensor) {
+  char* const data = tflite_tensor->data.raw;
+  const size_t padded_bytes = tflite_tensor->bytes;
+  if (num_rows == 0 || input_bytes.empty()) {
+    std::memset(data + input_bytes.size(), 0,
+                padded_bytes - input_bytes.size());
+    return;
+  }
+  const size_t row_bytes = input_bytes.size() / num_rows;
+  for (size_t offset = input_bytes.size(); offset < padded_bytes;
+       offset += row_bytes) {
+    std::memcpy(data + offset, data, row_bytes);
+  }
+}
+
+// Returns true if 'tensor' can be bound to the TFLite tensor 'tflite_tensor'
+// in place of its buffer.
+bool CanBindTensorBuffer(const Tensor& tensor,
+                         const TfLiteTensor* tflite_tensor) {
+  const absl::string_view data = tensor.tensor_data();
+  return data.data() != nullptr && data.size() == tflite_tensor->bytes &&
+         reinterpret_cast<uintptr_t>(data.data()) %
+                 tflite::kDefaultTensorAlignment ==
+             0;
+}
+
+// Binds tensors to the outputs of the interpreter, for it to write them in
+// place, and CreateOutputTensors() to return them as they are. The tensors
+// bound by a previous run are kept as long as they still fit and nothing else
+// references them, and new ones are allocated otherwise. Outputs whose size
+// isn't known before invoking the interpreter, or which aren't in its arena
+// to begin with, are left alone.
+absl::Status BindOutputTensors(
+    std::unique_ptr<internal::TfLiteInterpreterWrapper>& interpreter_wrapper) {
+  const auto* interpreter = interpreter_wrapper->Get();
+  for (const int tflite_idx : interpreter->outputs()) {
+    const TfLiteTensor* tflite_tensor = interpreter->tensor(tflite_idx);
+    if (tflite_tensor->allocation_type != kTfLiteArenaRw &&
+        tflite_tensor->allocation_type != kTfLiteCustom) {
+      continue;
+    }
+    DataType tf_type;
+    if (!TfLiteTypeToTfType(tflite_tensor->type, &tf_type).ok() ||
+        !DataTypeCanUseMemcpy(tf_type) ||
+        std::find(interpreter->inputs().begin(), interpreter->inputs().end(),
+                  tflite_idx) != interpreter->inputs().end()) {
+      TF_RETURN_IF_ERROR(interpreter_wrapper->ReleaseBoundTensor(tflite_idx));
+      continue;
+    }
+    TensorShape tf_shape;
+    for (int i = 0; i < tflite_tensor->dims->size; ++i) {
+      tf_shape.AddDim(tflite_tensor->dims->data[i]);
+    }
+    const Tensor* bound_tensor =
+        interpreter_wrapper->GetBoundTensor(tflite_idx);
+    if (bound_tensor != nullptr && bound_tensor->dtype() == tf_type &&
+        bound_tensor->shape() == tf_shape && bound_tensor->RefCountIsOne()) {
+      // Only the wrapper references it, so the outputs of previous runs are
+      // safe from being overwritten.
+      continue;
+    }
+    Tensor output(tf_type, tf_shape);
+    if (CanBindTensorBuffer(output, tflite_tensor)) {
+      TF_RETURN_IF_ERROR(
+          interpreter_wrapper->BindTensorBuffer(tflite_idx, output));
+    } else {
+      TF_RETURN_IF_ERROR(interpreter_wrapper->ReleaseBoundTensor(tflite_idx));
+    }
+  }
+  return absl::OkStatus();
+}
+
 // Create output tensors making sure they are the right size. //
 absl::Status CreateOutputTensors(
     std::unique_ptr<internal::TfLiteInterpreterWrapper>& interpreter_wrapper,
@@ -184,7 +310,15 @@ absl::Status CreateOutputTensors(
     }
     DataType tf_type;
     TF_RETURN_IF_ERROR(TfLiteTypeToTfType(tflite_tensor->type, &tf_type));
-    output_tensors->emplace_back(tf_type, tf_shape);
+    const Tensor* bound_tensor =
+        interpreter_wrapper->GetBoundTensor(tflite_idx);
+    if (bound_tensor != nullptr && bound_tensor->dtype() == tf_type &&
+        bound_tensor->shape() == tf_shape) {
+      // Written in place by the interpreter.
+      output_tensors->push_back(*bound_tensor);
+    } else {
+      output_tensors->emplace_back(tf_type, tf_shape);
+    }
     tflite_idx_to_output_tensor[tflite_idx] = &output_tensors->back();
   }
   return absl::OkStatus();
@@ -194,33 +328,44 @@ absl::Status SetInputAndInvokeMiniBatch(
     std::unique_ptr<internal::TfLiteInterpreterWrapper>& interpreter_wrapper,
     const std::vector<int>& tflite_input_indices,
     const std::vector<std::vector<const Tensor*>>& inputs, int batch_size,
-    int* fixed_batch_size) {
+    int* fixed_batch_size, const bool zero_copy_io) {
   auto* interpreter = interpreter_wrapper->Get();
-  // Load input data from Tensorflow tensors.
+  // Resize all the inputs, then allocate the tensors, and only then write the
+  // inputs, since allocating the tensors may move the buffers of the inputs.
+  // The interpreter may read the inputs in place, until it is invoked.
+  std::vector<Tensor> tf_inputs(tflite_input_indices.size());
+  std::vector<bool> padded(tflite_input_indices.size(), false);
+  bool needs_allocate = false;
   for (int i = 0; i < tflite_input_indices.size(); ++i) {
     int tflite_input_idx = tflite_input_indices[i];
     auto tflite_input_tensor = interpreter->tensor(tflite_input_idx);
     const auto& tf_input_tensors = inputs[i];
     if (tflite_input_tensor->type != kTfLiteString) {
-      const Tensor* tf_input_tensor = tf_input_tensors[0];
-      // concated.tensor_data() may be accessed later.
-      Tensor concated;
       if (tf_input_tensors.size() > 1) {
         std::vector<Tensor> to_concatenate;
         to_concatenate.reserve(tf_input_tensors.size());
         for (const auto* t : tf_input_tensors) {
           to_concatenate.push_back(std::move(*t));
         }
-        TF_RETURN_IF_ERROR(tensor::Concat(to_concatenate, &concated));
-        tf_input_tensor = &concated;
+        TF_RETURN_IF_ERROR(tensor::Concat(to_concatenate, &tf_inputs[i]));
+      } else {
+        tf_inputs[i] = *tf_input_tensors[0];
       }
-      auto tensor_bytes = tf_input_tensor->tensor_data();
-      std::vector<int> tf_dims = TensorDims(*tf_input_tensor);
+      const Tensor& tf_input_tensor = tf_inputs[i];
+      auto tensor_bytes = tf_input_tensor.tensor_data();
+      std::vector<int> tf_dims = TensorDims(tf_input_tensor);
       std::vector<int> tflite_dims(
           tflite_input_tensor->dims->data,
           tflite_input_tensor->dims->data + tflite_input_tensor->dims->size);
-      if (tensor_bytes.size() != tflite_input_tensor->bytes ||
-          tf_dims != tflite_dims) {
+      if (fixed_batch_size != nullptr &&
+          FitsPlannedBatch(tf_dims, tflite_dims,
+                           interpreter_wrapper->GetPlannedBatchSize())) {
+        // Pad the input rather than resizing the tensor. The corresponding
+        // output rows are dropped.
+        *fixed_batch_size = interpreter_wrapper->GetPlannedBatchSize();
+        padded[i] = true;
+      } else if (tensor_bytes.size() != tflite_input_tensor->bytes ||
+                 tf_dims != tflite_dims) {
         if (interpreter->ResizeInputTensor(tflite_input_idx, tf_dims) !=
             kTfLiteOk) {
           return absl::InternalError(absl::StrCat(
@@ -228,30 +373,84 @@ absl::Status SetInputAndInvokeMiniBatch(
               " from ", tflite_input_tensor->bytes, " to ", tensor_bytes.size(),
               " bytes."));
         }
-        if (interpreter->AllocateTensors() != kTfLiteOk) {
-          return absl::InternalError("Failed to allocate tensors");
-        }
+        needs_allocate = true;
       }
-      std::memcpy(tflite_input_tensor->data.raw, tensor_bytes.data(),
-                  tensor_bytes.size());
     } else {
-      // Copy the string tensor data to the input tflite tensor.
       const bool needs_resize =
           fixed_batch_size ? batch_size > interpreter_wrapper->GetBatchSize()
                            : batch_size != interpreter_wrapper->GetBatchSize();
       if (needs_resize) {
-        // std::cout << "resizing to: " << batch_size << std::endl;
         interpreter->ResizeInputTensor(tflite_input_idx, {batch_size});
         interpreter_wrapper->SetBatchSize(batch_size);
-        if (interpreter->AllocateTensors() != kTfLiteOk) {
-          return absl::InternalError("Failed to allocate tensors");
-        }
+        needs_allocate = true;
       }
       if (fixed_batch_size) {
         *fixed_batch_size = interpreter_wrapper->GetBatchSize();
       }
+    }
+  }
+  if (needs_allocate) {
+    TF_RETURN_IF_ERROR(interpreter_wrapper->AllocateTensors());
+  }
+
+  // Bind the buffers, and replan the tensors if binding them requires it,
+  // before writing any input data into the arena.
+  std::vector<bool> bound(tflite_input_indices.size(), false);
+  // Once invoked, or on error, release the bound inputs, which the pooled
+  // interpreter would otherwise keep alive until its next run.
+  auto release_inputs = gtl::MakeCleanup([&interpreter_wrapper, &bound,
+                                          &tflite_input_indices] {
+    for (int i = 0; i < tflite_input_indices.size(); ++i) {
+      if (bound[i]) {
+        interpreter_wrapper->ReleaseBoundTensor(tflite_input_indices[i])
+            .IgnoreError();
+      }
+    }
+  });
+  for (int i = 0; i < tflite_input_indices.size(); ++i) {
+    const int tflite_input_idx = tflite_input_indices[i];
+    const auto* tflite_input_tensor = interpreter->tensor(tflite_input_idx);
+    if (tflite_input_tensor->type == kTfLiteString) {
+      continue;
+    }
+    if (zero_copy_io && !padded[i] &&
+        CanBindTensorBuffer(tf_inputs[i], tflite_input_tensor)) {
+      // Let the interpreter read the input in place.
+      TF_RETURN_IF_ERROR(interpreter_wrapper->BindTensorBuffer(
+          tflite_input_idx, tf_inputs[i]));
+      bound[i] = true;
+    } else {
+      // Don't write over the input of a previous run.
+      TF_RETURN_IF_ERROR(
+          interpreter_wrapper->ReleaseBoundTensor(tflite_input_idx));
+    }
+  }
+  if (zero_copy_io) {
+    TF_RETURN_IF_ERROR(BindOutputTensors(interpreter_wrapper));
+    // Replans the tensors if binding buffers requires it, and does nothing
+    // otherwise.
+    TF_RETURN_IF_ERROR(interpreter_wrapper->AllocateTensors());
+  }
+
+  // Load input data from Tensorflow tensors.
+  for (int i = 0; i < tflite_input_indices.size(); ++i) {
+    const int tflite_input_idx = tflite_input_indices[i];
+    auto tflite_input_tensor = interpreter->tensor(tflite_input_idx);
+    if (tflite_input_tensor->type == kTfLiteString) {
+      // Copy the string tensor data to the input tflite tensor.
       TF_RETURN_IF_ERROR(interpreter_wrapper->SetStringData(
-          tf_input_tensors, tflite_input_tensor, tflite_input_idx, batch_size));
+          inputs[i], tflite_input_tensor, tflite_input_idx, batch_size));
+      continue;
+    }
+    if (bound[i]) {
+      continue;
+    }
+    const auto tensor_bytes = tf_inputs[i].tensor_data();
+    std::memcpy(tflite_input_tensor->data.raw, tensor_bytes.data(),
+                tensor_bytes.size());
+    if (padded[i]) {
+      PadPlannedBatchRows(tensor_bytes, tf_inputs[i].dim_size(0),
+                          tflite_input_tensor);
     }
   }
   if (interpreter_wrapper->Invoke() != kTfLiteOk) {
@@ -274,6 +473,10 @@ absl::Status SetMiniBatchOutput(
     auto tflite_tensor = interpreter->tensor(entry.first);
     if (DataTypeCanUseMemcpy(tf_type)) {
       auto tensor_bytes = tensor->tensor_data();
+      if (tensor_bytes.data() == tflite_tensor->data.raw) {
+        // Bound to the output.
+        continue;
+      }
       int offset = 0;
       size_t tflite_tensor_bytes = tflite_tensor->bytes;
       std::memcpy(const_cast<char*>(tensor_bytes.data() + offset),
@@ -292,6 +495,18 @@ absl::Status SetMiniBatchOutput(
   return absl::OkStatus();
 }
 
+// A serialized model read into a string.
+class StringMemoryRegion : public ReadOnlyMemoryRegion {
+ public:
+  explicit StringMemoryRegion(std::string&& data) : data_(std::move(data)) {}
+
+  const void* data() override { return data_.data(); }
+  uint64 length() override { return data_.size(); }
+
+ private:
+  const std::string data_;
+};
+
 int GetModelBatchSize(const tflite::Model* model) {
   const auto* primary_subgraph = model->subgraphs()->Get(0);
   const auto* inputs = primary_subgraph->inputs();
@@ -426,8 +641,34 @@ absl::Status TfLiteSession::Create(
     int num_interpreters_per_pool,
     std::unique_ptr<TfLiteSession>* tflite_session,
     ::google::protobuf::Map<std::string, SignatureDef>* signatures) {
+  return Create(std::move(buffer), options, num_pools,
+                num_interpreters_per_pool, /*allowed_batch_sizes=*/{},
+                /*zero_copy_io=*/false, TfLiteDelegateConfig(), tflite_session,
+                signatures);
+}
+
+absl::Status TfLiteSession::Create(
+    std::string&& buffer, const SessionOptions& options, int num_pools,
+    int num_interpreters_per_pool, const std::vector<int>& allowed_batch_sizes,
+    const bool zero_copy_io, const TfLiteDelegateConfig& delegate_config,
+    std::unique_ptr<TfLiteSession>* tflite_session,
+    ::google::protobuf::Map<std::string, SignatureDef>* signatures) {
+  return Create(std::make_unique<StringMemoryRegion>(std::move(buffer)),
+                options, num_pools, num_interpreters_per_pool,
+                allowed_batch_sizes, zero_copy_io, delegate_config,
+                tflite_session, signatures);
+}
+
+absl::Status TfLiteSession::Create(
+    std::unique_ptr<ReadOnlyMemoryRegion> model_region,
+    const SessionOptions& options, int num_pools,
+    int num_interpreters_per_pool, const std::vector<int>& allowed_batch_sizes,
+    const bool zero_copy_io, const TfLiteDelegateConfig& delegate_config,
+    std::unique_ptr<TfLiteSession>* tflite_session,
+    ::google::protobuf::Map<std::string, SignatureDef>* signatures) {
+  // Constant tensors point into the model, so all interpreters share them.
   auto model = tflite::FlatBufferModel::BuildFromModel(
-      flatbuffers::GetRoot<tflite::Model>(buffer.data()));
+      flatbuffers::GetRoot<tflite::Model>(model_region->data()));
   if (model == nullptr) {
     return absl::InvalidArgumentError(
         "Cannot build FlatBufferModel from buffer.");
@@ -510,14 +751,67 @@ absl::Status TfLiteSession::Create(
   const int num_interpreters = std::max(1, num_pools);
   const int model_batch_size = GetModelBatchSize(model->GetModel());
 
+  internal::TfLiteDelegateOptions delegate_options;
+  if (delegate_config.has_xnnpack()) {
+    delegate_options.xnnpack_num_threads =
+        std::max(1, delegate_config.xnnpack().num_threads());
+    if (delegate_config.xnnpack().enable_weights_cache()) {
+      TfLiteXNNPackDelegateWeightsCache* const weights_cache =
+          TfLiteXNNPackDelegateWeightsCacheCreate();
+      if (weights_cache == nullptr) {
+        return absl::InternalError(
+            "Failed to create the XNNPACK weights cache");
+      }
+      delegate_options.xnnpack_weights_cache.reset(
+          weights_cache, TfLiteXNNPackDelegateWeightsCacheDelete);
+    }
+  }
+
   std::unique_ptr<internal::TfLiteInterpreterPool> interpreter_pool;
   TF_RETURN_IF_ERROR(
       internal::TfLiteInterpreterPool::CreateTfLiteInterpreterPool(
-          model.get(), options, num_interpreters, interpreter_pool));
+          model.get(), options, num_interpreters, /*planned_batch_size=*/0,
+          delegate_options, interpreter_pool));
+
+  std::vector<int> planned_batch_sizes = allowed_batch_sizes;
+  std::sort(planned_batch_sizes.begin(), planned_batch_sizes.end());
+  planned_batch_sizes.erase(
+      std::unique(planned_batch_sizes.begin(), planned_batch_sizes.end()),
+      planned_batch_sizes.end());
+  std::vector<std::unique_ptr<internal::TfLiteInterpreterPool>>
+      planned_interpreter_pools;
+  for (const int batch_size : planned_batch_sizes) {
+    std::unique_ptr<internal::TfLiteInterpreterPool> planned_interpreter_pool;
+    const absl::Status status =
+        internal::TfLiteInterpreterPool::CreateTfLiteInterpreterPool(
+            model.get(), options, num_interpreters, batch_size,
+            delegate_options, planned_interpreter_pool);
+    if (!status.ok()) {
+      LOG(WARNING) << "Not planning TFLite interpreters for the allowed batch "
+                      "sizes: "
+                   << status;
+      planned_interpreter_pools.clear();
+      break;
+    }
+    LOG(INFO) << "Planned " << planned_interpreter_pool->size()
+              << " TFLite interpreters for batch size " << batch_size
+              << ", with " << planned_interpreter_pool->arena_tensor_bytes()
+              << " bytes of tensors";
+    planned_interpreter_pools.push_back(std::move(planned_interpreter_pool));
+  }
+
+  // All the interpreters have packed their weights by now. They may still
+  // look them up when they are resized, which soft finalization allows.
+  if (delegate_options.xnnpack_weights_cache != nullptr &&
+      !TfLiteXNNPackDelegateWeightsCacheFinalizeSoft(
+          delegate_options.xnnpack_weights_cache.get())) {
+    return absl::InternalError("Failed to finalize the XNNPACK weights cache");
+  }
 
   tflite_session->reset(new TfLiteSession(
       std::move(input_tensor_to_index), std::move(output_tensor_to_index),
-      std::move(buffer), std::move(model), std::move(interpreter_pool)));
+      std::move(model_region), std::move(model), std::move(interpreter_pool),
+      std::move(planned_interpreter_pools), zero_copy_io));
 
   if (num_interpreters_per_pool > 1) {
     const int default_allowed_batch =
@@ -543,14 +837,36 @@ absl::Status TfLiteSession::Create(
 
 TfLiteSession::TfLiteSession(
     std::map<std::string, int>&& input_tensor_to_index,
-    std::map<std::string, int>&& output_tensor_to_index, std::string&& buffer,
+    std::map<std::string, int>&& output_tensor_to_index,
+    std::unique_ptr<ReadOnlyMemoryRegion> model_region,
     std::unique_ptr<tflite::FlatBufferModel> model,
-    std::unique_ptr<internal::TfLiteInterpreterPool> interpreter_pool)
+    std::unique_ptr<internal::TfLiteInterpreterPool> interpreter_pool,
+    std::vector<std::unique_ptr<internal::TfLiteInterpreterPool>>
+        planned_interpreter_pools,
+    const bool zero_copy_io)
     : input_tensor_to_index_(std::move(input_tensor_to_index)),
       output_tensor_to_index_(std::move(output_tensor_to_index)),
-      model_serialized_bytes_(std::move(buffer)),
+      model_region_(std::move(model_region)),
       model_(std::move(model)),
-      interpreter_pool_(std::move(interpreter_pool)) {}
+      interpreter_pool_(std::move(interpreter_pool)),
+      planned_interpreter_pools_(std::move(planned_interpreter_pools)),
+      zero_copy_io_(zero_copy_io) {
+  UpdatePlannedInterpreterMetrics(planned_interpreter_pools_, /*add=*/true);
+}
+
+TfLiteSession::~TfLiteSession() {
+  UpdatePlannedInterpreterMetrics(planned_interpreter_pools_, /*add=*/false);
+}
+
+internal::TfLiteInterpreterPool* TfLiteSession::GetInterpreterPool(
+    const int batch_size) const {
+  for (const auto& planned_interpreter_pool : planned_interpreter_pools_) {
+    if (planned_interpreter_pool->planned_batch_size() >= batch_size) {
+      return planned_interpreter_pool.get();
+    }
+  }
+  return interpreter_pool_.get();
+}
 
 absl::Status TfLiteSession::Run(
     const std::vector<std::pair<std::string, Tensor>>& inputs,
@@ -578,18 +894,30 @@ absl::Status TfLiteSession::RunInternal(
     const std::vector<std::string>& output_tensor_names,
     std::vector<Tensor>* combined_outputs, int batch_size,
     int* fixed_batch_size) {
-#define RETURN_POOL_IF_ERROR(...)                                   \
-  do {                                                              \
-    ::tensorflow::Status _status = (__VA_ARGS__);                   \
-    if (TF_PREDICT_FALSE(!_status.ok())) {                          \
-      interpreter_pool_->ReturnInterpreter(std::move(interpreter)); \
-      return _status;                                               \
-    }                                                               \
+#define RETURN_POOL_IF_ERROR(...)                                  \
+  do {                                                             \
+    ::tensorflow::Status _status = (__VA_ARGS__);                  \
+    if (TF_PREDICT_FALSE(!_status.ok())) {                         \
+      interpreter_pool->ReturnInterpreter(std::move(interpreter)); \
+      return _status;                                              \
+    }                                                              \
   } while (0);
-  auto interpreter = interpreter_pool_->GetInterpreter();
+  internal::TfLiteInterpreterPool* const interpreter_pool =
+      GetInterpreterPool(batch_size);
+  // Interpreters planned for a batch size pad the inputs to it. Unless the
+  // caller takes care of the padding in the outputs, we drop it below.
+  int padded_batch_size = batch_size;
+  const bool drop_output_padding = fixed_batch_size == nullptr &&
+                                   interpreter_pool->planned_batch_size() > 0;
+  if (drop_output_padding) {
+    fixed_batch_size = &padded_batch_size;
+  }
+  const int num_previous_outputs = combined_outputs->size();
+  auto interpreter = interpreter_pool->GetInterpreter();
   RETURN_POOL_IF_ERROR(
       SetInputAndInvokeMiniBatch(interpreter, tflite_input_indices,
-                                 merged_inputs, batch_size, fixed_batch_size));
+                                 merged_inputs, batch_size, fixed_batch_size,
+                                 zero_copy_io_));
 
   // Create return tensors and map the tflite tensor index to the
   // index of the created tensor.
@@ -603,7 +931,15 @@ absl::Status TfLiteSession::RunInternal(
       interpreter, tflite_idx_to_output_tensor, combined_outputs));
 
 #undef RETURN_POOL_IF_ERROR
-  interpreter_pool_->ReturnInterpreter(std::move(interpreter));
+  interpreter_pool->ReturnInterpreter(std::move(interpreter));
+
+  if (drop_output_padding && padded_batch_size > batch_size) {
+    for (int i = num_previous_outputs; i < combined_outputs->size(); ++i) {
+      Tensor& output = (*combined_outputs)[i];
+      // Starts at the beginning of the buffer, so it is aligned.
+      output = output.Slice(0, batch_size);
+    }
+  }
   return absl::OkStatus();
 }
 
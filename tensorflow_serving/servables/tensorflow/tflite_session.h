@@ -36,6 +36,7 @@ limitations under the License.
 #include "tensorflow/lite/model.h"
 #include "tensorflow_serving/batching/threadsafe_status.h"
 #include "tensorflow_serving/servables/tensorflow/serving_session.h"
+#include "tensorflow_serving/servables/tensorflow/session_bundle_config.pb.h"
 #include "tensorflow_serving/servables/tensorflow/tflite_interpreter_pool.h"
 
 namespace tensorflow {
@@ -141,6 +142,40 @@ class TfLiteSession : public ServingSession {
                        std::unique_ptr<TfLiteSession>* tflite_session,
                        ::google::protobuf::Map<string, SignatureDef>* signatures);
 
+  // Same as above, but also creates interpreters planned for each of
+  // 'allowed_batch_sizes' (as many as for the default pool), so that batches
+  // are run without resizing the inputs and re-planning the tensors of the
+  // interpreters. Batches are padded to the smallest of the allowed batch
+  // sizes that fits them, and larger ones are run on the default interpreters.
+  // If the model can't be run on padded batches, e.g. because its outputs
+  // aren't batched, only the default interpreters are created.
+  //
+  // If 'zero_copy_io' is true, the interpreters read the inputs and write the
+  // outputs of each batch in place, where their buffers are suitably aligned,
+  // instead of copying them in and out of their arenas. Interpreters then
+  // keep a reference to the tensors of their last batch.
+  //
+  // The delegates of 'delegate_config' are applied to all the interpreters.
+  static Status Create(string&& buffer, const SessionOptions& options,
+                       int num_pools, int num_interpreters_per_pool,
+                       const std::vector<int>& allowed_batch_sizes,
+                       bool zero_copy_io,
+                       const TfLiteDelegateConfig& delegate_config,
+                       std::unique_ptr<TfLiteSession>* tflite_session,
+                       ::google::protobuf::Map<string, SignatureDef>* signatures);
+
+  // Same as above, but with the model in 'model_region', e.g. a file mapped
+  // into memory, which the session keeps and runs the model from rather than
+  // copying it.
+  static Status Create(std::unique_ptr<ReadOnlyMemoryRegion> model_region,
+                       const SessionOptions& options, int num_pools,
+                       int num_interpreters_per_pool,
+                       const std::vector<int>& allowed_batch_sizes,
+                       bool zero_copy_io,
+                       const TfLiteDelegateConfig& delegate_config,
+                       std::unique_ptr<TfLiteSession>* tflite_session,
+                       ::google::protobuf::Map<string, SignatureDef>* signatures);
+
   static Status CreateDefaultBasicBatchScheduler(
       const BasicBatchScheduler<TfLiteBatchTask>::Options& options,
       std::function<void(std::unique_ptr<Batch<TfLiteBatchTask>>)>
@@ -152,7 +187,7 @@ class TfLiteSession : public ServingSession {
       int open_batch_remaining_slot, int max_batch_size,
       std::vector<std::unique_ptr<TfLiteBatchTask>>* output_tasks);
 
-  ~TfLiteSession() override = default;
+  ~TfLiteSession() override;
 
   Status Run(const std::vector<std::pair<string, Tensor>>& inputs,
              const std::vector<string>& output_tensor_names,
@@ -185,9 +220,15 @@ class TfLiteSession : public ServingSession {
  private:
   TfLiteSession(
       std::map<string, int>&& input_tensor_to_index,
-      std::map<string, int>&& output_tensor_to_index, string&& buffer,
+      std::map<string, int>&& output_tensor_to_index,
+      std::unique_ptr<ReadOnlyMemoryRegion> model_region,
       std::unique_ptr<tflite::FlatBufferModel> model,
-      std::unique_ptr<internal::TfLiteInterpreterPool> interpreter_pool);
+      std::unique_ptr<internal::TfLiteInterpreterPool> interpreter_pool,
+      std::vector<std::unique_ptr<internal::TfLiteInterpreterPool>>
+          planned_interpreter_pools,
+      bool zero_copy_io);
+  // Returns the pool of interpreters to run a batch of 'batch_size' on.
+  internal::TfLiteInterpreterPool* GetInterpreterPool(int batch_size) const;
   Status RunInternal(
       const std::vector<int>& tflite_input_indices,
       const std::vector<std::vector<const Tensor*>>& merged_inputs,
@@ -196,9 +237,15 @@ class TfLiteSession : public ServingSession {
       int* fixed_batch_size = nullptr);
   const std::map<string, int> input_tensor_to_index_;
   const std::map<string, int> output_tensor_to_index_;
-  const string model_serialized_bytes_;
+  // Holds the serialized model, which 'model_' points into.
+  const std::unique_ptr<ReadOnlyMemoryRegion> model_region_;
   const std::unique_ptr<tflite::FlatBufferModel> model_;
   const std::unique_ptr<internal::TfLiteInterpreterPool> interpreter_pool_;
+  // Pools of interpreters planned for the allowed batch sizes, in increasing
+  // order of batch size.
+  const std::vector<std::unique_ptr<internal::TfLiteInterpreterPool>>
+      planned_interpreter_pools_;
+  const bool zero_copy_io_;
   bool use_fixed_batch_size_;
   std::unique_ptr<BasicBatchScheduler<TfLiteBatchTask>> scheduler_;
   BasicBatchScheduler<TfLiteBatchTask>::Options scheduler_options_;
@@ -141,6 +141,141 @@ TEST(TfLiteSession, BasicTest) {
   }
 }
 
+TEST(TfLiteSession, PlannedBatchSizesTest) {
+  std::string model_bytes;
+  TF_ASSERT_OK(ReadFileToString(tensorflow::Env::Default(),
+                                test_util::TestSrcDirPath(kTestModel),
+                                &model_bytes));
+
+  ::google::protobuf::Map<std::string, SignatureDef> signatures;
+  std::unique_ptr<TfLiteSession> session;
+  tensorflow::SessionOptions options;
+  TF_ASSERT_OK(TfLiteSession::Create(std::move(model_bytes), options,
+                                     /*num_pools=*/1,
+                                     /*num_interpreters_per_pool=*/1,
+                                     /*allowed_batch_sizes=*/{4, 2},
+                                     /*zero_copy_io=*/false,
+                                     TfLiteDelegateConfig(), &session,
+                                     &signatures));
+  // Batches of up to 2 and 4 are padded, larger ones are run by resizing.
+  for (int batch_size : {1, 2, 3, 4, 5, 3, 1}) {
+    std::vector<float> x(batch_size);
+    std::vector<float> expected_y(batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+      x[i] = i;
+      expected_y[i] = i / 2.0 + 2;
+    }
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run(
+        {{"x", test::AsTensor<float>(x, TensorShape({batch_size, 1}))}}, {"y"},
+        {}, &outputs));
+    ASSERT_EQ(outputs.size(), 1);
+    test::ExpectTensorEqual<float>(
+        outputs[0],
+        test::AsTensor<float>(expected_y, TensorShape({batch_size, 1})));
+  }
+}
+
+TEST(TfLiteSession, ZeroCopyIoTest) {
+  std::string model_bytes;
+  TF_ASSERT_OK(ReadFileToString(tensorflow::Env::Default(),
+                                test_util::TestSrcDirPath(kTestModel),
+                                &model_bytes));
+
+  ::google::protobuf::Map<std::string, SignatureDef> signatures;
+  std::unique_ptr<TfLiteSession> session;
+  tensorflow::SessionOptions options;
+  TF_ASSERT_OK(TfLiteSession::Create(std::move(model_bytes), options,
+                                     /*num_pools=*/1,
+                                     /*num_interpreters_per_pool=*/1,
+                                     /*allowed_batch_sizes=*/{},
+                                     /*zero_copy_io=*/true,
+                                     TfLiteDelegateConfig(), &session,
+                                     &signatures));
+  std::vector<Tensor> first_outputs;
+  TF_ASSERT_OK(session->Run(
+      {{"x", test::AsTensor<float>({1.0, 2.0, 3.0}, TensorShape({3}))}}, {"y"},
+      {}, &first_outputs));
+  ASSERT_EQ(first_outputs.size(), 1);
+  test::ExpectTensorEqual<float>(
+      first_outputs[0], test::AsTensor<float>({2.5, 3, 3.5}, TensorShape({3})));
+
+  // The outputs of a run aren't overwritten by the next ones, whether their
+  // inputs are bound or copied (since they aren't aligned) or resized.
+  const Tensor input =
+      test::AsTensor<float>({0.0, 4.0, 6.0, 8.0, 10.0}, TensorShape({5}));
+  for (const Tensor& next_input :
+       {input.Slice(0, 3), input.Slice(1, 4), input}) {
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({{"x", next_input}}, {"y"}, {}, &outputs));
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_EQ(outputs[0].NumElements(), next_input.NumElements());
+    for (int i = 0; i < next_input.NumElements(); ++i) {
+      EXPECT_EQ(outputs[0].flat<float>()(i),
+                next_input.unaligned_flat<float>()(i) / 2 + 2);
+    }
+  }
+  test::ExpectTensorEqual<float>(
+      first_outputs[0], test::AsTensor<float>({2.5, 3, 3.5}, TensorShape({3})));
+
+  // Once nothing references the outputs of a run, the next run of the same
+  // size writes its outputs into the same buffers.
+  const char* output_data = nullptr;
+  for (int run = 0; run < 2; ++run) {
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({{"x", input}}, {"y"}, {}, &outputs));
+    ASSERT_EQ(outputs.size(), 1);
+    test::ExpectTensorEqual<float>(
+        outputs[0],
+        test::AsTensor<float>({2, 4, 5, 6, 7}, TensorShape({5})));
+    if (run == 0) {
+      output_data = outputs[0].tensor_data().data();
+    } else {
+      EXPECT_EQ(outputs[0].tensor_data().data(), output_data);
+    }
+  }
+
+  // The session doesn't reference the inputs once they've been run.
+  EXPECT_TRUE(input.RefCountIsOne());
+}
+
+TEST(TfLiteSession, XnnpackDelegateTest) {
+  std::string model_bytes;
+  TF_ASSERT_OK(ReadFileToString(tensorflow::Env::Default(),
+                                test_util::TestSrcDirPath(kTestModel),
+                                &model_bytes));
+
+  ::google::protobuf::Map<std::string, SignatureDef> signatures;
+  std::unique_ptr<TfLiteSession> session;
+  tensorflow::SessionOptions options;
+  TfLiteDelegateConfig delegate_config;
+  delegate_config.mutable_xnnpack()->set_num_threads(2);
+  delegate_config.mutable_xnnpack()->set_enable_weights_cache(true);
+  // The weights cache is shared by the interpreters of all the pools.
+  TF_ASSERT_OK(TfLiteSession::Create(std::move(model_bytes), options,
+                                     /*num_pools=*/2,
+                                     /*num_interpreters_per_pool=*/1,
+                                     /*allowed_batch_sizes=*/{2},
+                                     /*zero_copy_io=*/false, delegate_config,
+                                     &session, &signatures));
+  for (int batch_size : {1, 2, 3}) {
+    std::vector<float> x(batch_size);
+    std::vector<float> expected_y(batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+      x[i] = i;
+      expected_y[i] = i / 2.0 + 2;
+    }
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run(
+        {{"x", test::AsTensor<float>(x, TensorShape({batch_size, 1}))}}, {"y"},
+        {}, &outputs));
+    ASSERT_EQ(outputs.size(), 1);
+    test::ExpectTensorEqual<float>(
+        outputs[0],
+        test::AsTensor<float>(expected_y, TensorShape({batch_size, 1})));
+  }
+}
+
 TEST(TfLiteSession, ResizeWithSameNumElementsTest) {
   std::string model_bytes;
   TF_ASSERT_OK(ReadFileToString(tensorflow::Env::Default(),
@@ -404,6 +539,89 @@ std::string BuildTestModel(
                         use_flex_op, signature_def_map);
 }
 
+// Returns a serialized FlatBuffer tflite model, which gathers the rows of the
+// constant 'kGatherModelParams' (an embedding table of 4 rows of 2 floats)
+// selected by its int32 input "ids", of shape [1], into its output
+// "embeddings", of shape [1, 2].
+constexpr float kGatherModelParams[] = {0, 1, 10, 11, 20, 21, 30, 31};
+
+std::string BuildGatherModel() {
+  flatbuffers::FlatBufferBuilder builder;
+  std::vector<flatbuffers::Offset<tflite::Buffer>> buffers;
+  // Buffer 0 is the empty buffer of the tensors without data.
+  buffers.push_back(tflite::CreateBuffer(builder));
+  buffers.push_back(tflite::CreateBuffer(
+      builder, builder.CreateVector(
+                   reinterpret_cast<const uint8_t*>(kGatherModelParams),
+                   sizeof(kGatherModelParams))));
+
+  std::vector<flatbuffers::Offset<tflite::Tensor>> tensors;
+  tensors.push_back(CreateTensor(builder, builder.CreateVector<int>({4, 2}),
+                                 tflite::TensorType_FLOAT32, /*buffer=*/1,
+                                 builder.CreateString("params")));
+  tensors.push_back(CreateTensor(builder, builder.CreateVector<int>({1}),
+                                 tflite::TensorType_INT32, /*buffer=*/0,
+                                 builder.CreateString("ids")));
+  tensors.push_back(CreateTensor(builder, builder.CreateVector<int>({1, 2}),
+                                 tflite::TensorType_FLOAT32, /*buffer=*/0,
+                                 builder.CreateString("embeddings")));
+  const std::vector<int32_t> inputs = {1};
+  const std::vector<int32_t> outputs = {2};
+
+  std::vector<flatbuffers::Offset<tflite::OperatorCode>> opcodes = {
+      CreateOperatorCode(builder, tflite::BuiltinOperator_GATHER, 0)};
+  std::vector<flatbuffers::Offset<tflite::Operator>> operators = {
+      CreateOperator(builder, /*opcode_index=*/0,
+                     builder.CreateVector<int32_t>({0, 1}),
+                     builder.CreateVector<int32_t>(outputs),
+                     tflite::BuiltinOptions_GatherOptions,
+                     tflite::CreateGatherOptions(builder, /*axis=*/0).Union())};
+
+  auto subgraph = CreateSubGraph(builder, builder.CreateVector(tensors),
+                                 builder.CreateVector<int32_t>(inputs),
+                                 builder.CreateVector<int32_t>(outputs),
+                                 builder.CreateVector(operators));
+  builder.Finish(CreateModel(
+      builder, TFLITE_SCHEMA_VERSION, builder.CreateVector(opcodes),
+      builder.CreateVector(&subgraph, 1), builder.CreateString("gathermodel"),
+      builder.CreateVector(buffers)));
+  return std::string(reinterpret_cast<char*>(builder.GetBufferPointer()),
+                     builder.GetSize());
+}
+
+// The rows padding an input to a planned batch size are valid ids, whatever
+// the arena held before.
+TEST(TfLiteSession, PlannedBatchSizesGatherTest) {
+  ::google::protobuf::Map<std::string, SignatureDef> signatures;
+  std::unique_ptr<TfLiteSession> session;
+  TF_ASSERT_OK(TfLiteSession::Create(BuildGatherModel(), SessionOptions(),
+                                     /*num_pools=*/1,
+                                     /*num_interpreters_per_pool=*/1,
+                                     /*allowed_batch_sizes=*/{4},
+                                     /*zero_copy_io=*/false,
+                                     TfLiteDelegateConfig(), &session,
+                                     &signatures));
+  // Batches of fewer than 4 ids are padded, and out-of-range padding ids
+  // would fail the run.
+  for (const std::vector<int32_t>& ids :
+       std::vector<std::vector<int32_t>>{{3}, {2, 1, 0}, {1, 3}, {0}}) {
+    std::vector<float> expected;
+    for (const int32_t id : ids) {
+      expected.push_back(kGatherModelParams[2 * id]);
+      expected.push_back(kGatherModelParams[2 * id + 1]);
+    }
+    const int batch_size = ids.size();
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run(
+        {{"ids", test::AsTensor<int32_t>(ids, TensorShape({batch_size}))}},
+        {"embeddings"}, {}, &outputs));
+    ASSERT_EQ(outputs.size(), 1);
+    test::ExpectTensorEqual<float>(
+        outputs[0],
+        test::AsTensor<float>(expected, TensorShape({batch_size, 2})));
+  }
+}
+
 TEST(TfLiteSession, ProcessStrings) {
   auto model_signature_def_map = GetTestSignatureDefMap();
   std::string model_bytes =
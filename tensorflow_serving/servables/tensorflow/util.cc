@@ -18,6 +18,7 @@ limitations under the License.
 #include <algorithm>
 #include <atomic>
 #include <cstdlib>
+#include <cstring>
 #include <deque>
 #include <iterator>
 #include <set>
@@ -25,8 +26,20 @@ limitations under the License.
 #include <vector>
 
 #include "google/protobuf/wrappers.pb.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "tensorflow/cc/saved_model/constants.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/core/example/example.pb.h"
+#include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
@@ -34,9 +47,11 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/cord.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/threadpool_options.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/example_proto_helper.h"
 #include "tensorflow_serving/apis/input.pb.h"
 #include "tensorflow_serving/apis/internal/serialized_input.pb.h"
 #include "tensorflow_serving/apis/model.pb.h"
@@ -88,6 +103,7 @@ auto* request_latency = monitoring::Sampler<3>::New(
     },  // Scale of 10, power of 1.8 with bucket count 33 (~20 minutes).
     monitoring::Buckets::Exponential(10, 1.8, 33));
 
+#if defined(PLATFORM_GOOGLE)
 // Returns the number of examples in the Input.
 int NumInputExamples(const internal::SerializedInput& input) {
   switch (input.kind_case()) {
@@ -100,9 +116,234 @@ int NumInputExamples(const internal::SerializedInput& input) {
   }
   return 0;
 }
+#endif
 
 std::atomic<bool> signature_method_check{false};
 
+// Gets the disk size of the checkpoint data files of the saved model in the
+// given path, i.e. of the variable values, or 0 if it has no checkpoint.
+absl::Status GetVariablesDataDiskSize(const std::string& path,
+                                      FileProbingEnv* env,
+                                      uint64_t* total_file_size) {
+  *total_file_size = 0;
+  const std::string variables_dir =
+      io::JoinPath(path, kSavedModelVariablesDirectory);
+  if (!env->FileExists(variables_dir).ok()) {
+    return absl::OkStatus();
+  }
+  std::vector<std::string> children;
+  TF_RETURN_IF_ERROR(env->GetChildren(variables_dir, &children));
+  const std::string data_file_prefix =
+      absl::StrCat(kSavedModelVariablesFilename, ".data-");
+  for (const std::string& child : children) {
+    if (!absl::StartsWith(child, data_file_prefix)) {
+      continue;
+    }
+    uint64_t file_size;
+    TF_RETURN_IF_ERROR(
+        env->GetFileSize(io::JoinPath(variables_dir, child), &file_size));
+    *total_file_size += file_size;
+  }
+  return absl::OkStatus();
+}
+
+// Returns the name of the node producing 'tensor_name', which may also be a
+// control input (i.e. "^node").
+absl::string_view NodeName(absl::string_view tensor_name) {
+  absl::ConsumePrefix(&tensor_name, "^");
+  return tensor_name.substr(0, tensor_name.find(':'));
+}
+
+// Returns 'tensor_name' with its output index, which GraphDefs leave out for
+// the first output of a node.
+std::string CanonicalTensorName(absl::string_view tensor_name) {
+  if (tensor_name.find(':') == absl::string_view::npos) {
+    return absl::StrCat(tensor_name, ":0");
+  }
+  return std::string(tensor_name);
+}
+
+// Gets attribute 'name' of 'node'.
+absl::Status GetAttr(const NodeDef& node, const std::string& name,
+                     const AttrValue** value) {
+  auto iter = node.attr().find(name);
+  if (iter == node.attr().end()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Node ", node.name(), " has no attribute ", name));
+  }
+  *value = &iter->second;
+  return absl::OkStatus();
+}
+
+// Gets the value of the Const node that feeds input 'index' of 'node', possibly
+// through Identity or Reshape nodes (which tf.io.parse_example puts between
+// the default values and the op), in which case it keeps the shape of the
+// Const.
+absl::Status GetConstantInput(
+    const absl::flat_hash_map<absl::string_view, const NodeDef*>& nodes,
+    const NodeDef& node, const int index, Tensor* value) {
+  if (index >= node.input_size()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Node ", node.name(), " has no input ", index));
+  }
+  auto iter = nodes.find(NodeName(node.input(index)));
+  while (iter != nodes.end() &&
+         (iter->second->op() == "Identity" ||
+          iter->second->op() == "Reshape") &&
+         iter->second->input_size() > 0) {
+    iter = nodes.find(NodeName(iter->second->input(0)));
+  }
+  if (iter == nodes.end() || iter->second->op() != "Const") {
+    return absl::UnimplementedError(absl::StrCat(
+        "Input ", node.input(index), " of node ", node.name(),
+        " is not a constant."));
+  }
+  const AttrValue* attr;
+  TF_RETURN_IF_ERROR(GetAttr(*iter->second, "value", &attr));
+  if (!value->FromProto(attr->tensor())) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid value of constant ", iter->second->name()));
+  }
+  return absl::OkStatus();
+}
+
+// Gets the 'num_keys' feature keys that inputs ['begin', 'end') of 'node' hold,
+// either one per input (ParseExample) or all in one (ParseExampleV2).
+absl::Status GetFeatureKeys(
+    const absl::flat_hash_map<absl::string_view, const NodeDef*>& nodes,
+    const NodeDef& node, const int begin, const int end, const int num_keys,
+    std::vector<std::string>* keys) {
+  for (int i = begin; i < end; ++i) {
+    Tensor value;
+    TF_RETURN_IF_ERROR(GetConstantInput(nodes, node, i, &value));
+    if (value.dtype() != DT_STRING) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Feature keys of node ", node.name(), " are not strings."));
+    }
+    const auto value_flat = value.flat<tstring>();
+    for (int j = 0; j < value_flat.size(); ++j) {
+      keys->emplace_back(value_flat(j));
+    }
+  }
+  if (static_cast<int>(keys->size()) != num_keys) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Node ", node.name(), " has ", keys->size(),
+                     " feature keys for ", num_keys, " features."));
+  }
+  return absl::OkStatus();
+}
+
+// Returns the feature 'key' of 'example', or nullptr if it has none.
+const Feature* FindFeature(const Example& example, const std::string& key) {
+  const auto& features = example.features().feature();
+  auto iter = features.find(key);
+  return iter == features.end() ? nullptr : &iter->second;
+}
+
+// Returns an error unless 'feature' holds values of type 'dtype'.
+absl::Status CheckFeatureType(const Feature& feature, const std::string& key,
+                              const DataType dtype) {
+  bool types_match;
+  TF_RETURN_IF_ERROR(CheckTypesMatch(feature, dtype, &types_match));
+  if (!types_match) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Feature: ", key, ". Data types don't match. Expected type: ",
+        DataTypeString(dtype), ", Feature is: ", feature.DebugString()));
+  }
+  return absl::OkStatus();
+}
+
+// Parses the dense 'feature' of 'examples' into a [batch_size, ...] tensor.
+// Examples lacking it get the one of 'context' if any, parsed once, and
+// otherwise its default value.
+absl::Status ParseDenseFeature(const FixedLenFeature& feature,
+                               const std::vector<const Example*>& examples,
+                               const Example* context, Tensor* values) {
+  Tensor missing_value = feature.default_value;
+  const Feature* context_feature =
+      context == nullptr ? nullptr : FindFeature(*context, feature.key);
+  if (context_feature != nullptr) {
+    TF_RETURN_IF_ERROR(
+        CheckFeatureType(*context_feature, feature.key, feature.dtype));
+    missing_value = Tensor(feature.dtype, feature.shape);
+    TF_RETURN_IF_ERROR(FeatureDenseCopy(0, "context", feature.key,
+                                        feature.dtype, feature.shape,
+                                        *context_feature, &missing_value));
+  }
+
+  const int batch_size = examples.size();
+  TensorShape shape = feature.shape;
+  shape.InsertDim(0, batch_size);
+  *values = Tensor(feature.dtype, shape);
+  for (int i = 0; i < batch_size; ++i) {
+    const Feature* example_feature = FindFeature(*examples[i], feature.key);
+    if (example_feature != nullptr) {
+      TF_RETURN_IF_ERROR(
+          CheckFeatureType(*example_feature, feature.key, feature.dtype));
+      TF_RETURN_IF_ERROR(FeatureDenseCopy(i, "", feature.key, feature.dtype,
+                                          feature.shape, *example_feature,
+                                          values));
+    } else if (missing_value.NumElements() > 0) {
+      RowDenseCopy(i, feature.dtype, missing_value, values);
+    } else {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Feature: ", feature.key, " (data type: ",
+          DataTypeString(feature.dtype),
+          ") is required but could not be found."));
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Parses the sparse 'feature' of 'examples' into the indices, values and dense
+// shape of a SparseTensor. Examples lacking it share the values of 'context'
+// if any, parsed once.
+absl::Status ParseSparseFeature(const VarLenFeature& feature,
+                                const std::vector<const Example*>& examples,
+                                const Example* context, Tensor* indices,
+                                Tensor* values, Tensor* dense_shape) {
+  Tensor missing_values(feature.dtype, TensorShape({0}));
+  const Feature* context_feature =
+      context == nullptr ? nullptr : FindFeature(*context, feature.key);
+  if (context_feature != nullptr) {
+    TF_RETURN_IF_ERROR(
+        CheckFeatureType(*context_feature, feature.key, feature.dtype));
+    missing_values =
+        FeatureSparseCopy(0, feature.key, feature.dtype, *context_feature);
+  }
+
+  const int batch_size = examples.size();
+  std::vector<Tensor> example_values;
+  example_values.reserve(batch_size);
+  for (int i = 0; i < batch_size; ++i) {
+    const Feature* example_feature = FindFeature(*examples[i], feature.key);
+    if (example_feature != nullptr) {
+      TF_RETURN_IF_ERROR(
+          CheckFeatureType(*example_feature, feature.key, feature.dtype));
+      example_values.push_back(
+          FeatureSparseCopy(i, feature.key, feature.dtype, *example_feature));
+    } else {
+      // Shares the buffer of 'missing_values'.
+      example_values.push_back(missing_values);
+    }
+  }
+
+  VarLenFeatureBatchShapes shapes;
+  TF_RETURN_IF_ERROR(
+      GetSparseTensorShapes(feature, example_values, batch_size, &shapes));
+  *indices = Tensor(DT_INT64, shapes.indices_shape);
+  *values = Tensor(feature.dtype, shapes.values_shape);
+  int64_t offset = 0;
+  for (int i = 0; i < batch_size; ++i) {
+    offset += CopyIntoSparseTensor(example_values[i], i, offset, indices,
+                                   values);
+  }
+  *dense_shape = Tensor(DT_INT64, TensorShape({2}));
+  dense_shape->vec<int64_t>()(0) = batch_size;
+  dense_shape->vec<int64_t>()(1) = shapes.max_num_features;
+  return absl::OkStatus();
+}
+
 }  // namespace
 
 namespace internal {
@@ -133,6 +374,7 @@ void RecordRequestExampleCount(const std::string& model_name, size_t count) {
 
 absl::Status InputToSerializedExampleTensor(const Input& input,
                                             Tensor* examples) {
+#if defined(PLATFORM_GOOGLE)
   internal::SerializedInput serialized_input;
   // There's a reason we serialize and then parse 'input' in this way:
   // 'example_list' and 'example_list_with_context' are lazily parsed
@@ -143,7 +385,6 @@ absl::Status InputToSerializedExampleTensor(const Input& input,
   // SerializedInput proto has been created to prevent this, but at the same
   // time get the count of num_examples as well.
   bool parse_serialized_input_ok = false;
-#if defined(PLATFORM_GOOGLE)
   {
     // Benchmark ('BM_InputToSerializedExample') can help measure the effect of
     // changes in the future.
@@ -154,10 +395,6 @@ absl::Status InputToSerializedExampleTensor(const Input& input,
     }
     parse_serialized_input_ok = serialized_input.ParseFromString(tmp);
   }
-#else
-  parse_serialized_input_ok =
-      serialized_input.ParseFromString(input.SerializeAsString());
-#endif
   if (!parse_serialized_input_ok) {
     return absl::InternalError("Error parsing serialized input.");
   }
@@ -191,15 +428,8 @@ absl::Status InputToSerializedExampleTensor(const Input& input,
         input_str.resize_uninitialized(context.size() + entry.size());
         // 'input_str_ptr' now points to the beginning of input_str.
         char* input_str_ptr = &input_str[0];
-#if defined(PLATFORM_GOOGLE)
-        // When absl::Cord OSS is fully shipped and protobuf open-source suports
-        // Cord, we can get rid of marco above and unify code path.
         context.CopyToArray(input_str_ptr);
         entry.CopyToArray(input_str_ptr + context.size());
-#else
-        memcpy(input_str_ptr, &context[0], context.size());
-        memcpy(input_str_ptr + context.size(), &entry[0], entry.size());
-#endif
       }
     } break;
 
@@ -208,6 +438,267 @@ absl::Status InputToSerializedExampleTensor(const Input& input,
           "Input with kind ", serialized_input.kind_case(), " not supported."));
   }
   return absl::OkStatus();
+#else
+  // Without lazy fields 'input' already holds its Examples parsed, so each one
+  // is serialized straight into its string rather than round-tripping the
+  // whole 'input' through a SerializedInput.
+  const ::google::protobuf::RepeatedPtrField<Example>* input_examples =
+      nullptr;
+  std::string context;
+  switch (input.kind_case()) {
+    case Input::KindCase::KIND_NOT_SET:
+      break;
+
+    case Input::KindCase::kExampleList:
+      input_examples = &input.example_list().examples();
+      break;
+
+    case Input::KindCase::kExampleListWithContext:
+      input_examples = &input.example_list_with_context().examples();
+      // A serialized Example followed by another one parses as the two
+      // merged, with the features of the latter taking precedence.
+      if (!input_examples->empty() &&
+          !input.example_list_with_context().context().SerializeToString(
+              &context)) {
+        return absl::InvalidArgumentError("Context failed to serialize.");
+      }
+      break;
+
+    default:
+      return absl::UnimplementedError(absl::StrCat(
+          "Input with kind ", input.kind_case(), " not supported."));
+  }
+  if (input_examples == nullptr || input_examples->empty()) {
+    return absl::InvalidArgumentError("Input is empty.");
+  }
+
+  *examples = Tensor(DT_STRING, TensorShape({input_examples->size()}));
+  auto input_vec = examples->vec<tstring>();
+  int input_vec_index = 0;
+  for (const Example& entry : *input_examples) {
+    tstring& input_str = input_vec(input_vec_index++);
+    const size_t entry_size = entry.ByteSizeLong();
+    input_str.resize_uninitialized(context.size() + entry_size);
+    char* input_str_ptr = &input_str[0];
+    memcpy(input_str_ptr, context.data(), context.size());
+    entry.SerializeWithCachedSizesToArray(
+        reinterpret_cast<uint8_t*>(input_str_ptr + context.size()));
+  }
+  return absl::OkStatus();
+#endif
+}
+
+absl::Status GetExampleParsingSpec(const GraphDef& graph_def,
+                                   const std::string& input_tensor_name,
+                                   ExampleParsingSpec* spec) {
+  const std::string input = CanonicalTensorName(input_tensor_name);
+  const absl::string_view input_node = NodeName(input);
+  absl::flat_hash_map<absl::string_view, const NodeDef*> nodes;
+  const NodeDef* parse_node = nullptr;
+  for (const NodeDef& node : graph_def.node()) {
+    nodes[node.name()] = &node;
+    for (int i = 0; i < node.input_size(); ++i) {
+      const bool is_control_input = absl::StartsWith(node.input(i), "^");
+      if (is_control_input ? NodeName(node.input(i)) != input_node
+                           : CanonicalTensorName(node.input(i)) != input) {
+        continue;
+      }
+      // Any other consumer would miss the serialized Examples.
+      if (parse_node != nullptr || is_control_input || i != 0) {
+        return absl::UnimplementedError(absl::StrCat(
+            "Input tensor ", input_tensor_name,
+            " is consumed by more than the serialized input of one node."));
+      }
+      parse_node = &node;
+    }
+  }
+  if (parse_node == nullptr) {
+    return absl::NotFoundError(
+        absl::StrCat("No node consumes input tensor ", input_tensor_name));
+  }
+  const NodeDef& node = *parse_node;
+  const bool is_v2 = node.op() == "ParseExampleV2";
+  if (!is_v2 && node.op() != "ParseExample") {
+    return absl::NotFoundError(absl::StrCat("Input tensor ", input_tensor_name,
+                                            " is consumed by ", node.op(),
+                                            " rather than by ParseExample."));
+  }
+
+  const AttrValue* sparse_types;
+  const AttrValue* dense_types;
+  const AttrValue* dense_shapes;
+  TF_RETURN_IF_ERROR(GetAttr(node, "sparse_types", &sparse_types));
+  TF_RETURN_IF_ERROR(GetAttr(node, "Tdense", &dense_types));
+  TF_RETURN_IF_ERROR(GetAttr(node, "dense_shapes", &dense_shapes));
+  const int num_sparse = sparse_types->list().type_size();
+  const int num_dense = dense_types->list().type_size();
+  if (dense_shapes->list().shape_size() != num_dense) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Node ", node.name(), " has ", dense_shapes->list().shape_size(),
+        " dense shapes for ", num_dense, " dense features."));
+  }
+
+  // The inputs are the serialized Examples, their names, the keys of the
+  // sparse, dense (and for V2 ragged) features and the dense default values.
+  std::vector<std::string> sparse_keys;
+  std::vector<std::string> dense_keys;
+  int dense_defaults_begin;
+  if (is_v2) {
+    const AttrValue* ragged_types;
+    TF_RETURN_IF_ERROR(GetAttr(node, "ragged_value_types", &ragged_types));
+    if (ragged_types->list().type_size() > 0) {
+      return absl::UnimplementedError(
+          absl::StrCat("Node ", node.name(), " parses ragged features."));
+    }
+    TF_RETURN_IF_ERROR(
+        GetFeatureKeys(nodes, node, 2, 3, num_sparse, &sparse_keys));
+    TF_RETURN_IF_ERROR(
+        GetFeatureKeys(nodes, node, 3, 4, num_dense, &dense_keys));
+    dense_defaults_begin = 5;
+  } else {
+    TF_RETURN_IF_ERROR(GetFeatureKeys(nodes, node, 2, 2 + num_sparse,
+                                      num_sparse, &sparse_keys));
+    TF_RETURN_IF_ERROR(GetFeatureKeys(nodes, node, 2 + num_sparse,
+                                      2 + num_sparse + num_dense, num_dense,
+                                      &dense_keys));
+    dense_defaults_begin = 2 + num_sparse + num_dense;
+  }
+
+  // The outputs are the sparse indices, values and shapes, then the dense
+  // values.
+  spec->sparse_features.clear();
+  for (int i = 0; i < num_sparse; ++i) {
+    VarLenFeature feature;
+    feature.key = sparse_keys[i];
+    feature.dtype = static_cast<DataType>(sparse_types->list().type(i));
+    feature.indices_output_tensor_name = absl::StrCat(node.name(), ":", i);
+    feature.values_output_tensor_name =
+        absl::StrCat(node.name(), ":", num_sparse + i);
+    feature.shapes_output_tensor_name =
+        absl::StrCat(node.name(), ":", 2 * num_sparse + i);
+    spec->sparse_features.push_back(std::move(feature));
+  }
+  spec->dense_features.clear();
+  for (int i = 0; i < num_dense; ++i) {
+    FixedLenFeature feature;
+    feature.key = dense_keys[i];
+    feature.dtype = static_cast<DataType>(dense_types->list().type(i));
+    const PartialTensorShape shape(dense_shapes->list().shape(i));
+    if (!shape.AsTensorShape(&feature.shape)) {
+      return absl::UnimplementedError(
+          absl::StrCat("Dense feature ", feature.key, " of node ", node.name(),
+                       " has variable length."));
+    }
+    TF_RETURN_IF_ERROR(GetConstantInput(nodes, node, dense_defaults_begin + i,
+                                        &feature.default_value));
+    const int64_t num_default_elements = feature.default_value.NumElements();
+    if (num_default_elements > 0 &&
+        !feature.default_value.CopyFrom(Tensor(feature.default_value),
+                                        feature.shape)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Default value of dense feature ", feature.key,
+                       " does not match its shape ",
+                       feature.shape.DebugString()));
+    }
+    feature.values_output_tensor_name =
+        absl::StrCat(node.name(), ":", 3 * num_sparse + i);
+    spec->dense_features.push_back(std::move(feature));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status InputToParsedExampleTensors(
+    const Input& input, const ExampleParsingSpec& spec,
+    std::vector<std::pair<std::string, Tensor>>* inputs, int* num_examples) {
+  std::vector<const Example*> examples;
+  const Example* context = nullptr;
+  switch (input.kind_case()) {
+    case Input::KindCase::KIND_NOT_SET:
+      break;
+
+    case Input::KindCase::kExampleList:
+      for (const Example& example : input.example_list().examples()) {
+        examples.push_back(&example);
+      }
+      break;
+
+    case Input::KindCase::kExampleListWithContext:
+      for (const Example& example :
+           input.example_list_with_context().examples()) {
+        examples.push_back(&example);
+      }
+      context = &input.example_list_with_context().context();
+      break;
+
+    default:
+      return absl::UnimplementedError(absl::StrCat(
+          "Input with kind ", input.kind_case(), " not supported."));
+  }
+  if (examples.empty()) {
+    return absl::InvalidArgumentError("Input is empty.");
+  }
+  *num_examples = examples.size();
+
+  for (const FixedLenFeature& feature : spec.dense_features) {
+    Tensor values;
+    TF_RETURN_IF_ERROR(ParseDenseFeature(feature, examples, context, &values));
+    inputs->emplace_back(feature.values_output_tensor_name, std::move(values));
+  }
+  for (const VarLenFeature& feature : spec.sparse_features) {
+    Tensor indices;
+    Tensor values;
+    Tensor dense_shape;
+    TF_RETURN_IF_ERROR(ParseSparseFeature(feature, examples, context, &indices,
+                                          &values, &dense_shape));
+    inputs->emplace_back(feature.indices_output_tensor_name,
+                         std::move(indices));
+    inputs->emplace_back(feature.values_output_tensor_name, std::move(values));
+    inputs->emplace_back(feature.shapes_output_tensor_name,
+                         std::move(dense_shape));
+  }
+  return absl::OkStatus();
+}
+
+ExampleParsingSpecMap GetExampleParsingSpecs(
+    const MetaGraphDef& meta_graph_def) {
+  ExampleParsingSpecMap specs;
+  std::set<std::string> input_tensor_names;
+  for (const auto& signature : meta_graph_def.signature_def()) {
+    if (GetSignatureMethodNameCheckFeature() &&
+        signature.second.method_name() != kClassifyMethodName &&
+        signature.second.method_name() != kRegressMethodName) {
+      continue;
+    }
+    // Classification and regression signatures share the input key.
+    auto input_iter = signature.second.inputs().find(kClassifyInputs);
+    if (input_iter == signature.second.inputs().end() ||
+        !input_tensor_names.insert(input_iter->second.name()).second) {
+      continue;
+    }
+    ExampleParsingSpec spec;
+    const absl::Status status = GetExampleParsingSpec(
+        meta_graph_def.graph_def(), input_iter->second.name(), &spec);
+    if (!status.ok()) {
+      VLOG(1) << "Feeding serialized Examples to input "
+              << input_iter->second.name() << " of signature "
+              << signature.first << ": " << status;
+      continue;
+    }
+    specs.emplace(input_iter->second.name(), std::move(spec));
+  }
+  return specs;
+}
+
+const ExampleParsingSpec* FindExampleParsingSpec(
+    const Session* session, const std::string& input_tensor_name) {
+  const auto* wrapper =
+      dynamic_cast<const ExampleParsingSessionWrapper*>(session);
+  if (wrapper == nullptr) {
+    return nullptr;
+  }
+  const ExampleParsingSpecMap& specs = wrapper->example_parsing_specs();
+  auto spec_iter = specs.find(input_tensor_name);
+  return spec_iter == specs.end() ? nullptr : &spec_iter->second;
 }
 
 absl::Status PerformOneShotTensorComputation(
@@ -235,6 +726,31 @@ absl::Status PerformOneShotTensorComputation(
   return absl::OkStatus();
 }
 
+absl::Status PerformOneShotTensorComputation(
+    const RunOptions& run_options, const Input& input,
+    const ExampleParsingSpec& parsing_spec,
+    const std::vector<std::string>& output_tensor_names, Session* session,
+    std::vector<Tensor>* outputs, int* num_input_examples,
+    const thread::ThreadPoolOptions& thread_pool_options,
+    int64_t* runtime_latency) {
+  // Setup the input Tensors to be the features the graph would parse out of
+  // the serialized tensorflow.Example.
+  std::vector<std::pair<std::string, Tensor>> inputs;
+  TF_RETURN_IF_ERROR(InputToParsedExampleTensors(input, parsing_spec, &inputs,
+                                                 num_input_examples));
+
+  const uint64_t start_microseconds = EnvTime::NowMicros();
+  RunMetadata run_metadata;
+  TF_RETURN_IF_ERROR(session->Run(run_options, inputs, output_tensor_names, {},
+                                  outputs, &run_metadata,
+                                  thread_pool_options));
+  const uint64_t end_microseconds = EnvTime::NowMicros();
+  if (runtime_latency != nullptr) {
+    *runtime_latency = end_microseconds - start_microseconds;
+  }
+  return absl::OkStatus();
+}
+
 absl::Status PerformOneShotTensorComputation(
     const RunOptions& run_options, const Input& input,
     const std::set<std::string>& input_tensor_names,
@@ -334,12 +850,26 @@ absl::Status GetModelDiskSize(const std::string& path, FileProbingEnv* env,
 absl::Status EstimateResourceFromPathUsingDiskState(
     const std::string& path, FileProbingEnv* env,
     ResourceAllocation* estimate) {
+  return EstimateResourceFromPathUsingDiskState(
+      path, env, /*map_variables=*/false, estimate);
+}
+
+absl::Status EstimateResourceFromPathUsingDiskState(
+    const std::string& path, FileProbingEnv* env, const bool map_variables,
+    ResourceAllocation* estimate) {
   uint64_t total_file_size = 0;
   TF_RETURN_IF_ERROR(GetModelDiskSize(path, env, &total_file_size));
+  // Mapped variable values take at most the pages of their files, with none
+  // of the overhead of tensors read into memory.
+  uint64_t mapped_file_size = 0;
+  if (map_variables) {
+    TF_RETURN_IF_ERROR(GetVariablesDataDiskSize(path, env, &mapped_file_size));
+    mapped_file_size = std::min(mapped_file_size, total_file_size);
+  }
 
   const uint64_t ram_requirement =
-      total_file_size * kResourceEstimateRAMMultiplier +
-      kResourceEstimateRAMPadBytes;
+      (total_file_size - mapped_file_size) * kResourceEstimateRAMMultiplier +
+      mapped_file_size + kResourceEstimateRAMPadBytes;
 
   ResourceAllocation::Entry* ram_entry = estimate->add_resource_quantities();
   Resource* ram_resource = ram_entry->mutable_resource();
@@ -16,16 +16,28 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_UTIL_H_
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_UTIL_H_
 
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "absl/types/optional.h"
+#include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/threadpool_options.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/public/session.h"
+#include "tensorflow/core/util/example_proto_helper.h"
 #include "tensorflow_serving/apis/input.pb.h"
 #include "tensorflow_serving/apis/model.pb.h"
 #include "tensorflow_serving/resources/resources.pb.h"
+#include "tensorflow_serving/servables/tensorflow/serving_session.h"
 #include "tensorflow_serving/util/file_probing_env.h"
 
 namespace tensorflow {
@@ -73,6 +85,75 @@ void RecordRequestExampleCount(const string& model_name, size_t count);
 // empty it will return a Tensor of shape {0}).
 Status InputToSerializedExampleTensor(const Input& input, Tensor* examples);
 
+// The features that a ParseExample (or ParseExampleV2) op parses out of the
+// serialized Examples fed to a graph, along with the names of the tensors it
+// outputs them as. Feeding those tensors instead skips the op, which saves
+// serializing the Examples of the request only for the op to parse them back.
+struct ExampleParsingSpec {
+  std::vector<FixedLenFeature> dense_features;
+  std::vector<VarLenFeature> sparse_features;
+};
+
+// Gets the parsing spec of the ParseExample or ParseExampleV2 op which takes
+// 'input_tensor_name' of 'graph_def' as its serialized Examples. Returns
+// NotFound if there is no such op, and Unimplemented if it can't be skipped,
+// e.g. as other nodes consume the tensor too, it parses ragged or variable
+// length features, or its feature keys or default values aren't constants.
+//
+// Walks the whole graph, so callers should get the spec once per signature.
+Status GetExampleParsingSpec(const GraphDef& graph_def,
+                             const string& input_tensor_name,
+                             ExampleParsingSpec* spec);
+
+// Parses the Examples of 'input' straight into the feature tensors of 'spec',
+// with the values that ParseExample would output for the serialized Examples
+// of InputToSerializedExampleTensor(), and appends them to 'inputs' keyed by
+// the names of those outputs.
+//
+// The features of the context of an Input::example_list_with_context are
+// parsed once and copied to the examples lacking them, rather than serialized
+// along with each example.
+Status InputToParsedExampleTensors(
+    const Input& input, const ExampleParsingSpec& spec,
+    std::vector<std::pair<string, Tensor>>* inputs, int* num_examples);
+
+// The ExampleParsingSpecs of the signatures of a model, keyed by the name of
+// the input tensor they take serialized Examples as.
+using ExampleParsingSpecMap = std::map<string, ExampleParsingSpec>;
+
+// Gets the parsing specs of the inputs of the classification and regression
+// signatures of 'meta_graph_def' whose ParseExample op can be skipped. The
+// other inputs are left out, to keep being fed serialized Examples.
+//
+// Needs the graph of 'meta_graph_def', so it has to be called when the model
+// loads, before the graph is possibly dropped.
+ExampleParsingSpecMap GetExampleParsingSpecs(
+    const MetaGraphDef& meta_graph_def);
+
+// A ServingSessionWrapper which carries the parsing specs of the signatures of
+// the model whose session it wraps.
+class ExampleParsingSessionWrapper : public ServingSessionWrapper {
+ public:
+  ExampleParsingSessionWrapper(std::unique_ptr<Session> wrapped,
+                               ExampleParsingSpecMap specs)
+      : ServingSessionWrapper(std::move(wrapped)), specs_(std::move(specs)) {}
+
+  ~ExampleParsingSessionWrapper() override = default;
+
+  const ExampleParsingSpecMap& example_parsing_specs() const { return specs_; }
+
+ private:
+  const ExampleParsingSpecMap specs_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ExampleParsingSessionWrapper);
+};
+
+// Returns the parsing spec for 'input_tensor_name' which 'session' carries, if
+// it is an ExampleParsingSessionWrapper, or nullptr, in which case the input
+// has to be fed serialized Examples.
+const ExampleParsingSpec* FindExampleParsingSpec(
+    const Session* session, const string& input_tensor_name);
+
 // Issues a single Session::Run() call with 'input' to produce 'outputs'.
 // Equivalent to InputToSerializedExampleTensor() followed by Session::Run().
 Status PerformOneShotTensorComputation(
@@ -84,6 +165,20 @@ Status PerformOneShotTensorComputation(
         thread::ThreadPoolOptions(),
     int64_t* runtime_latency = nullptr);
 
+// Same as PerformOneShotTensorComputation() above, except feeds the features
+// of 'input' parsed per 'parsing_spec' (see InputToParsedExampleTensors()).
+// Returns NotFound or Unimplemented if the features can't be fed, e.g. as
+// 'session' doesn't run the graph of 'parsing_spec', in which case callers
+// should fall back to feeding serialized Examples.
+Status PerformOneShotTensorComputation(
+    const RunOptions& run_options, const Input& input,
+    const ExampleParsingSpec& parsing_spec,
+    const std::vector<string>& output_tensor_names, Session* session,
+    std::vector<Tensor>* outputs, int* num_input_examples,
+    const thread::ThreadPoolOptions& thread_pool_options =
+        thread::ThreadPoolOptions(),
+    int64_t* runtime_latency = nullptr);
+
 // Same as PerformOneShotTensorComputation() above, except allows for multiple
 // input tensor names (each tensor is fed the *same* `input`).
 Status PerformOneShotTensorComputation(
@@ -114,6 +209,15 @@ Status EstimateResourceFromPathUsingDiskState(const string& path,
                                               FileProbingEnv* env,
                                               ResourceAllocation* estimate);
 
+// Like above, for a saved model whose variables are restored from a memory
+// mapping of its checkpoint if 'map_variables' is true (see
+// LoadSavedModelWithMappedVariables()), in which case the checkpoint data
+// files count only for their size.
+Status EstimateResourceFromPathUsingDiskState(const string& path,
+                                              FileProbingEnv* env,
+                                              bool map_variables,
+                                              ResourceAllocation* estimate);
+
 // Update metrics for runtime latency.
 void RecordRuntimeLatency(const string& model_name, const string& api,
                           const string& runtime, int64_t latency_usec);
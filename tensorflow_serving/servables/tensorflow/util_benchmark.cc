@@ -0,0 +1,149 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks for turning the Examples of classify and regress requests into
+// the input Tensors of a session, comparing serializing them for the graph's
+// ParseExample op to parse (InputToSerializedExampleTensor) against parsing
+// them straight into the feature Tensors (InputToParsedExampleTensors).
+//
+// Note that the former leaves the parsing to the graph's ParseExample op, whose
+// cost the latter also saves but these don't measure.
+//
+// Run with:
+// bazel run -c opt tensorflow_serving/servables/tensorflow:util_benchmark --
+// --benchmarks=.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/example/example.pb.h"
+#include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow_serving/apis/input.pb.h"
+#include "tensorflow_serving/servables/tensorflow/util.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// Number of float features of each Example, and of the context.
+constexpr int kNumFeatures = 32;
+
+// Number of values of each feature.
+constexpr int kFeatureWidth = 8;
+
+// Returns an Example with 'num_features' features named 'prefix'0, 'prefix'1...
+Example MakeExample(const string& prefix, const int num_features) {
+  Example example;
+  auto& features = *example.mutable_features()->mutable_feature();
+  for (int i = 0; i < num_features; ++i) {
+    auto* values = features[absl::StrCat(prefix, i)].mutable_float_list();
+    for (int j = 0; j < kFeatureWidth; ++j) {
+      values->add_value(i * kFeatureWidth + j);
+    }
+  }
+  return example;
+}
+
+// Returns an Input of 'num_examples' Examples with the "example" features, and
+// if 'with_context' a context with the "context" features.
+Input MakeInput(const int num_examples, const bool with_context) {
+  Input input;
+  const Example example = MakeExample("example", kNumFeatures);
+  if (with_context) {
+    auto* examples = input.mutable_example_list_with_context();
+    *examples->mutable_context() = MakeExample("context", kNumFeatures);
+    for (int i = 0; i < num_examples; ++i) {
+      *examples->add_examples() = example;
+    }
+  } else {
+    for (int i = 0; i < num_examples; ++i) {
+      *input.mutable_example_list()->add_examples() = example;
+    }
+  }
+  return input;
+}
+
+// Returns the spec parsing all the features of MakeInput() as dense ones.
+ExampleParsingSpec MakeParsingSpec(const bool with_context) {
+  ExampleParsingSpec spec;
+  std::vector<string> prefixes = {"example"};
+  if (with_context) {
+    prefixes.push_back("context");
+  }
+  for (const string& prefix : prefixes) {
+    for (int i = 0; i < kNumFeatures; ++i) {
+      FixedLenFeature feature;
+      feature.key = absl::StrCat(prefix, i);
+      feature.dtype = DT_FLOAT;
+      feature.shape = TensorShape({kFeatureWidth});
+      feature.default_value = Tensor(DT_FLOAT, TensorShape({0}));
+      feature.values_output_tensor_name =
+          absl::StrCat("parse:", spec.dense_features.size());
+      spec.dense_features.push_back(std::move(feature));
+    }
+  }
+  return spec;
+}
+
+void BM_InputToSerializedExample(::testing::benchmark::State& state) {
+  const Input input = MakeInput(state.range(0), state.range(1));
+  for (auto s : state) {
+    Tensor examples;
+    TF_CHECK_OK(InputToSerializedExampleTensor(input, &examples));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_InputToParsedExampleTensors(::testing::benchmark::State& state) {
+  const Input input = MakeInput(state.range(0), state.range(1));
+  const ExampleParsingSpec spec = MakeParsingSpec(state.range(1));
+  for (auto s : state) {
+    std::vector<std::pair<string, Tensor>> inputs;
+    int num_examples;
+    TF_CHECK_OK(
+        InputToParsedExampleTensors(input, spec, &inputs, &num_examples));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Arguments are {number of examples, with context}.
+BENCHMARK(BM_InputToSerializedExample)
+    ->ArgPair(1, 0)
+    ->ArgPair(100, 0)
+    ->ArgPair(1000, 0)
+    ->ArgPair(1000, 1);
+
+BENCHMARK(BM_InputToParsedExampleTensors)
+    ->ArgPair(1, 0)
+    ->ArgPair(100, 0)
+    ->ArgPair(1000, 0)
+    ->ArgPair(1000, 1);
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  tensorflow::testing::RunBenchmarks();
+  return 0;
+}
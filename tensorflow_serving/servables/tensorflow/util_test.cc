@@ -16,13 +16,18 @@ limitations under the License.
 #include "tensorflow_serving/servables/tensorflow/util.h"
 
 #include <map>
+#include <memory>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "google/protobuf/wrappers.pb.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -30,6 +35,9 @@ limitations under the License.
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
 #include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/core/public/session_options.h"
 #include "tensorflow_serving/servables/tensorflow/bundle_factory_test_util.h"
 #include "tensorflow_serving/test_util/test_util.h"
 #include "tensorflow_serving/util/test_util/mock_file_probing_env.h"
@@ -203,6 +211,295 @@ TEST_F(InputUtilTest, ExampleListWithContext_OnlyContext) {
   EXPECT_THAT(status.message(), HasSubstr("Input is empty"));
 }
 
+// Returns a graph parsing its "input" with ParseExampleV2, into a sparse
+// feature "b" and dense features "a" (with default value 7) and "c".
+GraphDef ParseExampleGraph() {
+  return test_util::CreateProto<GraphDef>(R"(
+    node { name: "input" op: "Placeholder"
+           attr { key: "dtype" value { type: DT_STRING } } }
+    node { name: "names" op: "Const"
+           attr { key: "value" value { tensor {
+             dtype: DT_STRING tensor_shape { dim { size: 0 } } } } } }
+    node { name: "sparse_keys" op: "Const"
+           attr { key: "value" value { tensor {
+             dtype: DT_STRING tensor_shape { dim { size: 1 } }
+             string_val: "b" } } } }
+    node { name: "dense_keys" op: "Const"
+           attr { key: "value" value { tensor {
+             dtype: DT_STRING tensor_shape { dim { size: 2 } }
+             string_val: "a" string_val: "c" } } } }
+    node { name: "ragged_keys" op: "Const"
+           attr { key: "value" value { tensor {
+             dtype: DT_STRING tensor_shape { dim { size: 0 } } } } } }
+    node { name: "default_a" op: "Const"
+           attr { key: "value" value { tensor {
+             dtype: DT_INT64 tensor_shape { dim { size: 1 } }
+             int64_val: 7 } } } }
+    node { name: "default_c" op: "Const"
+           attr { key: "value" value { tensor {
+             dtype: DT_INT64 tensor_shape { dim { size: 0 } } } } } }
+    node { name: "parse" op: "ParseExampleV2"
+           input: "input" input: "names" input: "sparse_keys"
+           input: "dense_keys" input: "ragged_keys" input: "default_a"
+           input: "default_c:0"
+           attr { key: "Tdense" value { list { type: DT_INT64
+                                               type: DT_INT64 } } }
+           attr { key: "num_sparse" value { i: 1 } }
+           attr { key: "sparse_types" value { list { type: DT_INT64 } } }
+           attr { key: "ragged_value_types" value { list { } } }
+           attr { key: "ragged_split_types" value { list { } } }
+           attr { key: "dense_shapes" value { list {
+             shape { dim { size: 1 } } shape { dim { size: 1 } } } } } }
+  )");
+}
+
+TEST(ExampleParsingSpecTest, ParseExampleV2) {
+  ExampleParsingSpec spec;
+  TF_ASSERT_OK(GetExampleParsingSpec(ParseExampleGraph(), "input:0", &spec));
+
+  ASSERT_EQ(2, spec.dense_features.size());
+  EXPECT_EQ("a", spec.dense_features[0].key);
+  EXPECT_EQ(DT_INT64, spec.dense_features[0].dtype);
+  EXPECT_EQ(TensorShape({1}), spec.dense_features[0].shape);
+  test::ExpectTensorEqual<int64_t>(test::AsTensor<int64_t>({7}, {1}),
+                                   spec.dense_features[0].default_value);
+  EXPECT_EQ("parse:3", spec.dense_features[0].values_output_tensor_name);
+  EXPECT_EQ("c", spec.dense_features[1].key);
+  EXPECT_EQ(0, spec.dense_features[1].default_value.NumElements());
+  EXPECT_EQ("parse:4", spec.dense_features[1].values_output_tensor_name);
+
+  ASSERT_EQ(1, spec.sparse_features.size());
+  EXPECT_EQ("b", spec.sparse_features[0].key);
+  EXPECT_EQ(DT_INT64, spec.sparse_features[0].dtype);
+  EXPECT_EQ("parse:0", spec.sparse_features[0].indices_output_tensor_name);
+  EXPECT_EQ("parse:1", spec.sparse_features[0].values_output_tensor_name);
+  EXPECT_EQ("parse:2", spec.sparse_features[0].shapes_output_tensor_name);
+}
+
+TEST(ExampleParsingSpecTest, ReshapedDefaultValue) {
+  GraphDef graph_def = ParseExampleGraph();
+  NodeDef* shape = graph_def.add_node();
+  *shape = test_util::CreateProto<NodeDef>(R"(
+    name: "shape" op: "Const"
+    attr { key: "value" value { tensor {
+      dtype: DT_INT32 tensor_shape { dim { size: 1 } } int_val: -1 } } })");
+  NodeDef* reshape = graph_def.add_node();
+  reshape->set_name("reshape");
+  reshape->set_op("Reshape");
+  reshape->add_input("default_a");
+  reshape->add_input("shape");
+  for (NodeDef& node : *graph_def.mutable_node()) {
+    if (node.name() == "parse") {
+      node.set_input(5, "reshape");
+    }
+  }
+
+  ExampleParsingSpec spec;
+  TF_ASSERT_OK(GetExampleParsingSpec(graph_def, "input", &spec));
+  ASSERT_EQ(2, spec.dense_features.size());
+  test::ExpectTensorEqual<int64_t>(test::AsTensor<int64_t>({7}, {1}),
+                                   spec.dense_features[0].default_value);
+}
+
+TEST(ExampleParsingSpecTest, NoParseExample) {
+  GraphDef graph_def = ParseExampleGraph();
+  NodeDef* other = graph_def.add_node();
+  other->set_name("other");
+  other->set_op("Placeholder");
+  NodeDef* identity = graph_def.add_node();
+  identity->set_name("identity");
+  identity->set_op("Identity");
+  identity->add_input("other");
+  ExampleParsingSpec spec;
+  EXPECT_EQ(absl::StatusCode::kNotFound,
+            GetExampleParsingSpec(graph_def, "other:0", &spec).code());
+  EXPECT_EQ(absl::StatusCode::kNotFound,
+            GetExampleParsingSpec(graph_def, "identity", &spec).code());
+}
+
+TEST(ExampleParsingSpecTest, OtherConsumers) {
+  GraphDef graph_def = ParseExampleGraph();
+  NodeDef* identity = graph_def.add_node();
+  identity->set_name("identity");
+  identity->set_op("Identity");
+  identity->add_input("input");
+  ExampleParsingSpec spec;
+  EXPECT_EQ(absl::StatusCode::kUnimplemented,
+            GetExampleParsingSpec(graph_def, "input", &spec).code());
+}
+
+TEST_F(InputUtilTest, ParsedExampleListWithContext) {
+  Example context = example_C();
+  (*context.mutable_features()->mutable_feature())["b"]
+      .mutable_int64_list()
+      ->add_value(44);
+  auto* examples =
+      input_.mutable_example_list_with_context()->mutable_examples();
+  *examples->Add() = example_A();
+  *examples->Add() = example_C(64);
+  *examples->Add() = example_B();
+  *input_.mutable_example_list_with_context()->mutable_context() = context;
+
+  ExampleParsingSpec spec;
+  TF_ASSERT_OK(GetExampleParsingSpec(ParseExampleGraph(), "input", &spec));
+  std::vector<std::pair<std::string, Tensor>> inputs;
+  int num_examples;
+  TF_ASSERT_OK(
+      InputToParsedExampleTensors(input_, spec, &inputs, &num_examples));
+  EXPECT_EQ(3, num_examples);
+  ASSERT_EQ(5, inputs.size());
+
+  // Dense "a" falls back to its default, and "c" to the context.
+  EXPECT_EQ("parse:3", inputs[0].first);
+  test::ExpectTensorEqual<int64_t>(test::AsTensor<int64_t>({11, 7, 7}, {3, 1}),
+                                   inputs[0].second);
+  EXPECT_EQ("parse:4", inputs[1].first);
+  test::ExpectTensorEqual<int64_t>(
+      test::AsTensor<int64_t>({33, 64, 33}, {3, 1}), inputs[1].second);
+
+  // Sparse "b" falls back to the context.
+  EXPECT_EQ("parse:0", inputs[2].first);
+  test::ExpectTensorEqual<int64_t>(
+      test::AsTensor<int64_t>({0, 0, 1, 0, 2, 0}, {3, 2}), inputs[2].second);
+  EXPECT_EQ("parse:1", inputs[3].first);
+  test::ExpectTensorEqual<int64_t>(test::AsTensor<int64_t>({44, 44, 22}, {3}),
+                                   inputs[3].second);
+  EXPECT_EQ("parse:2", inputs[4].first);
+  test::ExpectTensorEqual<int64_t>(test::AsTensor<int64_t>({3, 1}, {2}),
+                                   inputs[4].second);
+}
+
+TEST_F(InputUtilTest, ParsedExampleListMissingRequiredFeature) {
+  *input_.mutable_example_list()->mutable_examples()->Add() = example_C();
+  *input_.mutable_example_list()->mutable_examples()->Add() = example_A();
+
+  ExampleParsingSpec spec;
+  TF_ASSERT_OK(GetExampleParsingSpec(ParseExampleGraph(), "input", &spec));
+  std::vector<std::pair<std::string, Tensor>> inputs;
+  int num_examples;
+  const absl::Status status =
+      InputToParsedExampleTensors(input_, spec, &inputs, &num_examples);
+  ASSERT_FALSE(status.ok());
+  EXPECT_THAT(status.message(), HasSubstr("Feature: c"));
+  EXPECT_THAT(status.message(), HasSubstr("is required"));
+}
+
+TEST_F(InputUtilTest, ParsedExampleListEmpty) {
+  input_.mutable_example_list();
+
+  ExampleParsingSpec spec;
+  std::vector<std::pair<std::string, Tensor>> inputs;
+  int num_examples;
+  const absl::Status status =
+      InputToParsedExampleTensors(input_, spec, &inputs, &num_examples);
+  ASSERT_FALSE(status.ok());
+  EXPECT_THAT(status.message(), HasSubstr("Input is empty"));
+}
+
+// Expects InputToParsedExampleTensors() to output for 'input' the same tensors
+// as the ParseExampleV2 op of ParseExampleGraph() does for the serialized
+// Examples of InputToSerializedExampleTensor(), or to fail as it does.
+void ExpectParsedLikeParseExampleV2(const Input& input) {
+  std::unique_ptr<Session> session(NewSession(SessionOptions()));
+  TF_ASSERT_OK(session->Create(ParseExampleGraph()));
+  ExampleParsingSpec spec;
+  TF_ASSERT_OK(GetExampleParsingSpec(ParseExampleGraph(), "input", &spec));
+
+  std::vector<std::pair<std::string, Tensor>> parsed;
+  int num_examples;
+  const absl::Status parse_status =
+      InputToParsedExampleTensors(input, spec, &parsed, &num_examples);
+  std::vector<std::string> output_tensor_names;
+  for (const auto& output : parsed) {
+    output_tensor_names.push_back(output.first);
+  }
+  if (!parse_status.ok()) {
+    output_tensor_names = {"parse:0", "parse:1", "parse:2", "parse:3",
+                           "parse:4"};
+  }
+
+  Tensor serialized;
+  TF_ASSERT_OK(InputToSerializedExampleTensor(input, &serialized));
+  std::vector<Tensor> outputs;
+  const absl::Status run_status = session->Run(
+      {{"input", serialized}}, output_tensor_names, {}, &outputs);
+  ASSERT_EQ(run_status.code(), parse_status.code()) << run_status;
+  if (!run_status.ok()) {
+    return;
+  }
+  EXPECT_EQ(serialized.dim_size(0), num_examples);
+  ASSERT_EQ(outputs.size(), parsed.size());
+  for (int i = 0; i < outputs.size(); ++i) {
+    SCOPED_TRACE(output_tensor_names[i]);
+    test::ExpectTensorEqual<int64_t>(outputs[i], parsed[i].second);
+  }
+}
+
+TEST_F(InputUtilTest, ParsedLikeParseExampleV2) {
+  Example example = example_A();
+  auto& features = *example.mutable_features()->mutable_feature();
+  features["b"].mutable_int64_list()->add_value(21);
+  features["b"].mutable_int64_list()->add_value(22);
+  features["c"].mutable_int64_list()->add_value(31);
+  *input_.mutable_example_list()->mutable_examples()->Add() = example;
+  // Lacks "a", which falls back to its default, and "b", which is empty.
+  *input_.mutable_example_list()->mutable_examples()->Add() = example_C();
+  ExpectParsedLikeParseExampleV2(input_);
+}
+
+TEST_F(InputUtilTest, ParsedLikeParseExampleV2WithContext) {
+  Example context = example_C();
+  (*context.mutable_features()->mutable_feature())["b"]
+      .mutable_int64_list()
+      ->add_value(44);
+  auto* examples =
+      input_.mutable_example_list_with_context()->mutable_examples();
+  *examples->Add() = example_A();
+  *examples->Add() = example_C(64);
+  *examples->Add() = example_B();
+  *input_.mutable_example_list_with_context()->mutable_context() = context;
+  ExpectParsedLikeParseExampleV2(input_);
+}
+
+TEST_F(InputUtilTest, ParsedLikeParseExampleV2MissingRequiredFeature) {
+  *input_.mutable_example_list()->mutable_examples()->Add() = example_C();
+  // Lacks the required "c".
+  *input_.mutable_example_list()->mutable_examples()->Add() = example_A();
+  ExpectParsedLikeParseExampleV2(input_);
+}
+
+TEST_F(InputUtilTest, ParsedLikeParseExampleV2WrongType) {
+  Example example = example_C();
+  (*example.mutable_features()->mutable_feature())["a"]
+      .mutable_float_list()
+      ->add_value(1.0);
+  *input_.mutable_example_list()->mutable_examples()->Add() = example;
+  ExpectParsedLikeParseExampleV2(input_);
+}
+
+TEST(ExampleParsingSpecTest, CarriedBySessionWrapper) {
+  MetaGraphDef meta_graph_def;
+  *meta_graph_def.mutable_graph_def() = ParseExampleGraph();
+  SignatureDef classify_signature;
+  classify_signature.set_method_name(kClassifyMethodName);
+  (*classify_signature.mutable_inputs())[kClassifyInputs].set_name("input:0");
+  (*meta_graph_def.mutable_signature_def())["classify"] = classify_signature;
+  SignatureDef predict_signature;
+  predict_signature.set_method_name(kPredictMethodName);
+  (*predict_signature.mutable_inputs())[kClassifyInputs].set_name("names:0");
+  (*meta_graph_def.mutable_signature_def())["predict"] = predict_signature;
+  const ExampleParsingSpecMap specs = GetExampleParsingSpecs(meta_graph_def);
+  ASSERT_EQ(1, specs.size());
+  ASSERT_EQ(1, specs.count("input:0"));
+
+  std::unique_ptr<Session> session(NewSession(SessionOptions()));
+  EXPECT_EQ(nullptr, FindExampleParsingSpec(session.get(), "input:0"));
+  ExampleParsingSessionWrapper wrapper(std::move(session), specs);
+  EXPECT_EQ(&wrapper.example_parsing_specs().at("input:0"),
+            FindExampleParsingSpec(&wrapper, "input:0"));
+  EXPECT_EQ(nullptr, FindExampleParsingSpec(&wrapper, "names:0"));
+}
+
 TEST_F(InputUtilTest, RequestNumExamplesStreamz) {
   Input input_1;
   *input_1.mutable_example_list()->mutable_examples()->Add() = example_A();
@@ -316,6 +613,57 @@ TEST(ResourceEstimatorTest, EstimateResourceFromPathUsingDiskState) {
   EXPECT_THAT(actual, EqualsProto(expected));
 }
 
+TEST(ResourceEstimatorTest, EstimateResourceFromPathWithMappedVariables) {
+  const std::string export_dir = "/foo/bar";
+  const std::string graph_path = io::JoinPath(export_dir, "saved_model.pb");
+  const std::string variables_dir = io::JoinPath(export_dir, "variables");
+  const std::string data_path =
+      io::JoinPath(variables_dir, "variables.data-00000-of-00001");
+  const std::string index_path = io::JoinPath(variables_dir, "variables.index");
+
+  // A saved model with 100 bytes of graph, 1000 bytes of variable values and
+  // 10 bytes of checkpoint index.
+  test_util::MockFileProbingEnv env;
+  EXPECT_CALL(env, FileExists(_)).WillRepeatedly(Return(absl::OkStatus()));
+  EXPECT_CALL(env, GetChildren(export_dir, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(std::vector<std::string>(
+                                {"saved_model.pb", "variables"})),
+                            Return(absl::OkStatus())));
+  EXPECT_CALL(env, GetChildren(variables_dir, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(std::vector<std::string>(
+                                {"variables.data-00000-of-00001",
+                                 "variables.index"})),
+                            Return(absl::OkStatus())));
+  EXPECT_CALL(env, IsDirectory(variables_dir))
+      .WillRepeatedly(Return(absl::OkStatus()));
+  EXPECT_CALL(env, IsDirectory(graph_path))
+      .WillRepeatedly(Return(absl::FailedPreconditionError("")));
+  EXPECT_CALL(env, IsDirectory(data_path))
+      .WillRepeatedly(Return(absl::FailedPreconditionError("")));
+  EXPECT_CALL(env, IsDirectory(index_path))
+      .WillRepeatedly(Return(absl::FailedPreconditionError("")));
+  EXPECT_CALL(env, GetFileSize(graph_path, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(100), Return(absl::OkStatus())));
+  EXPECT_CALL(env, GetFileSize(data_path, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(1000), Return(absl::OkStatus())));
+  EXPECT_CALL(env, GetFileSize(index_path, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(10), Return(absl::OkStatus())));
+
+  ResourceAllocation actual;
+  TF_ASSERT_OK(EstimateResourceFromPathUsingDiskState(
+      export_dir, &env, /*map_variables=*/false, &actual));
+  EXPECT_THAT(actual,
+              EqualsProto(test_util::GetExpectedResourceEstimate(1110)));
+
+  // Only the graph and the index are read into memory.
+  actual.Clear();
+  TF_ASSERT_OK(EstimateResourceFromPathUsingDiskState(
+      export_dir, &env, /*map_variables=*/true, &actual));
+  ASSERT_EQ(1, actual.resource_quantities_size());
+  EXPECT_EQ(static_cast<uint64_t>(110 * 1.2 + 1000),
+            actual.resource_quantities(0).quantity());
+}
+
 TEST(GetMapKeysTest, GetKeys) {
   std::map<std::string, std::string> map = {
       std::pair<std::string, std::string>("key1", "value1"),
@@ -27,17 +27,123 @@ limitations under the License.
 
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "xla/tsl/platform/errors.h"
 #include "xla/tsl/platform/macros.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/env_time.h"
+#include "tensorflow/core/platform/file_statistics.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow_serving/core/servable_data.h"
 #include "tensorflow_serving/core/servable_id.h"
+#include "tensorflow_serving/util/threadpool_executor.h"
 
 namespace tensorflow {
 namespace serving {
+namespace internal {
+
+// The children of base paths listed by earlier polls, with the modification
+// times of the base paths at the time.
+class BasePathListingCache {
+ public:
+  // Sets 'children' to the children of 'base_path' listed earlier, if its
+  // modification time is still 'mtime_nsec', and they were listed no more than
+  // 'max_age_nsec' before 'now_nsec' (or at any time if it is negative).
+  // Returns false if there are none.
+  bool Lookup(const string& base_path, const int64_t mtime_nsec,
+              const int64_t now_nsec, const int64_t max_age_nsec,
+              std::vector<string>* children) {
+    mutex_lock l(mu_);
+    const auto it = listings_.find(base_path);
+    if (it == listings_.end() || it->second.mtime_nsec != mtime_nsec ||
+        (max_age_nsec >= 0 &&
+         now_nsec - it->second.listing_time_nsec > max_age_nsec)) {
+      return false;
+    }
+    *children = it->second.children;
+    return true;
+  }
+
+  // Records the children of 'base_path' listed at 'listing_time_nsec', when
+  // its modification time was 'mtime_nsec'.
+  void Insert(const string& base_path, const int64_t mtime_nsec,
+              const int64_t listing_time_nsec, std::vector<string> children) {
+    std::sort(children.begin(), children.end());
+    mutex_lock l(mu_);
+    if (uncacheable_base_paths_.count(base_path) > 0) {
+      return;
+    }
+    const auto it = listings_.find(base_path);
+    if (it != listings_.end() && it->second.mtime_nsec == mtime_nsec &&
+        it->second.children != children) {
+      // The file system doesn't update the modification time of the base path
+      // when its children change, so listings of it can't be reused.
+      LOG(WARNING) << "Not caching the listings of base path " << base_path
+                   << ", since its modification time doesn't change when its "
+                      "children do";
+      uncacheable_base_paths_.insert(base_path);
+      listings_.erase(it);
+      return;
+    }
+    // Modification times have a coarse granularity on some file systems, so a
+    // change right after the listing may not change the modification time.
+    // Such listings aren't reused.
+    if (listing_time_nsec - mtime_nsec < kMinListingDelayNanos) {
+      listings_.erase(base_path);
+      return;
+    }
+    listings_[base_path] = {mtime_nsec, listing_time_nsec, std::move(children)};
+  }
+
+  // Drops the listings of the base paths of servables not in 'config'.
+  void Retain(const FileSystemStoragePathSourceConfig& config) {
+    std::set<string> base_paths;
+    for (const FileSystemStoragePathSourceConfig::ServableToMonitor& servable :
+         config.servables()) {
+      base_paths.insert(servable.base_path());
+    }
+    mutex_lock l(mu_);
+    for (auto it = listings_.begin(); it != listings_.end();) {
+      if (base_paths.count(it->first) == 0) {
+        it = listings_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (auto it = uncacheable_base_paths_.begin();
+         it != uncacheable_base_paths_.end();) {
+      if (base_paths.count(*it) == 0) {
+        it = uncacheable_base_paths_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+ private:
+  static constexpr int64_t kMinListingDelayNanos = 2LL * 1000 * 1000 * 1000;
+
+  struct Listing {
+    int64_t mtime_nsec;
+    int64_t listing_time_nsec;
+    // Sorted.
+    std::vector<string> children;
+  };
+
+  mutex mu_;
+  std::map<string, Listing> listings_ TF_GUARDED_BY(mu_);
+  // Base paths whose listings changed while their modification times didn't.
+  std::set<string> uncacheable_base_paths_ TF_GUARDED_BY(mu_);
+};
+
+}  // namespace internal
+
+FileSystemStoragePathSource::FileSystemStoragePathSource()
+    : listing_cache_(new internal::BasePathListingCache) {}
 
 FileSystemStoragePathSource::~FileSystemStoragePathSource() {
   // Note: Deletion of 'fs_polling_thread_' will block until our underlying
@@ -48,6 +154,25 @@ FileSystemStoragePathSource::~FileSystemStoragePathSource() {
 
 namespace {
 
+auto* poll_latency = monitoring::Sampler<0>::New(
+    {"/tensorflow/serving/file_system_storage_path_source/poll_latency",
+     "Distribution of wall time (in microseconds) for polling the file system "
+     "for the versions of all servables."},
+    // Scale of 10, power of 1.8 with bucket count 33 (~20 minutes).
+    monitoring::Buckets::Exponential(10, 1.8, 33));
+
+// The default maximum age of the base path listings reused by polls.
+constexpr int64_t kDefaultMaxListingAgeNanos = 5LL * 60 * 1000 * 1000 * 1000;
+
+auto* servable_poll_latency = monitoring::Sampler<1>::New(
+    {"/tensorflow/serving/file_system_storage_path_source/"
+     "servable_poll_latency",
+     "Distribution of wall time (in microseconds) for polling the file system "
+     "for the versions of a servable.",
+     "servable_name"},
+    // Scale of 10, power of 1.8 with bucket count 33 (~20 minutes).
+    monitoring::Buckets::Exponential(10, 1.8, 33));
+
 // Returns the names of servables that appear in 'old_config' but not in
 // 'new_config'.
 std::set<string> GetDeletedServables(
@@ -246,45 +371,77 @@ bool AspireSpecificVersions(
   return !aspired_versions.empty();
 }
 
+// Lists the direct children of 'base_path'.
+absl::Status ListBasePath(const string& base_path,
+                          std::vector<string>* children) {
+  TF_RETURN_IF_ERROR(Env::Default()->GetChildren(base_path, children));
+
+  // GetChildren() returns all descendants instead for cloud storage like GCS.
+  // In such case we should filter out all non-direct descendants.
+  std::set<string> real_children;
+  for (int i = 0; i < children->size(); ++i) {
+    const string& child = (*children)[i];
+    real_children.insert(child.substr(0, child.find_first_of('/')));
+  }
+  children->clear();
+  children->insert(children->begin(), real_children.begin(),
+                   real_children.end());
+  return absl::OkStatus();
+}
+
 // Like PollFileSystemForConfig(), but for a single servable.
 absl::Status PollFileSystemForServable(
     const FileSystemStoragePathSourceConfig::ServableToMonitor& servable,
+    internal::BasePathListingCache* listing_cache,
+    const int64_t max_listing_age_nsec,
     std::vector<ServableData<StoragePath>>* versions) {
+  // With a listing cache, get the modification time of the base path, unless
+  // the file system doesn't report it.
+  int64_t mtime_nsec = 0;
+  if (listing_cache != nullptr) {
+    FileStatistics stat;
+    if (Env::Default()->Stat(servable.base_path(), &stat).ok()) {
+      mtime_nsec = stat.mtime_nsec;
+    }
+  }
+
   // First, determine whether the base path exists. This check guarantees that
   // we don't emit an empty aspired-versions list for a non-existent (or
   // transiently unavailable) base-path. (On some platforms, GetChildren()
   // returns an empty list instead of erring if the base path isn't found.)
-  absl::Status status = Env::Default()->FileExists(servable.base_path());
-  if (!status.ok()) {
-    return errors::InvalidArgument(
-        "Could not find base path ", servable.base_path(), " for servable ",
-        servable.servable_name(), " with error ", status.ToString());
-  }
-
-  if (servable.servable_version_policy().policy_choice_case() ==
-      FileSystemStoragePathSourceConfig::ServableVersionPolicy::kSpecific) {
-    // Special case the specific handler, to avoid GetChildren in the case where
-    // all of the directories match their version number.
-    if (AspireSpecificVersionsFastPath(servable, versions)) {
-      // We found them all, exit early.
-      return absl::OkStatus();
+  if (mtime_nsec == 0) {
+    absl::Status status = Env::Default()->FileExists(servable.base_path());
+    if (!status.ok()) {
+      return errors::InvalidArgument(
+          "Could not find base path ", servable.base_path(), " for servable ",
+          servable.servable_name(), " with error ", status.ToString());
     }
   }
 
-  // Retrieve a list of base-path children from the file system.
+  // Retrieve a list of base-path children from the file system, unless it
+  // hasn't changed since the last poll.
   std::vector<string> children;
-  TF_RETURN_IF_ERROR(
-      Env::Default()->GetChildren(servable.base_path(), &children));
+  if (mtime_nsec == 0 ||
+      !listing_cache->Lookup(servable.base_path(), mtime_nsec,
+                             EnvTime::NowNanos(), max_listing_age_nsec,
+                             &children)) {
+    if (servable.servable_version_policy().policy_choice_case() ==
+        FileSystemStoragePathSourceConfig::ServableVersionPolicy::kSpecific) {
+      // Special case the specific handler, to avoid GetChildren in the case
+      // where all of the directories match their version number.
+      if (AspireSpecificVersionsFastPath(servable, versions)) {
+        // We found them all, exit early.
+        return absl::OkStatus();
+      }
+    }
 
-  // GetChildren() returns all descendants instead for cloud storage like GCS.
-  // In such case we should filter out all non-direct descendants.
-  std::set<string> real_children;
-  for (int i = 0; i < children.size(); ++i) {
-    const string& child = children[i];
-    real_children.insert(child.substr(0, child.find_first_of('/')));
+    const int64_t listing_time_nsec = EnvTime::NowNanos();
+    TF_RETURN_IF_ERROR(ListBasePath(servable.base_path(), &children));
+    if (mtime_nsec != 0) {
+      listing_cache->Insert(servable.base_path(), mtime_nsec,
+                            listing_time_nsec, children);
+    }
   }
-  children.clear();
-  children.insert(children.begin(), real_children.begin(), real_children.end());
   const std::map<int64_t /* version */, string /* child */>
       children_by_version = IndexChildrenByVersion(children);
 
@@ -322,29 +479,68 @@ absl::Status PollFileSystemForServable(
 
 // Polls the file system, and populates 'versions_by_servable_name' with the
 // aspired-versions data FileSystemStoragePathSource should emit based on what
-// was found, indexed by servable name.
+// was found, indexed by servable name. Polls the base paths of the servables
+// concurrently on 'polling_pool' if it isn't null, and reuses their listings
+// in 'listing_cache' if config.cache_base_path_listings() is true.
 absl::Status PollFileSystemForConfig(
     const FileSystemStoragePathSourceConfig& config,
+    internal::BasePathListingCache* listing_cache,
+    ThreadPoolExecutor* polling_pool,
     std::map<string, std::vector<ServableData<StoragePath>>>*
         versions_by_servable_name) {
-  for (const FileSystemStoragePathSourceConfig::ServableToMonitor& servable :
-       config.servables()) {
-    std::vector<ServableData<StoragePath>> versions;
-    TF_RETURN_IF_ERROR(PollFileSystemForServable(servable, &versions));
+  const uint64_t start_micros = EnvTime::NowMicros();
+  if (!config.cache_base_path_listings()) {
+    listing_cache = nullptr;
+  }
+  const int64_t max_listing_age_nsec =
+      config.max_base_path_listing_age_seconds() == 0
+          ? kDefaultMaxListingAgeNanos
+          : config.max_base_path_listing_age_seconds() * 1000 * 1000 * 1000;
+  const int num_servables = config.servables_size();
+  std::vector<std::vector<ServableData<StoragePath>>> versions(num_servables);
+  std::vector<absl::Status> statuses(num_servables);
+  const auto poll_servable = [&](const int i) {
+    const uint64_t servable_start_micros = EnvTime::NowMicros();
+    statuses[i] = PollFileSystemForServable(config.servables(i), listing_cache,
+                                            max_listing_age_nsec, &versions[i]);
+    servable_poll_latency->GetCell(config.servables(i).servable_name())
+        ->Add(EnvTime::NowMicros() - servable_start_micros);
+  };
+  if (polling_pool != nullptr && num_servables > 1) {
+    absl::BlockingCounter polls_done(num_servables);
+    for (int i = 0; i < num_servables; ++i) {
+      polling_pool->Schedule([i, &poll_servable, &polls_done]() {
+        poll_servable(i);
+        polls_done.DecrementCount();
+      });
+    }
+    polls_done.Wait();
+  } else {
+    for (int i = 0; i < num_servables; ++i) {
+      poll_servable(i);
+      TF_RETURN_IF_ERROR(statuses[i]);
+    }
+  }
+
+  for (int i = 0; i < num_servables; ++i) {
+    TF_RETURN_IF_ERROR(statuses[i]);
     versions_by_servable_name->insert(
-        {servable.servable_name(), std::move(versions)});
+        {config.servables(i).servable_name(), std::move(versions[i])});
   }
+  poll_latency->GetCell()->Add(EnvTime::NowMicros() - start_micros);
   return absl::Status();
 }
 
 // Determines if, for any servables in 'config', the file system doesn't
 // currently contain at least one version under its base path.
 absl::Status FailIfZeroVersions(
-    const FileSystemStoragePathSourceConfig& config) {
+    const FileSystemStoragePathSourceConfig& config,
+    internal::BasePathListingCache* listing_cache,
+    ThreadPoolExecutor* polling_pool) {
   std::map<string, std::vector<ServableData<StoragePath>>>
       versions_by_servable_name;
-  TF_RETURN_IF_ERROR(
-      PollFileSystemForConfig(config, &versions_by_servable_name));
+  TF_RETURN_IF_ERROR(PollFileSystemForConfig(
+      config, listing_cache, polling_pool, &versions_by_servable_name));
 
   std::map<string, string> servable_name_to_base_path_map;
   for (const FileSystemStoragePathSourceConfig::ServableToMonitor& servable :
@@ -385,15 +581,31 @@ absl::Status FileSystemStoragePathSource::UpdateConfig(
         "Changing file_system_poll_wait_seconds is not supported");
   }
 
+  // Keep the threads of the polling pool across polls, rather than starting
+  // them for every poll.
+  const int num_polling_threads =
+      std::max(1, config.num_file_system_polling_threads());
+  if (num_polling_threads != num_polling_threads_) {
+    polling_pool_.reset();
+    if (num_polling_threads > 1) {
+      polling_pool_.reset(new ThreadPoolExecutor(
+          Env::Default(), "FileSystemStoragePathSource_polling_pool",
+          num_polling_threads));
+    }
+    num_polling_threads_ = num_polling_threads;
+  }
+
   if (config.fail_if_zero_versions_at_startup() ||  // NOLINT
       config.servable_versions_always_present()) {
-    TF_RETURN_IF_ERROR(FailIfZeroVersions(config));
+    TF_RETURN_IF_ERROR(FailIfZeroVersions(config, listing_cache_.get(),
+                                          polling_pool_.get()));
   }
 
   if (aspired_versions_callback_) {
     TF_RETURN_IF_ERROR(UnaspireServables(GetDeletedServables(config_, config)));
   }
   config_ = config;
+  listing_cache_->Retain(config_);
 
   return absl::Status();
 }
@@ -442,8 +654,9 @@ absl::Status FileSystemStoragePathSource::PollFileSystemAndInvokeCallback() {
   mutex_lock l(mu_);
   std::map<string, std::vector<ServableData<StoragePath>>>
       versions_by_servable_name;
-  TF_RETURN_IF_ERROR(
-      PollFileSystemForConfig(config_, &versions_by_servable_name));
+  TF_RETURN_IF_ERROR(PollFileSystemForConfig(config_, listing_cache_.get(),
+                                             polling_pool_.get(),
+                                             &versions_by_servable_name));
   for (const auto& entry : versions_by_servable_name) {
     const string& servable = entry.first;
     const std::vector<ServableData<StoragePath>>& versions = entry.second;
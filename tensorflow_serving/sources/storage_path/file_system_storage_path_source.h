@@ -29,10 +29,12 @@ limitations under the License.
 #include "tensorflow_serving/config/file_system_storage_path_source.pb.h"
 #include "tensorflow_serving/core/source.h"
 #include "tensorflow_serving/core/storage_path.h"
+#include "tensorflow_serving/util/threadpool_executor.h"
 
 namespace tensorflow {
 namespace serving {
 namespace internal {
+class BasePathListingCache;
 class FileSystemStoragePathSourceTestAccess;
 }  // namespace internal
 }  // namespace serving
@@ -81,7 +83,7 @@ class FileSystemStoragePathSource : public Source<StoragePath> {
  private:
   friend class internal::FileSystemStoragePathSourceTestAccess;
 
-  FileSystemStoragePathSource() = default;
+  FileSystemStoragePathSource();
 
   // Polls the file system and identify numerical children of the base path.
   // If zero such children are found, invokes 'aspired_versions_callback_' with
@@ -119,6 +121,16 @@ class FileSystemStoragePathSource : public Source<StoragePath> {
 
   std::function<void()> aspired_versions_callback_notifier_ TF_GUARDED_BY(mu_);
 
+  // The base path listings of earlier polls, used if
+  // 'config_.cache_base_path_listings()' is true.
+  const std::unique_ptr<internal::BasePathListingCache> listing_cache_;
+
+  // Polls the base paths of the servables concurrently, if
+  // 'config_.num_file_system_polling_threads()' is more than one, with that
+  // many threads.
+  std::unique_ptr<ThreadPoolExecutor> polling_pool_ TF_GUARDED_BY(mu_);
+  int num_polling_threads_ TF_GUARDED_BY(mu_) = 1;
+
   // A thread that calls PollFileSystemAndInvokeCallback() once or periodically.
   using ThreadType =
       absl::variant<absl::monostate, PeriodicFunction, std::unique_ptr<Thread>>;
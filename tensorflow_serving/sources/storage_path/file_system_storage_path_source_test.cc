@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow_serving/sources/storage_path/file_system_storage_path_source.h"
 
+#include <utime.h>
+
 #include <atomic>
 #include <functional>
 #include <memory>
@@ -29,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/env_time.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow_serving/config/file_system_storage_path_source.pb.h"
 #include "tensorflow_serving/core/servable_data.h"
@@ -524,6 +527,166 @@ TEST(FileSystemStoragePathSourceTest, MultipleServables) {
                    .PollFileSystemAndInvokeCallback());
 }
 
+TEST(FileSystemStoragePathSourceTest, MultipleServablesPolledConcurrently) {
+  FileSystemStoragePathSourceConfig config;
+  config.set_file_system_poll_wait_seconds(-1);  // Disable the polling thread.
+  config.set_num_file_system_polling_threads(4);
+
+  // Servable i has the single version i + 1.
+  const string base_path_prefix = io::JoinPath(
+      testing::TmpDir(), "MultipleServablesPolledConcurrently_");
+  for (int i = 0; i < 10; ++i) {
+    const string base_path = absl::StrCat(base_path_prefix, i);
+    TF_ASSERT_OK(Env::Default()->CreateDir(base_path));
+    const string version_path = io::JoinPath(base_path, absl::StrCat(i + 1));
+    TF_ASSERT_OK(Env::Default()->CreateDir(version_path));
+    auto* servable = config.add_servables();
+    servable->set_servable_name(absl::StrCat("servable_", i));
+    servable->set_base_path(base_path);
+  }
+
+  std::unique_ptr<FileSystemStoragePathSource> source;
+  TF_ASSERT_OK(FileSystemStoragePathSource::Create(config, &source));
+  std::unique_ptr<test_util::MockStoragePathTarget> target(
+      new StrictMock<test_util::MockStoragePathTarget>);
+  ConnectSourceToTarget(source.get(), target.get());
+
+  for (int i = 0; i < 10; ++i) {
+    const string servable_name = absl::StrCat("servable_", i);
+    EXPECT_CALL(*target,
+                SetAspiredVersions(
+                    Eq(servable_name),
+                    ElementsAre(ServableData<StoragePath>(
+                        {servable_name, i + 1},
+                        io::JoinPath(absl::StrCat(base_path_prefix, i),
+                                     absl::StrCat(i + 1))))));
+  }
+  TF_ASSERT_OK(internal::FileSystemStoragePathSourceTestAccess(source.get())
+                   .PollFileSystemAndInvokeCallback());
+
+  // A missing base path fails the whole poll, like with serial polling.
+  config.mutable_servables(3)->set_base_path(
+      absl::StrCat(base_path_prefix, "nonexistent"));
+  TF_ASSERT_OK(source->UpdateConfig(config));
+  EXPECT_FALSE(internal::FileSystemStoragePathSourceTestAccess(source.get())
+                   .PollFileSystemAndInvokeCallback()
+                   .ok());
+}
+
+TEST(FileSystemStoragePathSourceTest, CacheBasePathListings) {
+  const string base_path =
+      io::JoinPath(testing::TmpDir(), "CacheBasePathListings");
+  TF_ASSERT_OK(Env::Default()->CreateDir(base_path));
+  TF_ASSERT_OK(Env::Default()->CreateDir(io::JoinPath(base_path, "1")));
+  // Sets the modification time of the base path to 'seconds' since the epoch.
+  const auto set_base_path_mtime = [&](const time_t seconds) {
+    struct utimbuf times = {seconds, seconds};
+    ASSERT_EQ(0, utime(base_path.c_str(), &times));
+  };
+  const time_t now = EnvTime::NowSeconds();
+  set_base_path_mtime(now - 3600);
+
+  auto config = test_util::CreateProto<FileSystemStoragePathSourceConfig>(
+      strings::Printf("servables: {"
+                      "  servable_name: 'test_servable_name' "
+                      "  base_path: '%s' "
+                      "} "
+                      "cache_base_path_listings: true "
+                      // Disable the polling thread.
+                      "file_system_poll_wait_seconds: -1 ",
+                      base_path.c_str()));
+  std::unique_ptr<FileSystemStoragePathSource> source;
+  TF_ASSERT_OK(FileSystemStoragePathSource::Create(config, &source));
+  std::unique_ptr<test_util::MockStoragePathTarget> target(
+      new StrictMock<test_util::MockStoragePathTarget>);
+  ConnectSourceToTarget(source.get(), target.get());
+
+  EXPECT_CALL(*target, SetAspiredVersions(Eq("test_servable_name"),
+                                          ElementsAre(ServableData<StoragePath>(
+                                              {"test_servable_name", 1},
+                                              io::JoinPath(base_path, "1")))))
+      .Times(2);
+  TF_ASSERT_OK(internal::FileSystemStoragePathSourceTestAccess(source.get())
+                   .PollFileSystemAndInvokeCallback());
+
+  // A new version which leaves the modification time of the base path as it
+  // was isn't found, since the base path isn't listed again.
+  TF_ASSERT_OK(Env::Default()->CreateDir(io::JoinPath(base_path, "2")));
+  set_base_path_mtime(now - 3600);
+  TF_ASSERT_OK(internal::FileSystemStoragePathSourceTestAccess(source.get())
+                   .PollFileSystemAndInvokeCallback());
+
+  set_base_path_mtime(now - 1800);
+  EXPECT_CALL(*target, SetAspiredVersions(Eq("test_servable_name"),
+                                          ElementsAre(ServableData<StoragePath>(
+                                              {"test_servable_name", 2},
+                                              io::JoinPath(base_path, "2")))));
+  TF_ASSERT_OK(internal::FileSystemStoragePathSourceTestAccess(source.get())
+                   .PollFileSystemAndInvokeCallback());
+}
+
+TEST(FileSystemStoragePathSourceTest, MaxBasePathListingAge) {
+  const string base_path =
+      io::JoinPath(testing::TmpDir(), "MaxBasePathListingAge");
+  TF_ASSERT_OK(Env::Default()->CreateDir(base_path));
+  TF_ASSERT_OK(Env::Default()->CreateDir(io::JoinPath(base_path, "1")));
+  // Sets the modification time of the base path to an hour ago, as if the
+  // file system never updated it.
+  const time_t mtime = EnvTime::NowSeconds() - 3600;
+  const auto reset_base_path_mtime = [&]() {
+    struct utimbuf times = {mtime, mtime};
+    ASSERT_EQ(0, utime(base_path.c_str(), &times));
+  };
+  reset_base_path_mtime();
+
+  auto config = test_util::CreateProto<FileSystemStoragePathSourceConfig>(
+      strings::Printf("servables: {"
+                      "  servable_name: 'test_servable_name' "
+                      "  base_path: '%s' "
+                      "} "
+                      "cache_base_path_listings: true "
+                      "max_base_path_listing_age_seconds: 1 "
+                      // Disable the polling thread.
+                      "file_system_poll_wait_seconds: -1 ",
+                      base_path.c_str()));
+  std::unique_ptr<FileSystemStoragePathSource> source;
+  TF_ASSERT_OK(FileSystemStoragePathSource::Create(config, &source));
+  std::unique_ptr<test_util::MockStoragePathTarget> target(
+      new StrictMock<test_util::MockStoragePathTarget>);
+  ConnectSourceToTarget(source.get(), target.get());
+  const auto expect_version = [&](const int64_t version) {
+    EXPECT_CALL(*target, SetAspiredVersions(
+                             Eq("test_servable_name"),
+                             ElementsAre(ServableData<StoragePath>(
+                                 {"test_servable_name", version},
+                                 io::JoinPath(base_path,
+                                              absl::StrCat(version))))));
+  };
+
+  expect_version(1);
+  TF_ASSERT_OK(internal::FileSystemStoragePathSourceTestAccess(source.get())
+                   .PollFileSystemAndInvokeCallback());
+  TF_ASSERT_OK(Env::Default()->CreateDir(io::JoinPath(base_path, "2")));
+  reset_base_path_mtime();
+  expect_version(1);
+  TF_ASSERT_OK(internal::FileSystemStoragePathSourceTestAccess(source.get())
+                   .PollFileSystemAndInvokeCallback());
+
+  // Once the listing is too old, the base path is listed again.
+  Env::Default()->SleepForMicroseconds(1100 * 1000);
+  expect_version(2);
+  TF_ASSERT_OK(internal::FileSystemStoragePathSourceTestAccess(source.get())
+                   .PollFileSystemAndInvokeCallback());
+
+  // Its children changed while its modification time didn't, so it isn't
+  // cached anymore.
+  TF_ASSERT_OK(Env::Default()->CreateDir(io::JoinPath(base_path, "3")));
+  reset_base_path_mtime();
+  expect_version(3);
+  TF_ASSERT_OK(internal::FileSystemStoragePathSourceTestAccess(source.get())
+                   .PollFileSystemAndInvokeCallback());
+}
+
 TEST(FileSystemStoragePathSourceTest, ChangeSetOfServables) {
   FileSystemStoragePathSourceConfig config;
   config.set_fail_if_zero_versions_at_startup(false);
@@ -0,0 +1,325 @@
+/* Copyright 2018 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/util/binary_tensor.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/byte_order.h"
+
+namespace tensorflow {
+namespace serving {
+
+const char* const kBinaryTensorsContentType =
+    "application/x-tensorflow-serving-tensors";
+
+namespace {
+
+constexpr char kMagic[] = "TFSB";
+constexpr size_t kMagicSize = 4;
+constexpr uint32_t kVersion = 1;
+
+// Size of the buffer DT_STRING values are gathered in before being handed to
+// the output writer.
+constexpr size_t kStringChunkSize = 64 * 1024;
+
+// Returns true if tensors of `dtype` can be encoded.
+bool IsSupportedType(DataType dtype) {
+  return dtype == DT_STRING || DataTypeCanUseMemcpy(dtype);
+}
+
+// Returns true if the in-memory layout of `dtype` values matches the
+// (little-endian) encoding on this host.
+bool HasEncodedLayout(DataType dtype) {
+  return port::kLittleEndian || dtype == DT_STRING || DataTypeSize(dtype) == 1;
+}
+
+// Reads the encoding front to back. All Read*() methods return false if there
+// is not enough data left.
+class Reader {
+ public:
+  explicit Reader(absl::string_view data) : data_(data) {}
+
+  bool ReadUint32(uint32_t* value) {
+    if (data_.size() < sizeof(*value)) return false;
+    *value = core::DecodeFixed32(data_.data());
+    data_.remove_prefix(sizeof(*value));
+    return true;
+  }
+
+  bool ReadUint64(uint64_t* value) {
+    if (data_.size() < sizeof(*value)) return false;
+    *value = core::DecodeFixed64(data_.data());
+    data_.remove_prefix(sizeof(*value));
+    return true;
+  }
+
+  bool ReadBytes(uint64_t size, absl::string_view* bytes) {
+    if (data_.size() < size) return false;
+    *bytes = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  // Reads a uint32 size followed by that many bytes.
+  bool ReadString(absl::string_view* bytes) {
+    uint32_t size;
+    return ReadUint32(&size) && ReadBytes(size, bytes);
+  }
+
+  bool empty() const { return data_.empty(); }
+
+ private:
+  absl::string_view data_;
+};
+
+Status TruncatedError(absl::string_view what) {
+  return errors::InvalidArgument("Binary tensors truncated while reading ",
+                                 what);
+}
+
+// Decodes the `data` of a DT_STRING tensor into `tensor`.
+Status DecodeStrings(absl::string_view name, absl::string_view data,
+                     Tensor* tensor) {
+  Reader reader(data);
+  auto values = tensor->flat<tstring>();
+  for (int64_t i = 0; i < values.size(); ++i) {
+    absl::string_view value;
+    if (!reader.ReadString(&value)) {
+      return errors::InvalidArgument("Tensor name: ", name,
+                                     " has fewer string values than its "
+                                     "shape requires: ",
+                                     values.size());
+    }
+    values(i).assign(value.data(), value.size());
+  }
+  if (!reader.empty()) {
+    return errors::InvalidArgument("Tensor name: ", name,
+                                   " has more string values than its shape "
+                                   "allows: ",
+                                   values.size());
+  }
+  return OkStatus();
+}
+
+// Decodes one named tensor.
+Status DecodeTensor(Reader* reader, std::pair<string, Tensor>* named_tensor) {
+  absl::string_view name;
+  if (!reader->ReadString(&name)) return TruncatedError("tensor name");
+  named_tensor->first = string(name);
+
+  uint32_t dtype_value;
+  if (!reader->ReadUint32(&dtype_value)) return TruncatedError("dtype");
+  const DataType dtype = static_cast<DataType>(dtype_value);
+  if (!DataType_IsValid(dtype_value) || !IsSupportedType(dtype)) {
+    return errors::InvalidArgument("Tensor name: ", name,
+                                   " has unsupported dtype: ", dtype_value);
+  }
+  if (!HasEncodedLayout(dtype)) {
+    return errors::Unimplemented(
+        "Binary tensors of dtype: ", DataTypeString(dtype),
+        " are not supported on big-endian hosts");
+  }
+
+  uint32_t rank;
+  if (!reader->ReadUint32(&rank)) return TruncatedError("rank");
+  if (rank > TensorShape::MaxDimensions()) {
+    return errors::InvalidArgument("Tensor name: ", name,
+                                   " has too many dimensions: ", rank);
+  }
+  std::vector<int64_t> dims(rank);
+  for (uint32_t i = 0; i < rank; ++i) {
+    uint64_t dim;
+    if (!reader->ReadUint64(&dim)) return TruncatedError("dims");
+    dims[i] = static_cast<int64_t>(dim);
+  }
+  TensorShape shape;
+  TF_RETURN_IF_ERROR(TensorShape::BuildTensorShape(dims, &shape));
+
+  uint64_t data_size;
+  if (!reader->ReadUint64(&data_size)) return TruncatedError("data size");
+  absl::string_view data;
+  if (!reader->ReadBytes(data_size, &data)) return TruncatedError("data");
+
+  // Check the data size before allocating the tensor, so that a bogus shape
+  // cannot trigger a huge allocation.
+  const uint64_t num_elements = shape.num_elements();
+  if (dtype == DT_STRING) {
+    if (num_elements > data_size / sizeof(uint32_t)) {
+      return errors::InvalidArgument(
+          "Tensor name: ", name, " has ", data_size,
+          " bytes of data, too few for shape ", shape.DebugString());
+    }
+    Tensor tensor(dtype, shape);
+    TF_RETURN_IF_ERROR(DecodeStrings(name, data, &tensor));
+    named_tensor->second = std::move(tensor);
+    return OkStatus();
+  }
+  const uint64_t value_size = DataTypeSize(dtype);
+  if (num_elements > data_size / value_size ||
+      num_elements * value_size != data_size) {
+    return errors::InvalidArgument(
+        "Tensor name: ", name, " has ", data_size, " bytes of data, expecting ",
+        num_elements, " values of ", value_size, " bytes for shape ",
+        shape.DebugString());
+  }
+  if (dtype == DT_BOOL) {
+    // Any other byte value is not a valid bool.
+    for (const char c : data) {
+      if (c != 0 && c != 1) {
+        return errors::InvalidArgument("Tensor name: ", name,
+                                       " has invalid bool value: ",
+                                       static_cast<int>(c));
+      }
+    }
+  }
+  Tensor tensor(dtype, shape);
+  if (data_size > 0) std::memcpy(tensor.data(), data.data(), data_size);
+  named_tensor->second = std::move(tensor);
+  return OkStatus();
+}
+
+// Appends a uint32 size followed by `bytes` to `out`.
+void PutString(absl::string_view bytes, string* out) {
+  core::PutFixed32(out, bytes.size());
+  out->append(bytes.data(), bytes.size());
+}
+
+}  // namespace
+
+Status DecodeBinaryTensors(absl::string_view data, string* signature_name,
+                           std::vector<std::pair<string, Tensor>>* tensors) {
+  if (data.size() < kMagicSize ||
+      std::memcmp(data.data(), kMagic, kMagicSize) != 0) {
+    return errors::InvalidArgument(
+        "Binary tensors must start with magic bytes: ", kMagic);
+  }
+  Reader reader(data.substr(kMagicSize));
+  uint32_t version;
+  if (!reader.ReadUint32(&version)) return TruncatedError("version");
+  if (version != kVersion) {
+    return errors::InvalidArgument("Unsupported binary tensors version: ",
+                                   version, " expecting: ", kVersion);
+  }
+  absl::string_view signature;
+  if (!reader.ReadString(&signature)) return TruncatedError("signature name");
+  uint32_t num_tensors;
+  if (!reader.ReadUint32(&num_tensors)) {
+    return TruncatedError("number of tensors");
+  }
+
+  tensors->clear();
+  std::set<string> names;
+  for (uint32_t i = 0; i < num_tensors; ++i) {
+    std::pair<string, Tensor> named_tensor;
+    TF_RETURN_IF_ERROR(DecodeTensor(&reader, &named_tensor));
+    if (!names.insert(named_tensor.first).second) {
+      return errors::InvalidArgument("Duplicate tensor name: ",
+                                     named_tensor.first);
+    }
+    tensors->push_back(std::move(named_tensor));
+  }
+  if (!reader.empty()) {
+    return errors::InvalidArgument(
+        "Binary tensors have trailing data after the last tensor");
+  }
+  *signature_name = string(signature);
+  return OkStatus();
+}
+
+Status EncodeBinaryTensors(
+    absl::string_view signature_name,
+    const std::vector<std::pair<string, Tensor>>& tensors,
+    const BinaryTensorsWriter& output_writer) {
+  // Do all validation upfront, so that nothing is written on error.
+  for (const auto& kv : tensors) {
+    const DataType dtype = kv.second.dtype();
+    if (!IsSupportedType(dtype)) {
+      return errors::InvalidArgument(
+          "Tensor name: ", kv.first,
+          " has dtype not supported in binary tensors: ",
+          DataTypeString(dtype));
+    }
+    if (!HasEncodedLayout(dtype)) {
+      return errors::Unimplemented(
+          "Binary tensors of dtype: ", DataTypeString(dtype),
+          " are not supported on big-endian hosts");
+    }
+    if (dtype == DT_STRING) {
+      const auto values = kv.second.unaligned_flat<tstring>();
+      for (int64_t i = 0; i < values.size(); ++i) {
+        if (values(i).size() > std::numeric_limits<uint32_t>::max()) {
+          return errors::InvalidArgument("Tensor name: ", kv.first,
+                                         " has a string value that is too "
+                                         "large for binary tensors");
+        }
+      }
+    }
+  }
+
+  // Headers and string values are gathered in `buffer`, which is handed to
+  // `output_writer` ahead of each (non-string) tensor buffer, or when full.
+  string buffer(kMagic, kMagicSize);
+  core::PutFixed32(&buffer, kVersion);
+  PutString(signature_name, &buffer);
+  core::PutFixed32(&buffer, tensors.size());
+  for (const auto& kv : tensors) {
+    const Tensor& tensor = kv.second;
+    PutString(kv.first, &buffer);
+    core::PutFixed32(&buffer, tensor.dtype());
+    core::PutFixed32(&buffer, tensor.dims());
+    for (int i = 0; i < tensor.dims(); ++i) {
+      core::PutFixed64(&buffer, tensor.dim_size(i));
+    }
+    if (tensor.dtype() != DT_STRING) {
+      const absl::string_view data = tensor.tensor_data();
+      core::PutFixed64(&buffer, data.size());
+      output_writer(buffer);
+      buffer.clear();
+      if (!data.empty()) output_writer(data);
+      continue;
+    }
+    const auto values = tensor.unaligned_flat<tstring>();
+    uint64_t data_size = 0;
+    for (int64_t i = 0; i < values.size(); ++i) {
+      data_size += sizeof(uint32_t) + values(i).size();
+    }
+    core::PutFixed64(&buffer, data_size);
+    for (int64_t i = 0; i < values.size(); ++i) {
+      PutString(absl::string_view(values(i).data(), values(i).size()),
+                &buffer);
+      if (buffer.size() >= kStringChunkSize) {
+        output_writer(buffer);
+        buffer.clear();
+      }
+    }
+  }
+  if (!buffer.empty()) output_writer(buffer);
+  return OkStatus();
+}
+
+}  // namespace serving
+}  // namespace tensorflow
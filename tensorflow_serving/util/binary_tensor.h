@@ -0,0 +1,82 @@
+/* Copyright 2018 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_UTIL_BINARY_TENSOR_H_
+#define TENSORFLOW_SERVING_UTIL_BINARY_TENSOR_H_
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Binary encoding of a list of named tensors, used as an alternative to JSON
+// for bodies of REST predict requests and responses (see
+// tensorflow_serving/g3doc/api_rest.md).
+//
+// All integers are little-endian. The encoding is:
+//
+//   magic           4 bytes, "TFSB"
+//   version         uint32, currently 1
+//   signature_name  uint32 size, followed by that many bytes (may be empty)
+//   num_tensors     uint32
+//   num_tensors times:
+//     name          uint32 size, followed by that many bytes
+//     dtype         uint32, a tensorflow::DataType enum value
+//     rank          uint32
+//     dims          rank int64 values
+//     data_size     uint64
+//     data          data_size bytes
+//
+// For DT_STRING tensors `data` holds each element (in row-major order) as a
+// uint32 size followed by that many bytes. For all other dtypes it holds the
+// values in row-major order, exactly as laid out in the Tensor buffer, and
+// `data_size` must be the number of elements times the size of the dtype.
+// Only dtypes that TensorFlow can memcpy (see DataTypeCanUseMemcpy()) and
+// DT_STRING are supported.
+
+// Content type of bodies in the above encoding.
+extern const char* const kBinaryTensorsContentType;
+
+// Decodes `data` in the above encoding into `signature_name` and a list of
+// (name, Tensor) pairs. Values are copied straight into the Tensor buffers.
+Status DecodeBinaryTensors(
+    absl::string_view data, string* signature_name,
+    std::vector<std::pair<string, tensorflow::Tensor>>* tensors);
+
+// Receives the output of EncodeBinaryTensors(), one chunk at a time.
+using BinaryTensorsWriter = std::function<void(absl::string_view chunk)>;
+
+// Encodes `signature_name` and `tensors` in the above encoding, handing the
+// output to `output_writer`. Tensor buffers are passed to `output_writer` as
+// is (not copied) for all dtypes except DT_STRING.
+//
+// All errors are detected before any output is produced, so on error nothing
+// has been passed to `output_writer`.
+Status EncodeBinaryTensors(
+    absl::string_view signature_name,
+    const std::vector<std::pair<string, tensorflow::Tensor>>& tensors,
+    const BinaryTensorsWriter& output_writer);
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_UTIL_BINARY_TENSOR_H_
@@ -0,0 +1,161 @@
+/* Copyright 2018 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/util/binary_tensor.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using ::testing::HasSubstr;
+
+string Encode(absl::string_view signature_name,
+              const std::vector<std::pair<string, Tensor>>& tensors) {
+  string data;
+  TF_CHECK_OK(EncodeBinaryTensors(signature_name, tensors,
+                                  [&data](absl::string_view chunk) {
+                                    data.append(chunk.data(), chunk.size());
+                                  }));
+  return data;
+}
+
+// Returns the encoding of a single tensor with the given (raw) fields.
+string EncodeRaw(uint32 dtype, const std::vector<int64_t>& dims,
+                 absl::string_view tensor_data) {
+  string data = "TFSB";
+  core::PutFixed32(&data, 1);  // version
+  core::PutFixed32(&data, 0);  // signature name
+  core::PutFixed32(&data, 1);  // number of tensors
+  core::PutFixed32(&data, 1);
+  data.append("x");
+  core::PutFixed32(&data, dtype);
+  core::PutFixed32(&data, dims.size());
+  for (const int64_t dim : dims) core::PutFixed64(&data, dim);
+  core::PutFixed64(&data, tensor_data.size());
+  data.append(tensor_data.data(), tensor_data.size());
+  return data;
+}
+
+TEST(BinaryTensorTest, RoundTrip) {
+  const std::vector<std::pair<string, Tensor>> tensors = {
+      {"float", test::AsTensor<float>({1.5, -2, 3.25, 4, 5, 6},
+                                      TensorShape({2, 3}))},
+      {"int64", test::AsTensor<int64_t>({-1, 1LL << 40})},
+      {"string", test::AsTensor<tstring>({"foo", "", string(1 << 17, 'x')})},
+      {"bool", test::AsTensor<bool>({true, false})},
+      {"scalar", test::AsScalar<double>(0.1)},
+      {"empty", Tensor(DT_FLOAT, TensorShape({0, 4}))},
+  };
+  const string data = Encode("my_signature", tensors);
+
+  string signature_name;
+  std::vector<std::pair<string, Tensor>> decoded;
+  TF_ASSERT_OK(DecodeBinaryTensors(data, &signature_name, &decoded));
+  EXPECT_EQ(signature_name, "my_signature");
+  ASSERT_EQ(decoded.size(), tensors.size());
+  for (int i = 0; i < tensors.size(); ++i) {
+    EXPECT_EQ(decoded[i].first, tensors[i].first);
+    test::ExpectEqual(decoded[i].second, tensors[i].second);
+  }
+}
+
+TEST(BinaryTensorTest, TensorDataIsWrittenAsIs) {
+  const Tensor tensor = test::AsTensor<float>({1, 2, 3, 4});
+  std::vector<absl::string_view> chunks;
+  TF_ASSERT_OK(EncodeBinaryTensors(
+      "", {{"x", tensor}},
+      [&chunks](absl::string_view chunk) { chunks.push_back(chunk); }));
+  ASSERT_EQ(chunks.size(), 2);
+  EXPECT_EQ(chunks[1].data(), tensor.tensor_data().data());
+  EXPECT_EQ(chunks[1].size(), tensor.tensor_data().size());
+}
+
+TEST(BinaryTensorTest, EncodeErrors) {
+  int num_chunks = 0;
+  const absl::Status status = EncodeBinaryTensors(
+      "", {{"x", test::AsTensor<float>({1})}, {"v", Tensor(DT_VARIANT, {})}},
+      [&num_chunks](absl::string_view) { num_chunks++; });
+  EXPECT_TRUE(errors::IsInvalidArgument(status));
+  EXPECT_THAT(status.message(), HasSubstr("not supported"));
+  EXPECT_EQ(num_chunks, 0);
+}
+
+TEST(BinaryTensorTest, DecodeErrors) {
+  string signature_name;
+  std::vector<std::pair<string, Tensor>> tensors;
+  const auto decode_error = [&](absl::string_view data) {
+    const absl::Status status =
+        DecodeBinaryTensors(data, &signature_name, &tensors);
+    EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+    return string(status.message());
+  };
+
+  EXPECT_THAT(decode_error(""), HasSubstr("magic bytes"));
+  EXPECT_THAT(decode_error("{\"instances\": []}"), HasSubstr("magic bytes"));
+
+  const string float_data(8, '\0');
+  const string valid = EncodeRaw(DT_FLOAT, {2}, float_data);
+  TF_EXPECT_OK(DecodeBinaryTensors(valid, &signature_name, &tensors));
+  for (int size = 4; size < valid.size(); ++size) {
+    EXPECT_THAT(decode_error(valid.substr(0, size)), HasSubstr("truncated"));
+  }
+  EXPECT_THAT(decode_error(valid + "x"), HasSubstr("trailing data"));
+
+  string bad_version = valid;
+  bad_version[4] = 2;
+  EXPECT_THAT(decode_error(bad_version), HasSubstr("version: 2"));
+
+  EXPECT_THAT(decode_error(EncodeRaw(DT_FLOAT, {3}, float_data)),
+              HasSubstr("expecting 3 values of 4 bytes"));
+  // Negative dimensions are rejected when building the TensorShape.
+  decode_error(EncodeRaw(DT_FLOAT, {-1}, float_data));
+  EXPECT_THAT(decode_error(EncodeRaw(DT_FLOAT, {1LL << 40, 1LL << 20},
+                                     float_data)),
+              HasSubstr("expecting"));
+  EXPECT_THAT(decode_error(EncodeRaw(DT_VARIANT, {2}, float_data)),
+              HasSubstr("unsupported dtype"));
+  EXPECT_THAT(decode_error(EncodeRaw(12345, {2}, float_data)),
+              HasSubstr("unsupported dtype"));
+  EXPECT_THAT(decode_error(EncodeRaw(DT_BOOL, {1}, "\x02")),
+              HasSubstr("invalid bool value"));
+
+  string one_string;
+  core::PutFixed32(&one_string, 3);
+  one_string.append("foo");
+  EXPECT_THAT(decode_error(EncodeRaw(DT_STRING, {2}, one_string)),
+              HasSubstr("too few"));
+  EXPECT_THAT(decode_error(EncodeRaw(DT_STRING, {1}, one_string + "x")),
+              HasSubstr("more string values"));
+
+  const Tensor tensor = test::AsTensor<float>({1});
+  EXPECT_THAT(decode_error(Encode("", {{"x", tensor}, {"x", tensor}})),
+              HasSubstr("Duplicate tensor name: x"));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,140 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_UTIL_BOUNDED_MPMC_QUEUE_H_
+#define TENSORFLOW_SERVING_UTIL_BOUNDED_MPMC_QUEUE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A bounded, lock-free multi-producer multi-consumer queue of pointers, after
+// Dmitry Vyukov's "Bounded MPMC queue". Each cell carries a sequence number
+// which tells producers and consumers whether it is free to be written or read
+// for their position, so that both sides only contend on their own position
+// counter.
+//
+// The queue doesn't own the pointed-to elements.
+template <typename T>
+class BoundedMpmcQueue {
+ public:
+  // REQUIRES: 'capacity' is a power of two.
+  explicit BoundedMpmcQueue(int64_t capacity);
+
+  BoundedMpmcQueue(const BoundedMpmcQueue&) = delete;
+  BoundedMpmcQueue& operator=(const BoundedMpmcQueue&) = delete;
+
+  // Returns false if the queue is full.
+  bool Push(T* element);
+
+  // Returns nullptr if the queue is empty.
+  T* Pop();
+
+  // Returns the number of elements in the queue, which may be out of date by
+  // the time it returns if other threads push or pop concurrently.
+  int64_t ApproximateSize() const;
+
+  int64_t capacity() const { return mask_ + 1; }
+
+ private:
+  static constexpr size_t kCacheLineSize = 64;
+
+  struct Cell {
+    std::atomic<int64_t> sequence;
+    T* element;
+  };
+
+  const int64_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+  alignas(kCacheLineSize) std::atomic<int64_t> enqueue_pos_{0};
+  alignas(kCacheLineSize) std::atomic<int64_t> dequeue_pos_{0};
+};
+
+/***************************Implementation Details***************************/
+
+template <typename T>
+BoundedMpmcQueue<T>::BoundedMpmcQueue(const int64_t capacity)
+    : mask_(capacity - 1), cells_(new Cell[capacity]) {
+  DCHECK_GT(capacity, 0);
+  DCHECK_EQ(capacity & mask_, 0) << "capacity must be a power of two";
+  for (int64_t i = 0; i < capacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+bool BoundedMpmcQueue<T>::Push(T* const element) {
+  int64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    const int64_t seq = cell->sequence.load(std::memory_order_acquire);
+    const int64_t diff = seq - pos;
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->element = element;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+T* BoundedMpmcQueue<T>::Pop() {
+  int64_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    const int64_t seq = cell->sequence.load(std::memory_order_acquire);
+    const int64_t diff = seq - (pos + 1);
+    if (diff == 0) {
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return nullptr;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  T* const element = cell->element;
+  cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return element;
+}
+
+template <typename T>
+int64_t BoundedMpmcQueue<T>::ApproximateSize() const {
+  const int64_t dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+  const int64_t enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+  return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+}
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_UTIL_BOUNDED_MPMC_QUEUE_H_
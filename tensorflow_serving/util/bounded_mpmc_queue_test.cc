@@ -0,0 +1,90 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/util/bounded_mpmc_queue.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+TEST(BoundedMpmcQueueTest, FirstInFirstOut) {
+  BoundedMpmcQueue<int> queue(4);
+  EXPECT_EQ(4, queue.capacity());
+  EXPECT_EQ(nullptr, queue.Pop());
+
+  int elements[5];
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.Push(&elements[i]));
+    EXPECT_EQ(i + 1, queue.ApproximateSize());
+  }
+  EXPECT_FALSE(queue.Push(&elements[4]));
+
+  EXPECT_EQ(&elements[0], queue.Pop());
+  EXPECT_TRUE(queue.Push(&elements[4]));
+  for (int i = 1; i < 5; ++i) {
+    EXPECT_EQ(&elements[i], queue.Pop());
+  }
+  EXPECT_EQ(nullptr, queue.Pop());
+  EXPECT_EQ(0, queue.ApproximateSize());
+}
+
+TEST(BoundedMpmcQueueTest, ConcurrentProducersAndConsumers) {
+  constexpr int kNumThreads = 4;
+  constexpr int kNumElementsPerProducer = 10000;
+  BoundedMpmcQueue<int> queue(64);
+  std::vector<int> elements(kNumThreads * kNumElementsPerProducer);
+  std::vector<std::atomic<int>> num_popped(elements.size());
+  std::atomic<int> total_popped{0};
+  {
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int i = 0; i < kNumThreads; ++i) {
+      threads.emplace_back(Env::Default()->StartThread(
+          ThreadOptions(), "producer", [&, i]() {
+            for (int j = 0; j < kNumElementsPerProducer; ++j) {
+              while (!queue.Push(&elements[i * kNumElementsPerProducer + j])) {
+                std::this_thread::yield();
+              }
+            }
+          }));
+      threads.emplace_back(
+          Env::Default()->StartThread(ThreadOptions(), "consumer", [&]() {
+            while (total_popped.load() < elements.size()) {
+              int* const element = queue.Pop();
+              if (element == nullptr) {
+                std::this_thread::yield();
+                continue;
+              }
+              ++num_popped[element - elements.data()];
+              ++total_popped;
+            }
+          }));
+    }
+  }
+  for (const auto& count : num_popped) {
+    EXPECT_EQ(1, count.load());
+  }
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
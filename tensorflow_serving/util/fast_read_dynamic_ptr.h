@@ -23,6 +23,8 @@ limitations under the License.
 #include <string>
 
 #include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -189,6 +191,39 @@ namespace internal_read_ptr_holder {
 // The Factory-based interface of update() may seem strange, but it allows
 // ReadPtrHolders to hold several distinct ReadPtrs.
 
+// The sharded ReadPtrHolders, below, keep one shard per CPU, but if
+// port::NumTotalCPUs or port::GetCurrentCPU fails, they fall back to random
+// sharding.
+constexpr int kRandomShards = 16;
+
+inline int NumShards() {
+  return port::NumTotalCPUs() == -1 ? kRandomShards : port::NumTotalCPUs();
+}
+
+// Returns the shard of the calling thread, in [0, NumShards()).
+inline int GetShard() {
+  const int cpu = port::GetCurrentCPU();
+  if (cpu != -1) {
+    return cpu;
+  }
+  // Otherwise, return a random shard.  random::New64 would introduce a mutex
+  // lock here, which would defeat the purpose of the sharding.  Similarly, a
+  // static std::atomic<uint64_t>, if updated with any memory order other than
+  // std::memory_order_relaxed, would re-introduce contention on that memory
+  // location.  A thread_local sidesteps both problems with only eight bytes
+  // per thread of overhead.
+  //
+  // MCGs need to be seeded with an odd number, so we ensure the lowest bit is
+  // set.
+  thread_local uint64_t state = {random::New64() | 1ULL};
+  // We just need something simple and good enough.  The multiplier here was
+  // picked from "COMPUTATIONALLY EASY, SPECTRALLY GOOD MULTIPLIERS FOR
+  // CONGRUENTIAL PSEUDORANDOM NUMBER GENERATORS" by Steele and Vigna.
+  state *= 0xd09d;
+  // Update this shift if kRandomShards changes.
+  return state >> 60;
+}
+
 // SingleReadDPtr is the simplest possible implementation of a ReadPtrHolder,
 // but it causes every reader to contend on both the mutex_lock and the atomic
 // reference count for the ReadPtr it holds.  By default we use ShardedReadPtrs,
@@ -220,9 +255,7 @@ class SingleReadPtr {
   std::shared_ptr<const T> p_;
 };
 
-// This maintains a set of sharded ReadPtrs.  It tries to shard one ReadPtr per
-// CPU, but if the port::NumTotalCPUs or port::GetCurrentCPU fails, it falls
-// back to random sharding.
+// This maintains a set of sharded ReadPtrs, one per shard (see GetShard()).
 template <typename T>
 class ShardedReadPtrs {
  public:
@@ -272,37 +305,109 @@ class ShardedReadPtrs {
   static_assert(sizeof(PaddedThreadSafeSharedPtr) >= 64,
                 "PaddedThreadSafeSharedPtr should be at least 64 bytes.");
 
-  static constexpr int kRandomShards = 16;
-  int GetShard() const {
-    const int cpu = port::GetCurrentCPU();
-    if (cpu != -1) {
-      return cpu;
-    }
-    // Otherwise, return a random shard.  random::New64 would introduce a mutex
-    // lock here, which would defeat the purpose of the sharding.  Similarly, a
-    // static std::atomic<uint64_t>, if updated with any memory order other than
-    // std::memory_order_relaxed, would re-introduce contention on that memory
-    // location.  A thread_local sidesteps both problems with only eight bytes
-    // per thread of overhead.
-    //
-    // MCGs need to be seeded with an odd number, so we ensure the lowest bit is
-    // set.
-    thread_local uint64_t state = {random::New64() | 1ULL};
-    // We just need something simple and good enough.  The multiplier here was
-    // picked from "COMPUTATIONALLY EASY, SPECTRALLY GOOD MULTIPLIERS FOR
-    // CONGRUENTIAL PSEUDORANDOM NUMBER GENERATORS" by Steele and Vigna.
-    state *= 0xd09d;
-    // Update this shift if kRandomShards changes.
-    return state >> 60;
-  }
-
  protected:
-  const int num_shards_ =
-      port::NumTotalCPUs() == -1 ? kRandomShards : port::NumTotalCPUs();
+  const int num_shards_ = NumShards();
   std::atomic<uint32> index_{0};
   std::unique_ptr<PaddedThreadSafeSharedPtr[]> shards_;
 };
 
+// EpochReadPtrs lets readers pin the current object through per-CPU epoch
+// counters rather than through reference counts.  The ReadPtrs returned by the
+// holders above share the reference count of the shard they came from, so
+// every get() and every destruction of a ReadPtr writes to a cache line that
+// all readers of the shard (or, with SingleReadPtr, all readers) contend on.
+//
+// Here a reader instead increments the counter of the current epoch in its own
+// shard, and decrements it when its ReadPtr is destroyed; the object pointer
+// and the epoch are only ever read.  Each ReadPtr gets its own control block,
+// so copying it or using it with the aliasing constructor of shared_ptr (e.g.
+// to hand out pieces of the object) doesn't touch shared memory either.  The
+// price is an allocation per get(), which is thread-local with most
+// allocators.
+//
+// update() publishes the new object, moves on to the next epoch, and then waits
+// until every reader which started in the previous epoch is done, before it
+// lets go of the previous object.  Unlike with the holders above, update()
+// therefore blocks, and the ReadPtrs handed out by get() aren't the ones
+// produced by the factory.
+template <typename T>
+class EpochReadPtrs {
+ public:
+  EpochReadPtrs() : shards_(new PaddedEpochCounters[num_shards_]) {}
+
+  std::shared_ptr<const T> get() const {
+    const int shard = GetShard();
+    std::atomic<int64_t>* readers;
+    for (;;) {
+      const uint32 epoch = epoch_.load();
+      readers = &shards_[shard].readers[epoch];
+      readers->fetch_add(1);
+      // If update() has moved on to the next epoch in the meantime, it may
+      // have missed our increment.
+      if (epoch_.load() == epoch) {
+        break;
+      }
+      readers->fetch_sub(1);
+    }
+    const T* const p = p_.load();
+    if (p == nullptr) {
+      readers->fetch_sub(1, std::memory_order_release);
+      return nullptr;
+    }
+    return std::shared_ptr<const T>(p, [readers](const T*) {
+      readers->fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  template <typename Factory>
+  void update(const Factory& f) {
+    std::shared_ptr<const T> p = f();
+    p_.store(p.get());
+    owned_.swap(p);
+    // Readers which see the next epoch are guaranteed to see the new object,
+    // so once those which saw the previous one are done, nothing references the
+    // previous object through us anymore.
+    const uint32 orig_epoch = epoch_.load();
+    epoch_.store(orig_epoch ? 0 : 1);
+    while (NumReaders(orig_epoch) > 0) {
+      absl::SleepFor(absl::Microseconds(kDrainPollMicros));
+    }
+  }
+
+ private:
+  // The number of microseconds update() sleeps between checks of whether the
+  // readers of the previous epoch are done.
+  static constexpr int kDrainPollMicros = 50;
+
+  // Returns the number of readers which started in 'epoch' and aren't done yet.
+  int64_t NumReaders(const uint32 epoch) const {
+    int64_t num_readers = 0;
+    for (int shard = 0; shard < num_shards_; ++shard) {
+      num_readers += shards_[shard].readers[epoch].load();
+    }
+    return num_readers;
+  }
+
+  struct EpochCounters {
+    std::atomic<int64_t> readers[2] = {{0}, {0}};
+  };
+
+  // We pad the counters to ensure that individual shards don't experience
+  // false sharing between threads.
+  struct PaddedEpochCounters : public EpochCounters {
+    char padding[64 - sizeof(EpochCounters)];
+  };
+  static_assert(sizeof(PaddedEpochCounters) >= 64,
+                "PaddedEpochCounters should be at least 64 bytes.");
+
+  const int num_shards_ = NumShards();
+  std::atomic<uint32> epoch_{0};
+  std::atomic<const T*> p_{nullptr};
+  // Keeps the object alive for as long as it's current; only used by update().
+  std::shared_ptr<const T> owned_;
+  std::unique_ptr<PaddedEpochCounters[]> shards_;
+};
+
 }  // namespace internal_read_ptr_holder
 
 template <typename T, typename ReadPtrHolder>
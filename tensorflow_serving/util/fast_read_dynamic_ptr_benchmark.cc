@@ -29,6 +29,11 @@ limitations under the License.
 // bazel run -c opt \
 // tensorflow_serving/util:fast_read_dynamic_ptr_benchmark --
 // --benchmarks=.
+//
+// Each benchmark runs with every ReadPtrHolder, e.g.
+// BM_NoWork_NoUpdates_Reads<EpochIntPtr>, and with up to as many threads as
+// there are cores, to show how reads scale with the number of cores.
+//
 // For a longer run time and more consistent results, consider a min time
 // e.g.: --benchmark_min_time=60.0
 
@@ -45,6 +50,7 @@ limitations under the License.
 #include "absl/time/time.h"
 #include "tensorflow/core/kernels/batching_util/periodic_function.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/init_main.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -56,7 +62,11 @@ namespace tensorflow {
 namespace serving {
 namespace {
 
-using FastReadIntPtr = FastReadDynamicPtr<int>;
+using ShardedIntPtr = FastReadDynamicPtr<int>;
+using SingleIntPtr =
+    FastReadDynamicPtr<int, internal_read_ptr_holder::SingleReadPtr<int>>;
+using EpochIntPtr =
+    FastReadDynamicPtr<int, internal_read_ptr_holder::EpochReadPtrs<int>>;
 
 // The amount of time to sleep for the cases where we simulate doing work.
 constexpr absl::Duration kWorkSleepTime = absl::Milliseconds(5);
@@ -69,6 +79,7 @@ constexpr absl::Duration kWorkSleepTime = absl::Milliseconds(5);
 //    state.Setup();
 //    state.RunBenchmarkReadIterations(5 /* num_threads */, 42 /* iters */);
 //    state.Teardown();
+template <typename FastReadIntPtr>
 class BenchmarkState {
  public:
   BenchmarkState(const int update_micros, const bool do_work)
@@ -112,7 +123,8 @@ class BenchmarkState {
   bool do_work_;
 };
 
-void BenchmarkState::RunUpdateThread() {
+template <typename FastReadIntPtr>
+void BenchmarkState<FastReadIntPtr>::RunUpdateThread() {
   int current_value;
   {
     std::shared_ptr<const int> current = fast_ptr_.get();
@@ -122,7 +134,8 @@ void BenchmarkState::RunUpdateThread() {
   fast_ptr_.Update(std::move(tmp));
 }
 
-void BenchmarkState::Setup() {
+template <typename FastReadIntPtr>
+void BenchmarkState<FastReadIntPtr>::Setup() {
   // setup fast read int ptr:
   std::unique_ptr<int> i(new int(0));
   fast_ptr_.Update(std::move(i));
@@ -136,12 +149,14 @@ void BenchmarkState::Setup() {
   }
 }
 
-void BenchmarkState::Teardown() {
+template <typename FastReadIntPtr>
+void BenchmarkState<FastReadIntPtr>::Teardown() {
   // Destruct the update thread which blocks until it exits.
   update_thread_.reset();
 }
 
-void BenchmarkState::RunBenchmarkReads(int iters) {
+template <typename FastReadIntPtr>
+void BenchmarkState<FastReadIntPtr>::RunBenchmarkReads(int iters) {
   // Wait until all_read_threads_scheduled_ has been notified.
   all_read_threads_scheduled_.WaitForNotification();
 
@@ -155,7 +170,8 @@ void BenchmarkState::RunBenchmarkReads(int iters) {
   }
 }
 
-void BenchmarkState::RunBenchmarkReadIterations(
+template <typename FastReadIntPtr>
+void BenchmarkState<FastReadIntPtr>::RunBenchmarkReadIterations(
     int num_threads, ::testing::benchmark::State& state) {
   CHECK_GE(num_threads, 1) << " ****unexpected thread number";
   // To be compatible with the Google benchmark framework, the tensorflow new
@@ -196,41 +212,56 @@ void BenchmarkState::RunBenchmarkReadIterations(
   state.SetItemsProcessed(num_threads * kSubIters * state.iterations());
 }
 
+template <typename FastReadIntPtr>
 void BenchmarkReadsAndUpdates(int update_micros, bool do_work,
                               ::testing::benchmark::State& state,
                               int num_threads) {
-  BenchmarkState bm_state(update_micros, do_work);
+  BenchmarkState<FastReadIntPtr> bm_state(update_micros, do_work);
   bm_state.Setup();
   bm_state.RunBenchmarkReadIterations(num_threads, state);
   bm_state.Teardown();
 }
 
+template <typename FastReadIntPtr>
 void BM_Work_NoUpdates_Reads(::testing::benchmark::State& state) {
   const int num_threads = state.range(0);
   CHECK_GT(num_threads, 0);
   // No updates. 0 update_micros signals not to update at all.
-  BenchmarkReadsAndUpdates(0, true, state, num_threads);
+  BenchmarkReadsAndUpdates<FastReadIntPtr>(0, true, state, num_threads);
 }
 
+template <typename FastReadIntPtr>
 void BM_Work_FrequentUpdates_Reads(::testing::benchmark::State& state) {
   const int num_threads = state.range(0);
   CHECK_GT(num_threads, 0);
   // Frequent updates: 1000 micros == 1 millisecond or 1000qps of updates
-  BenchmarkReadsAndUpdates(1000, true, state, num_threads);
+  BenchmarkReadsAndUpdates<FastReadIntPtr>(1000, true, state, num_threads);
 }
 
+template <typename FastReadIntPtr>
 void BM_NoWork_NoUpdates_Reads(::testing::benchmark::State& state) {
   const int num_threads = state.range(0);
   CHECK_GT(num_threads, 0);
   // No updates. 0 update_micros signals not to update at all.
-  BenchmarkReadsAndUpdates(0, false, state, num_threads);
+  BenchmarkReadsAndUpdates<FastReadIntPtr>(0, false, state, num_threads);
 }
 
+template <typename FastReadIntPtr>
 void BM_NoWork_FrequentUpdates_Reads(::testing::benchmark::State& state) {
   const int num_threads = state.range(0);
   CHECK_GT(num_threads, 0);
   // Frequent updates: 1000 micros == 1 millisecond or 1000qps of updates
-  BenchmarkReadsAndUpdates(1000, false, state, num_threads);
+  BenchmarkReadsAndUpdates<FastReadIntPtr>(1000, false, state, num_threads);
+}
+
+// Runs with 1, 2, 4, ... threads, up to 64 or, on machines with more cores, up
+// to one thread per core.
+void ThreadCounts(::benchmark::internal::Benchmark* benchmark) {
+  const int max_threads = std::max(64, port::MaxParallelism());
+  for (int num_threads = 1; num_threads < max_threads; num_threads *= 2) {
+    benchmark->Arg(num_threads);
+  }
+  benchmark->Arg(max_threads);
 }
 
 // The benchmarking system by default uses cpu time to calculate items per
@@ -238,45 +269,45 @@ void BM_NoWork_FrequentUpdates_Reads(::testing::benchmark::State& state) {
 // Instead of that we use real-time here so that we can see items/s increasing
 // with increasing threads, which is easier to understand.
 
-BENCHMARK(BM_Work_NoUpdates_Reads)
+BENCHMARK_TEMPLATE(BM_Work_NoUpdates_Reads, ShardedIntPtr)
+    ->UseRealTime()
+    ->Apply(ThreadCounts);
+BENCHMARK_TEMPLATE(BM_Work_NoUpdates_Reads, SingleIntPtr)
+    ->UseRealTime()
+    ->Apply(ThreadCounts);
+BENCHMARK_TEMPLATE(BM_Work_NoUpdates_Reads, EpochIntPtr)
+    ->UseRealTime()
+    ->Apply(ThreadCounts);
+
+BENCHMARK_TEMPLATE(BM_Work_FrequentUpdates_Reads, ShardedIntPtr)
+    ->UseRealTime()
+    ->Apply(ThreadCounts);
+BENCHMARK_TEMPLATE(BM_Work_FrequentUpdates_Reads, SingleIntPtr)
+    ->UseRealTime()
+    ->Apply(ThreadCounts);
+BENCHMARK_TEMPLATE(BM_Work_FrequentUpdates_Reads, EpochIntPtr)
+    ->UseRealTime()
+    ->Apply(ThreadCounts);
+
+BENCHMARK_TEMPLATE(BM_NoWork_NoUpdates_Reads, ShardedIntPtr)
+    ->UseRealTime()
+    ->Apply(ThreadCounts);
+BENCHMARK_TEMPLATE(BM_NoWork_NoUpdates_Reads, SingleIntPtr)
     ->UseRealTime()
-    ->Arg(1)
-    ->Arg(2)
-    ->Arg(4)
-    ->Arg(8)
-    ->Arg(16)
-    ->Arg(32)
-    ->Arg(64);
-
-BENCHMARK(BM_Work_FrequentUpdates_Reads)
+    ->Apply(ThreadCounts);
+BENCHMARK_TEMPLATE(BM_NoWork_NoUpdates_Reads, EpochIntPtr)
+    ->UseRealTime()
+    ->Apply(ThreadCounts);
+
+BENCHMARK_TEMPLATE(BM_NoWork_FrequentUpdates_Reads, ShardedIntPtr)
     ->UseRealTime()
-    ->Arg(1)
-    ->Arg(2)
-    ->Arg(4)
-    ->Arg(8)
-    ->Arg(16)
-    ->Arg(32)
-    ->Arg(64);
-
-BENCHMARK(BM_NoWork_NoUpdates_Reads)
+    ->Apply(ThreadCounts);
+BENCHMARK_TEMPLATE(BM_NoWork_FrequentUpdates_Reads, SingleIntPtr)
     ->UseRealTime()
-    ->Arg(1)
-    ->Arg(2)
-    ->Arg(4)
-    ->Arg(8)
-    ->Arg(16)
-    ->Arg(32)
-    ->Arg(64);
-
-BENCHMARK(BM_NoWork_FrequentUpdates_Reads)
+    ->Apply(ThreadCounts);
+BENCHMARK_TEMPLATE(BM_NoWork_FrequentUpdates_Reads, EpochIntPtr)
     ->UseRealTime()
-    ->Arg(1)
-    ->Arg(2)
-    ->Arg(4)
-    ->Arg(8)
-    ->Arg(16)
-    ->Arg(32)
-    ->Arg(64);
+    ->Apply(ThreadCounts);
 
 }  // namespace
 }  // namespace serving
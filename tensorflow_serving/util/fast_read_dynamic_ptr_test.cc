@@ -33,7 +33,8 @@ class FastReadDynamicPtrTest : public ::testing::Test {};
 using FastReadDynamicPtrTypes = ::testing::Types<
     FastReadDynamicPtr<int>,
     FastReadDynamicPtr<int, internal_read_ptr_holder::ShardedReadPtrs<int>>,
-    FastReadDynamicPtr<int, internal_read_ptr_holder::SingleReadPtr<int>>>;
+    FastReadDynamicPtr<int, internal_read_ptr_holder::SingleReadPtr<int>>,
+    FastReadDynamicPtr<int, internal_read_ptr_holder::EpochReadPtrs<int>>>;
 
 TYPED_TEST_SUITE(FastReadDynamicPtrTest, FastReadDynamicPtrTypes);
 
@@ -117,6 +118,34 @@ TYPED_TEST(FastReadDynamicPtrTest, WaitsForReadPtrsBeforeDestruction) {
   fast_read_int = nullptr;
 }
 
+TYPED_TEST(FastReadDynamicPtrTest, UpdateWaitsForReadPtrsToOldObject) {
+  TypeParam fast_read_int;
+  fast_read_int.Update(std::unique_ptr<int>(new int(1)));
+  std::shared_ptr<const int> old_pointer = fast_read_int.get();
+
+  absl::Notification updated;
+  std::unique_ptr<Thread> thread(
+      Env::Default()->StartThread({}, "Updater", [&] {
+        std::unique_ptr<int> old_object =
+            fast_read_int.Update(std::unique_ptr<int>(new int(2)));
+        EXPECT_EQ(1, *old_object);
+        updated.Notify();
+      }));
+  // Wait until the update has been published.
+  while (*fast_read_int.get() != 2) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  // Copies of a ReadPtr keep the old object alive, just like the original.
+  std::shared_ptr<const int> old_pointer_copy = old_pointer;
+  old_pointer = nullptr;
+  Env::Default()->SleepForMicroseconds(100 * 1000);
+  EXPECT_FALSE(updated.HasBeenNotified());
+  EXPECT_EQ(1, *old_pointer_copy);
+
+  old_pointer_copy = nullptr;
+  updated.WaitForNotification();
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
@@ -16,14 +16,22 @@ limitations under the License.
 #include "tensorflow_serving/util/json_tensor.h"
 
 #include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <limits>
+#include <memory>
 #include <set>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "rapidjson/document.h"
 #include "rapidjson/error/en.h"
@@ -32,6 +40,8 @@ limitations under the License.
 #include "rapidjson/rapidjson.h"
 #include "rapidjson/reader.h"
 #include "rapidjson/stringbuffer.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/escaping.h"
 #include "absl/strings/match.h"
 #include "absl/strings/numbers.h"
@@ -40,7 +50,9 @@ limitations under the License.
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -706,6 +718,855 @@ Status FillPredictRequestFromJson(
 
 namespace {
 
+// Minimum capacity (in elements) of the buffer backing each decoded tensor.
+constexpr int64_t kMinDecodeBufferElements = 64;
+
+// Rough number of JSON bytes per numeric value (digits plus separator), used
+// to size the decode buffers from the request size.
+constexpr int64_t kEstimatedJsonBytesPerValue = 8;
+
+// A 1-D Tensor that grows geometrically as values are appended to it.
+//
+// Lets the streaming decoder write values in place before the final shape of
+// the tensor is known. Finish() returns the populated prefix reshaped to the
+// final shape, sharing (not copying) the underlying buffer.
+class TensorBuilder {
+ public:
+  TensorBuilder(DataType dtype, int64_t capacity)
+      : dtype_(dtype),
+        buffer_(dtype,
+                TensorShape({std::max(capacity, kMinDecodeBufferElements)})) {}
+
+  DataType dtype() const { return dtype_; }
+
+  template <typename T>
+  void Append(T val) {
+    if (size_ == buffer_.NumElements()) Grow();
+    static_cast<T*>(buffer_.data())[size_++] = std::move(val);
+  }
+
+  // Returns false if `shape` does not have exactly as many elements as were
+  // appended.
+  bool Finish(const TensorShape& shape, Tensor* out) const {
+    if (shape.num_elements() != size_) return false;
+    Tensor values = buffer_.Slice(0, size_);
+    // Do not pin a mostly unused buffer for the lifetime of the request.
+    if (size_ < buffer_.NumElements() / 2) values = tensor::DeepCopy(values);
+    return out->CopyFrom(values, shape);
+  }
+
+ private:
+  void Grow() {
+    Tensor grown(dtype_, TensorShape({2 * buffer_.NumElements()}));
+    if (dtype_ == DT_STRING) {
+      auto* src = static_cast<tstring*>(buffer_.data());
+      std::move(src, src + size_, static_cast<tstring*>(grown.data()));
+    } else {
+      std::memcpy(grown.data(), buffer_.data(), size_ * DataTypeSize(dtype_));
+    }
+    buffer_ = std::move(grown);
+  }
+
+  const DataType dtype_;
+  Tensor buffer_;
+  int64_t size_ = 0;
+};
+
+bool IsStreamingDecodeSupported(DataType dtype) {
+  switch (dtype) {
+    case DT_FLOAT:
+    case DT_DOUBLE:
+    case DT_INT32:
+    case DT_INT16:
+    case DT_INT8:
+    case DT_UINT8:
+    case DT_STRING:
+    case DT_INT64:
+    case DT_BOOL:
+    case DT_UINT32:
+    case DT_UINT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The Append*() functions below add a JSON number to `builder` following the
+// same type rules as AddValueToTensor() (and the conversion done by
+// Tensor::FromProto() for the narrow integer types). They return false if the
+// number cannot be represented in the dtype of the builder.
+void AppendInt32(int32_t val, TensorBuilder* builder) {
+  switch (builder->dtype()) {
+    case DT_INT16:
+      builder->Append<int16_t>(static_cast<int16_t>(val));
+      break;
+    case DT_INT8:
+      builder->Append<int8_t>(static_cast<int8_t>(val));
+      break;
+    case DT_UINT8:
+      builder->Append<uint8_t>(static_cast<uint8_t>(val));
+      break;
+    default:
+      builder->Append<int32_t>(val);
+      break;
+  }
+}
+
+bool AppendSigned(int64_t val, TensorBuilder* builder) {
+  switch (builder->dtype()) {
+    case DT_FLOAT:
+      builder->Append<float>(static_cast<float>(static_cast<double>(val)));
+      return true;
+    case DT_DOUBLE:
+      builder->Append<double>(static_cast<double>(val));
+      return true;
+    case DT_INT32:
+    case DT_INT16:
+    case DT_INT8:
+    case DT_UINT8:
+      if (val < std::numeric_limits<int32_t>::min() ||
+          val > std::numeric_limits<int32_t>::max()) {
+        return false;
+      }
+      AppendInt32(static_cast<int32_t>(val), builder);
+      return true;
+    case DT_INT64:
+      builder->Append<int64_t>(val);
+      return true;
+    case DT_UINT32:
+      if (val < 0 || val > std::numeric_limits<uint32_t>::max()) return false;
+      builder->Append<uint32_t>(static_cast<uint32_t>(val));
+      return true;
+    case DT_UINT64:
+      if (val < 0) return false;
+      builder->Append<uint64_t>(static_cast<uint64_t>(val));
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool AppendUnsigned(uint64_t val, TensorBuilder* builder) {
+  switch (builder->dtype()) {
+    case DT_FLOAT:
+      builder->Append<float>(static_cast<float>(static_cast<double>(val)));
+      return true;
+    case DT_DOUBLE:
+      builder->Append<double>(static_cast<double>(val));
+      return true;
+    case DT_INT32:
+    case DT_INT16:
+    case DT_INT8:
+    case DT_UINT8:
+      if (val > std::numeric_limits<int32_t>::max()) return false;
+      AppendInt32(static_cast<int32_t>(val), builder);
+      return true;
+    case DT_INT64:
+      if (val > std::numeric_limits<int64_t>::max()) return false;
+      builder->Append<int64_t>(static_cast<int64_t>(val));
+      return true;
+    case DT_UINT32:
+      if (val > std::numeric_limits<uint32_t>::max()) return false;
+      builder->Append<uint32_t>(static_cast<uint32_t>(val));
+      return true;
+    case DT_UINT64:
+      builder->Append<uint64_t>(val);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool AppendDouble(double val, TensorBuilder* builder) {
+  switch (builder->dtype()) {
+    case DT_FLOAT:
+      builder->Append<float>(static_cast<float>(val));
+      return true;
+    case DT_DOUBLE:
+      builder->Append<double>(val);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Decodes the JSON value of one named tensor from SAX events.
+//
+// The tensor may be built from several "items" (one per element of the
+// "instances" list), all of which must have the same shape. Shapes are
+// inferred as in GetDenseTensorShape() and validated as in FillTensorProto(),
+// but incrementally: the size of each level is fixed by the first list that
+// closes at that level, and the rank by the first leaf (or empty list).
+class JsonTensorDecoder {
+ public:
+  JsonTensorDecoder(DataType dtype, int64_t capacity)
+      : builder_(dtype, capacity) {}
+
+  // Starts decoding the next item. The following events must form exactly
+  // one JSON value.
+  void BeginItem() {
+    done_ = false;
+    num_items_++;
+  }
+
+  // Whether the value of the current item is complete.
+  bool done() const { return done_; }
+
+  int64_t num_items() const { return num_items_; }
+
+  bool Bool(bool b) {
+    if (builder_.dtype() != DT_BOOL || !BeginLeaf()) return false;
+    builder_.Append<bool>(b);
+    return EndLeaf();
+  }
+
+  bool Signed(int64_t val) {
+    return BeginLeaf() && AppendSigned(val, &builder_) && EndLeaf();
+  }
+
+  bool Unsigned(uint64_t val) {
+    return BeginLeaf() && AppendUnsigned(val, &builder_) && EndLeaf();
+  }
+
+  bool Double(double val) {
+    return BeginLeaf() && AppendDouble(val, &builder_) && EndLeaf();
+  }
+
+  bool String(const char* str, rapidjson::SizeType length) {
+    if (builder_.dtype() != DT_STRING) return false;
+    if (base64_state_ == Base64State::kExpectValue) {
+      string decoded;
+      if (!absl::Base64Unescape(absl::string_view(str, length), &decoded)) {
+        return false;
+      }
+      builder_.Append<tstring>(tstring(decoded));
+      base64_state_ = Base64State::kExpectEnd;
+      return true;
+    }
+    if (!BeginLeaf()) return false;
+    builder_.Append<tstring>(tstring(str, length));
+    return EndLeaf();
+  }
+
+  // Objects are only allowed as base64 encoded strings, formatted as
+  // { "b64": "<base64 encoded string>" }.
+  bool StartObject() {
+    if (builder_.dtype() != DT_STRING || !BeginLeaf()) return false;
+    base64_state_ = Base64State::kExpectKey;
+    return true;
+  }
+
+  bool Key(const char* str, rapidjson::SizeType length) {
+    if (base64_state_ != Base64State::kExpectKey ||
+        absl::string_view(str, length) != kBase64Key) {
+      return false;
+    }
+    base64_state_ = Base64State::kExpectValue;
+    return true;
+  }
+
+  bool EndObject() {
+    if (base64_state_ != Base64State::kExpectEnd) return false;
+    base64_state_ = Base64State::kNone;
+    return EndLeaf();
+  }
+
+  bool StartArray() {
+    if (base64_state_ != Base64State::kNone) return false;
+    // Lists can not be nested deeper than the rank.
+    if (rank_ >= 0 && depth() >= rank_) return false;
+    AddElementToParent();
+    open_list_sizes_.push_back(0);
+    return true;
+  }
+
+  bool EndArray() {
+    if (base64_state_ != Base64State::kNone || open_list_sizes_.empty()) {
+      return false;
+    }
+    const int64_t size = open_list_sizes_.back();
+    open_list_sizes_.pop_back();
+    const int level = depth();
+    if (size == 0 && rank_ < 0) rank_ = level + 1;
+    if (level >= static_cast<int>(dims_.size())) dims_.resize(level + 1, -1);
+    if (dims_[level] < 0) {
+      dims_[level] = size;
+    } else if (dims_[level] != size) {
+      return false;
+    }
+    if (open_list_sizes_.empty()) done_ = true;
+    return true;
+  }
+
+  // Builds the decoded tensor. If `batch_size` is non-negative, the items are
+  // stacked along a new leading dimension of that size.
+  bool Finish(int64_t batch_size, Tensor* tensor) const {
+    if (!done_ || rank_ < 0 || static_cast<int>(dims_.size()) != rank_) {
+      return false;
+    }
+    TensorShape shape;
+    if (batch_size >= 0) shape.AddDim(batch_size);
+    for (const int64_t dim : dims_) shape.AddDim(dim);
+    return builder_.Finish(shape, tensor);
+  }
+
+ private:
+  enum class Base64State { kNone, kExpectKey, kExpectValue, kExpectEnd };
+
+  int depth() const { return open_list_sizes_.size(); }
+
+  void AddElementToParent() {
+    if (!open_list_sizes_.empty()) open_list_sizes_.back()++;
+  }
+
+  // All values of a (dense) tensor are at the same level, equal to its rank.
+  bool BeginLeaf() {
+    if (base64_state_ != Base64State::kNone) return false;
+    if (rank_ < 0) {
+      rank_ = depth();
+    } else if (depth() != rank_) {
+      return false;
+    }
+    AddElementToParent();
+    return true;
+  }
+
+  bool EndLeaf() {
+    if (open_list_sizes_.empty()) done_ = true;
+    return true;
+  }
+
+  TensorBuilder builder_;
+  // Number of elements seen so far in each of the currently open lists.
+  std::vector<int64_t> open_list_sizes_;
+  // Size of each level, or -1 if no list at that level was closed yet.
+  std::vector<int64_t> dims_;
+  int rank_ = -1;
+  Base64State base64_state_ = Base64State::kNone;
+  int64_t num_items_ = 0;
+  bool done_ = false;
+};
+
+// rapidjson SAX handler that decodes a predict request JSON object into input
+// Tensors (see FillPredictInputsFromJson()).
+//
+// Returning false from any event aborts parsing. This happens for all
+// malformed requests, and for well-formed ones the handler does not support,
+// in which case the caller falls back to FillPredictRequestFromJson().
+class PredictJsonHandler {
+ public:
+  PredictJsonHandler(
+      const std::function<Status(const string&,
+                                 ::google::protobuf::Map<string, TensorInfo>*)>&
+          get_tensorinfo_map,
+      int64_t json_size)
+      : get_tensorinfo_map_(get_tensorinfo_map), json_size_(json_size) {}
+
+  bool Null() {
+    return Value([](JsonTensorDecoder* d) { return false; });
+  }
+  bool Bool(bool b) {
+    return Value([b](JsonTensorDecoder* d) { return d->Bool(b); });
+  }
+  bool Int(int i) {
+    return Value([i](JsonTensorDecoder* d) { return d->Signed(i); });
+  }
+  bool Uint(unsigned u) {
+    return Value([u](JsonTensorDecoder* d) { return d->Unsigned(u); });
+  }
+  bool Int64(int64_t i) {
+    return Value([i](JsonTensorDecoder* d) { return d->Signed(i); });
+  }
+  bool Uint64(uint64_t u) {
+    return Value([u](JsonTensorDecoder* d) { return d->Unsigned(u); });
+  }
+  bool Double(double v) {
+    return Value([v](JsonTensorDecoder* d) { return d->Double(v); });
+  }
+  bool RawNumber(const char* str, rapidjson::SizeType length, bool copy) {
+    return false;
+  }
+
+  bool String(const char* str, rapidjson::SizeType length, bool copy) {
+    if (active_ == nullptr && state_ == State::kSignatureName) {
+      signature_name_.assign(str, length);
+      state_ = State::kTopLevelKey;
+      return true;
+    }
+    return Value([str, length](JsonTensorDecoder* d) {
+      return d->String(str, length);
+    });
+  }
+
+  bool StartObject() {
+    if (active_ != nullptr) return Decode(active_->StartObject());
+    switch (state_) {
+      case State::kStart:
+        state_ = State::kTopLevelKey;
+        return true;
+      case State::kSkipValue:
+        skip_depth_++;
+        return true;
+      case State::kInstancesElement:
+        if (instances_ == InstancesFormat::kUnknown) {
+          state_ = State::kFirstInstanceKey;
+        } else {
+          state_ = State::kInstanceKey;
+          num_keys_ = 0;
+        }
+        return true;
+      case State::kInputs:
+        state_ = State::kFirstInputsKey;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool Key(const char* str, rapidjson::SizeType length, bool copy) {
+    if (active_ != nullptr) return Decode(active_->Key(str, length));
+    const absl::string_view key(str, length);
+    switch (state_) {
+      case State::kTopLevelKey:
+        return TopLevelKey(key);
+      case State::kSkipValue:
+        return true;
+      case State::kFirstInstanceKey:
+        if (IsBase64Key(key)) {
+          // Plain list of base64 encoded strings.
+          instances_ = InstancesFormat::kPlain;
+          return BeginPlainInstances() && Decode(active_->StartObject()) &&
+                 Decode(active_->Key(str, length));
+        }
+        instances_ = InstancesFormat::kObjects;
+        num_keys_ = 0;
+        state_ = State::kInstanceKey;
+        return InstanceKey(key);
+      case State::kInstanceKey:
+        return InstanceKey(key);
+      case State::kFirstInputsKey:
+        if (IsBase64Key(key)) {
+          return BeginValue(SoleDecoder(), State::kTopLevelKey) &&
+                 Decode(active_->StartObject()) &&
+                 Decode(active_->Key(str, length));
+        }
+        num_keys_ = 0;
+        state_ = State::kInputsKey;
+        return InputsKey(key);
+      case State::kInputsKey:
+        return InputsKey(key);
+      default:
+        return false;
+    }
+  }
+
+  bool EndObject(rapidjson::SizeType member_count) {
+    if (active_ != nullptr) return Decode(active_->EndObject());
+    switch (state_) {
+      case State::kTopLevelKey:
+        state_ = State::kDone;
+        return true;
+      case State::kSkipValue:
+        return EndSkippedContainer();
+      case State::kInstanceKey:
+        // Each object must have one key for each named tensor.
+        if (num_keys_ != decoders_.size()) return false;
+        num_instances_++;
+        state_ = State::kInstancesElement;
+        return true;
+      case State::kInputsKey:
+        if (num_keys_ != decoders_.size()) return false;
+        state_ = State::kTopLevelKey;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool StartArray() {
+    if (active_ != nullptr) return Decode(active_->StartArray());
+    switch (state_) {
+      case State::kSkipValue:
+        skip_depth_++;
+        return true;
+      case State::kInstances:
+        state_ = State::kInstancesElement;
+        return true;
+      case State::kInstancesElement:
+        if (instances_ != InstancesFormat::kUnknown) return false;
+        instances_ = InstancesFormat::kPlain;
+        return BeginPlainInstances() && Decode(active_->StartArray());
+      case State::kInputs:
+        return BeginValue(SoleDecoder(), State::kTopLevelKey) &&
+               Decode(active_->StartArray());
+      default:
+        return false;
+    }
+  }
+
+  bool EndArray(rapidjson::SizeType element_count) {
+    if (active_ != nullptr) return Decode(active_->EndArray());
+    switch (state_) {
+      case State::kSkipValue:
+        return EndSkippedContainer();
+      case State::kInstancesElement:
+        // Plain lists end inside the decoder, so this ends a list of objects.
+        if (instances_ != InstancesFormat::kObjects) return false;
+        state_ = State::kTopLevelKey;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Builds the decoded tensors once the whole JSON object has been parsed.
+  bool Finish(string* signature_name,
+              std::vector<std::pair<string, Tensor>>* inputs,
+              JsonPredictRequestFormat* format) {
+    if (state_ != State::kDone || decoders_.empty()) return false;
+    const int64_t batch_size =
+        instances_ == InstancesFormat::kObjects ? num_instances_ : -1;
+    for (const auto& kv : decoders_) {
+      Tensor tensor;
+      if (!kv.second->Finish(batch_size, &tensor)) return false;
+      inputs->emplace_back(kv.first, std::move(tensor));
+    }
+    *signature_name = signature_name_;
+    *format = format_;
+    return true;
+  }
+
+ private:
+  enum class State {
+    kStart,              // Expecting the top-level object.
+    kTopLevelKey,        // Expecting a key (or end) of the top-level object.
+    kSignatureName,      // Expecting the value of "signature_name".
+    kSkipValue,          // Skipping the value of an ignored key.
+    kInstances,          // Expecting the value of "instances".
+    kInstancesElement,   // Expecting an element (or end) of "instances".
+    kFirstInstanceKey,   // Expecting the first key of the first element.
+    kInstanceKey,        // Expecting a key (or end) of an element object.
+    kInputs,             // Expecting the value of "inputs".
+    kFirstInputsKey,     // Expecting the first key of the "inputs" object.
+    kInputsKey,          // Expecting a key (or end) of the "inputs" object.
+    kDone,
+  };
+
+  // Whether "instances" is a list of objects (one key per named tensor) or a
+  // plain list of values/lists for a single tensor.
+  enum class InstancesFormat { kUnknown, kPlain, kObjects };
+
+  // Dispatches a scalar value event.
+  template <typename DecodeFn>
+  bool Value(DecodeFn decode) {
+    if (active_ != nullptr) return Decode(decode(active_));
+    switch (state_) {
+      case State::kSkipValue:
+        if (skip_depth_ == 0) state_ = resume_state_;
+        return true;
+      case State::kInstancesElement:
+        if (instances_ != InstancesFormat::kUnknown) return false;
+        instances_ = InstancesFormat::kPlain;
+        return BeginPlainInstances() && Decode(decode(active_));
+      case State::kInputs:
+        return BeginValue(SoleDecoder(), State::kTopLevelKey) &&
+               Decode(decode(active_));
+      default:
+        return false;
+    }
+  }
+
+  // Handles the result of an event forwarded to the active decoder.
+  bool Decode(bool ok) {
+    if (!ok) return false;
+    if (active_->done()) {
+      active_ = nullptr;
+      state_ = resume_state_;
+    }
+    return true;
+  }
+
+  bool TopLevelKey(absl::string_view key) {
+    if (key == kPredictRequestSignatureKey) {
+      // The signature determines the dtypes, so it must come first.
+      if (seen_signature_ || !decoders_.empty()) return false;
+      seen_signature_ = true;
+      state_ = State::kSignatureName;
+      return true;
+    }
+    if (key == kPredictRequestInstancesKey) {
+      format_ = JsonPredictRequestFormat::kRow;
+      state_ = State::kInstances;
+      return CreateDecoders();
+    }
+    if (key == kPredictRequestInputsKey) {
+      format_ = JsonPredictRequestFormat::kColumnar;
+      state_ = State::kInputs;
+      return CreateDecoders();
+    }
+    // Any other keys in the top-level JSON object are ignored.
+    BeginSkip(State::kTopLevelKey);
+    return true;
+  }
+
+  bool InstanceKey(absl::string_view key) {
+    auto it = decoders_.find(key);
+    // Each key must appear exactly once per element.
+    if (it == decoders_.end() || it->second->num_items() != num_instances_) {
+      return false;
+    }
+    num_keys_++;
+    return BeginValue(it->second.get(), State::kInstanceKey);
+  }
+
+  bool InputsKey(absl::string_view key) {
+    auto it = decoders_.find(key);
+    if (it == decoders_.end()) {
+      // Keys that are not named inputs are ignored.
+      BeginSkip(State::kInputsKey);
+      return true;
+    }
+    if (it->second->num_items() != 0) return false;
+    num_keys_++;
+    return BeginValue(it->second.get(), State::kInputsKey);
+  }
+
+  bool CreateDecoders() {
+    // Only one of "instances" or "inputs" may appear, and only once.
+    if (!decoders_.empty()) return false;
+    ::google::protobuf::Map<string, TensorInfo> tensorinfo_map;
+    if (!get_tensorinfo_map_(signature_name_, &tensorinfo_map).ok() ||
+        tensorinfo_map.empty()) {
+      return false;
+    }
+    const int64_t capacity =
+        json_size_ / kEstimatedJsonBytesPerValue / tensorinfo_map.size();
+    for (const auto& kv : tensorinfo_map) {
+      const DataType dtype = kv.second.dtype();
+      if (!IsStreamingDecodeSupported(dtype)) return false;
+      decoders_.emplace(kv.first,
+                        absl::make_unique<JsonTensorDecoder>(
+                            dtype, dtype == DT_STRING ? 0 : capacity));
+    }
+    return true;
+  }
+
+  // Returns the decoder of the only named tensor, or nullptr if there are
+  // several named tensors.
+  JsonTensorDecoder* SoleDecoder() {
+    return decoders_.size() == 1 ? decoders_.begin()->second.get() : nullptr;
+  }
+
+  // A key named "b64" starts a base64 encoded string, unless it names the
+  // (only) tensor, which is ambiguous and left to the DOM based decoder.
+  bool IsBase64Key(absl::string_view key) {
+    return key == kBase64Key && decoders_.size() == 1 &&
+           decoders_.begin()->first != kBase64Key;
+  }
+
+  // The whole "instances" list is decoded as the value of the sole tensor,
+  // which yields the same values and shape as stacking its elements.
+  bool BeginPlainInstances() {
+    return BeginValue(SoleDecoder(), State::kTopLevelKey) &&
+           active_->StartArray();
+  }
+
+  bool BeginValue(JsonTensorDecoder* decoder, State resume_state) {
+    if (decoder == nullptr) return false;
+    decoder->BeginItem();
+    active_ = decoder;
+    resume_state_ = resume_state;
+    return true;
+  }
+
+  void BeginSkip(State resume_state) {
+    state_ = State::kSkipValue;
+    skip_depth_ = 0;
+    resume_state_ = resume_state;
+  }
+
+  bool EndSkippedContainer() {
+    if (--skip_depth_ == 0) state_ = resume_state_;
+    return true;
+  }
+
+  const std::function<Status(const string&,
+                             ::google::protobuf::Map<string, TensorInfo>*)>&
+      get_tensorinfo_map_;
+  const int64_t json_size_;
+
+  State state_ = State::kStart;
+  State resume_state_ = State::kStart;
+  int skip_depth_ = 0;
+  string signature_name_;
+  bool seen_signature_ = false;
+  JsonPredictRequestFormat format_ = JsonPredictRequestFormat::kInvalid;
+  InstancesFormat instances_ = InstancesFormat::kUnknown;
+  int64_t num_instances_ = 0;
+  // Number of keys seen in the current "instances" element or "inputs" object.
+  size_t num_keys_ = 0;
+  absl::flat_hash_map<string, std::unique_ptr<JsonTensorDecoder>> decoders_;
+  // Decoder receiving the events of the value currently being decoded.
+  JsonTensorDecoder* active_ = nullptr;
+};
+
+// rapidjson input stream over a JSON document supplied in chunks, which pulls
+// the next chunk once the current one has been consumed.
+class JsonChunkStream {
+ public:
+  typedef char Ch;
+
+  explicit JsonChunkStream(const JsonChunkReader& read_chunk)
+      : read_chunk_(read_chunk) {
+    NextChunk();
+  }
+
+  Ch Peek() const { return current_ != end_ ? *current_ : '\0'; }
+
+  Ch Take() {
+    if (current_ == end_) return '\0';
+    const Ch c = *current_++;
+    if (current_ == end_) NextChunk();
+    return c;
+  }
+
+  size_t Tell() const { return consumed_ + (current_ - begin_); }
+
+  bool empty() const { return current_ == end_; }
+
+  // Only needed for in situ parsing, which the stream does not support.
+  Ch* PutBegin() {
+    assert(false);
+    return nullptr;
+  }
+  void Put(Ch) { assert(false); }
+  void Flush() { assert(false); }
+  size_t PutEnd(Ch*) {
+    assert(false);
+    return 0;
+  }
+
+ private:
+  // Moves on to the next non-empty chunk, if any.
+  void NextChunk() {
+    consumed_ += current_ - begin_;
+    absl::string_view chunk;
+    while (read_chunk_(&chunk)) {
+      if (!chunk.empty()) {
+        begin_ = current_ = chunk.data();
+        end_ = chunk.data() + chunk.size();
+        return;
+      }
+    }
+    begin_ = current_ = end_ = nullptr;
+  }
+
+  const JsonChunkReader& read_chunk_;
+  const Ch* begin_ = nullptr;
+  const Ch* current_ = nullptr;
+  const Ch* end_ = nullptr;
+  // Size of the previous chunks.
+  size_t consumed_ = 0;
+};
+
+// Decodes the JSON of `stream` with a PredictJsonHandler. Returns false if the
+// request has to be decoded by FillPredictRequestFromJson() instead.
+template <typename Stream>
+bool DecodePredictInputs(
+    Stream& stream, int64_t json_size,
+    const std::function<tensorflow::Status(
+        const string&, ::google::protobuf::Map<string, tensorflow::TensorInfo>*)>&
+        get_tensorinfo_map,
+    string* signature_name, std::vector<std::pair<string, Tensor>>* inputs,
+    JsonPredictRequestFormat* format) {
+  constexpr auto parse_flags = rapidjson::kParseIterativeFlag |
+                               rapidjson::kParseNanAndInfFlag |
+                               rapidjson::kParseStopWhenDoneFlag;
+  PredictJsonHandler handler(get_tensorinfo_map, json_size);
+  rapidjson::Reader reader;
+  if (!reader.Parse<parse_flags>(stream, handler).IsError() &&
+      handler.Finish(signature_name, inputs, format)) {
+    return true;
+  }
+  inputs->clear();
+  return false;
+}
+
+// Fills input Tensors via FillPredictRequestFromJson(), for its error messages
+// or for the requests the streaming decoder does not handle.
+Status FillPredictInputsFromJsonDom(
+    const absl::string_view json,
+    const std::function<tensorflow::Status(
+        const string&, ::google::protobuf::Map<string, tensorflow::TensorInfo>*)>&
+        get_tensorinfo_map,
+    string* signature_name, std::vector<std::pair<string, Tensor>>* inputs,
+    JsonPredictRequestFormat* format) {
+  PredictRequest request;
+  TF_RETURN_IF_ERROR(
+      FillPredictRequestFromJson(json, get_tensorinfo_map, &request, format));
+  *signature_name = request.model_spec().signature_name();
+  for (const auto& kv : request.inputs()) {
+    Tensor tensor;
+    if (!tensor.FromProto(kv.second)) {
+      return errors::InvalidArgument("tensor parsing error: ", kv.first);
+    }
+    inputs->emplace_back(kv.first, std::move(tensor));
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
+Status FillPredictInputsFromJson(
+    const absl::string_view json,
+    const std::function<tensorflow::Status(
+        const string&, ::google::protobuf::Map<string, tensorflow::TensorInfo>*)>&
+        get_tensorinfo_map,
+    string* signature_name, std::vector<std::pair<string, Tensor>>* inputs,
+    JsonPredictRequestFormat* format) {
+  *format = JsonPredictRequestFormat::kInvalid;
+  signature_name->clear();
+  inputs->clear();
+  if (!json.empty()) {
+    rapidjson::MemoryStream ms(json.data(), json.size());
+    rapidjson::EncodedInputStream<rapidjson::UTF8<>, rapidjson::MemoryStream>
+        jsonstream(ms);
+    if (DecodePredictInputs(jsonstream, json.size(), get_tensorinfo_map,
+                            signature_name, inputs, format)) {
+      return OkStatus();
+    }
+  }
+  return FillPredictInputsFromJsonDom(json, get_tensorinfo_map, signature_name,
+                                      inputs, format);
+}
+
+Status FillPredictInputsFromJsonChunks(
+    const JsonChunkReader& read_chunk, const int64_t json_size_hint,
+    const std::function<tensorflow::Status(string*)>& read_json,
+    const std::function<tensorflow::Status(
+        const string&, ::google::protobuf::Map<string, tensorflow::TensorInfo>*)>&
+        get_tensorinfo_map,
+    string* signature_name, std::vector<std::pair<string, Tensor>>* inputs,
+    JsonPredictRequestFormat* format) {
+  *format = JsonPredictRequestFormat::kInvalid;
+  signature_name->clear();
+  inputs->clear();
+  {
+    JsonChunkStream stream(read_chunk);
+    if (!stream.empty() &&
+        DecodePredictInputs(stream, json_size_hint, get_tensorinfo_map,
+                            signature_name, inputs, format)) {
+      return OkStatus();
+    }
+  }
+  string json;
+  TF_RETURN_IF_ERROR(read_json(&json));
+  return FillPredictInputsFromJsonDom(json, get_tensorinfo_map, signature_name,
+                                      inputs, format);
+}
+
+namespace {
+
 bool IsFeatureOfKind(const Feature& feature, Feature::KindCase kind) {
   return feature.kind_case() == Feature::KIND_NOT_SET ||
          feature.kind_case() == kind;
@@ -1065,6 +1926,356 @@ Status MakeJsonFromTensors(const ::google::protobuf::Map<string, TensorProto>& t
   }
 }
 
+namespace {
+
+// Longest output of FormatDecimal(), e.g. "-2.2250738585072014e-308".
+constexpr int kMaxDecimalChars = 32;
+
+// Formats finite `val` into `buf` and returns the number of chars written.
+//
+// The digits are the shortest that round-trip to `val`, laid out as printf
+// "%g" would at max(6, <number of digits>) precision, with '.0' appended to
+// whole numbers not in scientific notation. This is the same text that
+// WriteDecimal() produces when six digits suffice, without the noise digits
+// of its max_digits10 fallback otherwise (0.1234567f stays 0.1234567 rather
+// than 0.123456703).
+template <typename T>
+int FormatDecimal(T val, char* buf) {
+  char* out = buf;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  // Shortest round-trip digits in the form "[-]d[.ddd]e<sign>dd[d]".
+  char sci[kMaxDecimalChars];
+  const char* const sci_end =
+      std::to_chars(sci, sci + sizeof(sci), val, std::chars_format::scientific)
+          .ptr;
+  const char* sci_begin = sci;
+  if (*sci_begin == '-') *out++ = *sci_begin++;
+  char digits[kMaxDecimalChars];
+  int num_digits = 0;
+  const char* e = sci_begin;
+  for (; *e != 'e'; ++e) {
+    if (*e != '.') digits[num_digits++] = *e;
+  }
+  int exponent = 0;
+  for (const char* c = e + 2; c < sci_end; ++c) {
+    exponent = exponent * 10 + (*c - '0');
+  }
+  if (e[1] == '-') exponent = -exponent;
+
+  if (exponent < -4 || exponent >= std::max(num_digits, 6)) {
+    // to_chars() writes scientific notation the same way printf does.
+    std::memcpy(out, sci_begin, sci_end - sci_begin);
+    return out + (sci_end - sci_begin) - buf;
+  }
+  if (exponent < 0) {
+    *out++ = '0';
+    *out++ = '.';
+    for (int i = -1; i > exponent; --i) *out++ = '0';
+    std::memcpy(out, digits, num_digits);
+    out += num_digits;
+  } else if (num_digits > exponent + 1) {
+    std::memcpy(out, digits, exponent + 1);
+    out += exponent + 1;
+    *out++ = '.';
+    std::memcpy(out, digits + exponent + 1, num_digits - exponent - 1);
+    out += num_digits - exponent - 1;
+  } else {
+    std::memcpy(out, digits, num_digits);
+    out += num_digits;
+    for (int i = num_digits; i <= exponent; ++i) *out++ = '0';
+    *out++ = '.';
+    *out++ = '0';
+  }
+  return out - buf;
+#else
+  // No floating-point std::to_chars(); use the same printf based approach as
+  // WriteDecimal().
+  int len = std::snprintf(out, kMaxDecimalChars, "%g", val);
+  T num;
+  if (!StringToDecimal(absl::string_view(out, len), &num) || num != val) {
+    len = std::snprintf(out, kMaxDecimalChars, "%.*g",
+                        std::numeric_limits<T>::max_digits10, val);
+  }
+  if (std::memchr(out, '.', len) == nullptr &&
+      std::memchr(out, 'e', len) == nullptr) {
+    out[len++] = '.';
+    out[len++] = '0';
+  }
+  return len;
+#endif
+}
+
+// rapidjson output stream that hands the JSON to a JsonOutputWriter in chunks
+// of (about) `chunk_size` bytes, so the document is never held in memory in
+// its entirety.
+class ChunkedJsonOutputStream {
+ public:
+  typedef char Ch;
+
+  ChunkedJsonOutputStream(const JsonOutputWriter& output_writer,
+                          size_t chunk_size)
+      : output_writer_(output_writer),
+        chunk_size_(std::max<size_t>(chunk_size, 1)) {
+    buffer_.reserve(chunk_size_);
+  }
+
+  void Put(char c) {
+    buffer_.push_back(c);
+    if (buffer_.size() >= chunk_size_) Flush();
+  }
+
+  void Flush() {
+    if (buffer_.empty()) return;
+    output_writer_(buffer_);
+    buffer_.clear();
+  }
+
+ private:
+  const JsonOutputWriter& output_writer_;
+  const size_t chunk_size_;
+  string buffer_;
+};
+
+using ChunkedJsonWriter = rapidjson::PrettyWriter<ChunkedJsonOutputStream>;
+
+bool IsNamedTensorBytes(const string& name, const Tensor& tensor) {
+  return tensor.dtype() == DT_STRING &&
+         absl::EndsWith(name, kBytesTensorNameSuffix);
+}
+
+// Returns true for the dtypes AddSingleValueAndAdvance() can write.
+bool IsJsonWritableType(DataType dtype) {
+  switch (dtype) {
+    case DT_FLOAT:
+    case DT_DOUBLE:
+    case DT_INT32:
+    case DT_INT16:
+    case DT_INT8:
+    case DT_UINT8:
+    case DT_STRING:
+    case DT_INT64:
+    case DT_BOOL:
+    case DT_UINT32:
+    case DT_UINT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+template <typename T>
+void WriteDecimalValue(T val, ChunkedJsonWriter* writer) {
+  if (std::isfinite(val)) {
+    char buf[kMaxDecimalChars];
+    writer->RawValue(buf, FormatDecimal(val, buf), rapidjson::kNumberType);
+  } else if (std::isnan(val)) {
+    writer->RawValue("NaN", 3, rapidjson::kNumberType);
+  } else if (std::signbit(val)) {
+    writer->RawValue("-Infinity", 9, rapidjson::kNumberType);
+  } else {
+    writer->RawValue("Infinity", 8, rapidjson::kNumberType);
+  }
+}
+
+// Calls `fn` on `count` consecutive values of `tensor`, starting at flat index
+// `offset`.
+template <typename T, typename Fn>
+void ForEachTensorValue(const Tensor& tensor, int64_t offset, int64_t count,
+                        Fn fn) {
+  const T* values = tensor.unaligned_flat<T>().data() + offset;
+  for (int64_t i = 0; i < count; ++i) fn(values[i]);
+}
+
+// Writes `count` consecutive values of `tensor`, starting at flat index
+// `offset`. The dtype must be one accepted by IsJsonWritableType().
+void WriteTensorValues(const Tensor& tensor, bool string_as_bytes,
+                       int64_t offset, int64_t count,
+                       ChunkedJsonWriter* writer) {
+  const auto write_int = [writer](int val) { writer->Int(val); };
+  switch (tensor.dtype()) {
+    case DT_FLOAT:
+      ForEachTensorValue<float>(
+          tensor, offset, count,
+          [writer](float val) { WriteDecimalValue(val, writer); });
+      break;
+    case DT_DOUBLE:
+      ForEachTensorValue<double>(
+          tensor, offset, count,
+          [writer](double val) { WriteDecimalValue(val, writer); });
+      break;
+    case DT_INT32:
+      ForEachTensorValue<int32>(tensor, offset, count, write_int);
+      break;
+    case DT_INT16:
+      ForEachTensorValue<int16>(tensor, offset, count, write_int);
+      break;
+    case DT_INT8:
+      ForEachTensorValue<int8>(tensor, offset, count, write_int);
+      break;
+    case DT_UINT8:
+      ForEachTensorValue<uint8>(tensor, offset, count, write_int);
+      break;
+    case DT_STRING:
+      ForEachTensorValue<tstring>(
+          tensor, offset, count, [string_as_bytes, writer](const tstring& str) {
+            if (string_as_bytes) {
+              // Write bytes as { "b64": <base64-encoded-string> }
+              string base64;
+              absl::Base64Escape(absl::string_view(str), &base64);
+              writer->StartObject();
+              writer->Key(kBase64Key);
+              writer->String(base64.c_str(), base64.size());
+              writer->EndObject();
+            } else {
+              writer->String(str.c_str(), str.size());
+            }
+          });
+      break;
+    case DT_INT64:
+      ForEachTensorValue<int64_t>(tensor, offset, count, [writer](int64_t val) {
+        writer->Int64(val);
+      });
+      break;
+    case DT_BOOL:
+      ForEachTensorValue<bool>(tensor, offset, count,
+                               [writer](bool val) { writer->Bool(val); });
+      break;
+    case DT_UINT32:
+      ForEachTensorValue<uint32>(tensor, offset, count,
+                                 [writer](uint32 val) { writer->Uint(val); });
+      break;
+    case DT_UINT64:
+      ForEachTensorValue<uint64_t>(
+          tensor, offset, count,
+          [writer](uint64_t val) { writer->Uint64(val); });
+      break;
+    default:
+      break;
+  }
+}
+
+// Tensor counterpart of AddTensorValues(): writes the values of `tensor` from
+// dimension `dim` on, starting at flat index `*offset`, as (nested) lists and
+// advances `*offset` past them. Rows of the innermost dimension are written
+// in one go.
+void WriteTensorDims(const Tensor& tensor, bool string_as_bytes, int dim,
+                     ChunkedJsonWriter* writer, int64_t* offset) {
+  // Scalar values dont need to be enclosed in an array.
+  if (dim > tensor.dims() - 1) {
+    WriteTensorValues(tensor, string_as_bytes, *offset, 1, writer);
+    (*offset)++;
+    return;
+  }
+  writer->StartArray();
+  const int64_t size = tensor.dim_size(dim);
+  if (dim == tensor.dims() - 1) {
+    WriteTensorValues(tensor, string_as_bytes, *offset, size, writer);
+    *offset += size;
+  } else {
+    for (int64_t i = 0; i < size; i++) {
+      WriteTensorDims(tensor, string_as_bytes, dim + 1, writer, offset);
+    }
+  }
+  writer->EndArray();
+}
+
+void WriteRowFormatJsonFromTensors(
+    const std::vector<std::pair<string, Tensor>>& tensors, int64_t batch_size,
+    ChunkedJsonWriter* writer) {
+  std::vector<int64_t> offsets(tensors.size(), 0);
+  writer->StartObject();
+  writer->Key(kPredictResponsePredictionsKey);
+  writer->StartArray();
+  const bool elements_are_objects = tensors.size() > 1;
+  for (int64_t item = 0; item < batch_size; item++) {
+    if (elements_are_objects) writer->StartObject();
+    writer->SetFormatOptions(rapidjson::kFormatSingleLineArray);
+    for (int i = 0; i < tensors.size(); i++) {
+      const auto& name = tensors[i].first;
+      const auto& tensor = tensors[i].second;
+      if (elements_are_objects) writer->Key(name.c_str());
+      WriteTensorDims(
+          tensor, IsNamedTensorBytes(name, tensor),
+          1 /* dimension, we start from 1st as 0th is batch dimension */,
+          writer, &offsets[i]);
+    }
+    writer->SetFormatOptions(rapidjson::kFormatDefault);
+    if (elements_are_objects) writer->EndObject();
+  }
+  writer->EndArray();
+  writer->EndObject();
+}
+
+void WriteColumnarFormatJsonFromTensors(
+    const std::vector<std::pair<string, Tensor>>& tensors,
+    ChunkedJsonWriter* writer) {
+  writer->StartObject();
+  writer->Key(kPredictResponseOutputsKey);
+  const bool elements_are_objects = tensors.size() > 1;
+  if (elements_are_objects) writer->StartObject();
+  for (const auto& kv : tensors) {
+    const auto& name = kv.first;
+    const auto& tensor = kv.second;
+    if (elements_are_objects) writer->Key(name.c_str());
+    int64_t unused_offset = 0;
+    WriteTensorDims(tensor, IsNamedTensorBytes(name, tensor), 0, writer,
+                    &unused_offset);
+  }
+  if (elements_are_objects) writer->EndObject();
+  writer->EndObject();
+}
+
+}  // namespace
+
+Status WriteJsonFromTensors(
+    const std::vector<std::pair<string, Tensor>>& tensors,
+    JsonPredictRequestFormat format, const JsonOutputWriter& output_writer,
+    size_t chunk_size) {
+  if (tensors.empty()) {
+    return errors::InvalidArgument("Cannot convert empty tensor map to JSON");
+  }
+  if (format == JsonPredictRequestFormat::kInvalid) {
+    return errors::InvalidArgument("Invalid request format");
+  }
+
+  // Do all validation upfront, so that nothing is written on error.
+  int64_t batch_size = -1;
+  for (const auto& kv : tensors) {
+    const auto& name = kv.first;
+    const auto& tensor = kv.second;
+    if (!IsJsonWritableType(tensor.dtype())) {
+      return errors::InvalidArgument(
+          "Failed to write JSON value for tensor type: ",
+          DataTypeString(tensor.dtype()));
+    }
+    if (format != JsonPredictRequestFormat::kRow) continue;
+    // Each named tensor must be batched to the same size (see
+    // MakeRowFormatJsonFromTensors()).
+    if (tensor.dims() == 0) {
+      return errors::InvalidArgument("Tensor name: ", name,
+                                     " has no shape information ");
+    }
+    const int64_t cur_batch_size = tensor.dim_size(0);
+    if (batch_size >= 0 && batch_size != cur_batch_size) {
+      return errors::InvalidArgument(
+          "Tensor name: ", name,
+          " has inconsistent batch size: ", cur_batch_size,
+          " expecting: ", batch_size);
+    }
+    batch_size = cur_batch_size;
+  }
+
+  ChunkedJsonOutputStream stream(output_writer, chunk_size);
+  ChunkedJsonWriter writer(stream);
+  if (format == JsonPredictRequestFormat::kRow) {
+    WriteRowFormatJsonFromTensors(tensors, batch_size, &writer);
+  } else {
+    WriteColumnarFormatJsonFromTensors(tensors, &writer);
+  }
+  stream.Flush();
+  return OkStatus();
+}
+
 Status MakeJsonFromClassificationResult(const ClassificationResult& result,
                                         string* json) {
   if (result.classifications_size() == 0) {
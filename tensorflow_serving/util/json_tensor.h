@@ -18,8 +18,11 @@ limitations under the License.
 
 #include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/strings/string_view.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
@@ -149,6 +152,53 @@ tensorflow::Status FillPredictRequestFromJson(
         get_tensorinfo_map,
     PredictRequest* request, JsonPredictRequestFormat* format);
 
+// Fills named input Tensors from a JSON object.
+//
+// Accepts exactly the same JSON as FillPredictRequestFromJson() above, but
+// decodes it in a single pass with a streaming (SAX) parser that writes values
+// straight into the buffers of the output Tensors, skipping both the JSON DOM
+// and the intermediate TensorProtos. Intended for the REST predict path, where
+// request payloads can be tens of megabytes of numbers.
+//
+// On success `signature_name` holds the (optional) "signature_name" key, and
+// `inputs` holds one (alias, Tensor) pair for each entry in the tensorinfo
+// map, with the dtype given by the map.
+//
+// Requests that the streaming decoder does not handle (e.g. "signature_name"
+// appearing after the tensors) as well as all malformed requests are decoded
+// via FillPredictRequestFromJson(), so results and error messages are the same
+// as for that function.
+tensorflow::Status FillPredictInputsFromJson(
+    const absl::string_view json,
+    const std::function<tensorflow::Status(
+        const string&, ::google::protobuf::Map<string, tensorflow::TensorInfo>*)>&
+        get_tensorinfo_map,
+    string* signature_name,
+    std::vector<std::pair<string, tensorflow::Tensor>>* inputs,
+    JsonPredictRequestFormat* format);
+
+// Supplies a JSON document in chunks: sets `chunk` to the next one, which only
+// needs to stay valid until the next call, and returns false after the last.
+using JsonChunkReader = std::function<bool(absl::string_view* chunk)>;
+
+// Like FillPredictInputsFromJson() above, but decodes the JSON as `read_chunk`
+// supplies it, e.g. while a request body is being uncompressed, so that the
+// whole JSON is never held in memory at once. `json_size_hint` is the expected
+// size of the JSON (or 0 if unknown), used to presize Tensors.
+//
+// Requests that the streaming decoder does not handle (including malformed
+// ones) are decoded via FillPredictRequestFromJson(), for which `read_json`
+// has to supply the whole JSON (from its start) in one string.
+tensorflow::Status FillPredictInputsFromJsonChunks(
+    const JsonChunkReader& read_chunk, int64_t json_size_hint,
+    const std::function<tensorflow::Status(string* json)>& read_json,
+    const std::function<tensorflow::Status(
+        const string&, ::google::protobuf::Map<string, tensorflow::TensorInfo>*)>&
+        get_tensorinfo_map,
+    string* signature_name,
+    std::vector<std::pair<string, tensorflow::Tensor>>* inputs,
+    JsonPredictRequestFormat* format);
+
 // Fills ClassificationRequest proto from a JSON object.
 //
 // `json` string is parsed to create `Example` protos and added to
@@ -260,6 +310,23 @@ tensorflow::Status MakeJsonFromTensors(
     const ::google::protobuf::Map<string, tensorflow::TensorProto>& tensor_map,
     JsonPredictRequestFormat format, string* json);
 
+// Receives the output of WriteJsonFromTensors(), one chunk at a time.
+using JsonOutputWriter = std::function<void(absl::string_view chunk)>;
+
+// Same as MakeJsonFromTensors() above, but formats Tensors (in the order of
+// `tensors`, as name/alias and Tensor pairs) directly, without converting them
+// to TensorProtos first, and hands the output JSON to `output_writer` in
+// chunks of about `chunk_size` bytes as it is generated rather than building
+// it up in one string. Floating-point values are written with the shortest
+// digits that round-trip.
+//
+// All errors are detected before any output is produced, so on error nothing
+// has been passed to `output_writer`.
+tensorflow::Status WriteJsonFromTensors(
+    const std::vector<std::pair<string, tensorflow::Tensor>>& tensors,
+    JsonPredictRequestFormat format, const JsonOutputWriter& output_writer,
+    size_t chunk_size = 64 * 1024);
+
 // Make JSON object from ClassificationResult proto.
 //
 // The output JSON object is formatted as follows:
@@ -0,0 +1,188 @@
+/* Copyright 2018 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks for decoding JSON predict requests into input Tensors, comparing
+// the streaming decoder (FillPredictInputsFromJson) against the DOM based one
+// (FillPredictRequestFromJson followed by Tensor::FromProto, as done by the
+// predict path), and for encoding output Tensors as JSON, comparing the chunked
+// writer (WriteJsonFromTensors) against MakeJsonFromTensors (after
+// Tensor::AsProtoField).
+//
+// Run with:
+// bazel run -c opt tensorflow_serving/util:json_tensor_benchmark --
+// --benchmarks=.
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+#include "tensorflow_serving/apis/predict.pb.h"
+#include "tensorflow_serving/util/json_tensor.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using TensorInfoMap = ::google::protobuf::Map<string, TensorInfo>;
+
+// Width of each instance, i.e. the size of the innermost dimension.
+constexpr int kInstanceWidth = 256;
+
+std::function<Status(const string&, TensorInfoMap*)> GetTensorInfoMap(
+    const TensorInfoMap& map) {
+  return [&map](const string&, TensorInfoMap* m) {
+    *m = map;
+    return OkStatus();
+  };
+}
+
+// Returns a JSON predict request with a single [num_instances, kInstanceWidth]
+// float tensor, in row or columnar format.
+string MakeFloatRequest(int num_instances, bool columnar) {
+  string json = columnar ? R"({"inputs": [)" : R"({"instances": [)";
+  for (int i = 0; i < num_instances; ++i) {
+    if (i > 0) json.append(",");
+    json.append("[");
+    for (int j = 0; j < kInstanceWidth; ++j) {
+      if (j > 0) json.append(",");
+      absl::StrAppend(&json, (i * kInstanceWidth + j) * 0.001f);
+    }
+    json.append("]");
+  }
+  json.append("]}");
+  return json;
+}
+
+TensorInfoMap MakeFloatTensorInfoMap() {
+  TensorInfoMap infomap;
+  infomap["x"].set_dtype(DT_FLOAT);
+  return infomap;
+}
+
+void BM_FillPredictRequestFromJson(::testing::benchmark::State& state) {
+  const string json = MakeFloatRequest(state.range(0), state.range(1));
+  const TensorInfoMap infomap = MakeFloatTensorInfoMap();
+  for (auto s : state) {
+    PredictRequest request;
+    JsonPredictRequestFormat format;
+    TF_CHECK_OK(FillPredictRequestFromJson(json, GetTensorInfoMap(infomap),
+                                           &request, &format));
+    for (const auto& kv : request.inputs()) {
+      Tensor tensor;
+      CHECK(tensor.FromProto(kv.second));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+void BM_FillPredictInputsFromJson(::testing::benchmark::State& state) {
+  const string json = MakeFloatRequest(state.range(0), state.range(1));
+  const TensorInfoMap infomap = MakeFloatTensorInfoMap();
+  for (auto s : state) {
+    string signature_name;
+    std::vector<std::pair<string, Tensor>> inputs;
+    JsonPredictRequestFormat format;
+    TF_CHECK_OK(FillPredictInputsFromJson(json, GetTensorInfoMap(infomap),
+                                          &signature_name, &inputs, &format));
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+// Arguments are {number of instances, columnar format}. 8192 instances make
+// for a ~20MB request.
+BENCHMARK(BM_FillPredictRequestFromJson)
+    ->ArgPair(1, 0)
+    ->ArgPair(64, 0)
+    ->ArgPair(8192, 0)
+    ->ArgPair(8192, 1);
+
+BENCHMARK(BM_FillPredictInputsFromJson)
+    ->ArgPair(1, 0)
+    ->ArgPair(64, 0)
+    ->ArgPair(8192, 0)
+    ->ArgPair(8192, 1);
+
+// Returns a [num_instances, kInstanceWidth] float tensor of values that need
+// a varying number of digits.
+Tensor MakeFloatOutput(int num_instances) {
+  Tensor tensor(DT_FLOAT, TensorShape({num_instances, kInstanceWidth}));
+  auto values = tensor.flat<float>();
+  for (int i = 0; i < values.size(); ++i) {
+    values(i) = i * 0.001f + 1.0f / (i % 7 + 1);
+  }
+  return tensor;
+}
+
+void BM_MakeJsonFromTensors(::testing::benchmark::State& state) {
+  const Tensor tensor = MakeFloatOutput(state.range(0));
+  const auto format = state.range(1) ? JsonPredictRequestFormat::kColumnar
+                                     : JsonPredictRequestFormat::kRow;
+  size_t json_size = 0;
+  for (auto s : state) {
+    ::google::protobuf::Map<string, TensorProto> outputs;
+    tensor.AsProtoField(&outputs["y"]);
+    string json;
+    TF_CHECK_OK(MakeJsonFromTensors(outputs, format, &json));
+    json_size = json.size();
+  }
+  state.SetBytesProcessed(state.iterations() * json_size);
+}
+
+void BM_WriteJsonFromTensors(::testing::benchmark::State& state) {
+  const std::vector<std::pair<string, Tensor>> outputs = {
+      {"y", MakeFloatOutput(state.range(0))}};
+  const auto format = state.range(1) ? JsonPredictRequestFormat::kColumnar
+                                     : JsonPredictRequestFormat::kRow;
+  size_t json_size = 0;
+  for (auto s : state) {
+    json_size = 0;
+    TF_CHECK_OK(WriteJsonFromTensors(
+        outputs, format,
+        [&json_size](absl::string_view chunk) { json_size += chunk.size(); }));
+  }
+  state.SetBytesProcessed(state.iterations() * json_size);
+}
+
+// Arguments are {number of instances, columnar format}. 4096 instances make
+// for 1M output values.
+BENCHMARK(BM_MakeJsonFromTensors)
+    ->ArgPair(1, 0)
+    ->ArgPair(64, 0)
+    ->ArgPair(4096, 0)
+    ->ArgPair(4096, 1);
+
+BENCHMARK(BM_WriteJsonFromTensors)
+    ->ArgPair(1, 0)
+    ->ArgPair(64, 0)
+    ->ArgPair(4096, 0)
+    ->ArgPair(4096, 1);
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  tensorflow::testing::RunBenchmarks();
+  return 0;
+}
@@ -16,7 +16,10 @@ limitations under the License.
 #include "tensorflow_serving/util/json_tensor.h"
 
 #include <functional>
+#include <limits>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "google/protobuf/message.h"
 #include "google/protobuf/text_format.h"
@@ -25,7 +28,10 @@ limitations under the License.
 #include "rapidjson/error/en.h"
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -793,6 +799,162 @@ TEST(JsontensorTest, MultipleNamedTensorErrors) {
               HasSubstr("Expecting value/list but got object"));
 }
 
+// Decodes `json` with FillPredictInputsFromJsonChunks(), supplying it in
+// chunks of `chunk_size` bytes.
+absl::Status FillPredictInputsFromJsonInChunks(
+    const string& json, const size_t chunk_size, const TensorInfoMap& infomap,
+    string* signature_name, std::vector<std::pair<string, Tensor>>* inputs,
+    JsonPredictRequestFormat* format) {
+  size_t offset = 0;
+  return FillPredictInputsFromJsonChunks(
+      [&](absl::string_view* chunk) {
+        if (offset == json.size()) return false;
+        *chunk = absl::string_view(json).substr(offset, chunk_size);
+        offset += chunk->size();
+        return true;
+      },
+      json.size(),
+      [&](string* whole_json) {
+        *whole_json = json;
+        return absl::OkStatus();
+      },
+      getmap(infomap), signature_name, inputs, format);
+}
+
+// Decodes `json` with FillPredictRequestFromJson(), as well as with
+// FillPredictInputsFromJson() and FillPredictInputsFromJsonChunks(), and
+// expects the same tensors (or error).
+void ExpectSameAsPredictRequestFromJson(const string& json,
+                                        const TensorInfoMap& infomap) {
+  PredictRequest req;
+  JsonPredictRequestFormat expected_format;
+  const absl::Status expected_status =
+      FillPredictRequestFromJson(json, getmap(infomap), &req, &expected_format);
+
+  for (const size_t chunk_size : {size_t{0}, size_t{1}, size_t{7}}) {
+    string signature_name;
+    std::vector<std::pair<string, Tensor>> inputs;
+    JsonPredictRequestFormat format;
+    const absl::Status status =
+        chunk_size == 0
+            ? FillPredictInputsFromJson(json, getmap(infomap), &signature_name,
+                                        &inputs, &format)
+            : FillPredictInputsFromJsonInChunks(json, chunk_size, infomap,
+                                                &signature_name, &inputs,
+                                                &format);
+    ASSERT_EQ(status, expected_status) << json;
+    if (!status.ok()) continue;
+    EXPECT_EQ(format, expected_format) << json;
+    EXPECT_EQ(signature_name, req.model_spec().signature_name()) << json;
+    ASSERT_EQ(inputs.size(), req.inputs().size()) << json;
+    for (const auto& kv : inputs) {
+      TensorProto proto;
+      kv.second.AsProtoField(&proto);
+      EXPECT_THAT(proto, EqualsProto(req.inputs().at(kv.first)))
+          << kv.first << " in " << json;
+    }
+  }
+}
+
+TEST(JsontensorTest, InputsFromJsonSingleTensor) {
+  for (const char* dtype :
+       {"DT_FLOAT", "DT_DOUBLE", "DT_INT32", "DT_INT16", "DT_INT8", "DT_UINT8",
+        "DT_INT64", "DT_UINT32", "DT_UINT64", "DT_BOOL", "DT_STRING"}) {
+    TensorInfoMap infomap;
+    ASSERT_TRUE(TextFormat::ParseFromString(absl::StrCat("dtype: ", dtype),
+                                            &infomap["default"]));
+    for (const char* json : {
+             R"({"instances": [[1,2],[3,4],[5,6]]})",
+             R"({"instances": [1, -2, 3]})",
+             R"({"instances": [[[1.5]], [[-2.25]]]})",
+             R"({"instances": [4294967295, 18446744073709551615]})",
+             R"({"instances": [-2147483649, 2147483648]})",
+             R"({"instances": [[], []]})",
+             R"({"instances": [true, false]})",
+             R"({"instances": ["foo", "bar"]})",
+             R"({"instances": [{"b64": "aGVsbG8="}, {"b64": "d29ybGQ="}]})",
+             R"({"instances": [["foo"], [{"b64": "d29ybGQ="}]]})",
+             R"({"instances": [{"default": [1, 2]}, {"default": [3, 4]}]})",
+             R"({"signature_name": "sig", "instances": [1], "other": [[{}]]})",
+             R"({"inputs": [[1, 2], [3, 4]]})",
+             R"({"inputs": 7})",
+             R"({"inputs": {"b64": "aGVsbG8="}})",
+             R"({"inputs": {"default": [1, 2], "ignored": {"a": null}}})",
+             R"({"instances": [1], "signature_name": "sig"})",
+         }) {
+      ExpectSameAsPredictRequestFromJson(json, infomap);
+    }
+  }
+}
+
+TEST(JsontensorTest, InputsFromJsonMultipleNamedTensors) {
+  TensorInfoMap infomap;
+  ASSERT_TRUE(
+      TextFormat::ParseFromString("dtype: DT_INT32", &infomap["int_tensor"]));
+  ASSERT_TRUE(
+      TextFormat::ParseFromString("dtype: DT_STRING", &infomap["str_tensor"]));
+  ASSERT_TRUE(
+      TextFormat::ParseFromString("dtype: DT_FLOAT", &infomap["float_tensor"]));
+
+  ExpectSameAsPredictRequestFromJson(R"(
+    {
+      "instances": [
+        {
+          "int_tensor": [[1,2],[3,4],[5,6]],
+          "str_tensor": ["foo", {"b64": "aGVsbG8="}],
+          "float_tensor": 1.5
+        },
+        {
+          "float_tensor": -2,
+          "int_tensor": [[7,8],[9,0],[1,2]],
+          "str_tensor": ["baz", "bat"]
+        }
+      ]
+    })",
+                                     infomap);
+  ExpectSameAsPredictRequestFromJson(R"(
+    {
+      "inputs": {
+        "int_tensor": [[1,2],[3,4],[5,6]],
+        "str_tensor": ["foo"],
+        "float_tensor": [],
+        "extra": [1, [2, {"x": 3}]]
+      }
+    })",
+                                     infomap);
+}
+
+TEST(JsontensorTest, InputsFromJsonErrors) {
+  TensorInfoMap infomap;
+  ASSERT_TRUE(
+      TextFormat::ParseFromString("dtype: DT_INT32", &infomap["int_tensor"]));
+  ASSERT_TRUE(
+      TextFormat::ParseFromString("dtype: DT_STRING", &infomap["str_tensor"]));
+
+  for (const char* json : {
+           "",
+           "[]",
+           R"({"instances": []})",
+           R"({"instances": [1, 2]})",
+           R"({"instances": [{"int_tensor": 1}]})",
+           R"({"instances": [{"int_tensor": 1, "str_tensor": "a"},
+                             {"int_tensor": [1], "str_tensor": "b"}]})",
+           R"({"instances": [{"int_tensor": [1, 2], "str_tensor": "a"},
+                             {"int_tensor": [1], "str_tensor": "b"}]})",
+           R"({"instances": [{"int_tensor": 1.5, "str_tensor": "a"}]})",
+           R"({"instances": [{"int_tensor": 1, "str_tensor": 1}]})",
+           R"({"instances": [{"int_tensor": 1, "str_tensor": {"b64": "!"}}]})",
+           R"({"instances": [{"int_tensor": [[1], 2], "str_tensor": "a"}]})",
+           R"({"instances": [{"int_tensor": null, "str_tensor": "a"}]})",
+           R"({"inputs": {"int_tensor": 1}})",
+           R"({"inputs": [1]})",
+           R"({"inputs": {"int_tensor": 1, "str_tensor": "a"}, "instances": []})",
+           R"({"signature_name": 1, "inputs": {}})",
+       }) {
+    ExpectSameAsPredictRequestFromJson(json, infomap);
+  }
+}
+
 template <const unsigned int parseflags = rapidjson::kParseNanAndInfFlag>
 absl::Status CompareJson(const string& json1, const string& json2) {
   rapidjson::Document doc1;
@@ -1224,6 +1386,132 @@ TEST(JsontensorTest, FromJsonMultipleZeroBatchTensorsErrors) {
   EXPECT_THAT(status.message(), HasSubstr("inconsistent batch size"));
 }
 
+// Runs WriteJsonFromTensors() with a small chunk size, checking the chunking,
+// and returns the concatenated output.
+absl::Status WriteJsonInChunks(
+    const std::vector<std::pair<string, Tensor>>& tensors,
+    JsonPredictRequestFormat format, string* json) {
+  constexpr size_t kChunkSize = 7;
+  std::vector<string> chunks;
+  TF_RETURN_IF_ERROR(WriteJsonFromTensors(
+      tensors, format,
+      [&chunks](absl::string_view chunk) { chunks.emplace_back(chunk); },
+      kChunkSize));
+  json->clear();
+  for (int i = 0; i < chunks.size(); i++) {
+    if (i + 1 < chunks.size()) {
+      EXPECT_EQ(chunks[i].size(), kChunkSize);
+    } else {
+      EXPECT_LE(chunks[i].size(), kChunkSize);
+    }
+    json->append(chunks[i]);
+  }
+  return absl::OkStatus();
+}
+
+TEST(JsontensorTest, WriteJsonFromTensorsMatchesMakeJsonFromTensors) {
+  const std::vector<std::pair<string, Tensor>> tensors = {
+      {"int_tensor",
+       test::AsTensor<int32>({1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 2},
+                             TensorShape({2, 3, 2}))},
+      {"str_tensor", test::AsTensor<tstring>({"foo", "bar", "baz", "bat"},
+                                             TensorShape({2, 2}))},
+      {"img_bytes",
+       test::AsTensor<tstring>({"hello", "world"}, TensorShape({2, 1}))},
+      {"float_tensor", test::AsTensor<float>({9000000, 0.00003})},
+      {"double_tensor", test::AsTensor<double>({0.5, 555557.5})},
+      {"int64_tensor", test::AsTensor<int64_t>({-1, 1LL << 40})},
+      {"uint8_tensor", test::AsTensor<uint8>({0, 255})},
+      {"bool_tensor", test::AsTensor<bool>({true, false})},
+  };
+  TensorMap tensormap;
+  for (const auto& kv : tensors) kv.second.AsProtoField(&tensormap[kv.first]);
+
+  for (const auto format :
+       {JsonPredictRequestFormat::kRow, JsonPredictRequestFormat::kColumnar}) {
+    string expected;
+    TF_ASSERT_OK(MakeJsonFromTensors(tensormap, format, &expected));
+    string json;
+    TF_ASSERT_OK(WriteJsonInChunks(tensors, format, &json));
+    TF_EXPECT_OK(CompareJsonAllValuesAsStrings(json, expected));
+  }
+
+  // Single named tensor, including the scalar case for columnar format.
+  for (const auto& tensor :
+       {test::AsTensor<float>({1.5, 2, 3}, TensorShape({3, 1})),
+        test::AsScalar<float>(3)}) {
+    tensormap.clear();
+    tensor.AsProtoField(&tensormap["float_tensor"]);
+    string expected;
+    TF_ASSERT_OK(MakeJsonFromTensors(
+        tensormap, JsonPredictRequestFormat::kColumnar, &expected));
+    string json;
+    TF_ASSERT_OK(WriteJsonInChunks({{"float_tensor", tensor}},
+                                   JsonPredictRequestFormat::kColumnar, &json));
+    TF_EXPECT_OK(CompareJsonAllValuesAsStrings(json, expected));
+  }
+}
+
+TEST(JsontensorTest, WriteJsonFromTensorsShortestDecimals) {
+  string json;
+  TF_ASSERT_OK(WriteJsonInChunks(
+      {{"float_tensor",
+        test::AsTensor<float>({0.1234567, 1435774380, 9000000, 999999, 0.0003,
+                               -0.0, std::numeric_limits<float>::quiet_NaN(),
+                               -std::numeric_limits<float>::infinity()})}},
+      JsonPredictRequestFormat::kColumnar, &json));
+  TF_EXPECT_OK(CompareJsonAllValuesAsStrings(json, R"({
+    "outputs": [0.1234567, 1.4357743e+09, 9e+06, 999999.0, 0.0003, -0.0,
+                NaN, -Infinity]
+    })"));
+
+  TF_ASSERT_OK(WriteJsonInChunks(
+      {{"double_tensor",
+        test::AsTensor<double>({0.1, 1e100, 123456789.0,
+                                std::numeric_limits<double>::infinity()})}},
+      JsonPredictRequestFormat::kRow, &json));
+  TF_EXPECT_OK(CompareJsonAllValuesAsStrings(json, R"({
+    "predictions": [0.1, 1e+100, 123456789.0, Infinity]
+    })"));
+}
+
+TEST(JsontensorTest, WriteJsonFromTensorsErrors) {
+  int num_chunks = 0;
+  const JsonOutputWriter output_writer = [&num_chunks](absl::string_view) {
+    num_chunks++;
+  };
+
+  absl::Status status = WriteJsonFromTensors(
+      {}, JsonPredictRequestFormat::kRow, output_writer);
+  EXPECT_TRUE(errors::IsInvalidArgument(status));
+  EXPECT_THAT(status.message(), HasSubstr("empty tensor map"));
+
+  status = WriteJsonFromTensors({{"t", test::AsScalar<float>(1)}},
+                                JsonPredictRequestFormat::kInvalid,
+                                output_writer);
+  EXPECT_TRUE(errors::IsInvalidArgument(status));
+  EXPECT_THAT(status.message(), HasSubstr("Invalid request format"));
+
+  status = WriteJsonFromTensors(
+      {{"t", test::AsTensor<float>({1})}, {"h", Tensor(DT_HALF, {1})}},
+      JsonPredictRequestFormat::kColumnar, output_writer);
+  EXPECT_TRUE(errors::IsInvalidArgument(status));
+  EXPECT_THAT(status.message(), HasSubstr("tensor type: half"));
+
+  status = WriteJsonFromTensors({{"t", test::AsScalar<float>(1)}},
+                                JsonPredictRequestFormat::kRow, output_writer);
+  EXPECT_TRUE(errors::IsInvalidArgument(status));
+  EXPECT_THAT(status.message(), HasSubstr("has no shape information"));
+
+  status = WriteJsonFromTensors(
+      {{"a", test::AsTensor<float>({1, 2})}, {"b", test::AsTensor<float>({1})}},
+      JsonPredictRequestFormat::kRow, output_writer);
+  EXPECT_TRUE(errors::IsInvalidArgument(status));
+  EXPECT_THAT(status.message(), HasSubstr("inconsistent batch size"));
+
+  EXPECT_EQ(num_chunks, 0);
+}
+
 template <typename RequestType>
 class ClassifyRegressRequestTest : public ::testing::Test {
  protected:
@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow_serving/util/net_http/server/internal/evhttp_request.h"
 
 #include <cassert>
+#include <cinttypes>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -27,7 +28,10 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/strings/ascii.h"
 #include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "libevent/include/event2/buffer.h"
@@ -43,6 +47,213 @@ namespace tensorflow {
 namespace serving {
 namespace net_http {
 
+namespace {
+
+// Size of the chunks gzip request bodies are uncompressed into.
+constexpr size_t kUncompressedChunkSize = 64 * 1024;
+
+// Returns true if the Accept-Encoding header value accepts gzip, i.e. lists
+// gzip (or "*" in the absence of gzip) without a zero q-value.
+bool AcceptsGzipEncoding(absl::string_view accept_encoding) {
+  bool gzip_listed = false;
+  bool gzip_accepted = false;
+  bool any_accepted = false;
+  for (absl::string_view coding : absl::StrSplit(accept_encoding, ',')) {
+    std::vector<absl::string_view> params = absl::StrSplit(coding, ';');
+    absl::string_view name = absl::StripAsciiWhitespace(params[0]);
+    bool accepted = true;
+    for (size_t i = 1; i < params.size(); i++) {
+      absl::string_view param = absl::StripAsciiWhitespace(params[i]);
+      double q;
+      if (absl::StartsWithIgnoreCase(param, "q=") &&
+          absl::SimpleAtod(param.substr(2), &q) && q <= 0) {
+        accepted = false;
+      }
+    }
+    if (absl::EqualsIgnoreCase(name, "gzip") ||
+        absl::EqualsIgnoreCase(name, "x-gzip")) {
+      gzip_listed = true;
+      gzip_accepted = accepted;
+    } else if (name == "*") {
+      any_accepted = accepted;
+    }
+  }
+  return gzip_listed ? gzip_accepted : any_accepted;
+}
+
+// Returns `input` gzip-compressed into a new evbuffer, or nullptr on error.
+// Compresses each chunk of `input` in place (without flattening it) straight
+// into space reserved in the output.
+evbuffer* CompressGzipBuffer(evbuffer* input, int level) {
+  const int num_chunks = evbuffer_peek(input, -1, nullptr, nullptr, 0);
+  std::vector<evbuffer_iovec> chunks(num_chunks);
+  evbuffer_peek(input, -1, nullptr, chunks.data(), num_chunks);
+
+  evbuffer* output = evbuffer_new();
+  if (output == nullptr) {
+    return nullptr;
+  }
+
+  ZLib zlib;
+  zlib.SetCompressionLevel(level);
+  for (const evbuffer_iovec& chunk : chunks) {
+    evbuffer_iovec reserved;
+    if (evbuffer_reserve_space(output, ZLib::MinCompressbufSize(chunk.iov_len),
+                               &reserved, 1) != 1) {
+      evbuffer_free(output);
+      return nullptr;
+    }
+    uLongf compressed_len = reserved.iov_len;
+    uLong source_len = chunk.iov_len;
+    int err = zlib.CompressAtMost(static_cast<Bytef*>(reserved.iov_base),
+                                  &compressed_len,
+                                  static_cast<const Bytef*>(chunk.iov_base),
+                                  &source_len);
+    if (err != Z_OK || source_len != 0) {
+      NET_LOG(ERROR, "Got zlib error: %d", err);
+      evbuffer_free(output);
+      return nullptr;
+    }
+    reserved.iov_len = compressed_len;
+    evbuffer_commit_space(output, &reserved, 1);
+  }
+
+  evbuffer_iovec reserved;
+  if (evbuffer_reserve_space(output, zlib.MinFooterSize(), &reserved, 1) !=
+      1) {
+    evbuffer_free(output);
+    return nullptr;
+  }
+  uLongf footer_len = reserved.iov_len;
+  int err = zlib.CompressChunkDone(static_cast<Bytef*>(reserved.iov_base),
+                                   &footer_len);
+  if (err != Z_OK) {
+    NET_LOG(ERROR, "Got zlib error: %d", err);
+    evbuffer_free(output);
+    return nullptr;
+  }
+  reserved.iov_len = footer_len;
+  evbuffer_commit_space(output, &reserved, 1);
+
+  return output;
+}
+
+// Reads the body in an evbuffer, without draining it. The chunks of the
+// buffer are passed as is, and gzip bodies are uncompressed into fixed-size
+// chunks.
+class EvRequestBodyStream final : public RequestBodyStream {
+ public:
+  // `input_buf` may be nullptr (no body).
+  EvRequestBodyStream(evbuffer* input_buf, bool gzip,
+                      int64_t max_uncompressed_size)
+      : gzip_(gzip), max_uncompressed_size_(max_uncompressed_size) {
+    if (input_buf != nullptr) {
+      const int num_chunks = evbuffer_peek(input_buf, -1, nullptr, nullptr, 0);
+      if (num_chunks > 0) {
+        chunks_.resize(num_chunks);
+        evbuffer_peek(input_buf, -1, nullptr, chunks_.data(), num_chunks);
+      }
+    }
+    if (gzip_) {
+      output_.reset(new char[kUncompressedChunkSize]);
+    }
+  }
+
+  bool Next(absl::string_view* chunk) override {
+    if (done_) {
+      return false;
+    }
+    if (!gzip_) {
+      if (next_chunk_ == chunks_.size()) {
+        done_ = true;
+        return false;
+      }
+      const evbuffer_iovec& iovec = chunks_[next_chunk_++];
+      *chunk = absl::string_view(static_cast<const char*>(iovec.iov_base),
+                                 iovec.iov_len);
+      return true;
+    }
+    return NextUncompressed(chunk);
+  }
+
+  bool ok() const override { return ok_; }
+
+ private:
+  // Uncompresses the body until it produces some output.
+  bool NextUncompressed(absl::string_view* chunk) {
+    while (true) {
+      // Move on to the next input chunk once the current one is consumed
+      // and the output it produced has been flushed.
+      if (source_len_ == 0 && !output_full_) {
+        if (next_chunk_ == chunks_.size()) {
+          done_ = true;
+          if (!chunks_.empty() && !zlib_.UncompressChunkDone()) {
+            NET_LOG(ERROR, "Gzipped body is truncated or corrupted");
+            ok_ = false;
+          }
+          return false;
+        }
+        const evbuffer_iovec& iovec = chunks_[next_chunk_++];
+        source_ = static_cast<const Bytef*>(iovec.iov_base);
+        source_len_ = iovec.iov_len;
+      }
+
+      uLongf output_len = kUncompressedChunkSize;
+      uLong remaining_len = source_len_;
+      int err = zlib_.UncompressAtMost(reinterpret_cast<Bytef*>(output_.get()),
+                                       &output_len, source_, &remaining_len);
+      if (err != Z_OK && err != Z_BUF_ERROR) {
+        NET_LOG(ERROR, "Got zlib error: %d", err);
+        return Fail();
+      }
+      if (output_len == 0 && remaining_len == source_len_ && source_len_ > 0) {
+        NET_LOG(ERROR, "Failed to make progress uncompressing the body");
+        return Fail();
+      }
+      uncompressed_size_ += output_len;
+      if (uncompressed_size_ > max_uncompressed_size_) {
+        NET_LOG(ERROR, "Uncompressed body exceeds the max size: %" PRId64,
+                max_uncompressed_size_);
+        return Fail();
+      }
+
+      source_ += source_len_ - remaining_len;
+      source_len_ = remaining_len;
+      output_full_ = output_len == kUncompressedChunkSize;
+      if (output_len > 0) {
+        *chunk = absl::string_view(output_.get(), output_len);
+        return true;
+      }
+    }
+  }
+
+  bool Fail() {
+    done_ = true;
+    ok_ = false;
+    return false;
+  }
+
+  const bool gzip_;
+  const int64_t max_uncompressed_size_;
+
+  // The chunks of the body, as held by the evbuffer.
+  std::vector<evbuffer_iovec> chunks_;
+  size_t next_chunk_ = 0;
+  bool done_ = false;
+  bool ok_ = true;
+
+  // State of gzip bodies: the rest of the current input chunk, and whether
+  // the last output filled the output buffer (so more may be pending).
+  ZLib zlib_;
+  std::unique_ptr<char[]> output_;
+  const Bytef* source_ = nullptr;
+  uLong source_len_ = 0;
+  bool output_full_ = false;
+  int64_t uncompressed_size_ = 0;
+};
+
+}  // namespace
+
 ParsedEvRequest::~ParsedEvRequest() {
   if (decoded_uri) {
     evhttp_uri_free(decoded_uri);
@@ -258,9 +469,44 @@ EvHTTPRequest::ReadRequestGzipBytes(evbuffer* input_buf, int64_t* size) {
   }
 }
 
+bool EvHTTPRequest::ReadRequestBody(const RequestBodyReader& reader) {
+  evbuffer* input_buf =
+      evhttp_request_get_input_buffer(parsed_request_->request);
+  if (input_buf == nullptr) {
+    return true;  // no body
+  }
+
+  std::unique_ptr<RequestBodyStream> stream = NewRequestBodyStream();
+  bool result = true;
+  absl::string_view chunk;
+  while (stream->Next(&chunk)) {
+    if (!reader(chunk)) {
+      result = false;
+      break;
+    }
+  }
+  result = result && stream->ok();
+  // Consume the body, so that subsequent reads hit EOF.
+  stream.reset();
+  evbuffer_drain(input_buf, evbuffer_get_length(input_buf));
+  return result;
+}
+
+std::unique_ptr<RequestBodyStream> EvHTTPRequest::NewRequestBodyStream() {
+  evbuffer* input_buf =
+      evhttp_request_get_input_buffer(parsed_request_->request);
+  return std::unique_ptr<RequestBodyStream>(new EvRequestBodyStream(
+      input_buf, NeedUncompressGzipContent(), MaxUncompressedBodySize()));
+}
+
+int64_t EvHTTPRequest::MaxUncompressedBodySize() const {
+  return handler_options_.auto_uncompress_max_size() > 0
+             ? handler_options_.auto_uncompress_max_size()
+             : ZLib::kMaxUncompressedBytes;
+}
+
 bool EvHTTPRequest::NeedUncompressGzipContent() {
-  if (handler_options_ != nullptr &&
-      handler_options_->auto_uncompress_input()) {
+  if (handler_options_.auto_uncompress_input()) {
     auto content_encoding = GetRequestHeader(HTTPHeaders::CONTENT_ENCODING);
     return absl::StrContains(content_encoding, "gzip");
   }
@@ -271,9 +517,7 @@ bool EvHTTPRequest::NeedUncompressGzipContent() {
 void EvHTTPRequest::UncompressGzipBody(void* input, size_t input_size,
                                        void** uncompressed_input,
                                        size_t* uncompressed_input_size) {
-  int64_t max = handler_options_->auto_uncompress_max_size() > 0
-                    ? handler_options_->auto_uncompress_max_size()
-                    : ZLib::kMaxUncompressedBytes;
+  int64_t max = MaxUncompressedBodySize();
 
   // our APIs don't need expose the actual content-length
   *uncompressed_input_size = static_cast<size_t>(max);
@@ -354,7 +598,49 @@ EvHTTPRequest::PartialReplyWithFlushCallback(std::function<void()> callback) {
   return CallbackStatus::NOT_SCHEDULED;
 }
 
+void EvHTTPRequest::MaybeCompressResponse() {
+  if (!handler_options_.auto_compress_output()) {
+    return;
+  }
+
+  evkeyvalq* ev_headers =
+      evhttp_request_get_output_headers(parsed_request_->request);
+  if (evhttp_find_header(ev_headers, HTTPHeaders::CONTENT_ENCODING) !=
+      nullptr) {
+    return;  // already encoded by the handler
+  }
+
+  // The encoding is negotiated, so caches must key the response on
+  // Accept-Encoding, whether or not this one gets compressed.
+  AppendResponseHeader(HTTPHeaders::VARY, HTTPHeaders::ACCEPT_ENCODING);
+  const size_t body_size = evbuffer_get_length(output_buf);
+  if (body_size == 0 ||
+      static_cast<int64_t>(body_size) <
+          handler_options_.auto_compress_min_size() ||
+      !AcceptsGzipEncoding(GetRequestHeader(HTTPHeaders::ACCEPT_ENCODING))) {
+    return;
+  }
+
+  evbuffer* compressed =
+      CompressGzipBuffer(output_buf, handler_options_.auto_compress_level());
+  if (compressed == nullptr) {
+    NET_LOG(ERROR, "Failed to compress the response, sending it as is");
+    return;
+  }
+  if (evbuffer_get_length(compressed) >= body_size) {
+    evbuffer_free(compressed);
+    return;  // incompressible
+  }
+
+  evbuffer_free(output_buf);
+  output_buf = compressed;
+  OverwriteResponseHeader(HTTPHeaders::CONTENT_ENCODING, "gzip");
+}
+
 void EvHTTPRequest::ReplyWithStatus(HTTPStatusCode status) {
+  // Compress from the calling thread rather than from the event loop.
+  MaybeCompressResponse();
+
   bool result =
       server_->EventLoopSchedule([this, status]() { EvSendReply(status); });
 
@@ -84,6 +84,15 @@ class EvHTTPRequest final : public ServerRequestInterface {
   std::unique_ptr<char[], ServerRequestInterface::BlockDeleter>
   ReadRequestBytes(int64_t* size) override;
 
+  // Passes the chunks of the libevent input buffer as is, and uncompresses
+  // gzip bodies into fixed-size chunks.
+  bool ReadRequestBody(const RequestBodyReader& reader) override;
+
+  // Like ReadRequestBody(), but the streams leave the input buffer in place,
+  // so any number of them may read the body until it is consumed by
+  // ReadRequestBytes() or ReadRequestBody().
+  std::unique_ptr<RequestBodyStream> NewRequestBodyStream() override;
+
   absl::string_view GetRequestHeader(absl::string_view header) const override;
 
   std::vector<absl::string_view> request_headers() const override;
@@ -107,9 +116,10 @@ class EvHTTPRequest final : public ServerRequestInterface {
   // Initializes the resource and returns false if any error.
   bool Initialize();
 
-  // Keeps a reference to the registered RequestHandlerOptions
+  // Keeps a copy of the registered RequestHandlerOptions, which may be
+  // overwritten while the request is in flight.
   void SetHandlerOptions(const RequestHandlerOptions& handler_options) {
-    this->handler_options_ = &handler_options;
+    this->handler_options_ = handler_options;
   }
 
  private:
@@ -126,9 +136,16 @@ class EvHTTPRequest final : public ServerRequestInterface {
   std::unique_ptr<char[], ServerRequestInterface::BlockDeleter>
   ReadRequestGzipBytes(evbuffer* input_buf, int64_t* size);
 
+  // Max size of uncompressed request bodies.
+  int64_t MaxUncompressedBodySize() const;
+
+  // Gzip-compresses the response body if enabled by the handler options and
+  // accepted by the client.
+  void MaybeCompressResponse();
+
   ServerSupport* server_;
 
-  const RequestHandlerOptions* handler_options_;
+  RequestHandlerOptions handler_options_;
 
   std::unique_ptr<ParsedEvRequest> parsed_request_;
 
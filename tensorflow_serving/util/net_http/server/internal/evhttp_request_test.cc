@@ -22,6 +22,9 @@ limitations under the License.
 
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow_serving/util/net_http/client/test_client/internal/evhttp_connection.h"
 #include "tensorflow_serving/util/net_http/compression/gzip_zlib.h"
 #include "tensorflow_serving/util/net_http/internal/fixed_thread_pool.h"
@@ -148,6 +151,42 @@ TEST_F(EvHTTPRequestTest, SimplePOST) {
   server->WaitForTermination();
 }
 
+// Test POST with the request body read in chunks
+TEST_F(EvHTTPRequestTest, ReadRequestBodyPOST) {
+  const std::string body(1024 * 1024, 'a');
+
+  auto handler = [](ServerRequestInterface* request) {
+    std::string body_str;
+    EXPECT_TRUE(request->ReadRequestBody([&](absl::string_view chunk) {
+      EXPECT_FALSE(chunk.empty());
+      body_str.append(chunk.data(), chunk.size());
+      return true;
+    }));
+    // The body has been consumed.
+    int64_t num_bytes;
+    EXPECT_EQ(nullptr, request->ReadRequestBytes(&num_bytes));
+    request->WriteResponseString(body_str);
+    request->Reply();
+  };
+  server->RegisterRequestHandler("/ok", std::move(handler),
+                                 RequestHandlerOptions());
+  server->StartAcceptingRequests();
+
+  auto connection =
+      TestEvHTTPConnection::Connect("localhost", server->listen_port());
+  ASSERT_TRUE(connection != nullptr);
+
+  TestClientRequest request = {"/ok", "POST", {}, body};
+  TestClientResponse response = {};
+
+  EXPECT_TRUE(connection->BlockingSendRequest(request, &response));
+  EXPECT_EQ(response.status, HTTPStatusCode::OK);
+  EXPECT_EQ(response.body, body);
+
+  server->Terminate();
+  server->WaitForTermination();
+}
+
 // Test request's uri_path() method.
 TEST_F(EvHTTPRequestTest, RequestUri) {
   static const char* const kUriPath[] = {
@@ -456,6 +495,276 @@ TEST_F(EvHTTPRequestTest, LargeGzipPost) {
   server->WaitForTermination();
 }
 
+// Test large gzip body read in chunks
+TEST_F(EvHTTPRequestTest, ReadRequestBodyLargeGzipPost) {
+  constexpr int64_t uncompress_len = 1024 * 1024;
+  std::string uncompressed = MakeRandomString(uncompress_len);
+  std::string compressed = CompressLargeString(
+      uncompressed.data(), uncompressed.size(), 2 * uncompress_len);
+
+  auto handler = [&](ServerRequestInterface* request) {
+    std::string body_str;
+    int num_chunks = 0;
+    EXPECT_TRUE(request->ReadRequestBody([&](absl::string_view chunk) {
+      body_str.append(chunk.data(), chunk.size());
+      num_chunks++;
+      return true;
+    }));
+    EXPECT_EQ(body_str, uncompressed);
+    // The body is never uncompressed at once.
+    EXPECT_GT(num_chunks, 1);
+
+    int64_t num_bytes;
+    EXPECT_EQ(nullptr, request->ReadRequestBytes(&num_bytes));
+    EXPECT_EQ(0, num_bytes);
+
+    request->Reply();
+  };
+  server->RegisterRequestHandler("/ok", std::move(handler),
+                                 RequestHandlerOptions());
+  server->StartAcceptingRequests();
+
+  auto connection =
+      TestEvHTTPConnection::Connect("localhost", server->listen_port());
+  ASSERT_TRUE(connection != nullptr);
+
+  TestClientRequest request = {"/ok", "POST", {}, compressed};
+  request.headers.emplace_back("Content-Encoding", "my_gzip");
+  TestClientResponse response = {};
+
+  EXPECT_TRUE(connection->BlockingSendRequest(request, &response));
+  EXPECT_EQ(response.status, HTTPStatusCode::OK);
+
+  server->Terminate();
+  server->WaitForTermination();
+}
+
+// Test large gzip body pulled in chunks, more than once
+TEST_F(EvHTTPRequestTest, RequestBodyStreamLargeGzipPost) {
+  constexpr int64_t uncompress_len = 1024 * 1024;
+  std::string uncompressed = MakeRandomString(uncompress_len);
+  std::string compressed = CompressLargeString(
+      uncompressed.data(), uncompressed.size(), 2 * uncompress_len);
+
+  auto handler = [&](ServerRequestInterface* request) {
+    // Each stream reads the whole body, from its start.
+    for (int i = 0; i < 2; ++i) {
+      std::unique_ptr<RequestBodyStream> stream =
+          request->NewRequestBodyStream();
+      std::string body_str;
+      int num_chunks = 0;
+      absl::string_view chunk;
+      while (stream->Next(&chunk)) {
+        body_str.append(chunk.data(), chunk.size());
+        num_chunks++;
+      }
+      EXPECT_TRUE(stream->ok());
+      EXPECT_EQ(body_str, uncompressed);
+      EXPECT_GT(num_chunks, 1);
+      EXPECT_FALSE(stream->Next(&chunk));
+    }
+
+    // Streams leave the body in place.
+    std::string body_str;
+    EXPECT_TRUE(request->ReadRequestBody([&](absl::string_view chunk) {
+      body_str.append(chunk.data(), chunk.size());
+      return true;
+    }));
+    EXPECT_EQ(body_str, uncompressed);
+
+    request->Reply();
+  };
+  server->RegisterRequestHandler("/ok", std::move(handler),
+                                 RequestHandlerOptions());
+  server->StartAcceptingRequests();
+
+  auto connection =
+      TestEvHTTPConnection::Connect("localhost", server->listen_port());
+  ASSERT_TRUE(connection != nullptr);
+
+  TestClientRequest request = {"/ok", "POST", {}, compressed};
+  request.headers.emplace_back("Content-Encoding", "my_gzip");
+  TestClientResponse response = {};
+
+  EXPECT_TRUE(connection->BlockingSendRequest(request, &response));
+  EXPECT_EQ(response.status, HTTPStatusCode::OK);
+
+  server->Terminate();
+  server->WaitForTermination();
+}
+
+// Test truncated gzip body pulled in chunks
+TEST_F(EvHTTPRequestTest, RequestBodyStreamTruncatedGzip) {
+  constexpr char kBody[] = "abcdefg12345";
+  constexpr int bodySize = sizeof(kBody) - 1;
+  std::string compressed = CompressString(kBody, static_cast<size_t>(bodySize));
+
+  auto handler = [](ServerRequestInterface* request) {
+    std::unique_ptr<RequestBodyStream> stream = request->NewRequestBodyStream();
+    absl::string_view chunk;
+    while (stream->Next(&chunk)) {
+    }
+    EXPECT_FALSE(stream->ok());
+    request->Reply();
+  };
+  server->RegisterRequestHandler("/ok", handler, RequestHandlerOptions());
+  server->StartAcceptingRequests();
+
+  auto connection =
+      TestEvHTTPConnection::Connect("localhost", server->listen_port());
+  ASSERT_TRUE(connection != nullptr);
+
+  TestClientRequest request = {
+      "/ok", "POST", {}, compressed.substr(0, compressed.size() - 1)};
+  request.headers.emplace_back("Content-Encoding", "my_gzip");
+  TestClientResponse response = {};
+
+  EXPECT_TRUE(connection->BlockingSendRequest(request, &response));
+  EXPECT_EQ(response.status, HTTPStatusCode::OK);
+
+  server->Terminate();
+  server->WaitForTermination();
+}
+
+// Test invalid, truncated and too large gzip bodies read in chunks
+TEST_F(EvHTTPRequestTest, ReadRequestBodyGzipErrors) {
+  constexpr char kBody[] = "abcdefg12345";
+  constexpr int bodySize = sizeof(kBody) - 1;
+  std::string compressed = CompressString(kBody, static_cast<size_t>(bodySize));
+
+  auto handler = [](ServerRequestInterface* request) {
+    EXPECT_FALSE(
+        request->ReadRequestBody([](absl::string_view) { return true; }));
+
+    int64_t num_bytes;
+    EXPECT_EQ(nullptr, request->ReadRequestBytes(&num_bytes));
+    EXPECT_EQ(0, num_bytes);
+
+    request->Reply();
+  };
+  server->RegisterRequestHandler("/ok", handler, RequestHandlerOptions());
+  RequestHandlerOptions options;
+  options.set_auto_uncompress_max_size(bodySize - 1);  // not enough buffer
+  server->RegisterRequestHandler("/limit", handler, options);
+  server->StartAcceptingRequests();
+
+  auto connection =
+      TestEvHTTPConnection::Connect("localhost", server->listen_port());
+  ASSERT_TRUE(connection != nullptr);
+
+  const std::pair<std::string, std::string> requests[] = {
+      {"/ok", "abcde"},
+      {"/ok", compressed.substr(0, compressed.size() - 1)},
+      {"/ok", compressed + "abcdefghijkl"},
+      {"/limit", compressed},
+  };
+  for (const auto& path_and_body : requests) {
+    TestClientRequest request = {path_and_body.first, "POST", {},
+                                 path_and_body.second};
+    request.headers.emplace_back("Content-Encoding", "my_gzip");
+    TestClientResponse response = {};
+
+    EXPECT_TRUE(connection->BlockingSendRequest(request, &response));
+    EXPECT_EQ(response.status, HTTPStatusCode::OK);
+  }
+
+  server->Terminate();
+  server->WaitForTermination();
+}
+
+// Returns the value of the response header, or "" if there is none
+std::string GetResponseHeader(const TestClientResponse& response,
+                              absl::string_view name) {
+  for (const auto& header : response.headers) {
+    if (absl::EqualsIgnoreCase(header.first, name)) {
+      return header.second;
+    }
+  }
+  return "";
+}
+
+std::string UncompressString(absl::string_view data, size_t uncompressed_size) {
+  ZLib zlib;
+  std::string buf(uncompressed_size, '\0');
+  uLongf size = buf.size();
+  int err = zlib.Uncompress(reinterpret_cast<Bytef*>(&buf[0]), &size,
+                            reinterpret_cast<const Bytef*>(data.data()),
+                            data.size());
+  EXPECT_EQ(Z_OK, err);
+  buf.resize(size);
+  return buf;
+}
+
+// Test gzip-compressed responses
+TEST_F(EvHTTPRequestTest, GzipResponse) {
+  std::string body;
+  for (int i = 0; i < 10000; i++) {
+    absl::StrAppend(&body, "label_", i, ",");
+  }
+
+  auto handler = [&](ServerRequestInterface* request) {
+    // Written in several chunks.
+    for (size_t pos = 0; pos < body.size(); pos += 1000) {
+      request->WriteResponseString(absl::string_view(body).substr(pos, 1000));
+    }
+    request->Reply();
+  };
+  auto small_handler = [](ServerRequestInterface* request) {
+    request->WriteResponseString("OK");
+    request->Reply();
+  };
+  RequestHandlerOptions options;
+  options.set_auto_compress_output(true).set_auto_compress_min_size(100);
+  server->RegisterRequestHandler("/ok", std::move(handler), options);
+  server->RegisterRequestHandler("/small", std::move(small_handler), options);
+  server->StartAcceptingRequests();
+
+  auto connection =
+      TestEvHTTPConnection::Connect("localhost", server->listen_port());
+  ASSERT_TRUE(connection != nullptr);
+
+  for (const char* accept_encoding : {"gzip", "deflate, GZIP;q=0.5", "*"}) {
+    TestClientRequest request = {"/ok", "GET", {}, ""};
+    request.headers.emplace_back("Accept-Encoding", accept_encoding);
+    TestClientResponse response = {};
+
+    EXPECT_TRUE(connection->BlockingSendRequest(request, &response));
+    EXPECT_EQ(response.status, HTTPStatusCode::OK);
+    EXPECT_EQ(GetResponseHeader(response, "Content-Encoding"), "gzip");
+    EXPECT_EQ(GetResponseHeader(response, "Vary"), "Accept-Encoding");
+    EXPECT_LT(response.body.size(), body.size() / 2);
+    EXPECT_EQ(UncompressString(response.body, body.size()), body);
+  }
+
+  for (const char* accept_encoding : {"", "deflate", "gzip;q=0, *"}) {
+    TestClientRequest request = {"/ok", "GET", {}, ""};
+    if (*accept_encoding != '\0') {
+      request.headers.emplace_back("Accept-Encoding", accept_encoding);
+    }
+    TestClientResponse response = {};
+
+    EXPECT_TRUE(connection->BlockingSendRequest(request, &response));
+    EXPECT_EQ(response.status, HTTPStatusCode::OK);
+    EXPECT_EQ(GetResponseHeader(response, "Content-Encoding"), "");
+    EXPECT_EQ(GetResponseHeader(response, "Vary"), "Accept-Encoding");
+    EXPECT_EQ(response.body, body);
+  }
+
+  // Below the min size
+  TestClientRequest request = {"/small", "GET", {}, ""};
+  request.headers.emplace_back("Accept-Encoding", "gzip");
+  TestClientResponse response = {};
+
+  EXPECT_TRUE(connection->BlockingSendRequest(request, &response));
+  EXPECT_EQ(response.status, HTTPStatusCode::OK);
+  EXPECT_EQ(GetResponseHeader(response, "Content-Encoding"), "");
+  EXPECT_EQ(GetResponseHeader(response, "Vary"), "Accept-Encoding");
+  EXPECT_EQ(response.body, "OK");
+
+  server->Terminate();
+  server->WaitForTermination();
+}
+
 }  // namespace
 }  // namespace net_http
 }  // namespace serving
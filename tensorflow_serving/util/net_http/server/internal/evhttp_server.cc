@@ -32,6 +32,7 @@ limitations under the License.
 #include "absl/memory/memory.h"
 #include "libevent/include/event2/event.h"
 #include "libevent/include/event2/http.h"
+#include "libevent/include/event2/listener.h"
 #include "libevent/include/event2/thread.h"
 #include "libevent/include/event2/util.h"
 #include "tensorflow_serving/util/net_http/internal/net_logging.h"
@@ -58,7 +59,9 @@ void GlobalInitialize() { absl::call_once(libevent_init_once, &InitLibEvent); }
 }  // namespace
 
 EvHTTPServer::EvHTTPServer(std::unique_ptr<ServerOptions> options)
-    : server_options_(std::move(options)), accepting_requests_() {}
+    : server_options_(std::move(options)),
+      accepting_requests_(),
+      handlers_(std::make_shared<HandlerTable>()) {}
 
 // May crash the server if called before WaitForTermination() returns
 EvHTTPServer::~EvHTTPServer() {
@@ -66,7 +69,9 @@ EvHTTPServer::~EvHTTPServer() {
     NET_LOG(ERROR, "Server has not been terminated. Force termination now.");
     Terminate();
   }
+}
 
+EvHTTPServer::EventLoop::~EventLoop() {
   if (ev_http_ != nullptr) {
     // this frees the socket handlers too
     evhttp_free(ev_http_);
@@ -92,7 +97,18 @@ bool EvHTTPServer::Initialize() {
 
   GlobalInitialize();
 
-  // This ev_base_ created per-server v.s. global
+  for (int i = 0; i < server_options_->num_event_loops(); i++) {
+    event_loops_.push_back(absl::make_unique<EventLoop>(this));
+    if (!event_loops_.back()->Initialize()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool EvHTTPServer::EventLoop::Initialize() {
+  // This ev_base_ created per-loop v.s. global
   ev_base_ = event_base_new();
   if (ev_base_ == nullptr) {
     NET_LOG(FATAL, "Failed to create an event_base.");
@@ -120,13 +136,26 @@ bool EvHTTPServer::Initialize() {
   return true;
 }
 
+const std::shared_ptr<const EvHTTPServer::HandlerTable>&
+EvHTTPServer::EventLoop::handlers() {
+  // Only take request_mu_ when new handlers have been registered.
+  if (server_->handlers_version_.load(std::memory_order_acquire) !=
+      handlers_version_) {
+    absl::MutexLock l(&server_->request_mu_);
+    handlers_ = server_->handlers_;
+    handlers_version_ =
+        server_->handlers_version_.load(std::memory_order_relaxed);
+  }
+  return handlers_;
+}
+
 // static function pointer
-void EvHTTPServer::DispatchEvRequestFn(evhttp_request* req, void* server) {
-  EvHTTPServer* http_server = static_cast<EvHTTPServer*>(server);
-  http_server->DispatchEvRequest(req);
+void EvHTTPServer::DispatchEvRequestFn(evhttp_request* req, void* loop) {
+  EventLoop* event_loop = static_cast<EventLoop*>(loop);
+  event_loop->server()->DispatchEvRequest(event_loop, req);
 }
 
-void EvHTTPServer::DispatchEvRequest(evhttp_request* req) {
+void EvHTTPServer::DispatchEvRequest(EventLoop* loop, evhttp_request* req) {
   auto parsed_request = absl::make_unique<ParsedEvRequest>(req);
 
   if (!parsed_request->decode()) {
@@ -138,37 +167,35 @@ void EvHTTPServer::DispatchEvRequest(evhttp_request* req) {
 
   bool dispatched = false;
   std::unique_ptr<EvHTTPRequest> ev_request(
-      new EvHTTPRequest(std::move(parsed_request), this));
+      new EvHTTPRequest(std::move(parsed_request), loop));
 
   if (!ev_request->Initialize()) {
     evhttp_send_error(req, HTTP_SERVUNAVAIL, nullptr);
     return;
   }
 
-  {
-    absl::MutexLock l(&request_mu_);
+  const std::shared_ptr<const HandlerTable>& handlers = loop->handlers();
 
-    auto handler_map_it = uri_handlers_.find(path);
-    if (handler_map_it != uri_handlers_.end()) {
-      ev_request->SetHandlerOptions(handler_map_it->second.options);
-      IncOps();
-      dispatched = true;
-      ScheduleHandlerReference(handler_map_it->second.handler,
-                               ev_request.release());
-    }
+  auto handler_map_it = handlers->uri_handlers.find(path);
+  if (handler_map_it != handlers->uri_handlers.end()) {
+    ev_request->SetHandlerOptions(handler_map_it->second.options);
+    IncOps();
+    dispatched = true;
+    ScheduleHandlerReference(handlers, handler_map_it->second.handler,
+                             ev_request.release());
+  }
 
-    if (!dispatched) {
-      for (const auto& dispatcher : dispatchers_) {
-        auto handler = dispatcher.dispatcher(ev_request.get());
-        if (handler == nullptr) {
-          continue;
-        }
-        ev_request->SetHandlerOptions(dispatcher.options);
-        IncOps();
-        dispatched = true;
-        ScheduleHandler(std::move(handler), ev_request.release());
-        break;
+  if (!dispatched) {
+    for (const auto& dispatcher : handlers->dispatchers) {
+      auto handler = dispatcher.dispatcher(ev_request.get());
+      if (handler == nullptr) {
+        continue;
       }
+      ev_request->SetHandlerOptions(dispatcher.options);
+      IncOps();
+      dispatched = true;
+      ScheduleHandler(std::move(handler), ev_request.release());
+      break;
     }
   }
 
@@ -178,10 +205,15 @@ void EvHTTPServer::DispatchEvRequest(evhttp_request* req) {
   }
 }
 
-void EvHTTPServer::ScheduleHandlerReference(const RequestHandler& handler,
-                                            EvHTTPRequest* ev_request) {
+// The handler is referenced from `handlers`, which is kept alive until the
+// handler returns, even if it's overwritten in the meantime.
+void EvHTTPServer::ScheduleHandlerReference(
+    std::shared_ptr<const HandlerTable> handlers, const RequestHandler& handler,
+    EvHTTPRequest* ev_request) {
   server_options_->executor()->Schedule(
-      [&handler, ev_request]() { handler(ev_request); });
+      [handlers = std::move(handlers), &handler, ev_request]() {
+        handler(ev_request);
+      });
 }
 
 // Exactly one copy of the handler argument
@@ -213,32 +245,64 @@ void ResolveEphemeralPort(evhttp_bound_socket* listener, int* port) {
   }
 }
 
-}  // namespace
+// Like evhttp_bind_socket_with_handle(), but the listener socket is bound
+// with SO_REUSEPORT so that each event loop can have its own.
+evhttp_bound_socket* BindReusePortSocket(event_base* ev_base, evhttp* ev_http,
+                                         const char* address, int port) {
+  evutil_addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = EVUTIL_AI_PASSIVE | EVUTIL_AI_ADDRCONFIG;
+
+  const std::string port_str = std::to_string(port);
+  evutil_addrinfo* addr_info = nullptr;
+  if (evutil_getaddrinfo(address, port_str.c_str(), &hints, &addr_info) != 0 ||
+      addr_info == nullptr) {
+    return nullptr;
+  }
 
-bool EvHTTPServer::StartAcceptingRequests() {
-  if (ev_http_ == nullptr) {
-    NET_LOG(FATAL, "Server has not been successfully initialized");
-    return false;
+  evconnlistener* listener = evconnlistener_new_bind(
+      ev_base, nullptr, nullptr,
+      LEV_OPT_CLOSE_ON_FREE | LEV_OPT_CLOSE_ON_EXEC | LEV_OPT_REUSEABLE |
+          LEV_OPT_REUSEABLE_PORT,
+      -1, addr_info->ai_addr, static_cast<int>(addr_info->ai_addrlen));
+  evutil_freeaddrinfo(addr_info);
+  if (listener == nullptr) {
+    return nullptr;
   }
 
-  const int port = server_options_->ports().front();
+  evhttp_bound_socket* bound_socket = evhttp_bind_listener(ev_http, listener);
+  if (bound_socket == nullptr) {
+    evconnlistener_free(listener);
+  }
+  return bound_socket;
+}
+
+}  // namespace
 
-  if (server_options_->ip_addresses().empty()) {
+bool EvHTTPServer::EventLoop::Listen(const std::string& ip_address, int port,
+                                     bool reuse_port) {
+  auto bind_socket = [this, port, reuse_port](const char* address) {
+    if (reuse_port) {
+      return BindReusePortSocket(ev_base_, ev_http_, address, port);
+    }
+    return evhttp_bind_socket_with_handle(ev_http_, address,
+                                          static_cast<ev_uint16_t>(port));
+  };
+
+  if (ip_address.empty()) {
     // "::"  =>  in6addr_any
-    ev_uint16_t ev_port = static_cast<ev_uint16_t>(port);
-    ev_listener_ = evhttp_bind_socket_with_handle(ev_http_, "::", ev_port);
+    ev_listener_ = bind_socket("::");
     if (ev_listener_ == nullptr) {
       // in case ipv6 is not supported, fallback to inaddr_any
-      ev_listener_ = evhttp_bind_socket_with_handle(ev_http_, nullptr, ev_port);
+      ev_listener_ = bind_socket(nullptr);
       if (ev_listener_ == nullptr) {
         NET_LOG(ERROR, "Couldn't bind to port %d", port);
         return false;
       }
     }
   } else {
-    const std::string& ip_address = server_options_->ip_addresses().front();
-    ev_listener_ =
-        evhttp_bind_socket_with_handle(ev_http_, ip_address.c_str(), port);
+    ev_listener_ = bind_socket(ip_address.c_str());
     if (ev_listener_ == nullptr) {
       NET_LOG(ERROR, "Couldn't bind address %s to port %d", ip_address.c_str(),
               port);
@@ -246,24 +310,51 @@ bool EvHTTPServer::StartAcceptingRequests() {
     }
   }
 
-  // Listener counts as an active operation
-  IncOps();
+  return true;
+}
+
+bool EvHTTPServer::StartAcceptingRequests() {
+  if (event_loops_.empty()) {
+    NET_LOG(FATAL, "Server has not been successfully initialized");
+    return false;
+  }
+
+  const int port = server_options_->ports().front();
+  const std::string ip_address = server_options_->ip_addresses().empty()
+                                     ? ""
+                                     : server_options_->ip_addresses().front();
+  const bool reuse_port = event_loops_.size() > 1;
 
   port_ = port;
-  if (port_ == 0) {
-    ResolveEphemeralPort(ev_listener_, &port_);
+  for (auto& loop : event_loops_) {
+    // An ephemeral port is resolved by the first listener, and shared by the
+    // others.
+    if (!loop->Listen(ip_address, port_, reuse_port)) {
+      return false;
+    }
+
+    // Listener counts as an active operation
+    IncOps();
+
+    if (port_ == 0) {
+      ResolveEphemeralPort(loop->ev_listener(), &port_);
+    }
   }
 
   accepting_requests_.Notify();
 
-  IncOps();
-  server_options_->executor()->Schedule([this]() {
-    NET_LOG(INFO, "Entering the event loop ...");
-    int result = event_base_loop(ev_base_, EVLOOP_NO_EXIT_ON_EMPTY);
-    NET_LOG(INFO, "event_base_loop() exits with value %d", result);
-
-    DecOps();
-  });
+  for (auto& loop : event_loops_) {
+    IncOps();
+    EventLoop* event_loop = loop.get();
+    server_options_->executor()->Schedule([this, event_loop]() {
+      NET_LOG(INFO, "Entering the event loop ...");
+      int result =
+          event_base_loop(event_loop->ev_base(), EVLOOP_NO_EXIT_ON_EMPTY);
+      NET_LOG(INFO, "event_base_loop() exits with value %d", result);
+
+      DecOps();
+    });
+  }
 
   return true;
 }
@@ -288,12 +379,16 @@ void EvHTTPServer::Terminate() {
   terminating_.Notify();
 
   // call exit-loop from the event loop
-  this->EventLoopSchedule([this]() {
-    // Stop the listener first, which will delete ev_listener_
-    // This may cause the loop to exit, so need be scheduled from within
-    evhttp_del_accept_socket(ev_http_, ev_listener_);
-    DecOps();
-  });
+  for (auto& loop : event_loops_) {
+    EventLoop* event_loop = loop.get();
+    event_loop->EventLoopSchedule([this, event_loop]() {
+      // Stop the listener first, which will delete ev_listener_
+      // This may cause the loop to exit, so need be scheduled from within
+      evhttp_del_accept_socket(event_loop->ev_http(),
+                               event_loop->ev_listener());
+      DecOps();
+    });
+  }
 
   // Current shut-down behavior:
   // - we don't proactively delete/close any HTTP connections as part of
@@ -317,15 +412,20 @@ void EvHTTPServer::DecOps() {
   num_pending_ops_--;
 }
 
+bool EvHTTPServer::OnlyEventLoopsPending() const {
+  return num_pending_ops_ <= static_cast<int64_t>(event_loops_.size());
+}
+
 void EvHTTPServer::WaitForTermination() {
   {
     absl::MutexLock l(&ops_mu_);
-    ops_mu_.Await(absl::Condition(
-        +[](int64_t* count) { return *count <= 1; }, &num_pending_ops_));
+    ops_mu_.Await(absl::Condition(this, &EvHTTPServer::OnlyEventLoopsPending));
   }
 
-  int result = event_base_loopexit(ev_base_, nullptr);
-  NET_LOG(INFO, "event_base_loopexit() exits with value %d", result);
+  for (auto& loop : event_loops_) {
+    int result = event_base_loopexit(loop->ev_base(), nullptr);
+    NET_LOG(INFO, "event_base_loopexit() exits with value %d", result);
+  }
 
   {
     absl::MutexLock l(&ops_mu_);
@@ -340,14 +440,14 @@ bool EvHTTPServer::WaitForTerminationWithTimeout(absl::Duration timeout) {
   {
     absl::MutexLock l(&ops_mu_);
     wait_result = ops_mu_.AwaitWithTimeout(
-        absl::Condition(
-            +[](int64_t* count) { return *count <= 1; }, &num_pending_ops_),
-        timeout);
+        absl::Condition(this, &EvHTTPServer::OnlyEventLoopsPending), timeout);
   }
 
   if (wait_result) {
-    int result = event_base_loopexit(ev_base_, nullptr);
-    NET_LOG(INFO, "event_base_loopexit() exits with value %d", result);
+    for (auto& loop : event_loops_) {
+      int result = event_base_loopexit(loop->ev_base(), nullptr);
+      NET_LOG(INFO, "event_base_loopexit() exits with value %d", result);
+    }
 
     // This should pass immediately
     {
@@ -373,11 +473,14 @@ EvHTTPServer::DispatcherInfo::DispatcherInfo(
     RequestDispatcher dispatcher_in, const RequestHandlerOptions& options_in)
     : dispatcher(std::move(dispatcher_in)), options(options_in) {}
 
+// Handlers are registered into a copy of the current table, which is then
+// published to the event loops.
 void EvHTTPServer::RegisterRequestHandler(
     absl::string_view uri, RequestHandler handler,
     const RequestHandlerOptions& options) {
   absl::MutexLock l(&request_mu_);
-  auto result = uri_handlers_.emplace(
+  auto handlers = std::make_shared<HandlerTable>(*handlers_);
+  auto result = handlers->uri_handlers.emplace(
       std::piecewise_construct, std::forward_as_tuple(uri),
       std::forward_as_tuple(uri, handler, options));
 
@@ -387,8 +490,8 @@ void EvHTTPServer::RegisterRequestHandler(
             "the URI path %.*s",
             static_cast<int>(uri.size()), uri.data());
 
-    uri_handlers_.erase(result.first);
-    if (!uri_handlers_
+    handlers->uri_handlers.erase(result.first);
+    if (!handlers->uri_handlers
              .emplace(std::piecewise_construct, std::forward_as_tuple(uri),
                       std::forward_as_tuple(uri, handler, options))
              .second) {
@@ -396,12 +499,22 @@ void EvHTTPServer::RegisterRequestHandler(
               static_cast<int>(uri.size()), uri.data());
     }
   }
+
+  PublishHandlers(std::move(handlers));
 }
 
 void EvHTTPServer::RegisterRequestDispatcher(
     RequestDispatcher dispatcher, const RequestHandlerOptions& options) {
   absl::MutexLock l(&request_mu_);
-  dispatchers_.emplace_back(dispatcher, options);
+  auto handlers = std::make_shared<HandlerTable>(*handlers_);
+  handlers->dispatchers.emplace_back(dispatcher, options);
+  PublishHandlers(std::move(handlers));
+}
+
+void EvHTTPServer::PublishHandlers(
+    std::shared_ptr<const HandlerTable> handlers) {
+  handlers_ = std::move(handlers);
+  handlers_version_.fetch_add(1, std::memory_order_release);
 }
 
 namespace {
@@ -414,7 +527,7 @@ void EvImmediateCallback(evutil_socket_t socket, int16_t flags, void* arg) {
 
 }  // namespace
 
-bool EvHTTPServer::EventLoopSchedule(std::function<void()> fn) {
+bool EvHTTPServer::EventLoop::EventLoopSchedule(std::function<void()> fn) {
   auto scheduled_fn = new std::function<void()>(std::move(fn));
   int result = event_base_once(ev_base_, -1, EV_TIMEOUT, EvImmediateCallback,
                                static_cast<void*>(scheduled_fn), immediate_);
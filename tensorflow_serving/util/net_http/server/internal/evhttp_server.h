@@ -18,9 +18,12 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_UTIL_NET_HTTP_SERVER_INTERNAL_EVHTTP_SERVER_H_
 #define TENSORFLOW_SERVING_UTIL_NET_HTTP_SERVER_INTERNAL_EVHTTP_SERVER_H_
 
+#include <atomic>
 #include <cstdint>
 #include <ctime>
+#include <functional>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -42,7 +45,11 @@ namespace tensorflow {
 namespace serving {
 namespace net_http {
 
-class EvHTTPServer final : public HTTPServerInterface, ServerSupport {
+// Runs one or more event loops (see ServerOptions::SetNumEventLoops()), each
+// with its own event_base, evhttp instance and listener. Requests are parsed
+// and dispatched by the event loop that accepted the connection, and replies
+// are sent from the same loop.
+class EvHTTPServer final : public HTTPServerInterface {
  public:
   virtual ~EvHTTPServer();
 
@@ -73,22 +80,7 @@ class EvHTTPServer final : public HTTPServerInterface, ServerSupport {
   void RegisterRequestDispatcher(RequestDispatcher dispatcher,
                                  const RequestHandlerOptions& options) override;
 
-  void IncOps() override;
-  void DecOps() override;
-
-  bool EventLoopSchedule(std::function<void()> fn) override;
-
  private:
-  static void DispatchEvRequestFn(struct evhttp_request* req, void* server);
-
-  void DispatchEvRequest(struct evhttp_request* req);
-
-  void ScheduleHandlerReference(const RequestHandler& handler,
-                                EvHTTPRequest* ev_request)
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(request_mu_);
-  void ScheduleHandler(RequestHandler&& handler, EvHTTPRequest* ev_request)
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(request_mu_);
-
   struct UriHandlerInfo {
    public:
     UriHandlerInfo(absl::string_view uri_in, RequestHandler handler_in,
@@ -107,6 +99,79 @@ class EvHTTPServer final : public HTTPServerInterface, ServerSupport {
     const RequestHandlerOptions options;
   };
 
+  // The registered handlers and dispatchers. Immutable once published, so
+  // that event loops can dispatch requests without taking request_mu_.
+  struct HandlerTable {
+    std::unordered_map<std::string, UriHandlerInfo> uri_handlers;
+    std::vector<DispatcherInfo> dispatchers;
+  };
+
+  // An event loop, which is the ServerSupport of the requests it dispatches.
+  class EventLoop final : public ServerSupport {
+   public:
+    explicit EventLoop(EvHTTPServer* server) : server_(server) {}
+    ~EventLoop() override;
+
+    EventLoop(const EventLoop& other) = delete;
+    EventLoop& operator=(const EventLoop& other) = delete;
+
+    // Creates the event_base and evhttp instances.
+    bool Initialize();
+
+    // Binds the listener, with SO_REUSEPORT if `reuse_port` is true.
+    bool Listen(const std::string& ip_address, int port, bool reuse_port);
+
+    // Returns the handlers to dispatch requests with, reloading them from
+    // the server if new ones have been registered. Only called from the
+    // event loop.
+    const std::shared_ptr<const HandlerTable>& handlers();
+
+    void IncOps() override { server_->IncOps(); }
+    void DecOps() override { server_->DecOps(); }
+
+    bool EventLoopSchedule(std::function<void()> fn) override;
+
+    EvHTTPServer* server() const { return server_; }
+    event_base* ev_base() const { return ev_base_; }
+    evhttp* ev_http() const { return ev_http_; }
+    evhttp_bound_socket* ev_listener() const { return ev_listener_; }
+
+   private:
+    EvHTTPServer* const server_;
+
+    event_base* ev_base_ = nullptr;
+    evhttp* ev_http_ = nullptr;
+    evhttp_bound_socket* ev_listener_ = nullptr;
+
+    // Timeval used to register immediate callbacks, which are called
+    // in the order that they are registered.
+    const timeval* immediate_ = nullptr;
+
+    // Only accessed from the event loop.
+    std::shared_ptr<const HandlerTable> handlers_;
+    uint64_t handlers_version_ = 0;
+  };
+
+  static void DispatchEvRequestFn(struct evhttp_request* req, void* loop);
+
+  void DispatchEvRequest(EventLoop* loop, struct evhttp_request* req);
+
+  void ScheduleHandlerReference(std::shared_ptr<const HandlerTable> handlers,
+                                const RequestHandler& handler,
+                                EvHTTPRequest* ev_request);
+  void ScheduleHandler(RequestHandler&& handler, EvHTTPRequest* ev_request);
+
+  // Makes `handlers` visible to the event loops.
+  void PublishHandlers(std::shared_ptr<const HandlerTable> handlers)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(request_mu_);
+
+  // book-keeping of active operations
+  void IncOps();
+  void DecOps();
+
+  // Returns true if the only pending operations are the running event loops.
+  bool OnlyEventLoopsPending() const ABSL_SHARED_LOCKS_REQUIRED(ops_mu_);
+
   std::unique_ptr<ServerOptions> server_options_;
 
   // Started accepting requests.
@@ -122,18 +187,12 @@ class EvHTTPServer final : public HTTPServerInterface, ServerSupport {
   int64_t num_pending_ops_ ABSL_GUARDED_BY(ops_mu_) = 0;
 
   mutable absl::Mutex request_mu_;
-  std::unordered_map<std::string, UriHandlerInfo> uri_handlers_
-      ABSL_GUARDED_BY(request_mu_);
-  std::vector<DispatcherInfo> dispatchers_ ABSL_GUARDED_BY(request_mu_);
-
-  // ev instances
-  event_base* ev_base_ = nullptr;
-  evhttp* ev_http_ = nullptr;
-  evhttp_bound_socket* ev_listener_ = nullptr;
-
-  // Timeval used to register immediate callbacks, which are called
-  // in the order that they are registered.
-  const timeval* immediate_;
+  std::shared_ptr<const HandlerTable> handlers_ ABSL_GUARDED_BY(request_mu_);
+  // Bumped whenever handlers_ changes. Starts at 1 so that event loops load
+  // the initial handlers too.
+  std::atomic<uint64_t> handlers_version_{1};
+
+  std::vector<std::unique_ptr<EventLoop>> event_loops_;
 };
 
 }  // namespace net_http
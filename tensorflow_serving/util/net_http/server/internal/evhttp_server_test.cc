@@ -17,10 +17,13 @@ limitations under the License.
 
 #include <functional>
 #include <memory>
+#include <set>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
 #include "tensorflow_serving/util/net_http/client/test_client/internal/evhttp_connection.h"
 #include "tensorflow_serving/util/net_http/internal/fixed_thread_pool.h"
@@ -360,6 +363,66 @@ TEST_F(EvHTTPServerTestWithAddress, BasicListen) {
   server->WaitForTermination();
 }
 
+class EvHTTPServerTestWithEventLoops : public EvHTTPServerTest {
+ protected:
+  std::unique_ptr<ServerOptions> GetOptions() override {
+    auto options = EvHTTPServerTest::GetOptions();
+    options->SetNumEventLoops(4);
+    // Event loops occupy an executor thread each.
+    options->SetExecutor(absl::make_unique<MyExecutor>(8));
+    return options;
+  }
+};
+
+// Test connections are spread across the event loops
+TEST_F(EvHTTPServerTestWithEventLoops, MultipleEventLoops) {
+  auto handler = [](ServerRequestInterface* request) {
+    request->WriteResponseString("OK");
+    request->Reply();
+  };
+
+  // Dispatchers are invoked from the event loop threads.
+  absl::Mutex mu;
+  std::set<std::thread::id> loop_threads;
+  auto dispatcher = [&](ServerRequestInterface* request) {
+    absl::MutexLock l(&mu);
+    loop_threads.insert(std::this_thread::get_id());
+    return handler;
+  };
+
+  server->RegisterRequestDispatcher(std::move(dispatcher),
+                                    RequestHandlerOptions());
+  server->StartAcceptingRequests();
+  EXPECT_NE(server->listen_port(), 0);
+
+  // Handlers registered after the start are picked up by all loops.
+  server->RegisterRequestHandler("/registered", handler,
+                                 RequestHandlerOptions());
+
+  for (int i = 0; i < 32; i++) {
+    auto connection =
+        TestEvHTTPConnection::Connect("localhost", server->listen_port());
+    ASSERT_TRUE(connection != nullptr);
+
+    for (const char* path : {"/ok", "/registered"}) {
+      TestClientRequest request = {path, "GET", {}, ""};
+      TestClientResponse response = {};
+
+      EXPECT_TRUE(connection->BlockingSendRequest(request, &response));
+      EXPECT_EQ(response.status, HTTPStatusCode::OK);
+      EXPECT_EQ(response.body, "OK");
+    }
+  }
+
+  {
+    absl::MutexLock l(&mu);
+    EXPECT_GT(loop_threads.size(), 1);
+  }
+
+  server->Terminate();
+  server->WaitForTermination();
+}
+
 }  // namespace
 
 }  // namespace net_http
@@ -73,15 +73,31 @@ class ServerOptions {
     executor_ = std::move(executor);
   }
 
+  // The number of event loops that accept connections and parse requests,
+  // each of which occupies one executor thread while the server is running.
+  // Defaults to 1.
+  //
+  // With more than one event loop, each loop binds its own listener with
+  // SO_REUSEPORT (e.g. Linux 3.9+) and the kernel spreads new connections
+  // across them. Note that SO_REUSEPORT allows other processes of the same
+  // user to bind the port too.
+  void SetNumEventLoops(int num_event_loops) {
+    assert(num_event_loops > 0);
+    num_event_loops_ = num_event_loops;
+  }
+
   const std::vector<std::string>& ip_addresses() const { return ip_addresses_; }
   const std::vector<int>& ports() const { return ports_; }
 
   EventExecutor* executor() const { return executor_.get(); }
 
+  int num_event_loops() const { return num_event_loops_; }
+
  private:
   std::vector<int> ports_;
   std::vector<std::string> ip_addresses_;
   std::unique_ptr<EventExecutor> executor_;
+  int num_event_loops_ = 1;
 };
 
 // Options to specify when registering a handler (given a uri pattern).
@@ -116,13 +132,51 @@ class RequestHandlerOptions {
 
   inline bool auto_uncompress_input() const { return auto_uncompress_input_; }
 
+  // The auto_compress_output option specifies whether the response body
+  // should be gzip-compressed if the request has an Accept-Encoding header
+  // that accepts gzip. The response is compressed by the thread that calls
+  // Reply(), i.e. not by the event loop. Responses that already have a
+  // Content-Encoding header are left as is. The option defaults to false.
+  inline RequestHandlerOptions& set_auto_compress_output(bool should_compress) {
+    auto_compress_output_ = should_compress;
+    return *this;
+  }
+
+  inline bool auto_compress_output() const { return auto_compress_output_; }
+
+  // Sets the min length of response bodies to compress. Smaller responses
+  // are not worth the CPU time.
+  inline RequestHandlerOptions& set_auto_compress_min_size(int64_t size) {
+    auto_compress_min_size_ = size;
+    return *this;
+  }
+
+  inline int64_t auto_compress_min_size() const {
+    return auto_compress_min_size_;
+  }
+
+  // Sets the zlib compression level of response bodies, from 1 (fastest) to
+  // 9 (best compression), or -1 for the zlib default.
+  inline RequestHandlerOptions& set_auto_compress_level(int level) {
+    auto_compress_level_ = level;
+    return *this;
+  }
+
+  inline int auto_compress_level() const { return auto_compress_level_; }
+
  private:
-  // To be added: compression, CORS rules, streaming control
+  // To be added: CORS rules, streaming control
   // thread executor, admission control, limits ...
 
   bool auto_uncompress_input_ = true;
 
   int64_t auto_uncompress_max_size_ = 0;
+
+  bool auto_compress_output_ = false;
+
+  int64_t auto_compress_min_size_ = 1024;
+
+  int auto_compress_level_ = -1;
 };
 
 // A request handler is registered by the application to handle a request
@@ -197,6 +251,9 @@ class HTTPServerInterface {
   // Dispatchers are invoked in order of registration, i.e. first registered
   // gets first pick. The server owns the dispatcher after registration.
   // Dispatchers may be registered after the server has been started.
+  //
+  // Dispatchers may be invoked concurrently if the server runs more than one
+  // event loop (see ServerOptions::SetNumEventLoops()).
   virtual void RegisterRequestDispatcher(
       RequestDispatcher dispatcher, const RequestHandlerOptions& options) = 0;
 
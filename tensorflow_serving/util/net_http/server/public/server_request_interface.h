@@ -30,6 +30,7 @@ limitations under the License.
 #include <cstdlib>
 #include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "absl/strings/string_view.h"
@@ -39,6 +40,22 @@ namespace tensorflow {
 namespace serving {
 namespace net_http {
 
+// Reads a request body one chunk at a time, as the caller pulls it (see
+// ServerRequestInterface::NewRequestBodyStream()).
+class RequestBodyStream {
+ public:
+  virtual ~RequestBodyStream() = default;
+
+  // Sets `chunk` to the next chunk of the body, which is only valid until the
+  // next call. Returns false once the whole body has been read, or if it can't
+  // be read any further (see ok()).
+  virtual bool Next(absl::string_view* chunk) = 0;
+
+  // Returns false if the body could not be read in full, e.g. because a
+  // compressed body is corrupted or exceeds the uncompressed size limit.
+  virtual bool ok() const = 0;
+};
+
 class ServerRequestInterface {
  public:
   // To be used with memory blocks returned via std::unique_ptr<char[]>
@@ -101,6 +118,71 @@ class ServerRequestInterface {
   virtual std::unique_ptr<char[], ServerRequestInterface::BlockDeleter>
   ReadRequestBytes(int64_t* size) = 0;
 
+  // Receives the request body one chunk at a time. The chunk is only valid
+  // for the duration of the call. Returns false to stop reading the body.
+  using RequestBodyReader = std::function<bool(absl::string_view chunk)>;
+
+  // Reads the (remaining) request body, passing it to `reader` in order and
+  // one chunk at a time. Compared to ReadRequestBytes(), implementations
+  // should pass chunks as they are buffered by the transport (without copying
+  // them), and uncompress compressed bodies incrementally, so that the
+  // uncompressed body is never held in memory at once by the server.
+  //
+  // Returns false if the body could not be read in full (e.g. a compressed
+  // body is corrupted or exceeds the uncompressed size limit) or if `reader`
+  // returned false. Either way the body is consumed, and subsequent reads
+  // will hit EOF.
+  //
+  // Like ReadRequestBytes(), this is not a streaming read API in that the
+  // complete request body should have already been received.
+  virtual bool ReadRequestBody(const RequestBodyReader& reader) {
+    int64_t num_bytes = 0;
+    auto request_chunk = ReadRequestBytes(&num_bytes);
+    while (request_chunk != nullptr) {
+      if (!reader(absl::string_view(request_chunk.get(),
+                                    static_cast<size_t>(num_bytes)))) {
+        while (ReadRequestBytes(&num_bytes) != nullptr) {
+        }
+        return false;
+      }
+      request_chunk = ReadRequestBytes(&num_bytes);
+    }
+    return true;
+  }
+
+  // Returns a stream of the request body from its start, which passes and
+  // uncompresses the body like ReadRequestBody(), but as the caller pulls it
+  // rather than pushing it to a callback. This lets e.g. a parser consume the
+  // body as it is being uncompressed.
+  //
+  // The default implementation reads the whole body with ReadRequestBody()
+  // when called, so the body can only be read once. Implementations that
+  // leave the body in place (like the libevent one) may return any number of
+  // streams, each reading the body from its start.
+  virtual std::unique_ptr<RequestBodyStream> NewRequestBodyStream() {
+    class BufferedRequestBodyStream final : public RequestBodyStream {
+     public:
+      bool Next(absl::string_view* chunk) override {
+        if (read_ || body_.empty()) return false;
+        read_ = true;
+        *chunk = body_;
+        return true;
+      }
+      bool ok() const override { return ok_; }
+
+      std::string body_;
+      bool ok_ = true;
+      bool read_ = false;
+    };
+    std::unique_ptr<BufferedRequestBodyStream> stream(
+        new BufferedRequestBodyStream());
+    stream->ok_ = ReadRequestBody([&stream](absl::string_view chunk) {
+      stream->body_.append(chunk.data(), chunk.size());
+      return true;
+    });
+    return stream;
+  }
+
   // Returns the first value, including "", associated with a request
   // header name. The header name argument is case-insensitive.
   // Returns nullptr if the specified header doesn't exist.
@@ -15,6 +15,10 @@ limitations under the License.
 
 // A single-threaded server to print the request details as HTML
 // URI: /print
+//
+// With num_event_loops specified, the server runs that many event loops (see
+// ServerOptions::SetNumEventLoops()) on a thread pool instead, e.g. as the
+// target of ev_load_client.
 
 #include <cstddef>
 #include <cstdint>
@@ -30,6 +34,7 @@ limitations under the License.
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "tensorflow_serving/util/net_http/internal/fixed_thread_pool.h"
 #include "tensorflow_serving/util/net_http/server/public/httpserver.h"
 #include "tensorflow_serving/util/net_http/server/public/httpserver_interface.h"
 #include "tensorflow_serving/util/net_http/server/public/server_request_interface.h"
@@ -39,6 +44,7 @@ namespace {
 using absl::StrAppend;
 
 using tensorflow::serving::net_http::EventExecutor;
+using tensorflow::serving::net_http::FixedThreadPool;
 using tensorflow::serving::net_http::HTTPServerInterface;
 using tensorflow::serving::net_http::RequestHandlerOptions;
 using tensorflow::serving::net_http::ServerOptions;
@@ -94,11 +100,33 @@ class MyExcecutor final : public EventExecutor {
   void Schedule(std::function<void()> fn) override { fn(); }
 };
 
+// An executor that runs a fixed number of threads
+class MyThreadPoolExecutor final : public EventExecutor {
+ public:
+  explicit MyThreadPoolExecutor(int num_threads) : thread_pool_(num_threads) {}
+
+  void Schedule(std::function<void()> fn) override {
+    thread_pool_.Schedule(fn);
+  }
+
+ private:
+  FixedThreadPool thread_pool_;
+};
+
 // Returns the server if success, or nullptr if there is any error.
-std::unique_ptr<HTTPServerInterface> StartServer(int port) {
+// Runs the event loop on the current thread if num_event_loops is 0.
+std::unique_ptr<HTTPServerInterface> StartServer(int port,
+                                                 int num_event_loops) {
   auto options = absl::make_unique<ServerOptions>();
   options->AddPort(port);
-  options->SetExecutor(absl::make_unique<MyExcecutor>());
+  if (num_event_loops > 0) {
+    options->SetNumEventLoops(num_event_loops);
+    // One thread per event loop, plus as many for the handlers.
+    options->SetExecutor(
+        absl::make_unique<MyThreadPoolExecutor>(2 * num_event_loops));
+  } else {
+    options->SetExecutor(absl::make_unique<MyExcecutor>());
+  }
 
   auto server = CreateEvHTTPServer(std::move(options));
 
@@ -109,7 +137,7 @@ std::unique_ptr<HTTPServerInterface> StartServer(int port) {
   RequestHandlerOptions handler_options;
   server->RegisterRequestHandler("/print", EchoHandler, handler_options);
 
-  // Blocking here with the use of MyExecutor
+  // Blocking here with the use of MyExcecutor (single event loop)
   bool success = server->StartAcceptingRequests();
 
   if (success) {
@@ -123,7 +151,8 @@ std::unique_ptr<HTTPServerInterface> StartServer(int port) {
 
 int main(int argc, char** argv) {
   if (argc < 2) {
-    std::cerr << "Usage: http-server <port:8080>" << std::endl;
+    std::cerr << "Usage: http-server <port:8080> [num_event_loops]"
+              << std::endl;
     return 1;
   }
 
@@ -133,7 +162,14 @@ int main(int argc, char** argv) {
     std::cerr << "Invalid port: " << argv[1] << std::endl;
   }
 
-  auto server = StartServer(port);
+  int num_event_loops = 0;
+  if (argc > 2 && (!absl::SimpleAtoi(argv[2], &num_event_loops) ||
+                   num_event_loops <= 0)) {
+    std::cerr << "Invalid num_event_loops: " << argv[2] << std::endl;
+    return 1;
+  }
+
+  auto server = StartServer(port, num_event_loops);
 
   if (server != nullptr) {
     server->WaitForTermination();
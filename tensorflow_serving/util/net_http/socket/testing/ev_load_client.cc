@@ -0,0 +1,201 @@
+/* Copyright 2018 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// A load generator in the style of ev_fetch_client: keeps a number of
+// keep-alive connections busy with back-to-back GET requests for a fixed
+// duration, and reports the request rate, e.g. against
+//
+//   evhttp_echo_server 8080 4
+//   ev_load_client http://localhost:8080/print 4 64 10
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "libevent/include/event2/event.h"
+#include "libevent/include/event2/http.h"
+#include "libevent/include/event2/keyvalq_struct.h"
+#include "libevent/include/event2/util.h"
+
+namespace {
+
+struct LoadOptions {
+  const char* host;
+  int port;
+  char uri[256];
+  int num_connections;
+  int duration_secs;
+};
+
+std::atomic<int64_t> num_responses(0);
+std::atomic<int64_t> num_errors(0);
+
+// One connection issuing requests back to back.
+struct Connection {
+  const LoadOptions* options;
+  evhttp_connection* evcon;
+};
+
+void SendRequest(Connection* connection);
+
+void response_cb(struct evhttp_request* req, void* ctx) {
+  auto connection = static_cast<Connection*>(ctx);
+  if (req == nullptr || evhttp_request_get_response_code(req) != HTTP_OK) {
+    num_errors++;
+  } else {
+    num_responses++;
+  }
+  SendRequest(connection);
+}
+
+void SendRequest(Connection* connection) {
+  struct evhttp_request* req = evhttp_request_new(response_cb, connection);
+  if (req == nullptr) {
+    fprintf(stderr, "evhttp_request_new() failed\n");
+    return;
+  }
+
+  struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req);
+  evhttp_add_header(output_headers, "Host", connection->options->host);
+
+  if (evhttp_make_request(connection->evcon, req, EVHTTP_REQ_GET,
+                          connection->options->uri) != 0) {
+    fprintf(stderr, "evhttp_make_request() failed\n");
+  }
+}
+
+// Runs the connections of one thread on their own event_base.
+void RunLoad(const LoadOptions& options) {
+  event_base* ev_base = event_base_new();
+  if (ev_base == nullptr) {
+    perror("event_base_new()");
+    return;
+  }
+
+  std::vector<Connection> connections(options.num_connections);
+  for (auto& connection : connections) {
+    connection.options = &options;
+    connection.evcon = evhttp_connection_base_new(
+        ev_base, nullptr, options.host, static_cast<uint16_t>(options.port));
+    if (connection.evcon == nullptr) {
+      fprintf(stderr, "evhttp_connection_base_new() failed\n");
+      return;
+    }
+    SendRequest(&connection);
+  }
+
+  timeval duration = {options.duration_secs, 0};
+  event_base_loopexit(ev_base, &duration);
+  event_base_dispatch(ev_base);
+
+  for (auto& connection : connections) {
+    evhttp_connection_free(connection.evcon);
+  }
+  event_base_free(ev_base);
+}
+
+void help() {
+  fputs(
+      "Usage: ev_load_client uri [num_threads:1] [num_connections:16] "
+      "[duration_secs:10]\n",
+      stderr);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 5) {
+    help();
+    return 1;
+  }
+
+  const int num_threads = argc > 2 ? atoi(argv[2]) : 1;
+  const int num_connections = argc > 3 ? atoi(argv[3]) : 16;
+  const int duration_secs = argc > 4 ? atoi(argv[4]) : 10;
+  if (num_threads <= 0 || num_connections <= 0 || duration_secs <= 0) {
+    help();
+    return 1;
+  }
+
+  struct evhttp_uri* http_uri = evhttp_uri_parse(argv[1]);
+  if (http_uri == nullptr) {
+    fputs("malformed url\n", stderr);
+    return 1;
+  }
+
+  const char* scheme = evhttp_uri_get_scheme(http_uri);
+  if (scheme == nullptr || strcasecmp(scheme, "http") != 0) {
+    fputs("url must be http\n", stderr);
+    return 1;
+  }
+
+  LoadOptions options;
+  options.host = evhttp_uri_get_host(http_uri);
+  if (options.host == nullptr) {
+    fputs("url must have a host\n", stderr);
+    return 1;
+  }
+
+  options.port = evhttp_uri_get_port(http_uri);
+  if (options.port == -1) {
+    options.port = 80;
+  }
+
+  const char* path = evhttp_uri_get_path(http_uri);
+  if (strlen(path) == 0) {
+    path = "/";
+  }
+
+  const char* query = evhttp_uri_get_query(http_uri);
+  if (query == nullptr) {
+    snprintf(options.uri, sizeof(options.uri) - 1, "%s", path);
+  } else {
+    snprintf(options.uri, sizeof(options.uri) - 1, "%s?%s", path, query);
+  }
+  options.uri[sizeof(options.uri) - 1] = '\0';
+
+  options.num_connections = num_connections;
+  options.duration_secs = duration_secs;
+
+  fprintf(stdout, "Running %d threads x %d connections for %d seconds ...\n",
+          num_threads, num_connections, duration_secs);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&options]() { RunLoad(options); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const double elapsed_secs =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  fprintf(stdout, "Responses: %lld, errors: %lld, requests/sec: %.0f\n",
+          static_cast<long long>(num_responses.load()),  // NOLINT
+          static_cast<long long>(num_errors.load()),     // NOLINT
+          num_responses.load() / elapsed_secs);
+
+  evhttp_uri_free(http_uri);
+  return 0;
+}
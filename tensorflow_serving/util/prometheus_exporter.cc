@@ -16,139 +16,202 @@ limitations under the License.
 #include "tensorflow_serving/util/prometheus_exporter.h"
 
 #include <memory>
+#include <utility>
 #include <vector>
 
-#include "absl/strings/match.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/str_cat.h"
-#include "absl/strings/str_format.h"
-#include "absl/strings/str_join.h"
-#include "re2/re2.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/core/lib/core/errors.h"
 
 namespace tensorflow {
 namespace serving {
 
 namespace {
 
-string SanitizeLabelValue(const string& value) {
-  // Backslash and double quote have to be escaped.
-  string new_value = value;
-  // Replace \ with \\.
-  RE2::GlobalReplace(&new_value, "\\\\", "\\\\\\\\");
-  // Replace " with \".
-  RE2::GlobalReplace(&new_value, "\"", "\\\\\"");
-  return new_value;
+// The size of the chunks WritePage() passes the page in.
+constexpr size_t kPageChunkSize = 64 * 1024;
+
+// The names of the labels which identify the model of a point.
+constexpr absl::string_view kModelLabelNames[] = {"model_name", "model"};
+
+// Accumulates the lines of a page, and passes them on in chunks.
+class PageWriter {
+ public:
+  explicit PageWriter(const std::function<void(absl::string_view)>& write)
+      : write_(write) {
+    buffer_.reserve(kPageChunkSize);
+  }
+
+  template <typename... Args>
+  void AppendLine(const Args&... args) {
+    absl::StrAppend(&buffer_, args..., "\n");
+    if (buffer_.size() >= kPageChunkSize) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    if (!buffer_.empty()) {
+      write_(buffer_);
+      buffer_.clear();
+    }
+  }
+
+ private:
+  const std::function<void(absl::string_view)>& write_;
+  string buffer_;
+};
+
+// Appends 'value' to 'out', with backslashes and double quotes escaped.
+void AppendLabelValue(absl::string_view value, string* out) {
+  for (const char c : value) {
+    if (c == '\\' || c == '"') {
+      out->push_back('\\');
+    }
+    out->push_back(c);
+  }
 }
 
-string SanatizeLabelName(const string& name) {
-  // Valid format: [a-zA-Z_][a-zA-Z0-9_]*
-  string new_name = name;
-  RE2::GlobalReplace(&new_name, "[^a-zA-Z0-9]", "_");
-  if (RE2::FullMatch(new_name, "^[0-9].*")) {
-    // Start with 0-9, prepend a underscore.
-    new_name = absl::StrCat("_", new_name);
+// Returns 'name' with each character for which 'is_valid' is false replaced
+// by 'replacement', and prefixed with an underscore if it starts with a digit.
+string SanitizeName(absl::string_view name, bool (*is_valid)(char),
+                    const char replacement) {
+  string new_name;
+  new_name.reserve(name.size() + 1);
+  for (const char c : name) {
+    // A multi-byte UTF-8 character is replaced once, at its leading byte.
+    if ((c & 0xC0) == 0x80) {
+      continue;
+    }
+    new_name.push_back(is_valid(c) ? c : replacement);
+  }
+  if (!new_name.empty() && absl::ascii_isdigit(new_name[0])) {
+    new_name.insert(0, "_");
   }
   return new_name;
 }
 
-string GetPrometheusMetricName(
-    const monitoring::MetricDescriptor& metric_descriptor) {
+string SanitizeLabelName(absl::string_view name) {
+  // Valid format: [a-zA-Z_][a-zA-Z0-9_]*
+  return SanitizeName(
+      name, [](char c) { return absl::ascii_isalnum(c); }, '_');
+}
+
+string SanitizeMetricName(absl::string_view name) {
   // Valid format: [a-zA-Z_:][a-zA-Z0-9_:]*
-  string new_name = metric_descriptor.name;
-  RE2::GlobalReplace(&new_name, "[^a-zA-Z0-9_]", ":");
-  if (RE2::FullMatch(new_name, "^[0-9].*")) {
-    // Start with 0-9, prepend a underscore.
-    new_name = absl::StrCat("_", new_name);
+  return SanitizeName(
+      name, [](char c) { return absl::ascii_isalnum(c) || c == '_'; }, ':');
+}
+
+// Appends the labels of 'point' to 'out' in Prometheus format, e.g.
+// a="x",b="y", where 'label_names' are the sanitized label names.
+void AppendLabels(const std::vector<string>& label_names,
+                  const monitoring::Point& point, string* out) {
+  for (int i = 0; i < point.labels.size(); ++i) {
+    if (i > 0) {
+      out->push_back(',');
+    }
+    absl::StrAppend(out,
+                    i < label_names.size()
+                        ? label_names[i]
+                        : SanitizeLabelName(point.labels[i].name),
+                    "=\"");
+    AppendLabelValue(point.labels[i].value, out);
+    out->push_back('"');
   }
-  return new_name;
 }
 
-void SerializeHistogram(const monitoring::MetricDescriptor& metric_descriptor,
-                        const monitoring::PointSet& point_set,
-                        std::vector<string>* lines) {
+void SerializeHistogram(const string& prom_metric_name,
+                        const std::vector<string>& label_names,
+                        const std::vector<const monitoring::Point*>& points,
+                        PageWriter* writer) {
   // For a metric name NAME, we should output:
   //   NAME_bucket{le=b1} x1
   //   NAME_bucket{le=b2} x2
   //   NAME_bucket{le=b3} x3 ...
   //   NAME_sum xsum
   //   NAME_count xcount
-  string prom_metric_name = GetPrometheusMetricName(metric_descriptor);
   // Type definition line.
-  lines->push_back(absl::StrFormat("# TYPE %s histogram", prom_metric_name));
-  for (const auto& point : point_set.points) {
+  writer->AppendLine("# TYPE ", prom_metric_name, " histogram");
+  string labels;
+  for (const monitoring::Point* point : points) {
     // Each points has differnet label values.
-    std::vector<string> labels = {};
-    labels.reserve(point->labels.size());
-    for (const auto& label : point->labels) {
-      labels.push_back(absl::StrFormat("%s=\"%s\"",
-                                       SanatizeLabelName(label.name),
-                                       SanitizeLabelValue(label.value)));
-    }
+    labels.clear();
+    AppendLabels(label_names, *point, &labels);
+    const absl::string_view separator = labels.empty() ? "" : ",";
+    const HistogramProto& histogram = point->histogram_value;
     int64_t cumulative_count = 0;
-    string bucket_prefix =
-        absl::StrCat(prom_metric_name, "_bucket{", absl::StrJoin(labels, ","));
-    if (!labels.empty()) {
-      absl::StrAppend(&bucket_prefix, ",");
-    }
     // One bucket per line, last one should be le="Inf".
-    for (int i = 0; i < point->histogram_value.bucket_size(); i++) {
-      cumulative_count += point->histogram_value.bucket(i);
-      string bucket_limit =
-          (i < point->histogram_value.bucket_size() - 1)
-              ? absl::StrCat(point->histogram_value.bucket_limit(i))
-              : "+Inf";
-      lines->push_back(absl::StrCat(
-          bucket_prefix, absl::StrFormat("le=\"%s\"} ", bucket_limit),
-          cumulative_count));
+    for (int i = 0; i < histogram.bucket_size(); i++) {
+      cumulative_count += histogram.bucket(i);
+      if (i < histogram.bucket_size() - 1) {
+        writer->AppendLine(prom_metric_name, "_bucket{", labels, separator,
+                           "le=\"", histogram.bucket_limit(i), "\"} ",
+                           cumulative_count);
+      } else {
+        writer->AppendLine(prom_metric_name, "_bucket{", labels, separator,
+                           "le=\"+Inf\"} ", cumulative_count);
+      }
     }
     // _sum and _count.
-    lines->push_back(absl::StrCat(prom_metric_name, "_sum{",
-                                  absl::StrJoin(labels, ","), "} ",
-                                  point->histogram_value.sum()));
-    lines->push_back(absl::StrCat(prom_metric_name, "_count{",
-                                  absl::StrJoin(labels, ","), "} ",
-                                  cumulative_count));
+    writer->AppendLine(prom_metric_name, "_sum{", labels, "} ",
+                       histogram.sum());
+    writer->AppendLine(prom_metric_name, "_count{", labels, "} ",
+                       cumulative_count);
   }
 }
 
 void SerializeScalar(const monitoring::MetricDescriptor& metric_descriptor,
-                     const monitoring::PointSet& point_set,
-                     std::vector<string>* lines) {
+                     const string& prom_metric_name,
+                     const std::vector<string>& label_names,
+                     const std::vector<const monitoring::Point*>& points,
+                     PageWriter* writer) {
   // A counter or gauge metric.
   // The format should be:
   //   NAME{label=value,label=value} x time
-  string prom_metric_name = GetPrometheusMetricName(metric_descriptor);
-  string metric_type_str = "untyped";
+  absl::string_view metric_type_str = "untyped";
   if (metric_descriptor.metric_kind == monitoring::MetricKind::kCumulative) {
     metric_type_str = "counter";
   } else if (metric_descriptor.metric_kind == monitoring::MetricKind::kGauge) {
     metric_type_str = "gauge";
   }
   // Type definition line.
-  lines->push_back(
-      absl::StrFormat("# TYPE %s %s", prom_metric_name, metric_type_str));
-  for (const auto& point : point_set.points) {
+  writer->AppendLine("# TYPE ", prom_metric_name, " ", metric_type_str);
+  string labels;
+  for (const monitoring::Point* point : points) {
     // Each points has differnet label values.
-    string name_bracket = absl::StrCat(prom_metric_name, "{");
-    std::vector<string> labels = {};
-    labels.reserve(point->labels.size());
-    for (const auto& label : point->labels) {
-      labels.push_back(absl::StrFormat("%s=\"%s\"",
-                                       SanatizeLabelName(label.name),
-                                       SanitizeLabelValue(label.value)));
-    }
-    lines->push_back(absl::StrCat(name_bracket, absl::StrJoin(labels, ","),
-                                  absl::StrFormat("} %d", point->int64_value)));
+    labels.clear();
+    AppendLabels(label_names, *point, &labels);
+    writer->AppendLine(prom_metric_name, "{", labels, "} ",
+                       point->int64_value);
   }
 }
 
-void SerializeMetric(const monitoring::MetricDescriptor& metric_descriptor,
-                     const monitoring::PointSet& point_set,
-                     std::vector<string>* lines) {
-  if (metric_descriptor.value_type == monitoring::ValueType::kHistogram) {
-    SerializeHistogram(metric_descriptor, point_set, lines);
-  } else {
-    SerializeScalar(metric_descriptor, point_set, lines);
+// Returns the value of the hex digit 'c'.
+int HexDigitValue(const char c) {
+  return absl::ascii_isdigit(c) ? c - '0' : absl::ascii_tolower(c) - 'a' + 10;
+}
+
+// Sets 'unescaped' to the query parameter value 'value' with its escaped
+// characters (e.g. %2F and +) unescaped.
+Status UnescapeQueryValue(absl::string_view value, string* unescaped) {
+  unescaped->clear();
+  for (int i = 0; i < value.size(); ++i) {
+    if (value[i] == '+') {
+      unescaped->push_back(' ');
+    } else if (value[i] != '%') {
+      unescaped->push_back(value[i]);
+    } else if (i + 2 < value.size() && absl::ascii_isxdigit(value[i + 1]) &&
+               absl::ascii_isxdigit(value[i + 2])) {
+      unescaped->push_back(static_cast<char>(HexDigitValue(value[i + 1]) * 16 +
+                                             HexDigitValue(value[i + 2])));
+      i += 2;
+    } else {
+      return errors::InvalidArgument("Invalid escape in query value: ", value);
+    }
   }
+  return absl::OkStatus();
 }
 
 }  // namespace
@@ -159,12 +222,61 @@ const char* const PrometheusExporter::kPrometheusPath =
 PrometheusExporter::PrometheusExporter()
     : collection_registry_(monitoring::CollectionRegistry::Default()) {}
 
+Status PrometheusExporter::ParsePageOptions(absl::string_view query,
+                                            PageOptions* options) {
+  for (const absl::string_view param :
+       absl::StrSplit(query, '&', absl::SkipEmpty())) {
+    const std::pair<absl::string_view, absl::string_view> name_and_value =
+        absl::StrSplit(param, absl::MaxSplits('=', 1));
+    if (name_and_value.first != "model_name") {
+      continue;
+    }
+    string model_name;
+    TF_RETURN_IF_ERROR(UnescapeQueryValue(name_and_value.second, &model_name));
+    if (model_name.empty()) {
+      return errors::InvalidArgument("Empty model_name in query: ", query);
+    }
+    options->model_names.insert(std::move(model_name));
+  }
+  return absl::OkStatus();
+}
+
+string PrometheusExporter::GetMetricName(const string& name) {
+  mutex_lock l(mu_);
+  auto it = metric_names_.find(name);
+  if (it == metric_names_.end()) {
+    it = metric_names_.emplace(name, SanitizeMetricName(name)).first;
+  }
+  return it->second;
+}
+
+string PrometheusExporter::GetLabelName(const string& name) {
+  mutex_lock l(mu_);
+  auto it = label_names_.find(name);
+  if (it == label_names_.end()) {
+    it = label_names_.emplace(name, SanitizeLabelName(name)).first;
+  }
+  return it->second;
+}
+
 Status PrometheusExporter::GeneratePage(string* http_page) {
   if (http_page == nullptr) {
     return Status(
         static_cast<absl::StatusCode>(absl::StatusCode::kInvalidArgument),
         "Http page pointer is null");
   }
+  string page;
+  TF_RETURN_IF_ERROR(
+      WritePage(PageOptions(), [&page](absl::string_view chunk) {
+        page.append(chunk.data(), chunk.size());
+      }));
+  *http_page = std::move(page);
+  return absl::OkStatus();
+}
+
+Status PrometheusExporter::WritePage(
+    const PageOptions& options,
+    const std::function<void(absl::string_view)>& write) {
   monitoring::CollectionRegistry::CollectMetricsOptions collect_options;
   collect_options.collect_metric_descriptors = true;
   const std::unique_ptr<monitoring::CollectedMetrics> collected_metrics =
@@ -173,7 +285,7 @@ Status PrometheusExporter::GeneratePage(string* http_page) {
   const auto& descriptor_map = collected_metrics->metric_descriptor_map;
   const auto& metric_map = collected_metrics->point_set_map;
 
-  std::vector<string> lines;
+  PageWriter writer(write);
   for (const auto& name_and_metric_descriptor : descriptor_map) {
     const string& metric_name = name_and_metric_descriptor.first;
     auto metric_iterator = metric_map.find(metric_name);
@@ -181,11 +293,49 @@ Status PrometheusExporter::GeneratePage(string* http_page) {
       // Not found.
       continue;
     }
-    SerializeMetric(*name_and_metric_descriptor.second,
-                    *(metric_iterator->second), &lines);
+    const monitoring::MetricDescriptor& metric_descriptor =
+        *name_and_metric_descriptor.second;
+
+    std::vector<string> label_names;
+    label_names.reserve(metric_descriptor.label_names.size());
+    int model_label_index = -1;
+    for (int i = 0; i < metric_descriptor.label_names.size(); ++i) {
+      const string label_name(metric_descriptor.label_names[i]);
+      label_names.push_back(GetLabelName(label_name));
+      for (const absl::string_view model_label_name : kModelLabelNames) {
+        if (label_name == model_label_name && model_label_index < 0) {
+          model_label_index = i;
+        }
+      }
+    }
+    if (options.model_names.empty()) {
+      model_label_index = -1;
+    }
+
+    std::vector<const monitoring::Point*> points;
+    for (const auto& point : metric_iterator->second->points) {
+      if (model_label_index >= 0 &&
+          (model_label_index >= point->labels.size() ||
+           options.model_names.count(
+               point->labels[model_label_index].value) == 0)) {
+        continue;
+      }
+      points.push_back(point.get());
+    }
+    if (model_label_index >= 0 && points.empty()) {
+      // None of the requested models.
+      continue;
+    }
+
+    const string prom_metric_name = GetMetricName(metric_name);
+    if (metric_descriptor.value_type == monitoring::ValueType::kHistogram) {
+      SerializeHistogram(prom_metric_name, label_names, points, &writer);
+    } else {
+      SerializeScalar(metric_descriptor, prom_metric_name, label_names,
+                      points, &writer);
+    }
   }
-  *http_page = absl::StrJoin(lines, "\n");
-  absl::StrAppend(http_page, "\n");
+  writer.Flush();
   return absl::OkStatus();
 }
 
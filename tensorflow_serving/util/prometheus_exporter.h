@@ -16,11 +16,17 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_UTIL_PROMETHEUS_EXPORTER_H_
 #define TENSORFLOW_SERVING_UTIL_PROMETHEUS_EXPORTER_H_
 
+#include <functional>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
+#include "absl/strings/string_view.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/monitoring/collected_metrics.h"
 #include "tensorflow/core/lib/monitoring/collection_registry.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 
 namespace tensorflow {
 namespace serving {
@@ -31,16 +37,45 @@ class PrometheusExporter {
   // Default path to expose the metrics.
   static const char* const kPrometheusPath;
 
+  // Options of the exported page.
+  struct PageOptions {
+    // If not empty, the points of metrics with a model label (named
+    // "model_name" or "model") are only exported for these models. Metrics
+    // without a model label are exported as usual.
+    std::set<string> model_names;
+  };
+
   PrometheusExporter();
 
+  // Parses the page options from the query of a request URI, i.e. the part
+  // after the '?', e.g. "model_name=a&model_name=b" to only export the points
+  // of models a and b. Unknown parameters are ignored.
+  static Status ParsePageOptions(absl::string_view query,
+                                 PageOptions* options);
+
   // Generates text page in Prometheus format:
   // https://prometheus.io/docs/instrumenting/exposition_formats/#text-format-example
   // If an error status returned, http_page is unchanged.
   Status GeneratePage(string* http_page);
 
+  // Like GeneratePage(), but passes the page to 'write' in chunks of some
+  // kilobytes as it is generated, rather than at once. The chunks are only
+  // valid for the duration of the call.
+  Status WritePage(const PageOptions& options,
+                   const std::function<void(absl::string_view)>& write);
+
  private:
+  // Returns the names of metrics and labels in Prometheus format, which are
+  // cached across pages.
+  string GetMetricName(const string& name) TF_LOCKS_EXCLUDED(mu_);
+  string GetLabelName(const string& name) TF_LOCKS_EXCLUDED(mu_);
+
   // The metrics registry.
   monitoring::CollectionRegistry* collection_registry_;
+
+  mutex mu_;
+  std::unordered_map<string, string> metric_names_ TF_GUARDED_BY(mu_);
+  std::unordered_map<string, string> label_names_ TF_GUARDED_BY(mu_);
 };
 
 }  // namespace serving
@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "tensorflow_serving/util/prometheus_exporter.h"
 
+#include <set>
+#include <vector>
+
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/gauge.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
@@ -142,6 +146,84 @@ TEST(PrometheusExporterTest, SanitizeMetricName) {
   EXPECT_PRED_FORMAT2(testing::IsSubstring, expected_result, http_page);
 }
 
+TEST(PrometheusExporterTest, WritePageInChunks) {
+  auto exporter = absl::make_unique<PrometheusExporter>();
+  auto counter = absl::WrapUnique(
+      monitoring::Counter<1>::New("/test/path/total", "A counter.", "name"));
+  // Enough points for a page of more than one chunk.
+  for (int i = 0; i < 10000; ++i) {
+    counter->GetCell(absl::StrCat("abcdefghij", i))->IncrementBy(i);
+  }
+
+  std::vector<string> chunks;
+  TF_ASSERT_OK(exporter->WritePage(
+      PrometheusExporter::PageOptions(),
+      [&chunks](absl::string_view chunk) { chunks.emplace_back(chunk); }));
+  EXPECT_GT(chunks.size(), 1);
+
+  string http_page;
+  TF_ASSERT_OK(exporter->GeneratePage(&http_page));
+  EXPECT_EQ(http_page, absl::StrJoin(chunks, ""));
+  EXPECT_PRED_FORMAT2(testing::IsSubstring,
+                      ":test:path:total{name=\"abcdefghij9999\"} 9999\n",
+                      http_page);
+}
+
+TEST(PrometheusExporterTest, FilterModels) {
+  auto exporter = absl::make_unique<PrometheusExporter>();
+  auto counter = absl::WrapUnique(monitoring::Counter<2>::New(
+      "/test/path/model_total", "A counter.", "model_name", "status"));
+  counter->GetCell("a", "OK")->IncrementBy(1);
+  counter->GetCell("b", "OK")->IncrementBy(2);
+  counter->GetCell("c", "OK")->IncrementBy(3);
+  auto other_counter = absl::WrapUnique(monitoring::Counter<1>::New(
+      "/test/path/other_model_total", "A counter.", "model_name"));
+  other_counter->GetCell("c")->IncrementBy(4);
+  auto gauge = absl::WrapUnique(
+      monitoring::Gauge<int64_t, 0>::New("/test/path/gauge", "A gauge"));
+  gauge->GetCell()->Set(5);
+
+  PrometheusExporter::PageOptions options;
+  TF_ASSERT_OK(PrometheusExporter::ParsePageOptions(
+      "model_name=a&other=b&model_name=b", &options));
+  string http_page;
+  TF_ASSERT_OK(exporter->WritePage(
+      options, [&http_page](absl::string_view chunk) {
+        absl::StrAppend(&http_page, chunk);
+      }));
+
+  EXPECT_PRED_FORMAT2(
+      testing::IsSubstring,
+      absl::StrJoin({"# TYPE :test:path:model_total counter",
+                     ":test:path:model_total{model_name=\"a\",status=\"OK\"} 1",
+                     ":test:path:model_total{model_name=\"b\",status=\"OK\"} 2",
+                     ""},
+                    "\n"),
+      http_page);
+  // Metrics without a model label aren't filtered, and those with only other
+  // models left out altogether.
+  EXPECT_PRED_FORMAT2(testing::IsSubstring, ":test:path:gauge{} 5\n",
+                      http_page);
+  EXPECT_PRED_FORMAT2(testing::IsNotSubstring, "model_name=\"c\"",
+                      http_page);
+  EXPECT_PRED_FORMAT2(testing::IsNotSubstring, "other_model_total",
+                      http_page);
+}
+
+TEST(PrometheusExporterTest, ParsePageOptions) {
+  PrometheusExporter::PageOptions options;
+  TF_ASSERT_OK(PrometheusExporter::ParsePageOptions("", &options));
+  EXPECT_TRUE(options.model_names.empty());
+  TF_ASSERT_OK(PrometheusExporter::ParsePageOptions(
+      "model_name=a%2Fb&model_name=c+d", &options));
+  EXPECT_EQ(std::set<string>({"a/b", "c d"}), options.model_names);
+
+  EXPECT_FALSE(
+      PrometheusExporter::ParsePageOptions("model_name=", &options).ok());
+  EXPECT_FALSE(
+      PrometheusExporter::ParsePageOptions("model_name=a%2", &options).ok());
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
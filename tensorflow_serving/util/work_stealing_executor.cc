@@ -0,0 +1,259 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/util/work_stealing_executor.h"
+
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// Both must be powers of two.
+constexpr int64_t kInjectionQueueCapacity = 1 << 14;
+constexpr int64_t kDequeCapacity = 1 << 10;
+
+constexpr size_t kCacheLineSize = 64;
+
+// Closures scheduled by a closure which has been running for longer than this
+// go to the injection queue rather than the deque of its thread, which will
+// not pop them until the closure returns.
+constexpr std::chrono::microseconds kMaxLocalScheduleAge(200);
+
+// The executor and the index of the current thread, if it is owned by a
+// WorkStealingExecutor, and when the closure it runs started.
+thread_local const void* current_executor = nullptr;
+thread_local int current_thread_index = -1;
+thread_local std::chrono::steady_clock::time_point current_closure_start;
+
+}  // namespace
+
+// A bounded Chase-Lev deque, with the memory orderings of "Correct and
+// Efficient Work-Stealing for Weak Memory Models" (Le et al., PPoPP'13).
+// Only the owning thread may Push() and Pop(), at the bottom; any thread may
+// Steal() from the top.
+class WorkStealingExecutor::WorkStealingDeque {
+ public:
+  explicit WorkStealingDeque(int64_t capacity)
+      : mask_(capacity - 1), buffer_(new std::atomic<Closure*>[capacity]) {
+    DCHECK_EQ(capacity & mask_, 0) << "capacity must be a power of two";
+  }
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  // Returns false if the deque is full.
+  bool Push(Closure* closure) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top > mask_) {
+      return false;
+    }
+    buffer_[bottom & mask_].store(closure, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Returns the most recently pushed closure, or nullptr if the deque is
+  // empty.
+  Closure* Pop() {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    Closure* closure = buffer_[bottom & mask_].load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // The last closure, which thieves may be racing for.
+      if (!top_.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        closure = nullptr;
+      }
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return closure;
+  }
+
+  // Returns the least recently pushed closure, or nullptr if the deque is
+  // empty or another thread won the race for it.
+  Closure* Steal() {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return nullptr;
+    }
+    Closure* closure = buffer_[top & mask_].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return closure;
+  }
+
+ private:
+  const int64_t mask_;
+  const std::unique_ptr<std::atomic<Closure*>[]> buffer_;
+  alignas(kCacheLineSize) std::atomic<int64_t> top_{0};
+  alignas(kCacheLineSize) std::atomic<int64_t> bottom_{0};
+};
+
+WorkStealingExecutor::WorkStealingExecutor(Env* const env,
+                                           const string& thread_pool_name,
+                                           const int num_threads)
+    : injection_queue_(
+          new BoundedMpmcQueue<Closure>(kInjectionQueueCapacity)) {
+  CHECK_GT(num_threads, 0);
+  for (int i = 0; i < num_threads; ++i) {
+    deques_.emplace_back(new WorkStealingDeque(kDequeCapacity));
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(env->StartThread(
+        ThreadOptions(), absl::StrCat(thread_pool_name, "_", i),
+        [this, i]() { WorkLoop(i); }));
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  {
+    absl::MutexLock l(&wakeup_mu_);
+    stopping_ = true;
+    wakeup_cv_.SignalAll();
+  }
+  // Joins the threads, which only exit once all the queues are empty.
+  threads_.clear();
+}
+
+void WorkStealingExecutor::Schedule(std::function<void()> fn) {
+  auto* closure = new Closure(std::move(fn));
+  // A long-running (or blocked) closure, such as the event loop of an HTTP
+  // server, would leave the closures it schedules to be stolen one at a time,
+  // with all threads contending on the top of its deque.
+  const int index = CurrentThreadIndex();
+  const bool schedule_locally =
+      index >= 0 && std::chrono::steady_clock::now() - current_closure_start <
+                        kMaxLocalScheduleAge;
+  if (!(schedule_locally && deques_[index]->Push(closure)) &&
+      !injection_queue_->Push(closure)) {
+    absl::MutexLock l(&overflow_mu_);
+    overflow_.push_back(closure);
+    num_overflowed_.fetch_add(1, std::memory_order_relaxed);
+  }
+  MaybeWakeUpThread();
+}
+
+int WorkStealingExecutor::CurrentThreadIndex() const {
+  return current_executor == this ? current_thread_index : -1;
+}
+
+WorkStealingExecutor::Closure* WorkStealingExecutor::FindWork(const int index) {
+  Closure* closure = deques_[index]->Pop();
+  if (closure != nullptr) {
+    return closure;
+  }
+  closure = injection_queue_->Pop();
+  if (closure != nullptr) {
+    return closure;
+  }
+  if (num_overflowed_.load(std::memory_order_relaxed) > 0) {
+    absl::MutexLock l(&overflow_mu_);
+    if (!overflow_.empty()) {
+      closure = overflow_.front();
+      overflow_.pop_front();
+      num_overflowed_.fetch_sub(1, std::memory_order_relaxed);
+      return closure;
+    }
+  }
+  const int num_threads = deques_.size();
+  for (int i = 1; i < num_threads; ++i) {
+    closure = deques_[(index + i) % num_threads]->Steal();
+    if (closure != nullptr) {
+      return closure;
+    }
+  }
+  return nullptr;
+}
+
+void WorkStealingExecutor::MaybeWakeUpThread() {
+  // Pairs with the fence in WorkLoop(): either the idle thread finds the
+  // closure just scheduled, or we see it idle here and wake it up.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_idle_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  absl::MutexLock l(&wakeup_mu_);
+  if (num_pending_wakeups_ < num_idle_.load(std::memory_order_relaxed)) {
+    ++num_pending_wakeups_;
+    wakeup_cv_.Signal();
+  }
+}
+
+void WorkStealingExecutor::WorkLoop(const int index) {
+  current_executor = this;
+  current_thread_index = index;
+  while (true) {
+    Closure* closure = FindWork(index);
+    if (closure == nullptr) {
+      num_idle_.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      closure = FindWork(index);
+      if (closure == nullptr) {
+        bool stopping;
+        {
+          absl::MutexLock l(&wakeup_mu_);
+          while (num_pending_wakeups_ == 0 && !stopping_) {
+            wakeup_cv_.Wait(&wakeup_mu_);
+          }
+          stopping = num_pending_wakeups_ == 0;
+          if (!stopping) {
+            --num_pending_wakeups_;
+          }
+        }
+        num_idle_.fetch_sub(1, std::memory_order_relaxed);
+        if (!stopping) {
+          continue;
+        }
+        // Exits once there is no work left.
+        closure = FindWork(index);
+        if (closure == nullptr) {
+          break;
+        }
+      } else {
+        num_idle_.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+    current_closure_start = std::chrono::steady_clock::now();
+    (*closure)();
+    delete closure;
+  }
+  current_executor = nullptr;
+  current_thread_index = -1;
+}
+
+}  // namespace serving
+}  // namespace tensorflow
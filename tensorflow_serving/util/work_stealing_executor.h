@@ -0,0 +1,111 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_UTIL_WORK_STEALING_EXECUTOR_H_
+#define TENSORFLOW_SERVING_UTIL_WORK_STEALING_EXECUTOR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow_serving/util/bounded_mpmc_queue.h"
+#include "tensorflow_serving/util/executor.h"
+
+namespace tensorflow {
+namespace serving {
+
+// An executor which runs the scheduled closures on a fixed set of threads,
+// without a lock on the scheduling or execution fast paths.
+//
+// Closures scheduled from outside the executor go to a global, lock-free
+// injection queue. Closures scheduled by a short-lived closure running on the
+// executor go to the deque of that thread, which pops them in LIFO order once
+// the closure returns, while idle threads steal from the other end. Closures
+// scheduled by a closure that has been running for a while (e.g. the event
+// loop of an HTTP server run on the executor, or a closure blocked on others)
+// go to the injection queue instead, as its thread would not get to them.
+// Threads look for work in their own deque, then the injection queue, then the
+// deques of the other threads, and only block once all of them are empty.
+//
+// Closures are not guaranteed to run in the order they are scheduled.
+class WorkStealingExecutor : public Executor {
+ public:
+  // Constructs an executor with 'num_threads' threads named after
+  // 'thread_pool_name'. Env is used to start the threads.
+  //
+  // REQUIRES: num_threads > 0.
+  WorkStealingExecutor(Env* env, const string& thread_pool_name,
+                       int num_threads);
+
+  // Waits until all scheduled work has finished and then destroys the set of
+  // threads.
+  ~WorkStealingExecutor() override;
+
+  void Schedule(std::function<void()> fn) override;
+
+ private:
+  class WorkStealingDeque;
+  using Closure = std::function<void()>;
+
+  // Returns the index of the calling thread if it is owned by this executor,
+  // and -1 otherwise.
+  int CurrentThreadIndex() const;
+
+  // Pops or steals a closure from any of the queues, or returns nullptr if
+  // they were all found empty. 'index' is the index of the calling thread.
+  Closure* FindWork(int index);
+
+  // Wakes up a blocked thread, if any.
+  void MaybeWakeUpThread();
+
+  // The body of each thread.
+  void WorkLoop(int index);
+
+  std::unique_ptr<BoundedMpmcQueue<Closure>> injection_queue_;
+  std::vector<std::unique_ptr<WorkStealingDeque>> deques_;
+
+  // Closures which did not fit in the (bounded) injection queue or in the
+  // deque of the scheduling thread. 'num_overflowed_' lets threads skip the
+  // lock while there are none, which is the common case.
+  absl::Mutex overflow_mu_;
+  std::deque<Closure*> overflow_ ABSL_GUARDED_BY(overflow_mu_);
+  std::atomic<int64_t> num_overflowed_{0};
+
+  // Threads block on 'wakeup_cv_' once they found all queues empty.
+  // 'num_idle_' counts the threads that are looking for work for the last time
+  // before blocking or are blocked, so that Schedule() only takes 'wakeup_mu_'
+  // if some thread needs to be woken up.
+  std::atomic<int> num_idle_{0};
+  absl::Mutex wakeup_mu_;
+  absl::CondVar wakeup_cv_;
+  int num_pending_wakeups_ ABSL_GUARDED_BY(wakeup_mu_) = 0;
+  bool stopping_ ABSL_GUARDED_BY(wakeup_mu_) = false;
+
+  std::vector<std::unique_ptr<Thread>> threads_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(WorkStealingExecutor);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_UTIL_WORK_STEALING_EXECUTOR_H_
@@ -0,0 +1,262 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks for the scheduling latency of WorkStealingExecutor against
+// ThreadPoolExecutor, which serves the HTTP/REST API by default.
+//
+// Closures are scheduled from a few threads at once, like the event loops of
+// the HTTP server do, and each one spins for a short while to simulate a
+// (cheap) request handler. Every closure records the time from its Schedule()
+// call until it starts running, and the percentiles of that latency are
+// reported as the label of each benchmark.
+//
+// The scheduling threads are either a separate thread pool, or (as in the
+// HTTP server) long-running closures on the executor itself, which then has
+// that many fewer threads left to run the scheduled closures.
+//
+// Run with:
+// bazel run -c opt \
+// tensorflow_serving/util:work_stealing_executor_benchmark --
+// --benchmarks=.
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow_serving/util/threadpool_executor.h"
+#include "tensorflow_serving/util/work_stealing_executor.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// The number of closures each scheduling thread schedules per iteration.
+constexpr int kClosuresPerScheduler = 1000;
+
+// How long each closure spins for.
+constexpr int64_t kWorkNanos = 2000;
+
+void SpinFor(int64_t nanos) {
+  const int64_t end_nanos = absl::GetCurrentTimeNanos() + nanos;
+  while (absl::GetCurrentTimeNanos() < end_nanos) {
+  }
+}
+
+// Returns the 'percentile' (in [0, 100]) of the sorted 'values'.
+int64_t Percentile(const std::vector<int64_t>& values, double percentile) {
+  const size_t index = std::min(
+      values.size() - 1, static_cast<size_t>(values.size() * percentile / 100));
+  return values[index];
+}
+
+// Runs 'num_loops' closures on an executor until destroyed, which like the
+// event loops of the HTTP server wait for work and then schedule closures on
+// the same executor.
+class EventLoops {
+ public:
+  // Each loop 'i' runs 'fn(i)' once per call to Run().
+  EventLoops(Executor* executor, int num_loops, std::function<void(int)> fn)
+      : fn_(std::move(fn)), num_loops_done_(num_loops) {
+    for (int i = 0; i < num_loops; ++i) {
+      executor->Schedule([this, i]() { Loop(i); });
+    }
+  }
+
+  ~EventLoops() {
+    {
+      absl::MutexLock l(&mu_);
+      stopping_ = true;
+    }
+    num_loops_done_.Wait();
+  }
+
+  // Lets each loop run 'fn' once more, without waiting for it.
+  void Run() {
+    absl::MutexLock l(&mu_);
+    ++generation_;
+  }
+
+ private:
+  void Loop(int index) {
+    int64_t generation = 0;
+    while (true) {
+      {
+        absl::MutexLock l(&mu_);
+        const auto ready = [this, &generation]()
+                               ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+                                 return stopping_ || generation_ > generation;
+                               };
+        mu_.Await(absl::Condition(&ready));
+        if (stopping_) {
+          break;
+        }
+        ++generation;
+      }
+      fn_(index);
+    }
+    num_loops_done_.DecrementCount();
+  }
+
+  const std::function<void(int)> fn_;
+  absl::Mutex mu_;
+  int64_t generation_ ABSL_GUARDED_BY(mu_) = 0;
+  bool stopping_ ABSL_GUARDED_BY(mu_) = false;
+  absl::BlockingCounter num_loops_done_;
+};
+
+// If 'event_loops', the scheduling threads are long-running closures on the
+// executor, which has 'num_threads' threads in total.
+template <typename ExecutorType, bool event_loops>
+void BM_ScheduleLatency(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const int num_schedulers = state.range(1);
+  CHECK_GT(num_threads, 0);
+  CHECK_GT(num_schedulers, 0);
+  if (event_loops) {
+    CHECK_GT(num_threads, num_schedulers);
+  }
+
+  ExecutorType executor(Env::Default(), "BM_ScheduleLatency", num_threads);
+
+  const int num_closures = num_schedulers * kClosuresPerScheduler;
+  std::vector<int64_t> latencies_nanos;
+  std::vector<int64_t> iteration_latencies_nanos(num_closures);
+  std::unique_ptr<absl::BlockingCounter> done;
+
+  const auto schedule_closures = [&](int i) {
+    for (int j = 0; j < kClosuresPerScheduler; ++j) {
+      int64_t* latency_nanos =
+          &iteration_latencies_nanos[i * kClosuresPerScheduler + j];
+      const int64_t schedule_nanos = absl::GetCurrentTimeNanos();
+      absl::BlockingCounter* iteration_done = done.get();
+      executor.Schedule([iteration_done, latency_nanos, schedule_nanos]() {
+        *latency_nanos = absl::GetCurrentTimeNanos() - schedule_nanos;
+        SpinFor(kWorkNanos);
+        iteration_done->DecrementCount();
+      });
+    }
+  };
+  std::unique_ptr<thread::ThreadPool> schedulers;
+  std::unique_ptr<EventLoops> loops;
+  if (event_loops) {
+    loops.reset(new EventLoops(&executor, num_schedulers, schedule_closures));
+  } else {
+    schedulers.reset(new thread::ThreadPool(
+        Env::Default(), "BM_ScheduleLatency_Scheduler", num_schedulers));
+  }
+
+  for (auto s : state) {
+    done.reset(new absl::BlockingCounter(num_closures));
+    if (event_loops) {
+      loops->Run();
+    } else {
+      for (int i = 0; i < num_schedulers; ++i) {
+        schedulers->Schedule([&schedule_closures, i]() {
+          schedule_closures(i);
+        });
+      }
+    }
+    done->Wait();
+
+    state.PauseTiming();
+    latencies_nanos.insert(latencies_nanos.end(),
+                           iteration_latencies_nanos.begin(),
+                           iteration_latencies_nanos.end());
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(num_closures * state.iterations());
+  // Stops the loops before the executor.
+  loops.reset();
+
+  std::sort(latencies_nanos.begin(), latencies_nanos.end());
+  state.SetLabel(absl::StrCat(
+      "latency_us p50=", Percentile(latencies_nanos, 50) / 1000,
+      " p99=", Percentile(latencies_nanos, 99) / 1000,
+      " p99.9=", Percentile(latencies_nanos, 99.9) / 1000,
+      " max=", latencies_nanos.back() / 1000));
+}
+
+void BM_ThreadPoolExecutor(::testing::benchmark::State& state) {
+  BM_ScheduleLatency<ThreadPoolExecutor, false>(state);
+}
+
+void BM_WorkStealingExecutor(::testing::benchmark::State& state) {
+  BM_ScheduleLatency<WorkStealingExecutor, false>(state);
+}
+
+void BM_ThreadPoolExecutorEventLoops(::testing::benchmark::State& state) {
+  BM_ScheduleLatency<ThreadPoolExecutor, true>(state);
+}
+
+void BM_WorkStealingExecutorEventLoops(::testing::benchmark::State& state) {
+  BM_ScheduleLatency<WorkStealingExecutor, true>(state);
+}
+
+// Args are {number of executor threads, number of scheduling threads}. Uses
+// real time, as the CPU time would include the time spent by all threads.
+
+BENCHMARK(BM_ThreadPoolExecutor)
+    ->UseRealTime()
+    ->ArgPair(4, 1)
+    ->ArgPair(4, 4)
+    ->ArgPair(16, 4)
+    ->ArgPair(64, 4)
+    ->ArgPair(64, 16);
+
+BENCHMARK(BM_WorkStealingExecutor)
+    ->UseRealTime()
+    ->ArgPair(4, 1)
+    ->ArgPair(4, 4)
+    ->ArgPair(16, 4)
+    ->ArgPair(64, 4)
+    ->ArgPair(64, 16);
+
+BENCHMARK(BM_ThreadPoolExecutorEventLoops)
+    ->UseRealTime()
+    ->ArgPair(4, 1)
+    ->ArgPair(8, 4)
+    ->ArgPair(16, 4)
+    ->ArgPair(64, 4)
+    ->ArgPair(64, 16);
+
+BENCHMARK(BM_WorkStealingExecutorEventLoops)
+    ->UseRealTime()
+    ->ArgPair(4, 1)
+    ->ArgPair(8, 4)
+    ->ArgPair(16, 4)
+    ->ArgPair(64, 4)
+    ->ArgPair(64, 16);
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  tensorflow::testing::RunBenchmarks();
+  return 0;
+}
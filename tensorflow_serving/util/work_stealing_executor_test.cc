@@ -0,0 +1,154 @@
+/* Copyright 2023 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/util/work_stealing_executor.h"
+
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
+#include <functional>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/notification.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+constexpr int kNumThreads = 30;
+
+TEST(WorkStealingExecutor, Empty) {
+  for (int num_threads = 1; num_threads < kNumThreads; num_threads++) {
+    LOG(INFO) << "Testing with " << num_threads << " threads";
+    WorkStealingExecutor executor(Env::Default(), "test", num_threads);
+  }
+}
+
+TEST(WorkStealingExecutor, DoWork) {
+  for (int num_threads = 1; num_threads < kNumThreads; num_threads++) {
+    LOG(INFO) << "Testing with " << num_threads << " threads";
+    const int kWorkItems = 15;
+    // Not using std::vector<bool> due to its unusual implementation and API -
+    // http://en.cppreference.com/w/cpp/container/vector_bool
+    bool work[kWorkItems];
+    for (int i = 0; i < kWorkItems; ++i) {
+      work[i] = false;
+    }
+    {
+      WorkStealingExecutor executor(Env::Default(), "test", num_threads);
+      for (int i = 0; i < kWorkItems; i++) {
+        executor.Schedule([&work, i]() {
+          ASSERT_FALSE(work[i]);
+          work[i] = true;
+        });
+      }
+    }
+    for (int i = 0; i < kWorkItems; i++) {
+      ASSERT_TRUE(work[i]);
+    }
+  }
+}
+
+// Schedules more work than fits in the injection queue from several threads
+// at once.
+TEST(WorkStealingExecutor, ConcurrentSchedule) {
+  const int kNumSchedulers = 8;
+  const int kWorkItemsPerScheduler = 20000;
+  std::atomic<int> num_done(0);
+  {
+    WorkStealingExecutor executor(Env::Default(), "test", 4);
+    std::vector<std::thread> schedulers;
+    for (int i = 0; i < kNumSchedulers; ++i) {
+      schedulers.emplace_back([&]() {
+        for (int j = 0; j < kWorkItemsPerScheduler; ++j) {
+          executor.Schedule([&num_done]() { num_done++; });
+        }
+      });
+    }
+    for (auto& scheduler : schedulers) {
+      scheduler.join();
+    }
+  }
+  EXPECT_EQ(kNumSchedulers * kWorkItemsPerScheduler, num_done.load());
+}
+
+// Closures scheduled from the executor go to the deque of the scheduling
+// thread, from which the other threads steal them while it is busy.
+TEST(WorkStealingExecutor, StealWork) {
+  const int kWorkItems = 100;
+  WorkStealingExecutor executor(Env::Default(), "test", 4);
+  absl::BlockingCounter done(kWorkItems);
+  absl::Notification scheduling_thread_done;
+  executor.Schedule([&]() {
+    for (int i = 0; i < kWorkItems; ++i) {
+      executor.Schedule([&done]() { done.DecrementCount(); });
+    }
+    // Never returns if the closures aren't stolen.
+    done.Wait();
+    scheduling_thread_done.Notify();
+  });
+  scheduling_thread_done.WaitForNotification();
+}
+
+// Like the event loops of the HTTP server, long-running closures keep
+// scheduling closures while they run, which then run on the other threads.
+TEST(WorkStealingExecutor, ScheduleFromLongRunningClosures) {
+  const int kNumLoops = 2;
+  const int kWorkItems = 10000;
+  WorkStealingExecutor executor(Env::Default(), "test", kNumLoops + 2);
+  absl::BlockingCounter done(kNumLoops * kWorkItems);
+  absl::BlockingCounter loops_done(kNumLoops);
+  for (int i = 0; i < kNumLoops; ++i) {
+    executor.Schedule([&]() {
+      for (int j = 0; j < kWorkItems; ++j) {
+        executor.Schedule([&done]() { done.DecrementCount(); });
+        if (j % 1000 == 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+      loops_done.DecrementCount();
+    });
+  }
+  loops_done.Wait();
+  done.Wait();
+}
+
+// Nested scheduling keeps working past the capacity of a thread's deque.
+TEST(WorkStealingExecutor, RecursiveSchedule) {
+  const int kDepth = 2;
+  const int kFanOut = 1200;
+  std::atomic<int> num_done(0);
+  std::function<void(int)> fan_out;
+  {
+    WorkStealingExecutor executor(Env::Default(), "test", 3);
+    fan_out = [&](int depth) {
+      num_done++;
+      if (depth == kDepth) {
+        return;
+      }
+      for (int i = 0; i < kFanOut; ++i) {
+        executor.Schedule([&fan_out, depth]() { fan_out(depth + 1); });
+      }
+    };
+    executor.Schedule([&fan_out]() { fan_out(0); });
+  }
+  EXPECT_EQ(1 + kFanOut + kFanOut * kFanOut, num_done.load());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow